@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/FileSystem.h"
+
+/**
+ * Measures the operations of FileSystem on generated fixture trees of different shapes: loading a directory and walking
+ * a tree, selecting, copying, concatenating, searching the contents, deduplicating and browsing a tar archive of the
+ * tree. The fixtures come from a fixed
+ * seed, so every run measures the same files; each benchmark runs once to warm the page cache and then BENCH_REPEAT
+ * times (5 by default), the median and the minimum are printed. BENCH_FILTER=text runs only the benchmarks whose
+ * fixture/name contains the text, BENCH_DIRECTORY sets where the fixtures are generated instead of /tmp.
+ */
+
+namespace
+{
+    /**
+     * @brief The shape of a generated tree.
+     */
+    struct Fixture
+    {
+        const char *name; /**< The name printed in the results. */
+        size_t depth; /**< The number of directory levels below the root. */
+        size_t fanOut; /**< The subdirectories of every directory above the last level. */
+        size_t filesPerDirectory; /**< The files in every directory. */
+        uintmax_t maximalFileSize; /**< The largest file, sizes are spread log-uniformly up to it. */
+        double duplicateShare; /**< The share of files that copy the contents of an earlier file. */
+    };
+
+    /**
+     * @brief What a benchmark works on.
+     */
+    struct Generated
+    {
+        fs::path root; /**< The root of the tree. */
+        std::vector<fs::path> files; /**< Every regular file. */
+        uintmax_t bytes = 0; /**< The size of all the files. */
+    };
+
+    const std::vector<Fixture> fixtures =
+    {
+        {"flat", 0, 0, 20000, 16 * 1024, 0.1},
+        {"deep", 6, 4, 2, 4 * 1024, 0.1},
+        {"mixed", 2, 8, 16, 1024 * 1024, 0.3}
+    };
+
+    const std::string needle = "needle-0xC0FFEE";
+
+    std::string generateContents(std::mt19937_64 &generator, uintmax_t size)
+    {
+        static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz      \n";
+        std::string contents(size, ' ');
+        for(uintmax_t i = 0; i < size; i += 8)
+        {
+            uint64_t random = generator();
+            for(uintmax_t j = i; j < std::min<uintmax_t>(i + 8, size); j++, random >>= 8)
+            {
+                contents[j] = alphabet[(random & 0xff) % (sizeof(alphabet) - 1)];
+            }
+        }
+        // One file in ten contains the needle the text searches look for
+        if(size > needle.size() && generator() % 10 == 0)
+        {
+            contents.replace(generator() % (size - needle.size()), needle.size(), needle);
+        }
+        return contents;
+    }
+
+    void generateDirectory(const Fixture &fixture, const fs::path &directory, size_t level, std::mt19937_64 &generator,
+                           Generated &generated, std::vector<std::string> &written)
+    {
+        fs::create_directories(directory);
+        std::uniform_real_distribution<double> logSize(0, std::log(double(fixture.maximalFileSize)));
+        std::uniform_real_distribution<double> share(0, 1);
+        for(size_t i = 0; i < fixture.filesPerDirectory; i++)
+        {
+            // Names are unique in the whole tree, so files of all the directories can be copied into one
+            fs::path path = directory / ("file-" + std::to_string(generated.files.size()) + (i % 3 ? ".txt" : ".log"));
+            std::string contents;
+            if(!written.empty() && share(generator) < fixture.duplicateShare)
+                contents = written[generator() % written.size()];
+            else
+                contents = generateContents(generator, uintmax_t(std::exp(logSize(generator))));
+
+            std::ofstream(path, std::ios::binary) << contents;
+            generated.files.push_back(path);
+            generated.bytes += contents.size();
+            // Only small files are kept as sources of duplicates, so generating stays within memory
+            if(contents.size() <= 64 * 1024 || written.size() < 16)
+                written.push_back(std::move(contents));
+        }
+
+        for(size_t i = 0; level < fixture.depth && i < fixture.fanOut; i++)
+        {
+            generateDirectory(fixture, directory / ("directory-" + std::to_string(i)), level + 1, generator, generated, written);
+        }
+    }
+
+    Generated generate(const Fixture &fixture, const fs::path &root)
+    {
+        Generated generated;
+        generated.root = root;
+        std::mt19937_64 generator(42);
+        std::vector<std::string> written;
+        generateDirectory(fixture, root, 0, generator, generated, written);
+        return generated;
+    }
+
+    void writeTarHeader(std::ofstream &output, const std::string &name, char type, uintmax_t size)
+    {
+        char header[512] = {};
+        std::memcpy(header, name.data(), std::min<size_t>(name.size(), 100));
+        std::snprintf(header + 100, 8, "%07o", 0644);
+        std::snprintf(header + 108, 8, "%07o", 0);
+        std::snprintf(header + 116, 8, "%07o", 0);
+        std::snprintf(header + 124, 12, "%011jo", size);
+        std::snprintf(header + 136, 12, "%011o", 0);
+        header[156] = type;
+        std::memcpy(header + 257, "ustar", 6);
+        std::memcpy(header + 263, "00", 2);
+
+        // The checksum is computed with its own field filled with spaces
+        std::memset(header + 148, ' ', 8);
+        unsigned checksum = 0;
+        for(unsigned char byte : header)
+        {
+            checksum += byte;
+        }
+        std::snprintf(header + 148, 7, "%06o", checksum);
+        output.write(header, sizeof(header));
+    }
+
+    void padTarBlock(std::ofstream &output, uintmax_t size)
+    {
+        static const char zeros[512] = {};
+        output.write(zeros, (512 - size % 512) % 512);
+    }
+
+    /**
+     * @brief Writes the regular files of the tree into a tar archive, the directories are only implied by their paths.
+     */
+    void writeArchive(const Generated &generated, const fs::path &archive)
+    {
+        std::ofstream output(archive, std::ios::binary | std::ios::trunc);
+        for(const auto& path : generated.files)
+        {
+            std::string name = path.lexically_relative(generated.root).string();
+            if(name.size() > 100)
+            {
+                // A GNU long name precedes the header of the member
+                writeTarHeader(output, "././@LongLink", 'L', name.size() + 1);
+                output.write(name.c_str(), name.size() + 1);
+                padTarBlock(output, name.size() + 1);
+            }
+
+            std::ifstream input(path, std::ios::binary);
+            std::string contents((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+            writeTarHeader(output, name, '0', contents.size());
+            output.write(contents.data(), contents.size());
+            padTarBlock(output, contents.size());
+        }
+        static const char end[1024] = {};
+        output.write(end, sizeof(end));
+    }
+
+    /**
+     * @brief Runs benchmarks and prints their results.
+     */
+    class Runner
+    {
+    public:
+        Runner(size_t repetitions, std::string filter) : m_repetitions(repetitions), m_filter(std::move(filter))
+        {
+        }
+
+        /**
+         * @brief Runs a benchmark, the setup before every repetition is not measured.
+         * @return False if the filter skipped it.
+         */
+        bool run(const std::string &fixture, const std::string &name, const Generated &generated,
+                 const std::function<void()> &setUp, const std::function<void()> &measured)
+        {
+            std::string fullName = fixture + "/" + name;
+            if(fullName.find(m_filter) == std::string::npos)
+                return false;
+
+            std::vector<double> seconds;
+            for(size_t repetition = 0; repetition <= m_repetitions; repetition++)
+            {
+                setUp();
+                auto start = std::chrono::steady_clock::now();
+                measured();
+                // The first repetition warms the page cache and the allocator
+                if(repetition > 0)
+                    seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+
+            std::sort(seconds.begin(), seconds.end());
+            double median = seconds[seconds.size() / 2];
+            std::cout << fixture << ", " << name << ", " << generated.files.size() << ", " << generated.bytes << ", "
+                      << median * 1000 << ", " << seconds.front() * 1000 << ", " << generated.files.size() / median << ", "
+                      << generated.bytes / median / 1e6 << std::endl;
+            return true;
+        }
+
+    private:
+        size_t m_repetitions;
+        std::string m_filter;
+    };
+
+    void selectAll(FileSystem &fileSystem)
+    {
+        for(int i = 0; i < fileSystem.filesInCurrentDirectory(); i++)
+        {
+            fileSystem.setSelectedAt(i);
+        }
+    }
+}
+
+int main()
+{
+    const char *repeat = std::getenv("BENCH_REPEAT");
+    const char *filter = std::getenv("BENCH_FILTER");
+    const char *directory = std::getenv("BENCH_DIRECTORY");
+    Runner runner(repeat ? std::max(1, std::atoi(repeat)) : 5, filter ? filter : "");
+
+    std::string pattern = (fs::path(directory ? directory : "/tmp") / "yakubleo-bench-XXXXXX").string();
+    if(!::mkdtemp(pattern.data()))
+    {
+        std::cerr << "Cannot create " << pattern << '\n';
+        return 1;
+    }
+    const fs::path workDirectory = pattern;
+
+    // The caches, the index and the trash of the benchmarks stay in the work directory, away from the user's
+    setenv("XDG_CACHE_HOME", (workDirectory / "cache").c_str(), 1);
+    setenv("XDG_DATA_HOME", (workDirectory / "data").c_str(), 1);
+
+    bool isCorrect = true;
+    std::cout << "fixture, benchmark, files, bytes, median ms, minimum ms, files/s, MB/s\n";
+    for(const auto& fixture : fixtures)
+    {
+        const Generated generated = generate(fixture, workDirectory / fixture.name);
+        const fs::path copies = workDirectory / "copies";
+        FileSystem fileSystem(generated.root);
+        auto resetCopies = [&copies] { fs::remove_all(copies); fs::create_directories(copies); };
+        auto loadAll = [&] { fileSystem.loadPaths(generated.files); };
+        auto nothing = [] {};
+
+        runner.run(fixture.name, "load-directory", generated, [&] { fileSystem.clearFileSystem(); },
+                   [&] { fileSystem.loadFiles(generated.root); });
+
+        bool isWalked = runner.run(fixture.name, "walk-tree", generated, nothing, [&]
+        {
+            fileSystem.startFind(generated.root, "type:f");
+            while(fileSystem.isFinding())
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            fileSystem.loadFoundFiles();
+        });
+        isCorrect = isCorrect && (!isWalked || size_t(fileSystem.filesInCurrentDirectory()) == generated.files.size());
+
+        loadAll();
+        runner.run(fixture.name, "select-all", generated, [&] { fileSystem.deSelectAllFiles(); }, [&] { selectAll(fileSystem); });
+        runner.run(fixture.name, "select-regex", generated, [&] { fileSystem.deSelectAllFiles(); },
+                   [&] { fileSystem.selectOnRegex("file-[0-9]*7\\.log"); });
+
+        runner.run(fixture.name, "copy", generated, [&] { resetCopies(); selectAll(fileSystem); },
+                   [&] { fileSystem.copySelectedFiles(copies); });
+
+        runner.run(fixture.name, "concatenate", generated, [&] { selectAll(fileSystem); }, [&]
+        {
+            std::ofstream output(copies / "concatenated", std::ios::binary | std::ios::trunc);
+            fileSystem.appendSelectedFilesTo(output);
+        });
+        fileSystem.deSelectAllFiles();
+
+        AhoCorasick automaton({needle, "zzzzzz", "qqqqq"});
+        runner.run(fixture.name, "search-text", generated, [&] { fileSystem.deSelectAllFiles(); },
+                   [&] { fileSystem.selectOnPatterns(automaton); });
+        runner.run(fixture.name, "search-regex", generated, [&] { fileSystem.deSelectAllFiles(); },
+                   [&] { fileSystem.selectOnRegexText("needle-0x[0-9A-F]+"); });
+
+        // Every repetition hashes again: a new file system with an empty hash cache and a fresh copy of the tree
+        const fs::path deduplicated = workDirectory / "deduplicated";
+        runner.run(fixture.name, "deduplicate", generated, [&]
+        {
+            fs::remove_all(workDirectory / "cache");
+            fs::remove_all(deduplicated);
+            fs::copy(generated.root, deduplicated, fs::copy_options::recursive);
+        }, [&]
+        {
+            FileSystem freshFileSystem(deduplicated);
+            std::vector<DuplicateGroup> groups = freshFileSystem.findDuplicatesIn(deduplicated);
+            DeduplicationResult result = freshFileSystem.deduplicateGroups(groups, Deduplicator::HARD_LINK);
+            isCorrect = isCorrect && !groups.empty() && result.failures == 0;
+        });
+
+        // The index is built again in every repetition of archive-index and loaded from its file in archive-index-cached
+        const fs::path archive = workDirectory / (std::string(fixture.name) + ".tar");
+        writeArchive(generated, archive);
+        auto removeIndex = [&]
+        {
+            fileSystem.closeArchive();
+            fs::remove(TarArchive::indexPathOf(archive));
+            fs::remove_all(workDirectory / "cache");
+        };
+        runner.run(fixture.name, "archive-index", generated, removeIndex, [&] { fileSystem.loadArchive(archive, ""); });
+        runner.run(fixture.name, "archive-index-cached", generated, [&] { fileSystem.closeArchive(); },
+                   [&] { fileSystem.loadArchive(archive, ""); });
+
+        BatchResult extracted;
+        bool isExtracted = runner.run(fixture.name, "archive-extract", generated, [&]
+        {
+            resetCopies();
+            fileSystem.loadArchive(archive, "");
+            selectAll(fileSystem);
+        }, [&] { extracted = fileSystem.extractSelectedMembers(copies); });
+        isCorrect = isCorrect && (!isExtracted || (extracted.failures == 0 && extracted.bytes == generated.bytes));
+
+        fileSystem.clearFileSystem();
+        fileSystem.closeArchive();
+        fs::remove(archive);
+        fs::remove(TarArchive::indexPathOf(archive));
+        fs::remove_all(deduplicated);
+        fs::remove_all(copies);
+        fs::remove_all(generated.root);
+    }
+
+    fs::remove_all(workDirectory);
+    if(!isCorrect)
+        std::cerr << "A benchmark gave a wrong result\n";
+    return isCorrect ? 0 : 1;
+}
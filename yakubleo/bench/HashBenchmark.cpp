@@ -0,0 +1,75 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../src/FastHash.h"
+
+/**
+ * Measures the throughput of every FastHash code path the CPU supports
+ * and checks that all of them give the same hash, whatever the split of the input.
+ */
+
+int main()
+{
+    const size_t inputSize = 256 * 1024 * 1024;
+    const size_t updateSize = 1024 * 1024;
+    const int repetitions = 5;
+
+    std::vector<uint8_t> input(inputSize);
+    std::mt19937_64 generator(42);
+    for(size_t i = 0; i < inputSize; i += 8)
+    {
+        uint64_t value = generator();
+        std::memcpy(input.data() + i, &value, 8);
+    }
+
+    bool agree = true;
+    ContentHash reference = FastHash::hash(input.data(), input.size());
+
+    std::cout << "implementation, GB/s\n";
+    for(FastHash::Implementation implementation : {FastHash::SCALAR, FastHash::SSE2, FastHash::AVX2})
+    {
+        if(!FastHash::isSupported(implementation))
+        {
+            std::cout << FastHash::name(implementation) << ", unsupported\n";
+            continue;
+        }
+
+        double bestSeconds = 1e30;
+        ContentHash result;
+        for(int repetition = 0; repetition < repetitions; repetition++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            FastHash hasher(implementation);
+            for(size_t offset = 0; offset < inputSize; offset += updateSize)
+            {
+                hasher.update(input.data() + offset, updateSize);
+            }
+            result = hasher.digest();
+            bestSeconds = std::min(bestSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        agree = agree && result == reference;
+        std::cout << FastHash::name(implementation) << ", " << inputSize / bestSeconds / 1e9 << '\n';
+
+        // Odd splits and lengths around the internal buffer sizes
+        for(size_t length : {0, 1, 15, 16, 17, 240, 241, 255, 256, 257, 1023, 1024, 1025, 4096 + 13})
+        {
+            ContentHash oneShot = FastHash::hash(input.data(), length);
+            FastHash hasher(implementation);
+            for(size_t offset = 0; offset < length; offset += 7)
+            {
+                hasher.update(input.data() + offset, std::min<size_t>(7, length - offset));
+            }
+            agree = agree && hasher.digest() == oneShot;
+        }
+    }
+
+    if(!agree)
+    {
+        std::cerr << "Code paths or input splits disagree on the hash\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <chrono>
+#include <iostream>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../src/Regex.h"
+#include "../src/RegexMatcher.h"
+
+/**
+ * Compares RegexMatcher with std::regex_match on generated file names
+ * and checks that both agree on every name, and on anchors, alternations and nested groups
+ * with std::regex_search too.
+ */
+
+namespace
+{
+    std::vector<std::string> generateNames(size_t count)
+    {
+        const char *extensions[] = {".txt", ".log", ".cpp", ".h", ".tar.gz", ""};
+        std::vector<std::string> names;
+        names.reserve(count);
+        for(size_t i = 0; i < count; i++)
+        {
+            names.push_back((i % 3 == 0 ? "file_" : i % 3 == 1 ? "log-2024-" : "aaaaaaaaaaaaaaaaaaaaaaaaa") + std::to_string(i) + extensions[i % 6]);
+        }
+        return names;
+    }
+
+    template <typename Function>
+    double secondsOf(Function function)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main()
+{
+    const std::vector<std::string> names = generateNames(200000);
+    const std::vector<std::string> patterns = {
+        "file_.*\\.txt",
+        ".*\\.(log|cpp)",
+        "log-2024-[0-9]+\\.log",
+        "[a-z_]+[0-9]{3,5}\\..*",
+    };
+
+    bool agree = true;
+    std::cout << "pattern, entries, std::regex ms, Regex ms, speedup\n";
+    for(const auto& pattern : patterns)
+    {
+        std::regex standard(pattern);
+        Regex regex(pattern);
+        RegexMatcher matcher(regex, RegexMatcher::FULL_MATCH);
+
+        std::vector<bool> standardResults(names.size());
+        std::vector<bool> results(names.size());
+
+        size_t standardCount = names.size();
+
+        double standardSeconds = secondsOf([&]
+        {
+            for(size_t i = 0; i < standardCount; i++)
+                standardResults[i] = std::regex_match(names[i], standard);
+        });
+        double seconds = secondsOf([&]
+        {
+            for(size_t i = 0; i < names.size(); i++)
+                results[i] = matcher.matches(names[i]);
+        });
+
+        for(size_t i = 0; i < standardCount; i++)
+        {
+            if(standardResults[i] != results[i])
+            {
+                std::cerr << "Mismatch for " << pattern << " on " << names[i] << '\n';
+                agree = false;
+            }
+        }
+
+        double standardPerEntry = standardSeconds / standardCount;
+        double perEntry = seconds / names.size();
+        std::cout << pattern << ", " << names.size() << ", " << standardPerEntry * names.size() * 1000 << ", "
+                  << seconds * 1000 << ", " << standardPerEntry / perEntry << "x\n";
+    }
+
+    // Backtracking makes this pattern exponential in the length of the input
+    std::cout << "\npathological (a*)*b, input length, std::regex ms, Regex ms\n";
+    Regex pathological("(a*)*b");
+    RegexMatcher pathologicalMatcher(pathological, RegexMatcher::FULL_MATCH);
+    std::regex standardPathological("(a*)*b");
+    for(size_t length : {8, 12, 14})
+    {
+        std::string input(length, 'a');
+        bool standardResult = false;
+        bool result = true;
+        double standardSeconds = secondsOf([&] { standardResult = std::regex_match(input, standardPathological); });
+        double seconds = secondsOf([&] { result = pathologicalMatcher.matches(input); });
+        agree = agree && standardResult == result;
+        std::cout << length << ", " << standardSeconds * 1000 << ", " << seconds * 1000 << '\n';
+    }
+    std::string longInput(1 << 20, 'a');
+    double seconds = secondsOf([&] { agree = agree && !pathologicalMatcher.matches(longInput); });
+    std::cout << longInput.size() << ", -, " << seconds * 1000 << '\n';
+
+    // Anchors anywhere in the pattern, they bind to one alternative only
+    const std::vector<std::string> anchoredPatterns = {
+        "^ab|xyz", "ab|xy$", "a\\\\$", "^$", "(^a|b)c", "a(b$|c)", "^(a|b)*$", "(^|a)b", "x^", "\\$",
+        std::string(200, '(') + "a|b" + std::string(200, ')') + "$",
+    };
+    const std::vector<std::string> texts = {"", "ab", "zzxyzzz", "abqq", "a\\", "xyz", "ac", "bc", "cab", "aab", "b", "ab$", "$"};
+    size_t checked = 0;
+    for(const auto& pattern : anchoredPatterns)
+    {
+        std::regex standard(pattern);
+        Regex regex(pattern);
+        RegexMatcher search(regex, RegexMatcher::SEARCH);
+        RegexMatcher full(regex, RegexMatcher::FULL_MATCH);
+        for(const auto& text : texts)
+        {
+            checked++;
+            if(search.matches(text) != std::regex_search(text, standard) || full.matches(text) != std::regex_match(text, standard))
+            {
+                std::cerr << "Mismatch for " << pattern << " on " << text << '\n';
+                agree = false;
+            }
+        }
+    }
+
+    // Patterns nested deeper than the parser allows are rejected instead of overflowing the stack
+    for(const std::string &pattern : {std::string(200000, '(') + "a" + std::string(200000, ')'), "a" + std::string(200000, '*')})
+    {
+        try
+        {
+            Regex regex(pattern);
+            std::cerr << "Accepted a pattern nested too deeply\n";
+            agree = false;
+        }
+        catch(const std::runtime_error &e)
+        {
+            checked++;
+        }
+    }
+    std::cout << "\nanchors, alternations and nesting, " << checked << " cases checked\n";
+
+    return agree ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include "AhoCorasick.h"
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+
+AhoCorasick::AhoCorasick(const std::vector<std::string> &patterns) : m_classCount(1)
+{
+    for(const auto& pattern : patterns)
+    {
+        if(!pattern.empty())
+        {
+            m_patterns.push_back(pattern);
+        }
+    }
+
+    // Every byte used by a pattern gets its own class, the rest stays in class 0
+    m_byteClass.fill(0);
+    for(const auto& pattern : m_patterns)
+    {
+        for(unsigned char byte : pattern)
+        {
+            if(m_byteClass[byte] == 0)
+            {
+                m_byteClass[byte] = m_classCount++;
+            }
+        }
+    }
+
+    const uint32_t missing = UINT32_MAX;
+    std::vector<std::vector<uint32_t>> outputs(1);
+    m_transitions.assign(m_classCount, missing);
+
+    // Build the trie
+    for(size_t index = 0; index < m_patterns.size(); index++)
+    {
+        uint32_t state = 0;
+        for(unsigned char byte : m_patterns[index])
+        {
+            uint32_t &next = m_transitions[state * m_classCount + m_byteClass[byte]];
+            if(next == missing)
+            {
+                next = outputs.size();
+                outputs.emplace_back();
+                m_transitions.resize(m_transitions.size() + m_classCount, missing);
+            }
+            state = m_transitions[state * m_classCount + m_byteClass[byte]];
+        }
+        outputs[state].push_back(index);
+    }
+
+    // Turn the trie into a DFA by following failure links breadth first
+    std::vector<uint32_t> failure(outputs.size(), 0);
+    std::queue<uint32_t> queue;
+    for(size_t byteClass = 0; byteClass < m_classCount; byteClass++)
+    {
+        uint32_t &next = m_transitions[byteClass];
+        if(next == missing)
+        {
+            next = 0;
+        }
+        else
+        {
+            queue.push(next);
+        }
+    }
+
+    while(!queue.empty())
+    {
+        uint32_t state = queue.front();
+        queue.pop();
+
+        const std::vector<uint32_t> &inherited = outputs[failure[state]];
+        outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+
+        for(size_t byteClass = 0; byteClass < m_classCount; byteClass++)
+        {
+            uint32_t fallback = m_transitions[failure[state] * m_classCount + byteClass];
+            uint32_t &next = m_transitions[state * m_classCount + byteClass];
+            if(next == missing)
+            {
+                next = fallback;
+            }
+            else
+            {
+                failure[next] = fallback;
+                queue.push(next);
+            }
+        }
+    }
+
+    // Flatten the outputs so that the scan loop touches only two arrays
+    m_outputOffsets.reserve(outputs.size() + 1);
+    for(const auto& stateOutputs : outputs)
+    {
+        m_outputOffsets.push_back(m_outputs.size());
+        m_outputs.insert(m_outputs.end(), stateOutputs.begin(), stateOutputs.end());
+    }
+    m_outputOffsets.push_back(m_outputs.size());
+}
+
+size_t AhoCorasick::patternCount() const
+{
+    return m_patterns.size();
+}
+
+const std::string &AhoCorasick::getPattern(size_t index) const
+{
+    return m_patterns.at(index);
+}
+
+uint32_t AhoCorasick::scan(const char *data, size_t length, uint32_t state, std::vector<bool> &matched, size_t &matchedCount) const
+{
+    const uint32_t *transitions = m_transitions.data();
+    const uint32_t *offsets = m_outputOffsets.data();
+
+    for(size_t i = 0; i < length; i++)
+    {
+        state = transitions[state * m_classCount + m_byteClass[(unsigned char)data[i]]];
+
+        for(uint32_t output = offsets[state]; output < offsets[state + 1]; output++)
+        {
+            if(!matched[m_outputs[output]])
+            {
+                matched[m_outputs[output]] = true;
+                matchedCount++;
+            }
+        }
+    }
+    return state;
+}
+
+std::vector<std::string> AhoCorasick::parsePatterns(const std::string &input, const fs::path &currentDirectory)
+{
+    std::vector<std::string> patterns;
+
+    if(!input.empty() && input[0] == '@')
+    {
+        fs::path patternFile = currentDirectory / input.substr(1);
+        std::ifstream inputFile(patternFile);
+        if(!inputFile.is_open())
+        {
+            throw std::runtime_error("Could not open file " + patternFile.string());
+        }
+
+        std::string line;
+        while(std::getline(inputFile, line))
+        {
+            if(!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if(!line.empty())
+                patterns.push_back(line);
+        }
+        return patterns;
+    }
+
+    size_t start = 0;
+    while(start <= input.size())
+    {
+        size_t end = input.find('|', start);
+        if(end == std::string::npos)
+            end = input.size();
+        if(end > start)
+            patterns.push_back(input.substr(start, end - start));
+        start = end + 1;
+    }
+    return patterns;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @class AhoCorasick
+ * @brief Automaton that searches for many patterns at once in a single pass over the input.
+ *
+ * Bytes that do not appear in any pattern share one equivalence class, so the transition table
+ * has only (number of distinct pattern bytes + 1) columns and stays small enough to live in cache.
+ */
+class AhoCorasick
+{
+public:
+    /**
+     * @brief Compiles the patterns into the automaton. Empty patterns are ignored.
+     * @param patterns The patterns to search for.
+     */
+    AhoCorasick(const std::vector<std::string> &patterns);
+
+    /**
+     * @brief Gets the number of compiled patterns.
+     * @return The number of patterns.
+     */
+    size_t patternCount() const;
+
+    /**
+     * @brief Gets the pattern with the specified index.
+     * @param index The index of the pattern.
+     * @return The pattern.
+     */
+    const std::string &getPattern(size_t index) const;
+
+    /**
+     * @brief Feeds a chunk of input to the automaton.
+     *
+     * The returned state is passed to the next call, so a file can be scanned in chunks
+     * and matches crossing a chunk boundary are still found.
+     *
+     * @param data The chunk of input.
+     * @param length The length of the chunk.
+     * @param state The state returned by the previous call, 0 for the start of the input.
+     * @param matched Flags of the patterns found so far, indexed by pattern index.
+     * @param matchedCount The number of set flags in matched, updated by the function.
+     * @return The state after the chunk.
+     */
+    uint32_t scan(const char *data, size_t length, uint32_t state, std::vector<bool> &matched, size_t &matchedCount) const;
+
+    /**
+     * @brief Splits the user input into patterns.
+     *
+     * Input starting with '@' is a path to a file with one pattern per line,
+     * otherwise the patterns are separated by '|'.
+     *
+     * @param input The user input.
+     * @param currentDirectory The directory relative paths to a pattern file are resolved against.
+     * @return The patterns.
+     */
+    static std::vector<std::string> parsePatterns(const std::string &input, const fs::path &currentDirectory);
+
+private:
+    std::vector<std::string> m_patterns; /**< The compiled patterns. */
+    std::array<uint16_t, 256> m_byteClass; /**< Maps every byte to its equivalence class. */
+    size_t m_classCount; /**< The number of equivalence classes, the width of a table row. */
+    std::vector<uint32_t> m_transitions; /**< The transition table, state * m_classCount + class. */
+    std::vector<uint32_t> m_outputOffsets; /**< Offsets into m_outputs for every state, one extra at the end. */
+    std::vector<uint32_t> m_outputs; /**< Indexes of the patterns that end in each state. */
+};
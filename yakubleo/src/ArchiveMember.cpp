@@ -0,0 +1,195 @@
+#include "ArchiveMember.h"
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "Tracer.h"
+
+ArchiveMember::ArchiveMember(std::shared_ptr<const TarArchive> archive, size_t index)
+    : File(archive->getPath() / archive->getEntries().at(index).path), m_archive(std::move(archive)), m_index(index)
+{
+}
+
+void ArchiveMember::copy(const fs::path &destination)
+{
+    BatchResult result = m_archive->extract({m_index}, destination);
+    if(result.failures > 0)
+        throw std::runtime_error(result.firstError);
+}
+
+void ArchiveMember::move(const fs::path &destination)
+{
+    throw std::runtime_error("Could not move " + m_pathToFile.string() + ": the archive is read-only");
+}
+
+void ArchiveMember::remove()
+{
+    throw std::runtime_error("Could not remove " + m_pathToFile.string() + ": the archive is read-only");
+}
+
+char ArchiveMember::getTypeLetter() const
+{
+    switch(getEntry().type)
+    {
+    case '5':
+        return 'D';
+    case '2':
+        return 'S';
+    default:
+        return 'F';
+    }
+}
+
+void ArchiveMember::appendContentsTo(std::ofstream &outputStream) const
+{
+    Tracer::Span span(Tracer::APPEND_CONTENTS);
+    readBlocks([&](const char *data, size_t size)
+    {
+        if(!outputStream.write(data, size))
+            throw std::runtime_error("Could not write the contents of " + m_pathToFile.string());
+        span.addBytes(size);
+        return true;
+    });
+}
+
+void ArchiveMember::selectOnText(const std::string &text)
+{
+    Tracer::Span span(Tracer::SELECT_ON_TEXT);
+    readLines([&](const std::string &line)
+    {
+        span.addBytes(line.size() + 1);
+        if(line.find(text) == std::string::npos)
+            return true;
+        m_isSelected = true;
+        return false;
+    });
+}
+
+std::vector<size_t> ArchiveMember::selectOnPatterns(const AhoCorasick &automaton)
+{
+    Tracer::Span span(Tracer::SELECT_ON_TEXT);
+    std::vector<bool> matched(automaton.patternCount(), false);
+    size_t matchedCount = 0;
+    uint32_t state = 0;
+
+    readBlocks([&](const char *data, size_t size)
+    {
+        span.addBytes(size);
+        state = automaton.scan(data, size, state, matched, matchedCount);
+        return matchedCount < automaton.patternCount();
+    });
+
+    std::vector<size_t> matchedPatterns;
+    for(size_t i = 0; i < matched.size(); i++)
+    {
+        if(matched[i])
+        {
+            matchedPatterns.push_back(i);
+        }
+    }
+    if(!matchedPatterns.empty())
+    {
+        m_isSelected = true;
+    }
+    return matchedPatterns;
+}
+
+void ArchiveMember::selectOnRegexText(RegexMatcher &matcher)
+{
+    Tracer::Span span(Tracer::SELECT_ON_TEXT);
+    readLines([&](const std::string &line)
+    {
+        span.addBytes(line.size() + 1);
+        if(!matcher.matches(line))
+            return true;
+        m_isSelected = true;
+        return false;
+    });
+}
+
+File *ArchiveMember::clone() const
+{
+    return new ArchiveMember(*this);
+}
+
+bool ArchiveMember::isEqualTo(const File &otherFile) const
+{
+    return false;
+}
+
+std::string ArchiveMember::getContents() const
+{
+    std::string contents;
+    readBlocks([&](const char *data, size_t size)
+    {
+        contents.append(data, size);
+        return true;
+    });
+    return contents;
+}
+
+uintmax_t ArchiveMember::changeToLink(const File &fileToPointAt, Deduplicator::Mode mode)
+{
+    return 0;
+}
+
+const TarEntry &ArchiveMember::getEntry() const
+{
+    return m_archive->getEntries()[m_index];
+}
+
+size_t ArchiveMember::getIndex() const
+{
+    return m_index;
+}
+
+const std::shared_ptr<const TarArchive> &ArchiveMember::getArchive() const
+{
+    return m_archive;
+}
+
+void ArchiveMember::readBlocks(const std::function<bool(const char *, size_t)> &consume) const
+{
+    const TarEntry &entry = getEntry();
+    if(entry.type != '0')
+        return;
+
+    std::vector<char> buffer(64 * 1024);
+    for(uint64_t offset = 0; offset < entry.size; )
+    {
+        size_t count = m_archive->read(entry, offset, buffer.data(), buffer.size());
+        if(count == 0)
+            throw std::runtime_error("The archive ends inside " + m_pathToFile.string());
+        if(!consume(buffer.data(), count))
+            return;
+        offset += count;
+    }
+}
+
+void ArchiveMember::readLines(const std::function<bool(const std::string &)> &consume) const
+{
+    std::string line;
+    bool isStopped = false;
+    readBlocks([&](const char *data, size_t size)
+    {
+        for(const char *end = data + size; data < end; )
+        {
+            const char *newline = static_cast<const char *>(std::memchr(data, '\n', end - data));
+            if(!newline)
+            {
+                line.append(data, end);
+                break;
+            }
+            line.append(data, newline);
+            data = newline + 1;
+            if(!consume(line))
+            {
+                isStopped = true;
+                return false;
+            }
+            line.clear();
+        }
+        return true;
+    });
+    if(!isStopped && !line.empty())
+        consume(line);
+}
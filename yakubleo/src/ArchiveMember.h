@@ -0,0 +1,135 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include "File.h"
+#include "TarArchive.h"
+
+/**
+ * @class ArchiveMember
+ * @brief Class representing a member of a tar archive listed as a file, derived from the File class.
+ *
+ * Its path is the path of the archive followed by the path of the member. The archive is read-only:
+ * a copy extracts the member, moving and removing it fail.
+ */
+class ArchiveMember : public File
+{
+public:
+    /**
+     * @brief Constructor for the ArchiveMember class.
+     * @param archive The open archive, shared by its listed members.
+     * @param index The index of the member in the archive.
+     */
+    ArchiveMember(std::shared_ptr<const TarArchive> archive, size_t index);
+
+    /**
+     * @brief Extracts the member, a directory with everything below it, into the destination directory.
+     * @param destination The destination directory.
+     * @throws std::runtime_error If some members could not be extracted.
+     */
+    void copy(const fs::path &destination) override;
+
+    /**
+     * @brief Refuses to move the member.
+     * @throws std::runtime_error Always, the archive is read-only.
+     */
+    void move(const fs::path &destination) override;
+
+    /**
+     * @brief Refuses to remove the member.
+     * @throws std::runtime_error Always, the archive is read-only.
+     */
+    void remove() override;
+
+    /**
+     * @brief Gets the letter of the member.
+     * @return D for a directory, F for a regular file, S for a symbolic link.
+     */
+    char getTypeLetter() const override;
+
+    /**
+     * @brief Appends the data of a regular member to the output stream.
+     * @param outputStream The output stream.
+     */
+    void appendContentsTo(std::ofstream& outputStream) const override;
+
+    /**
+     * @brief Selects a regular member if a line of its data contains the text.
+     * @param text The text to match.
+     */
+    void selectOnText(const std::string &text) override;
+
+    /**
+     * @brief Selects a regular member if its data contains any of the patterns.
+     * @param automaton The compiled patterns.
+     * @return Indexes of the patterns found in the member.
+     */
+    std::vector<size_t> selectOnPatterns(const AhoCorasick &automaton) override;
+
+    /**
+     * @brief Selects a regular member if a line of its data matches the regular expression.
+     * @param matcher The matcher of the regular expression in search mode.
+     */
+    void selectOnRegexText(RegexMatcher &matcher) override;
+
+    /**
+     * @brief Clones the member.
+     * @return A pointer to the cloned member.
+     */
+    File *clone() const override;
+
+    /**
+     * @brief Ignores the other file so that members are never deduplicated.
+     * @param otherFile The other file.
+     * @return false.
+     */
+    bool isEqualTo(const File &otherFile) const override;
+
+    /**
+     * @brief Gets the data of a regular member.
+     * @return The data, empty for the other members.
+     */
+    std::string getContents() const override;
+
+    /**
+     * @brief Does nothing, the archive is read-only.
+     * @param fileToPointAt The file to point at.
+     * @param mode The kind of the link.
+     * @return 0.
+     */
+    uintmax_t changeToLink(const File &fileToPointAt, Deduplicator::Mode mode) override;
+
+    /**
+     * @brief Gets the member in the archive.
+     * @return The member.
+     */
+    const TarEntry &getEntry() const;
+
+    /**
+     * @brief Gets the index of the member in the archive.
+     * @return The index.
+     */
+    size_t getIndex() const;
+
+    /**
+     * @brief Gets the archive the member is in.
+     * @return The archive.
+     */
+    const std::shared_ptr<const TarArchive> &getArchive() const;
+
+private:
+    std::shared_ptr<const TarArchive> m_archive; /**< The archive the member is in. */
+    size_t m_index; /**< The index of the member in the archive. */
+
+    /**
+     * @brief Reads the data of a regular member a block at a time.
+     * @param consume Receives every block, returns false to stop reading.
+     */
+    void readBlocks(const std::function<bool(const char *, size_t)> &consume) const;
+
+    /**
+     * @brief Reads the data of a regular member a line at a time, without the newlines.
+     * @param consume Receives every line, returns false to stop reading.
+     */
+    void readLines(const std::function<bool(const std::string &)> &consume) const;
+};
@@ -0,0 +1,291 @@
+#include "BatchRenamer.h"
+#include "SystemCall.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <regex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    constexpr size_t none = size_t(-1);
+    constexpr uintmax_t averageEntrySize = 32;
+
+    int openDirectory(const fs::path &directory)
+    {
+        return ::open(directory.empty() ? "." : directory.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    bool exists(int directoryDescriptor, const std::string &name)
+    {
+        struct stat status;
+        return ::fstatat(directoryDescriptor, name.c_str(), &status, AT_SYMLINK_NOFOLLOW) == 0;
+    }
+}
+
+RenamePlan BatchRenamer::plan(const std::vector<fs::path> &paths, const std::string &pattern, const std::string &replacement)
+{
+    std::regex regex;
+    try
+    {
+        regex.assign(pattern, std::regex::ECMAScript);
+    }
+    catch(const std::regex_error &e)
+    {
+        throw std::runtime_error("Invalid regular expression " + pattern);
+    }
+
+    std::vector<Candidate> candidates(paths.size());
+    std::vector<DirectoryNames> directories;
+    std::unordered_map<std::string, size_t> directoryIndexes;
+    for(size_t i = 0; i < paths.size(); i++)
+    {
+        Candidate &candidate = candidates[i];
+        candidate.name = paths[i].filename().string();
+        candidate.newName = std::regex_replace(candidate.name, regex, replacement, std::regex_constants::format_first_only);
+        auto inserted = directoryIndexes.emplace(paths[i].parent_path().string(), directories.size());
+        if(inserted.second)
+            directories.push_back({paths[i].parent_path(), {}, {}, {}});
+        candidate.directory = inserted.first->second;
+        directories[candidate.directory].oldNames.insert(candidate.name);
+    }
+
+    RenamePlan result;
+    std::vector<bool> isRenamed(paths.size(), false);
+    for(size_t i = 0; i < paths.size(); i++)
+    {
+        const Candidate &candidate = candidates[i];
+        DirectoryNames &directory = directories[candidate.directory];
+        if(!isValidName(candidate.newName))
+        {
+            result.conflicts.push_back(paths[i].string() + ": invalid new name \"" + candidate.newName + "\"");
+            continue;
+        }
+
+        // Every name of the batch is taken once the batch is done, the ones that stay included
+        auto taken = directory.newNames.emplace(candidate.newName, i);
+        if(!taken.second)
+        {
+            result.conflicts.push_back(paths[taken.first->second].string() + " and " + paths[i].string() + " would both be named " + candidate.newName);
+            continue;
+        }
+
+        if(candidate.newName == candidate.name)
+        {
+            result.unchangedCount++;
+            continue;
+        }
+        isRenamed[i] = true;
+        if(!directory.oldNames.count(candidate.newName))
+            directory.checked.push_back(i);
+    }
+
+    // New names not freed by the batch must not exist yet
+    for(const auto& directory : directories)
+    {
+        for(size_t i : findExisting(directory.path, directory.checked, candidates))
+        {
+            result.conflicts.push_back(paths[i].string() + ": " + candidates[i].newName + " already exists");
+            isRenamed[i] = false;
+        }
+    }
+
+    for(size_t i = 0; i < paths.size(); i++)
+    {
+        if(isRenamed[i])
+            result.renames.push_back({paths[i], directories[candidates[i].directory].path / candidates[i].newName});
+    }
+    return result;
+}
+
+std::vector<size_t> BatchRenamer::findExisting(const fs::path &directory, const std::vector<size_t> &checked, const std::vector<Candidate> &candidates)
+{
+    std::vector<size_t> existing;
+    if(checked.empty())
+        return existing;
+
+    Descriptor directoryDescriptor(openDirectory(directory));
+    struct stat status;
+    if(directoryDescriptor.get() < 0 || ::fstat(directoryDescriptor.get(), &status) != 0)
+        throw systemError("Could not open directory", directory);
+
+    // A failed lookup costs several times more than reading one entry, the size of a directory
+    // estimates its entries well enough to tell which is cheaper
+    if(checked.size() * averageEntrySize * 4 < uintmax_t(status.st_size))
+    {
+        for(size_t i : checked)
+        {
+            if(exists(directoryDescriptor.get(), candidates[i].newName))
+                existing.push_back(i);
+        }
+        return existing;
+    }
+
+    DIR *stream = ::opendir(directory.empty() ? "." : directory.c_str());
+    if(!stream)
+        throw systemError("Could not read directory", directory);
+    std::unordered_set<std::string> names;
+    while(dirent *entry = ::readdir(stream))
+    {
+        names.insert(entry->d_name);
+    }
+    ::closedir(stream);
+
+    for(size_t i : checked)
+    {
+        if(names.count(candidates[i].newName))
+            existing.push_back(i);
+    }
+    return existing;
+}
+
+size_t BatchRenamer::rename(const RenamePlan &plan)
+{
+    if(!plan.conflicts.empty())
+    {
+        throw std::runtime_error("The renames have conflicts: " + plan.conflicts.front());
+    }
+
+    std::unordered_map<std::string, size_t> groupIndexes;
+    std::vector<Group> groups;
+    for(const auto& rename : plan.renames)
+    {
+        auto inserted = groupIndexes.emplace(rename.from.parent_path().string(), groups.size());
+        if(inserted.second)
+            groups.push_back({rename.from.parent_path(), {}});
+        groups[inserted.first->second].renames.emplace_back(rename.from.filename().string(), rename.to.filename().string());
+    }
+
+    // Directories renamed by the batch are renamed after the files in them, so the paths of the groups stay valid
+    std::stable_sort(groups.begin(), groups.end(), [](const Group &first, const Group &second)
+    {
+        return std::distance(first.directory.begin(), first.directory.end()) > std::distance(second.directory.begin(), second.directory.end());
+    });
+
+    std::vector<JournalEntry> journal;
+    journal.reserve(plan.renames.size() + 1);
+    for(size_t i = 0; i < groups.size(); i++)
+    {
+        try
+        {
+            renameGroup(i, groups[i], journal);
+        }
+        catch(const std::exception &e)
+        {
+            size_t undone = journal.size();
+            size_t failed = rollBack(groups, journal);
+            throw std::runtime_error(std::string(e.what()) + ", " + std::to_string(undone - failed) + " renames undone"
+                + (failed ? ", " + std::to_string(failed) + " could not be undone" : std::string()));
+        }
+    }
+    return plan.renames.size();
+}
+
+bool BatchRenamer::isValidName(const std::string &name)
+{
+    return !name.empty() && name != "." && name != ".." && name.find('/') == std::string::npos && name.find('\0') == std::string::npos;
+}
+
+void BatchRenamer::renameGroup(size_t groupIndex, const Group &group, std::vector<JournalEntry> &journal)
+{
+    Descriptor directoryDescriptor(openDirectory(group.directory));
+    if(directoryDescriptor.get() < 0)
+        throw systemError("Could not open directory", group.directory);
+
+    const auto& renames = group.renames;
+    std::unordered_map<std::string, size_t> bySource;
+    bySource.reserve(renames.size());
+    for(size_t i = 0; i < renames.size(); i++)
+    {
+        bySource.emplace(renames[i].first, i);
+    }
+
+    // The new names are distinct, so the renames form chains and cycles: a rename waits for at most one other
+    // to free its new name and at most one other waits for it
+    std::vector<size_t> waitingFor(renames.size(), none);
+    std::vector<size_t> waitedBy(renames.size(), none);
+    for(size_t i = 0; i < renames.size(); i++)
+    {
+        auto blocker = bySource.find(renames[i].second);
+        if(blocker != bySource.end())
+        {
+            waitingFor[i] = blocker->second;
+            waitedBy[blocker->second] = i;
+        }
+    }
+
+    auto run = [&](const std::string &from, const std::string &to)
+    {
+        if(renameNoReplace(directoryDescriptor.get(), from, directoryDescriptor.get(), to) != 0)
+            throw systemError("Could not rename", group.directory / from);
+        journal.push_back({groupIndex, from, to});
+    };
+
+    std::vector<bool> isDone(renames.size(), false);
+    for(size_t i = 0; i < renames.size(); i++)
+    {
+        if(waitingFor[i] != none)
+            continue;
+        for(size_t j = i; j != none; j = waitedBy[j])
+        {
+            run(renames[j].first, renames[j].second);
+            isDone[j] = true;
+        }
+    }
+
+    for(size_t i = 0; i < renames.size(); i++)
+    {
+        if(isDone[i])
+            continue;
+
+        // A cycle, its first file steps aside under a temporary name until the others moved
+        std::string temporaryName;
+        for(int attempt = 0; ; attempt++)
+        {
+            temporaryName = ".yakubleo-rename-" + std::to_string(::getpid()) + "-" + std::to_string(attempt);
+            if(renameNoReplace(directoryDescriptor.get(), renames[i].first, directoryDescriptor.get(), temporaryName) == 0)
+                break;
+            if(errno != EEXIST || attempt == 100)
+                throw systemError("Could not rename", group.directory / renames[i].first);
+        }
+        journal.push_back({groupIndex, renames[i].first, temporaryName});
+
+        for(size_t j = waitedBy[i]; j != i; j = waitedBy[j])
+        {
+            run(renames[j].first, renames[j].second);
+            isDone[j] = true;
+        }
+        run(temporaryName, renames[i].second);
+        isDone[i] = true;
+    }
+}
+
+size_t BatchRenamer::rollBack(const std::vector<Group> &groups, const std::vector<JournalEntry> &journal)
+{
+    size_t failed = 0;
+    size_t openGroup = none;
+    int directoryDescriptor = -1;
+    for(auto entry = journal.rbegin(); entry != journal.rend(); ++entry)
+    {
+        // The directories are reopened by path, the ones renamed later have their old names back already
+        if(entry->group != openGroup)
+        {
+            if(directoryDescriptor >= 0)
+                ::close(directoryDescriptor);
+            directoryDescriptor = openDirectory(groups[entry->group].directory);
+            openGroup = entry->group;
+        }
+        if(directoryDescriptor < 0 || renameNoReplace(directoryDescriptor, entry->to, directoryDescriptor, entry->from) != 0)
+            failed++;
+    }
+    if(directoryDescriptor >= 0)
+        ::close(directoryDescriptor);
+    return failed;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief A file whose name changes, it stays in its directory.
+ */
+struct PlannedRename
+{
+    fs::path from; /**< The current path. */
+    fs::path to; /**< The new path, in the same directory. */
+};
+
+/**
+ * @brief The renames computed for a batch of files, checked before anything is renamed.
+ */
+struct RenamePlan
+{
+    std::vector<PlannedRename> renames; /**< The files whose names change, in the order they were given. */
+    std::vector<std::string> conflicts; /**< Why the plan cannot run, empty if it can. */
+    size_t unchangedCount = 0; /**< The number of files the pattern leaves as they are. */
+};
+
+/**
+ * @class BatchRenamer
+ * @brief Renames many files at once by replacing a regular expression in their names.
+ *
+ * The whole batch is planned first: every new name is computed and collisions among the new names, with the names
+ * that stay and with other files of the directories are found with hash sets, so a batch that cannot succeed renames
+ * nothing. The renames of one directory run by renameat2(RENAME_NOREPLACE) relative to one descriptor of it, in an
+ * order where every new name is free when it is taken: chains of renames are run from their ends and cycles, such as
+ * two swapped names, pass one of their files through a temporary name. Every rename done is journaled, if one fails
+ * the journal is undone backwards and the files get their old names again.
+ */
+class BatchRenamer
+{
+public:
+    /**
+     * @brief Computes the new names of the files and checks them.
+     * @param paths The files to rename.
+     * @param pattern The ECMAScript regular expression searched for in the names, its first match is replaced.
+     * @param replacement The replacement, $1 to $9 insert the groups of the match, $& the whole match, $$ a dollar.
+     * @return The plan, with the conflicts that prevent running it.
+     * @throws std::runtime_error If the pattern is invalid.
+     */
+    static RenamePlan plan(const std::vector<fs::path> &paths, const std::string &pattern, const std::string &replacement);
+
+    /**
+     * @brief Runs the renames of the plan.
+     * @param plan The plan, it must have no conflicts.
+     * @return The number of files renamed.
+     * @throws std::runtime_error If a file cannot be renamed, the files renamed before it get their old names back.
+     */
+    static size_t rename(const RenamePlan &plan);
+
+private:
+    /**
+     * @brief A file of the batch while it is planned.
+     */
+    struct Candidate
+    {
+        std::string name; /**< The current name. */
+        std::string newName; /**< The name after the replacement. */
+        size_t directory; /**< The index of its directory. */
+    };
+
+    /**
+     * @brief The names of the batch in one directory.
+     */
+    struct DirectoryNames
+    {
+        fs::path path; /**< The directory. */
+        std::unordered_set<std::string> oldNames; /**< The current names of the files of the batch. */
+        std::unordered_map<std::string, size_t> newNames; /**< The new names and the files that get them. */
+        std::vector<size_t> checked; /**< The files whose new names are not freed by the batch. */
+    };
+
+    /**
+     * @brief A rename done, kept to be undone.
+     */
+    struct JournalEntry
+    {
+        size_t group; /**< The index of the directory. */
+        std::string from; /**< The old name. */
+        std::string to; /**< The new name. */
+    };
+
+    /**
+     * @brief The renames of one directory.
+     */
+    struct Group
+    {
+        fs::path directory; /**< The directory. */
+        std::vector<std::pair<std::string, std::string>> renames; /**< The old and the new names. */
+    };
+
+    /**
+     * @brief Tells if a name can be given to a file.
+     * @param name The name.
+     * @return True if it is not empty, not a dot entry and has no slash or NUL.
+     */
+    static bool isValidName(const std::string &name);
+
+    /**
+     * @brief Finds the files whose new names exist in the directory, by a lookup of each or by reading the directory once.
+     * @param directory The directory.
+     * @param checked The files to check.
+     * @param candidates The files of the batch.
+     * @return The files whose new names exist.
+     * @throws std::runtime_error If the directory cannot be read.
+     */
+    static std::vector<size_t> findExisting(const fs::path &directory, const std::vector<size_t> &checked, const std::vector<Candidate> &candidates);
+
+    /**
+     * @brief Runs the renames of one directory, ends of chains first, cycles through a temporary name.
+     * @param groupIndex The index of the directory.
+     * @param group The renames.
+     * @param journal The renames done, new ones are appended.
+     * @throws std::runtime_error If a file cannot be renamed.
+     */
+    static void renameGroup(size_t groupIndex, const Group &group, std::vector<JournalEntry> &journal);
+
+    /**
+     * @brief Gives back the old names in the reverse order.
+     * @param groups The directories.
+     * @param journal The renames done.
+     * @return The number of renames that could not be undone.
+     */
+    static size_t rollBack(const std::vector<Group> &groups, const std::vector<JournalEntry> &journal);
+};
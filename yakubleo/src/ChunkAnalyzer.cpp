@@ -0,0 +1,189 @@
+#include "ChunkAnalyzer.h"
+#include <algorithm>
+#include <bitset>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include "FastHash.h"
+
+namespace
+{
+    // Normalised chunking, two more mask bits below the average size and two less above it
+    constexpr uint64_t smallChunkMask = ~0ULL << (64 - 15);
+    constexpr uint64_t largeChunkMask = ~0ULL << (64 - 11);
+
+    /**
+     * @brief A distinct chunk and the files that contain it.
+     */
+    struct ChunkEntry
+    {
+        uint32_t size;
+        std::bitset<ChunkAnalyzer::maximalFileCount> files;
+    };
+}
+
+ChunkAnalyzer::ChunkAnalyzer(size_t threadCount) : m_threadCount(threadCount)
+{
+}
+
+ChunkReport ChunkAnalyzer::analyze(const std::vector<fs::path> &files) const
+{
+    if(files.size() > maximalFileCount)
+    {
+        throw std::runtime_error("At most " + std::to_string(maximalFileCount) + " files can be analysed at once");
+    }
+
+    ChunkReport report;
+    report.files = files;
+    report.fileSizes.assign(files.size(), 0);
+    report.uniqueBytes.assign(files.size(), 0);
+    report.sharedBytes.assign(files.size(), std::vector<uintmax_t>(files.size(), 0));
+
+    std::mutex mutex;
+    std::unordered_map<ContentHash, ChunkEntry, ContentHashHasher> chunks;
+
+    ThreadPool pool(m_threadCount);
+    for(size_t index = 0; index < files.size(); index++)
+    {
+        pool.submit([&, index]
+        {
+            std::unordered_map<ContentHash, uint32_t, ContentHashHasher> fileChunks;
+            uintmax_t fileSize = 0;
+            size_t chunkCount = 0;
+            chunkFile(files[index], [&](const ContentHash &hash, uint32_t size)
+            {
+                fileChunks.emplace(hash, size);
+                fileSize += size;
+                chunkCount++;
+            });
+
+            std::lock_guard<std::mutex> lock(mutex);
+            report.fileSizes[index] = fileSize;
+            report.chunkCount += chunkCount;
+            for(const auto& [hash, size] : fileChunks)
+            {
+                report.uniqueBytes[index] += size;
+                ChunkEntry &entry = chunks[hash];
+                entry.size = size;
+                entry.files.set(index);
+            }
+        });
+    }
+    pool.wait();
+
+    for(size_t index = 0; index < files.size(); index++)
+    {
+        report.totalBytes += report.fileSizes[index];
+    }
+
+    report.distinctChunkCount = chunks.size();
+    std::vector<size_t> owners;
+    for(const auto& [hash, entry] : chunks)
+    {
+        report.storedBytes += entry.size;
+        if(entry.files.count() < 2)
+            continue;
+
+        owners.clear();
+        for(size_t index = 0; index < files.size(); index++)
+        {
+            if(entry.files.test(index))
+                owners.push_back(index);
+        }
+        for(size_t first = 0; first < owners.size(); first++)
+        {
+            for(size_t second = first + 1; second < owners.size(); second++)
+            {
+                report.sharedBytes[owners[first]][owners[second]] += entry.size;
+                report.sharedBytes[owners[second]][owners[first]] += entry.size;
+            }
+        }
+    }
+    return report;
+}
+
+void ChunkAnalyzer::chunkFile(const fs::path &path, const ChunkVisitor &visitor)
+{
+    std::ifstream inputFile(path, std::ios::binary);
+    if(!inputFile.is_open())
+    {
+        throw std::runtime_error("Could not open file " + path.string());
+    }
+
+    const std::array<uint64_t, 256> &gear = gearTable();
+    std::vector<char> buffer(FileContents::blockSize);
+
+    FastHash hasher;
+    size_t chunkLength = 0;
+    uint64_t fingerprint = 0;
+
+    while(inputFile)
+    {
+        inputFile.read(buffer.data(), buffer.size());
+        size_t length = inputFile.gcount();
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(buffer.data());
+
+        size_t position = 0;
+        while(position < length)
+        {
+            size_t start = position;
+            bool boundary = false;
+            while(position < length)
+            {
+                // Boundaries below the minimal size are never used, so the rolling hash skips those bytes
+                if(chunkLength < minimalChunkSize)
+                {
+                    size_t skip = std::min(minimalChunkSize - chunkLength, length - position);
+                    position += skip;
+                    chunkLength += skip;
+                    continue;
+                }
+
+                fingerprint = (fingerprint << 1) + gear[data[position]];
+                position++;
+                chunkLength++;
+
+                uint64_t mask = chunkLength < averageChunkSize ? smallChunkMask : largeChunkMask;
+                if((fingerprint & mask) == 0 || chunkLength >= maximalChunkSize)
+                {
+                    boundary = true;
+                    break;
+                }
+            }
+
+            hasher.update(data + start, position - start);
+            if(boundary)
+            {
+                visitor(hasher.digest(), chunkLength);
+                hasher.reset();
+                chunkLength = 0;
+                fingerprint = 0;
+            }
+        }
+    }
+
+    if(chunkLength > 0)
+    {
+        visitor(hasher.digest(), chunkLength);
+    }
+}
+
+const std::array<uint64_t, 256> &ChunkAnalyzer::gearTable()
+{
+    static const std::array<uint64_t, 256> table = []
+    {
+        std::array<uint64_t, 256> values{};
+        uint64_t state = 0x4745415254414231ULL;
+        for(auto& value : values)
+        {
+            state += 0x9E3779B97F4A7C15ULL;
+            uint64_t mixed = state;
+            mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+            value = mixed ^ (mixed >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
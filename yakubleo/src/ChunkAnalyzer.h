@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include "FileContents.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Bytes the analysed files share at the chunk level.
+ */
+struct ChunkReport
+{
+    std::vector<fs::path> files; /**< The analysed files. */
+    std::vector<uintmax_t> fileSizes; /**< The size of every file. */
+    std::vector<uintmax_t> uniqueBytes; /**< The bytes of every file after removing chunks repeated inside the file. */
+    std::vector<std::vector<uintmax_t>> sharedBytes; /**< Bytes of the distinct chunks present in both files, [first][second]. */
+    uintmax_t totalBytes = 0; /**< The size of all the files together. */
+    uintmax_t storedBytes = 0; /**< The size of the distinct chunks, what block-level dedup would store. */
+    size_t chunkCount = 0; /**< The number of chunks of all the files. */
+    size_t distinctChunkCount = 0; /**< The number of distinct chunks. */
+};
+
+/**
+ * @class ChunkAnalyzer
+ * @brief Splits files into content-defined chunks and measures how much of them the files share.
+ *
+ * Chunk boundaries are found by a gear rolling hash with FastCDC normalised chunking: boundaries are harder to hit
+ * below the average chunk size and easier above it. An insertion therefore shifts only the chunks around it,
+ * the following boundaries stay where they were, so snapshots that differ in a few regions share most of their chunks.
+ * The files are streamed in parallel, memory is bounded by the index of distinct chunks, not by the file sizes.
+ */
+class ChunkAnalyzer
+{
+public:
+    static constexpr size_t minimalChunkSize = 2 * 1024; /**< No boundary is placed closer to the previous one. */
+    static constexpr size_t averageChunkSize = 8 * 1024; /**< The targeted size of a chunk. */
+    static constexpr size_t maximalChunkSize = 64 * 1024; /**< A boundary is forced after this many bytes. */
+    static constexpr size_t maximalFileCount = 64; /**< The most files one analysis can compare. */
+
+    /**
+     * @brief Called for every chunk with its hash and size.
+     */
+    using ChunkVisitor = std::function<void(const ContentHash &hash, uint32_t size)>;
+
+    /**
+     * @brief Constructor.
+     * @param threadCount The number of files chunked at once.
+     */
+    ChunkAnalyzer(size_t threadCount = ThreadPool::defaultThreadCount());
+
+    /**
+     * @brief Chunks the files and compares their chunks.
+     * @param files The regular files to analyse.
+     * @return The report.
+     * @throws std::runtime_error If there are too many files or one of them cannot be read.
+     */
+    ChunkReport analyze(const std::vector<fs::path> &files) const;
+
+    /**
+     * @brief Streams the file and reports its chunks in order.
+     * @param path The path to the file.
+     * @param visitor Called for every chunk.
+     * @throws std::runtime_error If the file cannot be read.
+     */
+    static void chunkFile(const fs::path &path, const ChunkVisitor &visitor);
+
+private:
+    size_t m_threadCount; /**< The number of files chunked at once. */
+
+    /**
+     * @brief Gets the table of random values of the gear hash, one for every byte.
+     * @return The table.
+     */
+    static const std::array<uint64_t, 256> &gearTable();
+};
@@ -0,0 +1,800 @@
+#include "CommandLine.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+
+namespace
+{
+    constexpr auto progressInterval = std::chrono::milliseconds(250);
+
+    std::string quote(const std::string &text)
+    {
+        std::string quoted = "\"";
+        for(unsigned char character : text)
+        {
+            if(character == '"' || character == '\\')
+            {
+                quoted.push_back('\\');
+                quoted.push_back(character);
+            }
+            else if(character < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+                quoted += escaped;
+            }
+            else
+            {
+                quoted.push_back(character);
+            }
+        }
+        return quoted + "\"";
+    }
+
+    /**
+     * @brief One line of the output, a JSON object built key by key.
+     */
+    class Event
+    {
+    public:
+        Event(const std::string &type) : m_text("{\"event\":" + quote(type))
+        {
+        }
+
+        Event &add(const char *key, const std::string &value)
+        {
+            m_text += std::string(",\"") + key + "\":" + quote(value);
+            return *this;
+        }
+
+        Event &add(const char *key, const char *value)
+        {
+            return add(key, std::string(value));
+        }
+
+        Event &add(const char *key, const fs::path &value)
+        {
+            return add(key, value.string());
+        }
+
+        template<typename Number, typename = std::enable_if_t<std::is_arithmetic_v<Number>>>
+        Event &add(const char *key, Number value)
+        {
+            m_text += std::string(",\"") + key + "\":";
+            if constexpr(std::is_same_v<Number, bool>)
+            {
+                m_text += value ? "true" : "false";
+            }
+            else if constexpr(std::is_floating_point_v<Number>)
+            {
+                char number[32];
+                std::snprintf(number, sizeof(number), "%.6f", double(value));
+                m_text += number;
+            }
+            else
+            {
+                m_text += std::to_string(value);
+            }
+            return *this;
+        }
+
+        template<typename Item>
+        Event &add(const char *key, const std::vector<Item> &values)
+        {
+            m_text += std::string(",\"") + key + "\":[";
+            for(size_t i = 0; i < values.size(); i++)
+            {
+                m_text += (i ? "," : "") + quote(fs::path(values[i]).string());
+            }
+            m_text += "]";
+            return *this;
+        }
+
+        friend std::ostream &operator<<(std::ostream &output, const Event &event)
+        {
+            // Every event is flushed, a reader of a pipe sees the progress as it happens
+            return output << event.m_text << "}" << std::endl;
+        }
+
+    private:
+        std::string m_text;
+    };
+
+    const char *statusName(int exitCode)
+    {
+        switch(exitCode)
+        {
+        case CommandLine::SUCCESS:
+            return "ok";
+        case CommandLine::PARTIAL_FAILURE:
+            return "partial";
+        case CommandLine::USAGE_ERROR:
+            return "usage";
+        default:
+            return "failed";
+        }
+    }
+
+    bool parseCount(const std::string &text, size_t &count)
+    {
+        if(text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        count = std::stoul(text);
+        return true;
+    }
+}
+
+CommandLine::CommandLine(std::ostream &output, std::ostream &errors) : m_output(output), m_errors(errors), m_fileSystem(fs::current_path())
+{
+    const size_t many = size_t(-1);
+    m_commands =
+    {
+        {"copy", {&CommandLine::copy, 2, many, "DESTINATION PATH...  copy into the directory, existing large copies are updated by their deltas"}},
+        {"move", {&CommandLine::move, 2, many, "DESTINATION PATH...  move into the directory"}},
+        {"remove", {&CommandLine::remove, 1, many, "[--permanently] PATH...  move to the trash, --permanently deletes what has no trash"}},
+        {"rename", {&CommandLine::rename, 3, many, "PATTERN REPLACEMENT PATH...  replace the first match of the regular expression in the names"}},
+        {"concatenate", {&CommandLine::concatenate, 2, many, "OUTPUT PATH...  append the contents of the files to the output"}},
+        {"search-text", {&CommandLine::searchText, 2, many, "PATTERNS PATH...  list the files containing any of the patterns a|b|c or @file"}},
+        {"search-regex", {&CommandLine::searchRegex, 2, many, "REGEX PATH...  list the files with a line matching the regular expression"}},
+        {"match-name", {&CommandLine::matchName, 2, many, "REGEX PATH...  list the files whose names match the regular expression"}},
+        {"find", {&CommandLine::find, 2, 2, "DIRECTORY QUERY  find the files below the directory matching the query"}},
+        {"top", {&CommandLine::top, 3, 3, "DIRECTORY largest|oldest COUNT  find the largest or the oldest files below the directory"}},
+        {"duplicates", {&CommandLine::duplicates, 1, 1, "DIRECTORY  list the groups of identical files"}},
+        {"deduplicate", {&CommandLine::deduplicate, 2, 2, "DIRECTORY symlink|hardlink|reflink  replace the identical files by links to the first of their group"}},
+        {"subtrees", {&CommandLine::subtrees, 1, 1, "DIRECTORY  list the groups of identical directories"}},
+        {"compare", {&CommandLine::compare, 2, 3, "SOURCE TARGET [--contents]  list the entries that differ"}},
+        {"mirror", {&CommandLine::mirror, 2, 4, "SOURCE TARGET [--contents] [--delete]  copy what differs, --delete removes the extras"}},
+        {"chunks", {&CommandLine::chunks, 1, many, "PATH...  measure the bytes the files share in content-defined chunks"}},
+        {"index", {&CommandLine::index, 1, 1, "DIRECTORY  add the directory to the file name index and update it"}},
+        {"search-index", {&CommandLine::searchIndex, 1, 1, "QUERY  search the file name index"}},
+        {"trash-list", {&CommandLine::trashList, 0, 0, "list the entries of the trash"}},
+        {"trash-restore", {&CommandLine::trashRestore, 1, many, "PATH...  restore the entries last deleted from the paths"}},
+        {"trash-empty", {&CommandLine::trashEmpty, 0, 0, "purge the trash and wait until it is done"}},
+        {"tar-list", {&CommandLine::tarList, 1, 2, "ARCHIVE [DIRECTORY]  list the members of a directory of the tar archive, the index is saved for the next time"}},
+        {"tar-extract", {&CommandLine::tarExtract, 2, many, "ARCHIVE DESTINATION [MEMBER...]  extract the members, or the whole archive, into the directory in parallel"}},
+        {"stats", {&CommandLine::stats, 0, 2, "[JSON [TRACE]]  print the calls, bytes and latencies of the traced operations, write them as JSON and the spans as a Chrome trace"}}
+    };
+}
+
+int CommandLine::run(const std::vector<std::string> &arguments)
+{
+    if(arguments.empty() || arguments[0] == "--help" || arguments[0] == "-h")
+    {
+        printUsage();
+        return arguments.empty() ? USAGE_ERROR : SUCCESS;
+    }
+
+    if(arguments[0] != "--script")
+    {
+        return runCommand(arguments);
+    }
+
+    bool isKeptGoing = arguments.size() == 3 && arguments[2] == "--keep-going";
+    if(arguments.size() < 2 || (arguments.size() == 3 && !isKeptGoing) || arguments.size() > 3)
+    {
+        printUsage();
+        return USAGE_ERROR;
+    }
+    if(arguments[1] == "-")
+    {
+        return runScript(std::cin, isKeptGoing);
+    }
+
+    std::ifstream script(arguments[1]);
+    if(!script)
+    {
+        m_output << Event("error").add("message", "Cannot read script " + arguments[1]);
+        return FAILURE;
+    }
+    return runScript(script, isKeptGoing);
+}
+
+int CommandLine::runScript(std::istream &script, bool isKeptGoing)
+{
+    int worst = SUCCESS;
+    std::string line;
+    size_t lineNumber = 0;
+    while(std::getline(script, line))
+    {
+        lineNumber++;
+        std::vector<std::string> command;
+        try
+        {
+            command = splitLine(line);
+        }
+        catch(const std::exception &e)
+        {
+            m_output << Event("error").add("line", lineNumber).add("message", e.what());
+            command.clear();
+            worst = std::max<int>(worst, USAGE_ERROR);
+            if(!isKeptGoing)
+                return USAGE_ERROR;
+            continue;
+        }
+        if(command.empty() || command[0][0] == '#')
+            continue;
+
+        int exitCode = runCommand(command);
+        if(exitCode != SUCCESS && !isKeptGoing)
+            return exitCode;
+        worst = std::max(worst, exitCode);
+    }
+    return worst;
+}
+
+int CommandLine::runCommand(const std::vector<std::string> &command)
+{
+    auto found = m_commands.find(command[0]);
+    std::vector<std::string> arguments(command.begin() + 1, command.end());
+    if(found == m_commands.end() || arguments.size() < found->second.minimalArgumentCount || arguments.size() > found->second.maximalArgumentCount)
+    {
+        m_output << Event("error").add("command", command[0])
+            .add("message", found == m_commands.end() ? "Unknown command" : "Usage: " + command[0] + " " + found->second.usage);
+        return USAGE_ERROR;
+    }
+
+    m_output << Event("start").add("command", command[0]).add("arguments", arguments);
+    auto start = std::chrono::steady_clock::now();
+    int exitCode;
+    try
+    {
+        exitCode = (this->*found->second.handler)(arguments);
+    }
+    catch(const std::exception &e)
+    {
+        m_output << Event("error").add("command", command[0]).add("message", e.what());
+        exitCode = FAILURE;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_output << Event("done").add("command", command[0]).add("status", statusName(exitCode)).add("exit", exitCode).add("seconds", seconds);
+    return exitCode;
+}
+
+std::vector<std::string> CommandLine::splitLine(const std::string &line)
+{
+    std::vector<std::string> words;
+    std::string word;
+    bool isInWord = false;
+    char quote = 0;
+    for(size_t i = 0; i < line.size(); i++)
+    {
+        char character = line[i];
+        if(quote)
+        {
+            if(character == quote)
+                quote = 0;
+            else if(character == '\\' && quote == '"' && i + 1 < line.size())
+                word.push_back(line[++i]);
+            else
+                word.push_back(character);
+        }
+        else if(character == '\'' || character == '"')
+        {
+            quote = character;
+            isInWord = true;
+        }
+        else if(character == '\\' && i + 1 < line.size())
+        {
+            word.push_back(line[++i]);
+            isInWord = true;
+        }
+        else if(character == ' ' || character == '\t' || character == '\r')
+        {
+            if(isInWord)
+                words.push_back(std::move(word));
+            word.clear();
+            isInWord = false;
+        }
+        else
+        {
+            word.push_back(character);
+            isInWord = true;
+        }
+    }
+
+    if(quote)
+        throw std::runtime_error("Unclosed quote");
+    if(isInWord)
+        words.push_back(std::move(word));
+    return words;
+}
+
+void CommandLine::printUsage() const
+{
+    m_errors << "Usage: yakubleo                      the terminal interface\n"
+             << "       yakubleo COMMAND ARGUMENT...  run one command\n"
+             << "       yakubleo --script FILE|- [--keep-going]  run one command per line\n\n"
+             << "Commands:\n";
+    for(const auto& [name, command] : m_commands)
+    {
+        m_errors << "  " << name << " " << command.usage << '\n';
+    }
+    m_errors << "\nEvery line of the output is a JSON object with an \"event\" key: start, progress, path, match, group,\n"
+             << "difference, entry, conflict, probe, result, error and done, which tells the status and the seconds taken.\n"
+             << "Exit codes: 0 success, 1 failure, 2 invalid usage, 3 some entries failed.\n";
+}
+
+void CommandLine::selectPaths(const std::vector<std::string> &paths)
+{
+    std::vector<fs::path> loaded;
+    for(const auto& path : paths)
+    {
+        struct stat status;
+        if(::lstat(path.c_str(), &status) != 0)
+            throw std::runtime_error("No such file " + path);
+        loaded.push_back(fs::absolute(path));
+    }
+
+    // Every command works on its own arguments, not on what a command before it selected
+    m_fileSystem.deSelectAllFiles();
+    m_fileSystem.loadPaths(loaded);
+    for(int i = 0; i < m_fileSystem.filesInCurrentDirectory(); i++)
+    {
+        m_fileSystem.setSelectedAt(i);
+    }
+}
+
+void CommandLine::printSelected()
+{
+    for(const auto& path : m_fileSystem.getSelectedPaths())
+    {
+        m_output << Event("path").add("path", path);
+    }
+}
+
+template<typename Running, typename Scanned>
+void CommandLine::waitFor(Running isRunning, Scanned scannedCount)
+{
+    while(isRunning())
+    {
+        std::this_thread::sleep_for(progressInterval);
+        m_output << Event("progress").add("scanned", scannedCount());
+    }
+}
+
+int CommandLine::printBatchResult(const BatchResult &result)
+{
+    if(result.failures > 0)
+        m_output << Event("error").add("message", result.firstError);
+    m_output << Event("result").add("files", result.doneCount).add("bytes", result.bytes).add("failures", result.failures);
+    return result.failures == 0 ? SUCCESS : result.doneCount > 0 ? PARTIAL_FAILURE : FAILURE;
+}
+
+int CommandLine::copy(const std::vector<std::string> &arguments)
+{
+    selectPaths(std::vector<std::string>(arguments.begin() + 1, arguments.end()));
+    return printBatchResult(m_fileSystem.copySelectedFiles(arguments[0]));
+}
+
+int CommandLine::move(const std::vector<std::string> &arguments)
+{
+    selectPaths(std::vector<std::string>(arguments.begin() + 1, arguments.end()));
+    return printBatchResult(m_fileSystem.moveSelectedFiles(arguments[0]));
+}
+
+int CommandLine::remove(const std::vector<std::string> &arguments)
+{
+    bool isPermanentAllowed = arguments[0] == "--permanently";
+    selectPaths(std::vector<std::string>(arguments.begin() + (isPermanentAllowed ? 1 : 0), arguments.end()));
+    BatchResult result = m_fileSystem.removeSelectedFiles();
+
+    // The files left selected have no trash, they are deleted instead and counted by that batch
+    size_t remaining = m_fileSystem.selectedFilesCount();
+    if(result.failures == 0 || !isPermanentAllowed || remaining == 0)
+        return printBatchResult(result);
+
+    m_output << Event("warning").add("message", std::to_string(result.failures) + " files not moved to the trash: " + result.firstError);
+    BatchResult permanent = m_fileSystem.removeSelectedFilesPermanently();
+    result.failures -= std::min(result.failures, remaining);
+    if(result.failures == 0)
+        result.firstError = permanent.firstError;
+    result.failures += permanent.failures;
+    result.doneCount += permanent.doneCount;
+    return printBatchResult(result);
+}
+
+int CommandLine::rename(const std::vector<std::string> &arguments)
+{
+    selectPaths(std::vector<std::string>(arguments.begin() + 2, arguments.end()));
+    RenamePlan plan = m_fileSystem.planRenameOfSelectedFiles(arguments[0], arguments[1]);
+    for(const auto& conflict : plan.conflicts)
+    {
+        m_output << Event("conflict").add("message", conflict);
+    }
+    if(!plan.conflicts.empty())
+    {
+        m_output << Event("result").add("renamed", 0).add("unchanged", plan.unchangedCount).add("conflicts", plan.conflicts.size());
+        return FAILURE;
+    }
+
+    size_t renamed = m_fileSystem.renameFiles(plan);
+    for(const auto& rename : plan.renames)
+    {
+        m_output << Event("path").add("path", rename.to).add("from", rename.from);
+    }
+    m_output << Event("result").add("renamed", renamed).add("unchanged", plan.unchangedCount).add("conflicts", 0);
+    return SUCCESS;
+}
+
+int CommandLine::concatenate(const std::vector<std::string> &arguments)
+{
+    selectPaths(std::vector<std::string>(arguments.begin() + 1, arguments.end()));
+    std::ofstream output(arguments[0], std::ios::binary | std::ios::app);
+    if(!output)
+        throw std::runtime_error("Cannot open " + arguments[0]);
+    BatchResult result = m_fileSystem.appendSelectedFilesTo(output);
+    output.close();
+    if(!output)
+        throw std::runtime_error("Cannot write " + arguments[0]);
+    return printBatchResult(result);
+}
+
+int CommandLine::searchText(const std::vector<std::string> &arguments)
+{
+    AhoCorasick automaton(AhoCorasick::parsePatterns(arguments[0], fs::current_path()));
+    if(automaton.patternCount() == 0)
+        throw std::runtime_error("No patterns");
+
+    selectPaths(std::vector<std::string>(arguments.begin() + 1, arguments.end()));
+    m_fileSystem.deSelectAllFiles();
+    auto matches = m_fileSystem.selectOnPatterns(automaton);
+    for(const auto& [path, matchedPatterns] : matches)
+    {
+        std::vector<std::string> patterns;
+        for(size_t pattern : matchedPatterns)
+        {
+            patterns.push_back(automaton.getPattern(pattern));
+        }
+        m_output << Event("match").add("path", path).add("patterns", patterns);
+    }
+    m_output << Event("result").add("files", size_t(m_fileSystem.filesInCurrentDirectory())).add("matches", matches.size());
+    return SUCCESS;
+}
+
+int CommandLine::searchRegex(const std::vector<std::string> &arguments)
+{
+    selectPaths(std::vector<std::string>(arguments.begin() + 1, arguments.end()));
+    m_fileSystem.deSelectAllFiles();
+    m_fileSystem.selectOnRegexText(arguments[0]);
+    printSelected();
+    m_output << Event("result").add("files", size_t(m_fileSystem.filesInCurrentDirectory())).add("matches", m_fileSystem.selectedFilesCount());
+    return SUCCESS;
+}
+
+int CommandLine::matchName(const std::vector<std::string> &arguments)
+{
+    selectPaths(std::vector<std::string>(arguments.begin() + 1, arguments.end()));
+    m_fileSystem.deSelectAllFiles();
+    m_fileSystem.selectOnRegex(arguments[0]);
+    printSelected();
+    m_output << Event("result").add("files", size_t(m_fileSystem.filesInCurrentDirectory())).add("matches", m_fileSystem.selectedFilesCount());
+    return SUCCESS;
+}
+
+int CommandLine::find(const std::vector<std::string> &arguments)
+{
+    m_fileSystem.startFind(fs::absolute(arguments[0]), arguments[1]);
+    waitFor([this] { return m_fileSystem.isFinding(); }, [this] { return m_fileSystem.findScannedCount(); });
+    m_fileSystem.loadFoundFiles();
+
+    for(int i = 0; i < m_fileSystem.filesInCurrentDirectory(); i++)
+    {
+        m_output << Event("path").add("path", m_fileSystem.getPathAt(i));
+    }
+    m_output << Event("result").add("found", size_t(m_fileSystem.filesInCurrentDirectory())).add("scanned", m_fileSystem.findScannedCount());
+    return SUCCESS;
+}
+
+int CommandLine::top(const std::vector<std::string> &arguments)
+{
+    size_t count;
+    if(!parseCount(arguments[2], count) || (arguments[1] != "largest" && arguments[1] != "oldest"))
+    {
+        m_output << Event("error").add("message", "Usage: top " + std::string(m_commands.at("top").usage));
+        return USAGE_ERROR;
+    }
+
+    TopFilesFinder::Criterion criterion = arguments[1] == "largest" ? TopFilesFinder::LARGEST : TopFilesFinder::OLDEST;
+    m_fileSystem.startTopFiles(fs::absolute(arguments[0]), criterion, count);
+    waitFor([this] { return m_fileSystem.isFindingTopFiles(); }, [this] { return m_fileSystem.topFilesScannedCount(); });
+    m_fileSystem.loadTopFiles();
+
+    for(int i = 0; i < m_fileSystem.filesInCurrentDirectory(); i++)
+    {
+        fs::path path = m_fileSystem.getPathAt(i);
+        struct stat status;
+        if(::lstat(path.c_str(), &status) != 0)
+            continue;
+        m_output << Event("path").add("path", path).add("size", uintmax_t(status.st_size)).add("modified", int64_t(status.st_mtime));
+    }
+    m_output << Event("result").add("found", size_t(m_fileSystem.filesInCurrentDirectory())).add("scanned", m_fileSystem.topFilesScannedCount());
+    return SUCCESS;
+}
+
+int CommandLine::duplicates(const std::vector<std::string> &arguments)
+{
+    std::vector<DuplicateGroup> groups = m_fileSystem.findDuplicatesIn(arguments[0]);
+    uintmax_t wastedBytes = 0;
+    for(const auto& group : groups)
+    {
+        wastedBytes += group.size * (group.files.size() - 1);
+        m_output << Event("group").add("size", group.size).add("paths", group.files);
+    }
+
+    const HashCache &hashCache = m_fileSystem.getHashCache();
+    m_output << Event("result").add("groups", groups.size()).add("wastedBytes", wastedBytes)
+        .add("hashesReused", hashCache.hitCount()).add("hashLookups", hashCache.lookupCount()).add("bytesHashed", hashCache.bytesHashed());
+    return SUCCESS;
+}
+
+int CommandLine::deduplicate(const std::vector<std::string> &arguments)
+{
+    Deduplicator::Mode mode;
+    if(arguments[1] == "symlink")
+        mode = Deduplicator::SYMBOLIC_LINK;
+    else if(arguments[1] == "hardlink")
+        mode = Deduplicator::HARD_LINK;
+    else if(arguments[1] == "reflink")
+        mode = Deduplicator::REFLINK;
+    else
+    {
+        m_output << Event("error").add("message", "Usage: deduplicate " + std::string(m_commands.at("deduplicate").usage));
+        return USAGE_ERROR;
+    }
+
+    std::vector<DuplicateGroup> groups = m_fileSystem.findDuplicatesIn(arguments[0]);
+    DeduplicationResult result = m_fileSystem.deduplicateGroups(groups, mode);
+    if(result.failures > 0)
+        m_output << Event("error").add("message", result.firstError);
+    m_output << Event("result").add("groups", groups.size()).add("filesReplaced", result.filesReplaced)
+        .add("bytesReclaimed", result.bytesReclaimed).add("failures", result.failures);
+    return result.failures ? PARTIAL_FAILURE : SUCCESS;
+}
+
+int CommandLine::subtrees(const std::vector<std::string> &arguments)
+{
+    std::vector<SubtreeGroup> groups = m_fileSystem.findIdenticalSubtreesIn(arguments[0]);
+    for(const auto& group : groups)
+    {
+        m_output << Event("group").add("size", group.size).add("files", group.fileCount).add("paths", group.directories);
+    }
+    m_output << Event("result").add("groups", groups.size());
+    return SUCCESS;
+}
+
+int CommandLine::compare(const std::vector<std::string> &arguments)
+{
+    bool isContentChecked = arguments.size() == 3 && arguments[2] == "--contents";
+    if(arguments.size() == 3 && !isContentChecked)
+    {
+        m_output << Event("error").add("message", "Unknown option " + arguments[2]);
+        return USAGE_ERROR;
+    }
+
+    DirectoryComparison comparison = m_fileSystem.compareDirectories(arguments[0], arguments[1], isContentChecked);
+    const char *kinds[] = {"added", "removed", "changed"};
+    for(const auto& entry : comparison.differences)
+    {
+        m_output << Event("difference").add("kind", kinds[entry.difference]).add("path", entry.relativePath)
+            .add("directory", entry.isDirectory).add("size", entry.size);
+    }
+    for(const auto& path : comparison.unreadableDirectories)
+    {
+        m_output << Event("unreadable").add("path", path);
+    }
+    m_output << Event("result").add("differences", comparison.differences.size()).add("identical", comparison.identicalCount)
+        .add("identicalBytes", comparison.identicalBytes).add("unreadable", comparison.unreadableDirectories.size());
+    return comparison.unreadableDirectories.empty() ? SUCCESS : PARTIAL_FAILURE;
+}
+
+int CommandLine::mirror(const std::vector<std::string> &arguments)
+{
+    bool isContentChecked = false;
+    bool isExtraRemoved = false;
+    for(size_t i = 2; i < arguments.size(); i++)
+    {
+        if(arguments[i] == "--contents")
+            isContentChecked = true;
+        else if(arguments[i] == "--delete")
+            isExtraRemoved = true;
+        else
+        {
+            m_output << Event("error").add("message", "Unknown option " + arguments[i]);
+            return USAGE_ERROR;
+        }
+    }
+
+    DirectoryComparison comparison = m_fileSystem.compareDirectories(arguments[0], arguments[1], isContentChecked);
+    m_output << Event("progress").add("differences", comparison.differences.size()).add("identical", comparison.identicalCount)
+        .add("unreadable", comparison.unreadableDirectories.size());
+    MirrorResult result = m_fileSystem.mirrorDirectories(comparison, isExtraRemoved);
+    m_output << Event("result").add("entriesCopied", result.entriesCopied).add("bytesCopied", result.bytesCopied)
+        .add("bytesWritten", result.bytesWritten).add("entriesRemoved", result.entriesRemoved).add("failures", result.failures);
+    return result.failures ? PARTIAL_FAILURE : SUCCESS;
+}
+
+int CommandLine::chunks(const std::vector<std::string> &arguments)
+{
+    selectPaths(arguments);
+    ChunkReport report = m_fileSystem.analyzeChunksOfSelectedFiles();
+    for(size_t i = 0; i < report.files.size(); i++)
+    {
+        m_output << Event("path").add("path", report.files[i]).add("size", report.fileSizes[i]).add("uniqueBytes", report.uniqueBytes[i]);
+    }
+    m_output << Event("result").add("totalBytes", report.totalBytes).add("storedBytes", report.storedBytes)
+        .add("chunks", report.chunkCount).add("distinctChunks", report.distinctChunkCount);
+    return SUCCESS;
+}
+
+int CommandLine::index(const std::vector<std::string> &arguments)
+{
+    IndexStatistics statistics = m_fileSystem.indexDirectory(fs::absolute(arguments[0]));
+    m_output << Event("result").add("entries", statistics.entryCount).add("directoriesRead", statistics.directoriesRead)
+        .add("directoriesReused", statistics.directoriesReused);
+    return SUCCESS;
+}
+
+int CommandLine::searchIndex(const std::vector<std::string> &arguments)
+{
+    std::vector<IndexEntry> entries = m_fileSystem.searchIndex(arguments[0]);
+    for(const auto& entry : entries)
+    {
+        m_output << Event("path").add("path", entry.path).add("type", std::string(1, entry.type)).add("size", entry.size)
+            .add("modified", entry.modified / 1000000000);
+    }
+    m_output << Event("result").add("found", entries.size());
+    return SUCCESS;
+}
+
+int CommandLine::trashList(const std::vector<std::string> &arguments)
+{
+    std::vector<TrashEntry> entries = m_fileSystem.listTrash();
+    for(const auto& entry : entries)
+    {
+        Event event("entry");
+        event.add("path", entry.originalPath).add("deleted", int64_t(entry.deletionTime)).add("trash", entry.trashDirectory / "files" / entry.name);
+        if(entry.isSizeKnown)
+            event.add("size", entry.size);
+        m_output << event;
+    }
+    m_output << Event("result").add("entries", entries.size());
+    return SUCCESS;
+}
+
+int CommandLine::trashRestore(const std::vector<std::string> &arguments)
+{
+    std::vector<TrashEntry> entries = m_fileSystem.listTrash();
+    size_t restored = 0;
+    for(const auto& argument : arguments)
+    {
+        // The entries are listed the most recently deleted first
+        fs::path path = fs::absolute(argument).lexically_normal();
+        auto entry = std::find_if(entries.begin(), entries.end(), [&path](const TrashEntry &candidate) { return candidate.originalPath == path; });
+        try
+        {
+            if(entry == entries.end())
+                throw std::runtime_error(path.string() + " is not in the trash");
+            m_fileSystem.restoreFromTrash(*entry);
+            entries.erase(entry);
+            m_output << Event("path").add("path", path);
+            restored++;
+        }
+        catch(const std::exception &e)
+        {
+            m_output << Event("error").add("path", path).add("message", e.what());
+        }
+    }
+    m_output << Event("result").add("restored", restored).add("failures", arguments.size() - restored);
+    return restored == arguments.size() ? SUCCESS : restored == 0 ? FAILURE : PARTIAL_FAILURE;
+}
+
+int CommandLine::trashEmpty(const std::vector<std::string> &arguments)
+{
+    const Trash &trash = m_fileSystem.getTrash();
+    m_fileSystem.emptyTrash();
+    while(trash.isPurging())
+    {
+        std::this_thread::sleep_for(progressInterval);
+        m_output << Event("progress").add("purgedBytes", trash.purgedBytes());
+    }
+    m_output << Event("result").add("purgedBytes", trash.purgedBytes()).add("entries", m_fileSystem.listTrash().size());
+    return SUCCESS;
+}
+
+int CommandLine::stats(const std::vector<std::string> &arguments)
+{
+    for(const auto& probe : Tracer::statistics())
+    {
+        if(probe.count == 0)
+            continue;
+        m_output << Event("probe").add("name", probe.name).add("count", probe.count).add("bytes", probe.bytes)
+            .add("totalNs", probe.totalNanoseconds).add("p50Ns", probe.p50Nanoseconds).add("p90Ns", probe.p90Nanoseconds)
+            .add("p99Ns", probe.p99Nanoseconds).add("maxNs", probe.maximalNanoseconds);
+    }
+
+    Event result("result");
+    if(arguments.size() >= 1)
+    {
+        Tracer::writeJson(arguments[0]);
+        result.add("json", arguments[0]);
+    }
+    if(arguments.size() == 2)
+    {
+        result.add("trace", arguments[1]).add("spans", Tracer::writeChromeTrace(arguments[1]));
+    }
+    m_output << result;
+    return SUCCESS;
+}
+
+int CommandLine::tarList(const std::vector<std::string> &arguments)
+{
+    m_fileSystem.loadArchive(fs::absolute(arguments[0]), arguments.size() > 1 ? arguments[1] : "");
+    bool isIndexCached = false;
+    for(int i = 0; i < m_fileSystem.filesInCurrentDirectory(); i++)
+    {
+        const auto &member = static_cast<const ArchiveMember &>(m_fileSystem.getFileAt(i));
+        const TarEntry &entry = member.getEntry();
+        isIndexCached = member.getArchive()->isIndexCached();
+        m_output << Event("path").add("path", entry.path).add("type", std::string(1, member.getTypeLetter()))
+            .add("size", entry.size).add("modified", entry.modified);
+    }
+    m_output << Event("result").add("members", size_t(m_fileSystem.filesInCurrentDirectory())).add("indexCached", isIndexCached)
+        .add("skipped", m_fileSystem.skippedArchiveMembers());
+    return SUCCESS;
+}
+
+int CommandLine::tarExtract(const std::vector<std::string> &arguments)
+{
+    fs::path archive = fs::absolute(arguments[0]);
+    std::vector<std::string> paths(arguments.begin() + 2, arguments.end());
+    bool isWholeArchive = paths.empty();
+    if(isWholeArchive)
+        paths.push_back("");
+
+    // Every member is looked up in the listing of the directory it is in
+    std::shared_ptr<const TarArchive> opened;
+    std::vector<size_t> members;
+    for(const auto& path : paths)
+    {
+        std::string member = fs::path(path).lexically_normal().relative_path().string();
+        while(!member.empty() && member.back() == '/')
+            member.pop_back();
+        size_t slash = member.rfind('/');
+        m_fileSystem.loadArchive(archive, path.empty() || slash == std::string::npos ? "" : member.substr(0, slash));
+
+        bool isFound = false;
+        for(int i = 0; i < m_fileSystem.filesInCurrentDirectory(); i++)
+        {
+            const auto &file = static_cast<const ArchiveMember &>(m_fileSystem.getFileAt(i));
+            opened = file.getArchive();
+            if(path.empty() || file.getEntry().path == member)
+            {
+                members.push_back(file.getIndex());
+                isFound = true;
+            }
+        }
+        if(!isFound && !path.empty())
+            throw std::runtime_error(path + " is not in " + archive.string());
+    }
+    BatchResult result = opened ? opened->extract(members, arguments[1]) : BatchResult();
+
+    // Like tar, the members leaving the destination fail the extraction of the whole archive
+    size_t skipped = isWholeArchive ? m_fileSystem.skippedArchiveMembers() : 0;
+    if(skipped > 0)
+    {
+        if(result.failures == 0)
+            result.firstError = std::to_string(skipped) + " members leave the destination with .. and were skipped";
+        result.failures += skipped;
+    }
+    if(result.failures > 0)
+        m_output << Event("error").add("message", result.firstError);
+    m_output << Event("result").add("extracted", result.doneCount).add("bytes", result.bytes).add("failures", result.failures);
+    return result.failures == 0 ? SUCCESS : result.doneCount > 0 ? PARTIAL_FAILURE : FAILURE;
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <filesystem>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "FileSystem.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @class CommandLine
+ * @brief Runs the operations of the file manager from command line arguments or a script, without the terminal interface.
+ *
+ * Every command is one operation of FileSystem applied to paths given as arguments instead of selected files.
+ * The output is one JSON object per line: a start event, progress events of the long searches, the found items,
+ * a result with the counts of the operation and a done event with the status and the time it took. Errors are
+ * reported as error events and by the exit code, so the commands can run from cron jobs, pipelines and benchmarks.
+ */
+class CommandLine
+{
+public:
+    /**
+     * @brief Exit codes of the commands.
+     */
+    enum ExitCode
+    {
+        SUCCESS = 0, /**< The operation succeeded. */
+        FAILURE = 1, /**< The operation failed or found conflicts, nothing or only a part was done. */
+        USAGE_ERROR = 2, /**< The command or its arguments are invalid. */
+        PARTIAL_FAILURE = 3 /**< The operation finished but some entries failed. */
+    };
+
+    /**
+     * @brief Constructor.
+     * @param output Receives the events.
+     * @param errors Receives the usage.
+     */
+    CommandLine(std::ostream &output, std::ostream &errors);
+
+    /**
+     * @brief Runs the arguments of the program: a command, --script FILE, or --help.
+     * @param arguments The arguments without the name of the program.
+     * @return The exit code.
+     */
+    int run(const std::vector<std::string> &arguments);
+
+    /**
+     * @brief Runs one command per line of the script, empty lines and lines starting with # are skipped.
+     * @param script The script.
+     * @param isKeptGoing True to run the rest of the script after a command fails.
+     * @return The exit code of the first failed command, or of the worst one when kept going, SUCCESS if none failed.
+     */
+    int runScript(std::istream &script, bool isKeptGoing);
+
+    /**
+     * @brief Runs one command.
+     * @param command The name of the command followed by its arguments.
+     * @return The exit code.
+     */
+    int runCommand(const std::vector<std::string> &command);
+
+    /**
+     * @brief Splits a line of a script into words, single and double quotes group words and a backslash escapes the next character.
+     * @param line The line.
+     * @return The words.
+     * @throws std::runtime_error If a quote is not closed.
+     */
+    static std::vector<std::string> splitLine(const std::string &line);
+
+private:
+    /**
+     * @brief Runs a command whose arguments were checked, returns the exit code.
+     */
+    using Handler = int (CommandLine::*)(const std::vector<std::string> &arguments);
+
+    /**
+     * @brief A command and how it is called.
+     */
+    struct Command
+    {
+        Handler handler; /**< Runs the command. */
+        size_t minimalArgumentCount; /**< The number of arguments required. */
+        size_t maximalArgumentCount; /**< The largest number of arguments accepted. */
+        const char *usage; /**< The arguments and what the command does. */
+    };
+
+    std::ostream &m_output; /**< Receives the events. */
+    std::ostream &m_errors; /**< Receives the usage. */
+    FileSystem m_fileSystem; /**< Runs the operations. */
+    std::map<std::string, Command> m_commands; /**< The commands by their names. */
+
+    /**
+     * @brief Prints the commands and the exit codes.
+     */
+    void printUsage() const;
+
+    /**
+     * @brief Loads the paths as the files of the file system and selects all of them.
+     * @param paths The paths.
+     * @throws std::runtime_error If one of them does not exist.
+     */
+    void selectPaths(const std::vector<std::string> &paths);
+
+    /**
+     * @brief Prints the selected files as path events.
+     */
+    void printSelected();
+
+    /**
+     * @brief Prints a progress event every quarter of a second while the search runs.
+     * @param isRunning Tells if the search still runs.
+     * @param scannedCount Gets the number of entries checked so far.
+     */
+    template<typename Running, typename Scanned>
+    void waitFor(Running isRunning, Scanned scannedCount);
+
+    /**
+     * @brief Prints the outcome of a batch as a result event, preceded by the first failure as an error event.
+     * @param result The outcome.
+     * @return SUCCESS, PARTIAL_FAILURE if some files failed, FAILURE if all of them did.
+     */
+    int printBatchResult(const BatchResult &result);
+
+    /**
+     * @name Commands
+     * Each runs the command of its name, the number of its arguments is checked already, and returns the exit code.
+     * @{
+     */
+    int copy(const std::vector<std::string> &arguments);
+    int move(const std::vector<std::string> &arguments);
+    int remove(const std::vector<std::string> &arguments);
+    int rename(const std::vector<std::string> &arguments);
+    int concatenate(const std::vector<std::string> &arguments);
+    int searchText(const std::vector<std::string> &arguments);
+    int searchRegex(const std::vector<std::string> &arguments);
+    int matchName(const std::vector<std::string> &arguments);
+    int find(const std::vector<std::string> &arguments);
+    int top(const std::vector<std::string> &arguments);
+    int duplicates(const std::vector<std::string> &arguments);
+    int deduplicate(const std::vector<std::string> &arguments);
+    int subtrees(const std::vector<std::string> &arguments);
+    int compare(const std::vector<std::string> &arguments);
+    int mirror(const std::vector<std::string> &arguments);
+    int chunks(const std::vector<std::string> &arguments);
+    int index(const std::vector<std::string> &arguments);
+    int searchIndex(const std::vector<std::string> &arguments);
+    int trashList(const std::vector<std::string> &arguments);
+    int trashRestore(const std::vector<std::string> &arguments);
+    int trashEmpty(const std::vector<std::string> &arguments);
+    int stats(const std::vector<std::string> &arguments);
+    int tarList(const std::vector<std::string> &arguments);
+    int tarExtract(const std::vector<std::string> &arguments);
+    /** @} */
+};
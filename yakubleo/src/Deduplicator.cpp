@@ -0,0 +1,319 @@
+#include "Deduplicator.h"
+#include "SystemCall.h"
+#include "FileContents.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <linux/fs.h>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+uintmax_t Deduplicator::replace(const fs::path &original, const fs::path &duplicate, Mode mode,
+    const struct stat *originalSeen, const struct stat *duplicateSeen)
+{
+    struct stat originalStatus;
+    struct stat duplicateStatus;
+    if(::stat(original.c_str(), &originalStatus) != 0)
+        throw systemError("Could not stat", original);
+    if(::lstat(duplicate.c_str(), &duplicateStatus) != 0)
+        throw systemError("Could not stat", duplicate);
+
+    if(!S_ISREG(duplicateStatus.st_mode) || duplicateStatus.st_size != originalStatus.st_size)
+    {
+        throw std::runtime_error("Not a duplicate of the original " + duplicate.string());
+    }
+
+    // Replacing a file by a link to itself would destroy it
+    if(originalStatus.st_dev == duplicateStatus.st_dev && originalStatus.st_ino == duplicateStatus.st_ino)
+    {
+        return 0;
+    }
+
+    // Either file may have been rewritten since the contents were compared
+    if(originalSeen)
+        checkUnchanged(original, *originalSeen, false);
+    if(duplicateSeen)
+        checkUnchanged(duplicate, *duplicateSeen, true);
+
+    if(mode == REFLINK)
+    {
+        return shareExtents(original, duplicate);
+    }
+
+    linkAtomically(original, duplicate, mode);
+
+    // Data of a file with other hard links stays on the disk
+    return duplicateStatus.st_nlink == 1 ? duplicateStatus.st_size : 0;
+}
+
+DeduplicationResult Deduplicator::replaceGroups(const std::vector<DuplicateGroup> &groups, Mode mode)
+{
+    DeduplicationResult result;
+    for(const auto& group : groups)
+    {
+        for(size_t i = 1; i < group.files.size(); i++)
+        {
+            try
+            {
+                if(group.statuses.size() == group.files.size())
+                    result.bytesReclaimed += replace(group.files.front(), group.files[i], mode, &group.statuses.front(), &group.statuses[i]);
+                else
+                    result.bytesReclaimed += replace(group.files.front(), group.files[i], mode);
+                result.filesReplaced++;
+            }
+            catch(const std::exception &e)
+            {
+                if(result.failures++ == 0)
+                    result.firstError = e.what();
+            }
+        }
+    }
+    return result;
+}
+
+uintmax_t Deduplicator::replaceDirectory(const fs::path &original, const fs::path &duplicate, Mode mode)
+{
+    struct stat originalStatus;
+    struct stat duplicateStatus;
+    if(::stat(original.c_str(), &originalStatus) != 0)
+        throw systemError("Could not stat", original);
+    if(::lstat(duplicate.c_str(), &duplicateStatus) != 0)
+        throw systemError("Could not stat", duplicate);
+
+    if(!S_ISDIR(originalStatus.st_mode) || !S_ISDIR(duplicateStatus.st_mode))
+    {
+        throw std::runtime_error("Not a duplicate of the original " + duplicate.string());
+    }
+    if(originalStatus.st_dev == duplicateStatus.st_dev && originalStatus.st_ino == duplicateStatus.st_ino)
+    {
+        return 0;
+    }
+
+    // Equal hashes only suggest equal trees; the kernel compares the bytes of reflinks itself
+    if(mode != REFLINK && !isSameTree(original, duplicate))
+    {
+        throw std::runtime_error("Not a duplicate of the original " + duplicate.string());
+    }
+
+    uintmax_t reclaimed = 0;
+    if(mode == SYMBOLIC_LINK)
+    {
+        for(const auto& entry : fs::recursive_directory_iterator(duplicate))
+        {
+            struct stat status;
+            if(::lstat(entry.path().c_str(), &status) == 0 && S_ISREG(status.st_mode) && status.st_nlink == 1)
+                reclaimed += status.st_size;
+        }
+        exchangeWithSymbolicLink(original, duplicate);
+        return reclaimed;
+    }
+
+    for(const auto& entry : fs::recursive_directory_iterator(duplicate))
+    {
+        if(entry.symlink_status().type() == fs::file_type::regular)
+        {
+            reclaimed += replace(original / entry.path().lexically_relative(duplicate), entry.path(), mode);
+        }
+    }
+    return reclaimed;
+}
+
+DeduplicationResult Deduplicator::replaceSubtreeGroups(const std::vector<SubtreeGroup> &groups, Mode mode)
+{
+    DeduplicationResult result;
+    for(const auto& group : groups)
+    {
+        for(size_t i = 1; i < group.directories.size(); i++)
+        {
+            try
+            {
+                result.bytesReclaimed += replaceDirectory(group.directories.front(), group.directories[i], mode);
+                result.filesReplaced++;
+            }
+            catch(const std::exception &e)
+            {
+                if(result.failures++ == 0)
+                    result.firstError = e.what();
+            }
+        }
+    }
+    return result;
+}
+
+void Deduplicator::checkUnchanged(const fs::path &path, const struct stat &seen, bool compareChangeTime)
+{
+    Descriptor descriptor(::open(path.c_str(), O_PATH | O_NOFOLLOW | O_CLOEXEC));
+    if(descriptor.get() < 0)
+        throw systemError("Could not open", path);
+
+    struct stat status;
+    if(::fstat(descriptor.get(), &status) != 0)
+        throw systemError("Could not stat", path);
+
+    bool isUnchanged = status.st_dev == seen.st_dev && status.st_ino == seen.st_ino && status.st_size == seen.st_size
+        && status.st_mtim.tv_sec == seen.st_mtim.tv_sec && status.st_mtim.tv_nsec == seen.st_mtim.tv_nsec
+        && (!compareChangeTime || (status.st_ctim.tv_sec == seen.st_ctim.tv_sec && status.st_ctim.tv_nsec == seen.st_ctim.tv_nsec));
+    if(!isUnchanged)
+        throw std::runtime_error("Changed since it was compared " + path.string());
+}
+
+void Deduplicator::linkAtomically(const fs::path &original, const fs::path &duplicate, Mode mode)
+{
+    fs::path directory = duplicate.parent_path();
+    if(directory.empty())
+        directory = ".";
+
+    Descriptor directoryDescriptor(::open(directory.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC));
+    if(directoryDescriptor.get() < 0)
+        throw systemError("Could not open directory", directory);
+
+    std::string name = duplicate.filename().string();
+    std::string temporaryName;
+    for(int attempt = 0; ; attempt++)
+    {
+        temporaryName = "." + name + ".yakubleo-" + std::to_string(::getpid()) + "-" + std::to_string(attempt);
+
+        int created;
+        if(mode == HARD_LINK)
+            created = ::linkat(AT_FDCWD, original.c_str(), directoryDescriptor.get(), temporaryName.c_str(), 0);
+        else
+            created = ::symlinkat(fs::absolute(original).c_str(), directoryDescriptor.get(), temporaryName.c_str());
+
+        if(created == 0)
+            break;
+        if(errno != EEXIST || attempt == 100)
+            throw systemError("Could not create link to", original);
+    }
+
+    if(::renameat(directoryDescriptor.get(), temporaryName.c_str(), directoryDescriptor.get(), name.c_str()) != 0)
+    {
+        int renameError = errno;
+        ::unlinkat(directoryDescriptor.get(), temporaryName.c_str(), 0);
+        errno = renameError;
+        throw systemError("Could not replace", duplicate);
+    }
+}
+
+uintmax_t Deduplicator::shareExtents(const fs::path &original, const fs::path &duplicate)
+{
+    Descriptor source(::open(original.c_str(), O_RDONLY | O_CLOEXEC));
+    if(source.get() < 0)
+        throw systemError("Could not open", original);
+
+    // The kernel requires the destination to be writable unless the caller owns it
+    int destinationDescriptor = ::open(duplicate.c_str(), O_RDWR | O_CLOEXEC);
+    if(destinationDescriptor < 0 && errno == EACCES)
+        destinationDescriptor = ::open(duplicate.c_str(), O_RDONLY | O_CLOEXEC);
+    Descriptor destination(destinationDescriptor);
+    if(destination.get() < 0)
+        throw systemError("Could not open", duplicate);
+
+    struct stat status;
+    if(::fstat(source.get(), &status) != 0)
+        throw systemError("Could not stat", original);
+
+    // Filesystems limit the length of one request, btrfs to 16 MiB
+    const uint64_t requestLength = 16 * 1024 * 1024;
+    std::vector<char> request(sizeof(file_dedupe_range) + sizeof(file_dedupe_range_info));
+    auto *range = reinterpret_cast<file_dedupe_range *>(request.data());
+
+    uintmax_t deduplicated = 0;
+    uint64_t offset = 0;
+    while(offset < uint64_t(status.st_size))
+    {
+        std::fill(request.begin(), request.end(), 0);
+        range->src_offset = offset;
+        range->src_length = std::min<uint64_t>(requestLength, status.st_size - offset);
+        range->dest_count = 1;
+        range->info[0].dest_fd = destination.get();
+        range->info[0].dest_offset = offset;
+
+        if(::ioctl(source.get(), FIDEDUPERANGE, range) != 0)
+            throw systemError("The filesystem cannot share extents of", duplicate);
+
+        if(range->info[0].status == FILE_DEDUPE_RANGE_DIFFERS)
+            throw std::runtime_error("Contents differ from the original " + duplicate.string());
+        if(range->info[0].status < 0)
+        {
+            errno = -range->info[0].status;
+            throw systemError("The filesystem cannot share extents of", duplicate);
+        }
+        if(range->info[0].bytes_deduped == 0)
+            break;
+
+        deduplicated += range->info[0].bytes_deduped;
+        offset += range->info[0].bytes_deduped;
+    }
+    return deduplicated;
+}
+
+void Deduplicator::exchangeWithSymbolicLink(const fs::path &original, const fs::path &duplicate)
+{
+    fs::path directory = duplicate.parent_path();
+    if(directory.empty())
+        directory = ".";
+
+    Descriptor directoryDescriptor(::open(directory.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC));
+    if(directoryDescriptor.get() < 0)
+        throw systemError("Could not open directory", directory);
+
+    std::string name = duplicate.filename().string();
+    std::string temporaryName;
+    for(int attempt = 0; ; attempt++)
+    {
+        temporaryName = "." + name + ".yakubleo-" + std::to_string(::getpid()) + "-" + std::to_string(attempt);
+        if(::symlinkat(fs::absolute(original).c_str(), directoryDescriptor.get(), temporaryName.c_str()) == 0)
+            break;
+        if(errno != EEXIST || attempt == 100)
+            throw systemError("Could not create link to", original);
+    }
+
+    // A directory cannot be renamed over, the link and the directory swap their names instead
+    if(::renameat2(directoryDescriptor.get(), temporaryName.c_str(), directoryDescriptor.get(), name.c_str(), RENAME_EXCHANGE) != 0)
+    {
+        int renameError = errno;
+        ::unlinkat(directoryDescriptor.get(), temporaryName.c_str(), 0);
+        errno = renameError;
+        throw systemError("Could not replace", duplicate);
+    }
+
+    std::error_code error;
+    fs::remove_all(directory / temporaryName, error);
+    if(error)
+        throw std::runtime_error("Could not remove " + (directory / temporaryName).string() + ": " + error.message());
+}
+
+bool Deduplicator::isSameTree(const fs::path &original, const fs::path &duplicate)
+{
+    try
+    {
+        size_t entryCount = 0;
+        for(const auto& entry : fs::recursive_directory_iterator(duplicate))
+        {
+            entryCount++;
+            fs::path counterpart = original / entry.path().lexically_relative(duplicate);
+            fs::file_type type = entry.symlink_status().type();
+            if(fs::symlink_status(counterpart).type() != type)
+                return false;
+            if(type == fs::file_type::regular && !FileContents::equal(counterpart, entry.path()))
+                return false;
+            if(type == fs::file_type::symlink && fs::read_symlink(counterpart) != fs::read_symlink(entry.path()))
+                return false;
+        }
+
+        // Every entry of the duplicate has its counterpart, the original must not have more
+        size_t originalCount = std::distance(fs::recursive_directory_iterator(original), fs::recursive_directory_iterator());
+        return entryCount == originalCount;
+    }
+    catch(const std::exception &e)
+    {
+        // A tree that cannot be read completely is not replaced
+        return false;
+    }
+}
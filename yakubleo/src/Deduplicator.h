@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "DuplicateFinder.h"
+#include "SubtreeHasher.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Outcome of replacing duplicates.
+ */
+struct DeduplicationResult
+{
+    uintmax_t bytesReclaimed = 0; /**< Bytes of data no longer stored twice. */
+    size_t filesReplaced = 0; /**< The number of duplicates replaced. */
+    size_t failures = 0; /**< The number of duplicates that could not be replaced. */
+    std::string firstError; /**< Why the first failed duplicate could not be replaced. */
+};
+
+/**
+ * @class Deduplicator
+ * @brief Replaces duplicates of a file without copying or rewriting any data.
+ *
+ * Links are created under a temporary name in the directory of the duplicate and renamed over it,
+ * so the duplicate is replaced atomically and its name never disappears.
+ */
+class Deduplicator
+{
+public:
+    /**
+     * @brief How the duplicates are replaced.
+     */
+    enum Mode
+    {
+        SYMBOLIC_LINK, /**< A symbolic link to the original, breaks when the original moves. */
+        HARD_LINK, /**< A hard link to the original, the files share one inode, both have to be on one filesystem. */
+        REFLINK /**< The files stay independent but share extents, FIDEDUPERANGE on btrfs, XFS and similar. */
+    };
+
+    /**
+     * @brief Replaces the duplicate by a link to the original.
+     * @param original The file that is kept.
+     * @param duplicate The file that is replaced.
+     * @param mode How the duplicate is replaced.
+     * @param originalSeen The status of the original when it was compared, nullptr if it was compared just now.
+     * @param duplicateSeen The status of the duplicate when it was compared, nullptr if it was compared just now.
+     * @return The number of bytes reclaimed.
+     * @throws std::runtime_error If the duplicate cannot be replaced or either file changed since it was compared, it is left untouched.
+     */
+    static uintmax_t replace(const fs::path &original, const fs::path &duplicate, Mode mode,
+        const struct stat *originalSeen = nullptr, const struct stat *duplicateSeen = nullptr);
+
+    /**
+     * @brief Keeps the first file of every group and replaces the others.
+     * @param groups The groups of duplicates.
+     * @param mode How the duplicates are replaced.
+     * @return The number of bytes reclaimed and files replaced.
+     */
+    static DeduplicationResult replaceGroups(const std::vector<DuplicateGroup> &groups, Mode mode);
+
+    /**
+     * @brief Replaces a directory identical to the original.
+     *
+     * A symbolic link replaces the whole directory, it is swapped with the directory atomically
+     * by renameat2(RENAME_EXCHANGE) and the directory is removed afterwards.
+     * Hard links and reflinks keep the directories and replace every regular file by its counterpart in the original.
+     *
+     * @param original The directory that is kept.
+     * @param duplicate The directory that is replaced, it has to have the same contents as the original, which is confirmed byte by byte before it is replaced by links.
+     * @param mode How the duplicate is replaced.
+     * @return The number of bytes reclaimed.
+     * @throws std::runtime_error If the duplicate cannot be replaced, with hard links and reflinks some files may be replaced already.
+     */
+    static uintmax_t replaceDirectory(const fs::path &original, const fs::path &duplicate, Mode mode);
+
+    /**
+     * @brief Keeps the first directory of every group and replaces the others.
+     * @param groups The groups of identical directories.
+     * @param mode How the duplicates are replaced.
+     * @return The number of bytes reclaimed and directories replaced.
+     */
+    static DeduplicationResult replaceSubtreeGroups(const std::vector<SubtreeGroup> &groups, Mode mode);
+
+private:
+    /**
+     * @brief Checks that a file is still the one that was compared.
+     * @param path The file.
+     * @param seen Its status when it was compared.
+     * @param compareChangeTime False for the original, the links to it created meanwhile change its ctime.
+     * @throws std::runtime_error If the file was replaced or its contents may have changed.
+     */
+    static void checkUnchanged(const fs::path &path, const struct stat &seen, bool compareChangeTime);
+
+    /**
+     * @brief Creates a link under a temporary name and renames it over the duplicate.
+     * @param original The file that is kept.
+     * @param duplicate The file that is replaced.
+     * @param mode SYMBOLIC_LINK or HARD_LINK.
+     */
+    static void linkAtomically(const fs::path &original, const fs::path &duplicate, Mode mode);
+
+    /**
+     * @brief Asks the kernel to share the extents of the duplicate with the original.
+     * @param original The file that is kept.
+     * @param duplicate The file whose extents are replaced.
+     * @return The number of bytes the kernel deduplicated.
+     */
+    static uintmax_t shareExtents(const fs::path &original, const fs::path &duplicate);
+
+    /**
+     * @brief Swaps the directory with a symbolic link to the original and removes it.
+     * @param original The directory the link points at.
+     * @param duplicate The directory that is replaced.
+     */
+    static void exchangeWithSymbolicLink(const fs::path &original, const fs::path &duplicate);
+
+    /**
+     * @brief Compares two trees entry by entry, the regular files byte by byte.
+     * @param original The directory that is kept.
+     * @param duplicate The directory that is replaced.
+     * @return True if both have the same entries with the same types, contents and link targets, false also if something cannot be read.
+     */
+    static bool isSameTree(const fs::path &original, const fs::path &duplicate);
+};
@@ -0,0 +1,348 @@
+#include "DeltaCopier.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "FastHash.h"
+#include "ThreadPool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DELTACOPIER_X86 1
+#endif
+
+namespace
+{
+    /**
+     * @brief An open descriptor closed when it goes out of scope.
+     */
+    struct Descriptor
+    {
+        int value;
+
+        ~Descriptor()
+        {
+            if(value >= 0)
+                ::close(value);
+        }
+    };
+
+    /**
+     * @brief A read-only mapping of a whole file unmapped when it goes out of scope.
+     */
+    struct Mapping
+    {
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+
+        Mapping(int descriptor, size_t length, const fs::path &path) : size(length)
+        {
+            if(size == 0)
+                return;
+            void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if(mapping == MAP_FAILED)
+                throw std::runtime_error("Cannot map " + path.string());
+            data = static_cast<const uint8_t *>(mapping);
+            ::madvise(mapping, size, MADV_SEQUENTIAL);
+        }
+
+        ~Mapping()
+        {
+            if(data)
+                ::munmap(const_cast<uint8_t *>(data), size);
+        }
+    };
+
+    void writeAll(int descriptor, const uint8_t *data, size_t length, uint64_t offset, const fs::path &path)
+    {
+        while(length > 0)
+        {
+            ssize_t written = ::pwrite(descriptor, data, length, offset);
+            if(written <= 0)
+                throw std::runtime_error("Cannot write " + path.string());
+            data += written;
+            length -= written;
+            offset += written;
+        }
+    }
+
+    void weakChecksumGeneric(const uint8_t *data, size_t length, uint32_t &sum, uint32_t &weightedSum)
+    {
+        uint32_t a = 0;
+        uint32_t b = 0;
+        for(size_t i = 0; i < length; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        sum = a;
+        weightedSum = b;
+    }
+
+#ifdef DELTACOPIER_X86
+    __attribute__((target("avx2")))
+    void weakChecksumAvx2(const uint8_t *data, size_t length, uint32_t &sum, uint32_t &weightedSum)
+    {
+        // Every 32 bytes add their sum and their sum weighted 32 to 1, and 32 times the sum before them
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ones = _mm256_set1_epi16(1);
+        const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+            16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+        __m256i sums = zero;
+        __m256i previousSums = zero;
+        __m256i weighted = zero;
+        size_t chunks = length / 32;
+        for(size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + chunk * 32));
+            previousSums = _mm256_add_epi64(previousSums, sums);
+            sums = _mm256_add_epi64(sums, _mm256_sad_epu8(bytes, zero));
+            weighted = _mm256_add_epi32(weighted, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, weights), ones));
+        }
+
+        uint64_t sumLanes[4];
+        uint64_t previousLanes[4];
+        uint32_t weightedLanes[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(sumLanes), sums);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(previousLanes), previousSums);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(weightedLanes), weighted);
+
+        uint32_t a = uint32_t(sumLanes[0] + sumLanes[1] + sumLanes[2] + sumLanes[3]);
+        uint32_t b = uint32_t(32 * (previousLanes[0] + previousLanes[1] + previousLanes[2] + previousLanes[3]));
+        for(uint32_t lane : weightedLanes)
+        {
+            b += lane;
+        }
+        for(size_t i = chunks * 32; i < length; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        sum = a;
+        weightedSum = b;
+    }
+#endif
+
+    using ChecksumFunction = void (*)(const uint8_t *, size_t, uint32_t &, uint32_t &);
+
+    constexpr uint32_t filterBits = 1 << 22;
+
+    inline uint32_t filterBucket(uint32_t weak)
+    {
+        return (weak * 0x9E3779B1U) >> 10;
+    }
+
+    ChecksumFunction selectChecksumFunction()
+    {
+#ifdef DELTACOPIER_X86
+        if(__builtin_cpu_supports("avx2"))
+            return weakChecksumAvx2;
+#endif
+        return weakChecksumGeneric;
+    }
+}
+
+DeltaResult DeltaCopier::update(const fs::path &source, const fs::path &destination)
+{
+    Descriptor sourceDescriptor{::open(source.c_str(), O_RDONLY | O_CLOEXEC)};
+    Descriptor destinationDescriptor{::open(destination.c_str(), O_RDWR | O_CLOEXEC)};
+    struct stat sourceStatus;
+    struct stat destinationStatus;
+    if(sourceDescriptor.value < 0 || ::fstat(sourceDescriptor.value, &sourceStatus) != 0 || !S_ISREG(sourceStatus.st_mode))
+    {
+        throw std::runtime_error("Cannot read " + source.string());
+    }
+    if(destinationDescriptor.value < 0 || ::fstat(destinationDescriptor.value, &destinationStatus) != 0 || !S_ISREG(destinationStatus.st_mode))
+    {
+        throw std::runtime_error("Cannot update " + destination.string());
+    }
+
+    Mapping sourceData(sourceDescriptor.value, sourceStatus.st_size, source);
+    Mapping destinationData(destinationDescriptor.value, destinationStatus.st_size, destination);
+
+    // The short last block of the destination gets no signature, its bytes are literals if they changed
+    const size_t blockSize = blockSizeFor(destinationData.size);
+    const size_t blockCount = destinationData.size / blockSize;
+    std::vector<Signature> signatures(blockCount);
+    ThreadPool::parallelFor(blockCount, [&](size_t begin, size_t end)
+    {
+        for(size_t block = begin; block < end; block++)
+        {
+            const uint8_t *data = destinationData.data + block * blockSize;
+            uint32_t sum;
+            uint32_t weightedSum;
+            weakChecksum(data, blockSize, sum, weightedSum);
+            signatures[block].weak = combine(sum, weightedSum);
+            signatures[block].strong = FastHash::hash(data, blockSize);
+        }
+    }, 16);
+
+    // Most windows of a changed region match no block, a bit per weak checksum bucket rejects them before the map is searched
+    std::unordered_multimap<uint32_t, size_t> blocksByWeak;
+    std::vector<uint64_t> weakFilter(filterBits / 64);
+    blocksByWeak.reserve(blockCount);
+    for(size_t block = 0; block < blockCount; block++)
+    {
+        blocksByWeak.emplace(signatures[block].weak, block);
+        uint32_t bucket = filterBucket(signatures[block].weak);
+        weakFilter[bucket / 64] |= uint64_t(1) << (bucket % 64);
+    }
+
+    std::vector<Operation> operations;
+    DeltaResult result;
+    const uint8_t *data = sourceData.data;
+    uint64_t position = 0;
+    uint64_t literalStart = 0;
+    bool isWindowValid = false;
+    uint32_t sum = 0;
+    uint32_t weightedSum = 0;
+    while(blockCount > 0 && position + blockSize <= sourceData.size)
+    {
+        if(!isWindowValid)
+        {
+            weakChecksum(data + position, blockSize, sum, weightedSum);
+            isWindowValid = true;
+        }
+
+        // The block at the same offset is preferred, the destination can then be patched in place
+        uint32_t weak = combine(sum, weightedSum);
+        size_t match = blockCount;
+        uint32_t bucket = filterBucket(weak);
+        auto candidates = (weakFilter[bucket / 64] >> (bucket % 64)) & 1 ? blocksByWeak.equal_range(weak) : std::make_pair(blocksByWeak.end(), blocksByWeak.end());
+        if(candidates.first != candidates.second)
+        {
+            ContentHash strong = FastHash::hash(data + position, blockSize);
+            size_t sameOffset = position / blockSize;
+            if(position % blockSize == 0 && sameOffset < blockCount && signatures[sameOffset].weak == weak && signatures[sameOffset].strong == strong)
+            {
+                match = sameOffset;
+            }
+            for(auto candidate = candidates.first; candidate != candidates.second && match == blockCount; ++candidate)
+            {
+                if(signatures[candidate->second].strong == strong)
+                    match = candidate->second;
+            }
+        }
+
+        if(match < blockCount)
+        {
+            if(literalStart < position)
+                append(operations, {literalStart, 0, position - literalStart, true});
+            append(operations, {position, match * blockSize, blockSize, false});
+            result.bytesMatched += blockSize;
+            position += blockSize;
+            literalStart = position;
+            isWindowValid = false;
+            continue;
+        }
+
+        if(position + blockSize == sourceData.size)
+            break;
+        uint8_t leaving = data[position];
+        uint8_t entering = data[position + blockSize];
+        sum = sum - leaving + entering;
+        weightedSum = weightedSum - uint32_t(blockSize) * leaving + sum;
+        position++;
+    }
+    if(literalStart < sourceData.size)
+    {
+        append(operations, {literalStart, 0, sourceData.size - literalStart, true});
+    }
+
+    result.isInPlace = std::all_of(operations.begin(), operations.end(),
+        [](const Operation &operation) { return operation.isLiteral || operation.sourceOffset == operation.destinationOffset; });
+
+    const struct timespec times[2] = {{0, UTIME_OMIT}, sourceStatus.st_mtim};
+    if(result.isInPlace)
+    {
+        // Only the pages that differ from the old contents are written
+        const uint64_t pageSize = 4096;
+        for(const auto& operation : operations)
+        {
+            if(!operation.isLiteral)
+                continue;
+            for(uint64_t offset = operation.sourceOffset; offset < operation.sourceOffset + operation.length; offset += pageSize)
+            {
+                uint64_t length = std::min(pageSize, operation.sourceOffset + operation.length - offset);
+                if(offset + length <= destinationData.size && std::memcmp(data + offset, destinationData.data + offset, length) == 0)
+                    continue;
+                writeAll(destinationDescriptor.value, data + offset, length, offset, destination);
+                result.bytesWritten += length;
+            }
+        }
+        if(sourceData.size != destinationData.size && ::ftruncate(destinationDescriptor.value, sourceData.size) != 0)
+        {
+            throw std::runtime_error("Cannot resize " + destination.string());
+        }
+        ::fchmod(destinationDescriptor.value, sourceStatus.st_mode & 07777);
+        ::futimens(destinationDescriptor.value, times);
+        return result;
+    }
+
+    // Moved blocks would be overwritten before they are read, the new contents are assembled next to the destination
+    fs::path temporary = destination.parent_path() / ("." + destination.filename().string() + ".yakubleo-delta");
+    Descriptor temporaryDescriptor{::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, sourceStatus.st_mode & 07777)};
+    if(temporaryDescriptor.value < 0)
+    {
+        throw std::runtime_error("Cannot create " + temporary.string());
+    }
+    try
+    {
+        uint64_t offset = 0;
+        for(const auto& operation : operations)
+        {
+            const uint8_t *part = operation.isLiteral ? data + operation.sourceOffset : destinationData.data + operation.destinationOffset;
+            writeAll(temporaryDescriptor.value, part, operation.length, offset, temporary);
+            offset += operation.length;
+        }
+        ::futimens(temporaryDescriptor.value, times);
+        fs::rename(temporary, destination);
+    }
+    catch(const std::exception &e)
+    {
+        ::unlink(temporary.c_str());
+        throw;
+    }
+    result.bytesWritten = sourceData.size;
+    return result;
+}
+
+void DeltaCopier::weakChecksum(const uint8_t *data, size_t length, uint32_t &sum, uint32_t &weightedSum)
+{
+    static const ChecksumFunction checksum = selectChecksumFunction();
+    checksum(data, length, sum, weightedSum);
+}
+
+size_t DeltaCopier::blockSizeFor(uintmax_t size)
+{
+    size_t blockSize = 4096;
+    while(blockSize < (1 << 20) && uintmax_t(blockSize) * blockSize < size)
+    {
+        blockSize *= 2;
+    }
+    return blockSize;
+}
+
+uint32_t DeltaCopier::combine(uint32_t sum, uint32_t weightedSum)
+{
+    return (sum & 0xFFFF) | (weightedSum << 16);
+}
+
+void DeltaCopier::append(std::vector<Operation> &operations, const Operation &operation)
+{
+    if(!operations.empty())
+    {
+        Operation &last = operations.back();
+        if(last.isLiteral == operation.isLiteral && last.sourceOffset + last.length == operation.sourceOffset
+            && (operation.isLiteral || last.destinationOffset + last.length == operation.destinationOffset))
+        {
+            last.length += operation.length;
+            return;
+        }
+    }
+    operations.push_back(operation);
+}
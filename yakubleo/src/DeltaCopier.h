@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include "FileContents.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Outcome of updating a file by its delta.
+ */
+struct DeltaResult
+{
+    uintmax_t bytesWritten = 0; /**< The bytes written to the disk. */
+    uintmax_t bytesMatched = 0; /**< The bytes of the source found in the old destination. */
+    bool isInPlace = false; /**< True if the destination was patched, false if it was rebuilt and renamed over. */
+};
+
+/**
+ * @class DeltaCopier
+ * @brief Updates an existing copy of a file by writing only what changed, the rsync algorithm applied locally.
+ *
+ * The old destination is split into blocks, each with a weak rolling checksum and a strong FastHash. The source
+ * is scanned with a window of one block: where the window matches a block of the destination it moves by a whole
+ * block, elsewhere the weak checksum is rolled by one byte. If every match stays at its offset, only the differing
+ * bytes are written into the destination, otherwise a new file is assembled from the matched blocks and the literal
+ * bytes next to it and renamed over the destination. The checksum of a whole block is computed with AVX2 where available.
+ */
+class DeltaCopier
+{
+public:
+    /**
+     * @brief Smaller files are copied whole, the delta would not save anything.
+     */
+    static constexpr uintmax_t minimalSize = 1 << 20;
+
+    /**
+     * @brief Makes the destination a copy of the source by writing only its changes, keeps the modification time of the source.
+     * @param source The file to copy.
+     * @param destination The old copy, a regular file.
+     * @return The bytes written and matched.
+     * @throws std::runtime_error If one of the files cannot be read or the destination cannot be written.
+     */
+    static DeltaResult update(const fs::path &source, const fs::path &destination);
+
+    /**
+     * @brief Computes the weak checksum of a block, the same value rolling reaches.
+     * @param data The block.
+     * @param length The length of the block.
+     * @param sum Set to the sum of the bytes.
+     * @param weightedSum Set to the sum of the bytes weighted by their distance from the end of the block.
+     */
+    static void weakChecksum(const uint8_t *data, size_t length, uint32_t &sum, uint32_t &weightedSum);
+
+    /**
+     * @brief Chooses the block size, about the square root of the size like rsync does.
+     * @param size The size of the destination.
+     * @return A power of two between 4 KiB and 1 MiB.
+     */
+    static size_t blockSizeFor(uintmax_t size);
+
+private:
+    /**
+     * @brief A part of the new contents.
+     */
+    struct Operation
+    {
+        uint64_t sourceOffset; /**< Where the part is in the source. */
+        uint64_t destinationOffset; /**< Where a matched part is in the old destination. */
+        uint64_t length; /**< The length of the part. */
+        bool isLiteral; /**< True for bytes not found in the destination. */
+    };
+
+    /**
+     * @brief The signature of a block of the destination.
+     */
+    struct Signature
+    {
+        uint32_t weak; /**< The weak checksum. */
+        ContentHash strong; /**< The strong hash. */
+    };
+
+    /**
+     * @brief Combines the two sums into the weak checksum.
+     * @param sum The sum of the bytes.
+     * @param weightedSum The weighted sum of the bytes.
+     * @return The weak checksum.
+     */
+    static uint32_t combine(uint32_t sum, uint32_t weightedSum);
+
+    /**
+     * @brief Appends a part to the new contents, joins it with the previous part if they are adjacent.
+     * @param operations The parts so far.
+     * @param operation The part.
+     */
+    static void append(std::vector<Operation> &operations, const Operation &operation);
+};
@@ -1,4 +1,7 @@
 #include "Directory.h"
+#include <stdexcept>
+#include "Tracer.h"
+#include "SubtreeHasher.h"
 
 Directory::Directory(const fs::path &pathToFile) : File(pathToFile)
 {
@@ -8,6 +11,7 @@ Directory::Directory(const fs::path &pathToFile) : File(pathToFile)
 
 void Directory::copy(const fs::path &destination)
 {
+    Tracer::Span span(Tracer::COPY);
     fs::path destinationFilename = destination / m_pathToFile.filename();
     fs::copy(m_pathToFile, destinationFilename ,fs::copy_options::recursive | fs::copy_options::overwrite_existing);
 
@@ -15,54 +19,21 @@ void Directory::copy(const fs::path &destination)
 
 void Directory::move(const fs::path &destination)
 {
-    fs::rename(m_pathToFile, destination / m_pathToFile.filename());
+    Tracer::Span span(Tracer::MOVE);
+    if(!getParent()->rename(getName(), DirectoryHandle(destination)))
+        throw std::runtime_error("Could not move " + m_pathToFile.string() + " to another filesystem");
 }
 
 void Directory::remove()
 {
-    fs::remove_all(m_pathToFile);
+    Tracer::Span span(Tracer::REMOVE);
+    getParent()->removeAll(getName());
 }
 
 
-void Directory::print(int row, int column, int normalColour, int selectedColour ) const
+char Directory::getTypeLetter() const
 {
-
-    attron(A_NORMAL);
-    mvprintw(row, column, "[D] ");
-    attroff(A_NORMAL);
-
-    
-    int indent = 4;
-    if(m_isPointedAt)
-    {
-        
-        attron(COLOR_PAIR(normalColour));
-        attron(A_REVERSE);
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(A_REVERSE);
-        attroff(COLOR_PAIR(normalColour));
-    }
-    else if(m_isSelected)
-    {
-        attron(COLOR_PAIR(selectedColour));
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(COLOR_PAIR(selectedColour));
-    }
-    else
-    {
-        attron(COLOR_PAIR(normalColour));
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(COLOR_PAIR(normalColour));
-    }
-
-    if(m_isPointedAt && m_isSelected)
-    {
-        attron(COLOR_PAIR(selectedColour));
-        attron(A_REVERSE);
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(A_REVERSE);
-        attroff(COLOR_PAIR(selectedColour));
-    }
+    return 'D';
 }
 
 void Directory::appendContentsTo(std::ofstream &outputStream) const
@@ -75,14 +46,34 @@ void Directory::selectOnText(const std::string &text)
     // Do nothing
 }
 
+std::vector<size_t> Directory::selectOnPatterns(const AhoCorasick &automaton)
+{
+    return {};
+}
+
+void Directory::selectOnRegexText(RegexMatcher &matcher)
+{
+    // Do nothing
+}
+
 File *Directory::clone() const
 {
     return new Directory(*this);
 }
 
+void Directory::setHashCache(HashCache *hashCache)
+{
+    m_hashCache = hashCache;
+}
+
 bool Directory::isEqualTo(const File &otherFile) const
 {
-    return false;
+    const fs::path &otherPath = otherFile.getPath();
+    if(!fs::is_directory(fs::symlink_status(otherPath)))
+    {
+        return false;
+    }
+    return SubtreeHasher::isIdentical(otherPath, m_pathToFile, m_hashCache);
 }
 
 std::string Directory::getContents() const
@@ -90,7 +81,7 @@ std::string Directory::getContents() const
     return "";
 }
 
-void Directory::changeToSymbolicLink(const File &fileToPointAt)
+uintmax_t Directory::changeToLink(const File &fileToPointAt, Deduplicator::Mode mode)
 {
-    // Do nothing
+    return Deduplicator::replaceDirectory(fileToPointAt.getPath(), m_pathToFile, mode);
 }
@@ -1,7 +1,7 @@
 #pragma once
 #include <filesystem>
-#include <ncurses.h>
 #include "File.h"
+#include "HashCache.h"
 #include <fstream>
 
 /**
@@ -43,15 +43,10 @@ public:
     void remove() override;
 
     /**
-     * @brief Prints the directory name.
-     *
-     *
-     * @param row The row number for printing.
-     * @param column The column number for printing.
-     * @param normalColour The color pair number for normal display.
-     * @param selectedColour The color pair number for selected display.
+     * @brief Gets the letter of a directory.
+     * @return D.
      */
-    void print(int row, int column, int normalColour, int selectedColour ) const override;
+    char getTypeLetter() const override;
 
     /**
      * @brief Ignores the output file stream.
@@ -64,6 +59,19 @@ public:
      */
     void selectOnText(const std::string &text) override;
 
+    /**
+     * @brief Ignores the patterns so that only regular files are selected.
+     * @param automaton The compiled patterns.
+     * @return Empty vector.
+     */
+    std::vector<size_t> selectOnPatterns(const AhoCorasick &automaton) override;
+
+    /**
+     * @brief Ignores the regular expression so that only regular files are selected.
+     * @param matcher The matcher of the regular expression.
+     */
+    void selectOnRegexText(RegexMatcher &matcher) override;
+
     /**
      * @brief Clones the directory.
      * @return A pointer to the cloned directory.
@@ -71,9 +79,15 @@ public:
     File *clone() const override;
 
     /**
-     * @brief Ignores the other file so that only regular files are selected.
+     * @brief Sets the cache of content hashes used by isEqualTo().
+     * @param hashCache The cache, nullptr to always read the files.
+     */
+    void setHashCache(HashCache *hashCache);
+
+    /**
+     * @brief Compares the whole subtrees by their Merkle hashes, see SubtreeHasher::isIdentical().
      * @param otherFile The other file.
-     * @return false.
+     * @return True if the other file is a directory with the same names, types and contents, both non-empty and readable.
      */
     bool isEqualTo(const File &otherFile) const override;
 
@@ -84,9 +98,13 @@ public:
     std::string getContents() const override;
 
     /**
-     * @brief Does nothing. So that only regular files can be changed to symbolic links.
-     * @param fileToPointAt The file to point at.
+     * @brief Replaces the directory identical to the other one, see Deduplicator::replaceDirectory().
+     * @param fileToPointAt The directory to point at.
+     * @param mode The kind of the link.
+     * @return The number of bytes reclaimed.
      */
-    void changeToSymbolicLink(const File& fileToPointAt) override;    
+    uintmax_t changeToLink(const File &fileToPointAt, Deduplicator::Mode mode) override;
 
+private:
+    HashCache *m_hashCache = nullptr; /**< The cache of content hashes, may be nullptr. */
 };
\ No newline at end of file
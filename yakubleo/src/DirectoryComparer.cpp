@@ -0,0 +1,265 @@
+#include "DirectoryComparer.h"
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include "DeltaCopier.h"
+#include "FileContents.h"
+
+DirectoryComparer::DirectoryComparer(HashCache *hashCache, size_t threadCount) : m_hashCache(hashCache), m_threadCount(threadCount), m_isContentChecked(false)
+{
+}
+
+DirectoryComparison DirectoryComparer::compare(const fs::path &source, const fs::path &target, bool isContentChecked)
+{
+    if(!fs::is_directory(source) || !fs::is_directory(target))
+    {
+        throw std::runtime_error("Both compared paths have to be directories");
+    }
+
+    m_isContentChecked = isContentChecked;
+    m_source = source;
+    m_target = target;
+    m_comparison = DirectoryComparison();
+    m_comparison.source = source;
+    m_comparison.target = target;
+
+    ThreadPool pool(m_threadCount);
+    pool.submit([this, &pool] { compareDirectories(pool, fs::path()); });
+    pool.wait();
+
+    std::sort(m_comparison.differences.begin(), m_comparison.differences.end(),
+        [](const ComparedEntry &first, const ComparedEntry &second) { return first.relativePath < second.relativePath; });
+    std::sort(m_comparison.unreadableDirectories.begin(), m_comparison.unreadableDirectories.end());
+    return std::move(m_comparison);
+}
+
+MirrorResult DirectoryComparer::mirror(const DirectoryComparison &comparison, bool isExtraRemoved, size_t threadCount)
+{
+    MirrorResult result;
+    result.failures = comparison.unreadableDirectories.size();
+    std::mutex mutex;
+
+    // The differing entries never contain one another, they are mirrored independently
+    ThreadPool pool(threadCount);
+    for(const auto& entry : comparison.differences)
+    {
+        pool.submit([&comparison, &entry, isExtraRemoved, &result, &mutex]
+        {
+            fs::path source = comparison.source / entry.relativePath;
+            fs::path target = comparison.target / entry.relativePath;
+            try
+            {
+                switch(entry.difference)
+                {
+                case ComparedEntry::ADDED:
+                    copyEntry(source, target, result, mutex);
+                    break;
+                case ComparedEntry::CHANGED:
+                {
+                    bool areRegularFiles = fs::is_regular_file(fs::symlink_status(source)) && fs::is_regular_file(fs::symlink_status(target));
+                    if(areRegularFiles && fs::file_size(target) >= DeltaCopier::minimalSize)
+                    {
+                        DeltaResult delta = DeltaCopier::update(source, target);
+                        std::lock_guard<std::mutex> lock(mutex);
+                        result.entriesCopied++;
+                        result.bytesCopied += fs::file_size(target);
+                        result.bytesWritten += delta.bytesWritten;
+                    }
+                    else if(areRegularFiles)
+                    {
+                        // The old file stays complete until the new one replaces it
+                        fs::path temporary = target.parent_path() / ("." + target.filename().string() + ".yakubleo-mirror");
+                        fs::remove(temporary);
+                        copyEntry(source, temporary, result, mutex);
+                        fs::rename(temporary, target);
+                    }
+                    else
+                    {
+                        fs::remove_all(target);
+                        copyEntry(source, target, result, mutex);
+                    }
+                    break;
+                }
+                case ComparedEntry::REMOVED:
+                    if(isExtraRemoved)
+                    {
+                        fs::remove_all(target);
+                        std::lock_guard<std::mutex> lock(mutex);
+                        result.entriesRemoved++;
+                    }
+                    break;
+                }
+            }
+            catch(const std::exception &e)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                result.failures++;
+            }
+        });
+    }
+    pool.wait();
+    return result;
+}
+
+void DirectoryComparer::compareDirectories(ThreadPool &pool, const fs::path &relativePath)
+{
+    std::vector<Entry> sourceEntries;
+    std::vector<Entry> targetEntries;
+    try
+    {
+        sourceEntries = readDirectory(m_source / relativePath);
+        targetEntries = readDirectory(m_target / relativePath);
+    }
+    catch(const std::exception &e)
+    {
+        // Like an unreadable file, the pair only fails, the rest of the trees is still compared
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_comparison.unreadableDirectories.push_back(relativePath);
+        return;
+    }
+
+    std::vector<ComparedEntry> differences;
+    size_t identicalCount = 0;
+    uintmax_t identicalBytes = 0;
+    auto regularSize = [](const struct stat &status) { return S_ISREG(status.st_mode) ? uintmax_t(status.st_size) : 0; };
+
+    // Both lists are sorted by name, one pass matches them
+    size_t i = 0;
+    size_t j = 0;
+    while(i < sourceEntries.size() || j < targetEntries.size())
+    {
+        int order = (i == sourceEntries.size()) ? 1 : (j == targetEntries.size()) ? -1 : sourceEntries[i].name.compare(targetEntries[j].name);
+        if(order < 0)
+        {
+            const struct stat &status = sourceEntries[i].status;
+            differences.push_back({relativePath / sourceEntries[i].name, ComparedEntry::ADDED, S_ISDIR(status.st_mode), regularSize(status)});
+            i++;
+            continue;
+        }
+        if(order > 0)
+        {
+            const struct stat &status = targetEntries[j].status;
+            differences.push_back({relativePath / targetEntries[j].name, ComparedEntry::REMOVED, S_ISDIR(status.st_mode), regularSize(status)});
+            j++;
+            continue;
+        }
+
+        const Entry &source = sourceEntries[i++];
+        const Entry &target = targetEntries[j++];
+        fs::path path = relativePath / source.name;
+        if(S_ISDIR(source.status.st_mode) && S_ISDIR(target.status.st_mode))
+        {
+            identicalCount++;
+            pool.submit([this, &pool, path] { compareDirectories(pool, path); });
+        }
+        else if(isEqual(path, source, target))
+        {
+            identicalCount++;
+            identicalBytes += regularSize(source.status);
+        }
+        else
+        {
+            differences.push_back({path, ComparedEntry::CHANGED, S_ISDIR(source.status.st_mode), regularSize(source.status)});
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_comparison.differences.insert(m_comparison.differences.end(), differences.begin(), differences.end());
+    m_comparison.identicalCount += identicalCount;
+    m_comparison.identicalBytes += identicalBytes;
+}
+
+bool DirectoryComparer::isEqual(const fs::path &relativePath, const Entry &source, const Entry &target) const
+{
+    if((source.status.st_mode & S_IFMT) != (target.status.st_mode & S_IFMT))
+    {
+        return false;
+    }
+
+    try
+    {
+        if(S_ISREG(source.status.st_mode))
+        {
+            if(source.status.st_size != target.status.st_size)
+                return false;
+            if(!m_isContentChecked)
+                return source.status.st_mtim.tv_sec == target.status.st_mtim.tv_sec && source.status.st_mtim.tv_nsec == target.status.st_mtim.tv_nsec;
+            if(!m_hashCache)
+                return FileContents::equal(m_source / relativePath, m_target / relativePath);
+            return m_hashCache->hash(m_source / relativePath, source.status, HashCache::FULL)
+                == m_hashCache->hash(m_target / relativePath, target.status, HashCache::FULL);
+        }
+        if(S_ISLNK(source.status.st_mode))
+        {
+            return fs::read_symlink(m_source / relativePath) == fs::read_symlink(m_target / relativePath);
+        }
+    }
+    catch(const std::exception &e)
+    {
+        // What cannot be read is copied again
+        return false;
+    }
+    return true;
+}
+
+std::vector<DirectoryComparer::Entry> DirectoryComparer::readDirectory(const fs::path &directory)
+{
+    DIR *stream = ::opendir(directory.c_str());
+    if(!stream)
+    {
+        throw std::runtime_error("Cannot read directory " + directory.string());
+    }
+
+    std::vector<Entry> entries;
+    int descriptor = ::dirfd(stream);
+    while(dirent *entry = ::readdir(stream))
+    {
+        if(std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        Entry read;
+        read.name = entry->d_name;
+        if(::fstatat(descriptor, entry->d_name, &read.status, AT_SYMLINK_NOFOLLOW) == 0)
+            entries.push_back(std::move(read));
+    }
+    ::closedir(stream);
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &first, const Entry &second) { return first.name < second.name; });
+    return entries;
+}
+
+void DirectoryComparer::copyEntry(const fs::path &source, const fs::path &destination, MirrorResult &result, std::mutex &mutex)
+{
+    fs::file_status status = fs::symlink_status(source);
+    uintmax_t bytes = 0;
+    if(fs::is_symlink(status))
+    {
+        fs::copy_symlink(source, destination);
+    }
+    else if(fs::is_directory(status))
+    {
+        fs::create_directory(destination, source);
+        for(const auto& entry : fs::directory_iterator(source))
+        {
+            copyEntry(entry.path(), destination / entry.path().filename(), result, mutex);
+        }
+    }
+    else if(fs::is_regular_file(status))
+    {
+        fs::copy_file(source, destination);
+        fs::last_write_time(destination, fs::last_write_time(source));
+        bytes = fs::file_size(destination);
+    }
+    else
+    {
+        // Devices, pipes and sockets are not copied
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    result.entriesCopied++;
+    result.bytesCopied += bytes;
+    result.bytesWritten += bytes;
+}
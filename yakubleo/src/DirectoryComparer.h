@@ -0,0 +1,152 @@
+#pragma once
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include "HashCache.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief An entry that differs between the compared directories.
+ */
+struct ComparedEntry
+{
+    /**
+     * @brief How the entry differs.
+     */
+    enum Difference
+    {
+        ADDED, /**< Only in the source, a directory is listed once for its whole subtree. */
+        REMOVED, /**< Only in the target, a directory is listed once for its whole subtree. */
+        CHANGED /**< In both, with a different type, size, modification time, contents or link target. */
+    };
+
+    fs::path relativePath; /**< The path relative to the compared directories. */
+    Difference difference; /**< How the entry differs. */
+    bool isDirectory; /**< True if the entry in the source, or in the target for a removed one, is a directory. */
+    uintmax_t size; /**< The size of a regular file, 0 otherwise. */
+};
+
+/**
+ * @brief Outcome of comparing two directory trees.
+ */
+struct DirectoryComparison
+{
+    fs::path source; /**< The directory that is mirrored. */
+    fs::path target; /**< The directory that becomes its copy. */
+    std::vector<ComparedEntry> differences; /**< The differing entries sorted by their paths. */
+    size_t identicalCount = 0; /**< The number of identical entries, directories present in both included. */
+    uintmax_t identicalBytes = 0; /**< The size of the identical regular files. */
+    std::vector<fs::path> unreadableDirectories; /**< Directories that could not be read in one of the trees, relative to them; nothing below them is compared or mirrored. */
+};
+
+/**
+ * @brief Outcome of mirroring a directory.
+ */
+struct MirrorResult
+{
+    size_t entriesCopied = 0; /**< The number of regular files, links and directories copied. */
+    uintmax_t bytesCopied = 0; /**< The size of the copied regular files. */
+    uintmax_t bytesWritten = 0; /**< The bytes written, less than bytesCopied when changed files are updated by their deltas. */
+    size_t entriesRemoved = 0; /**< The number of extra entries removed from the target. */
+    size_t failures = 0; /**< The number of differing entries that could not be mirrored and of directories that could not be compared. */
+};
+
+/**
+ * @class DirectoryComparer
+ * @brief Compares two directory trees in parallel and mirrors one onto the other copying only what differs.
+ *
+ * Every pair of directories present in both trees is read by one task of a thread pool and the entries are matched
+ * by name. Regular files are equal when their size and modification time are, or, when the contents are checked,
+ * when their sizes and content hashes are. Identical entries are only counted, so comparing a large unchanged tree
+ * costs two readdir and stat calls per entry and keeps no per-file state.
+ */
+class DirectoryComparer
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param hashCache The cache of content hashes, nullptr to always read the files.
+     * @param threadCount The number of threads.
+     */
+    DirectoryComparer(HashCache *hashCache = nullptr, size_t threadCount = ThreadPool::defaultThreadCount());
+
+    /**
+     * @brief Compares the trees.
+     * @param source The directory that is mirrored.
+     * @param target The directory that becomes its copy.
+     * @param isContentChecked True to compare the contents of regular files of the same size instead of their modification times.
+     * @return The differences, directories that cannot be read are listed in unreadableDirectories.
+     * @throws std::runtime_error If one of the paths is not a directory.
+     */
+    DirectoryComparison compare(const fs::path &source, const fs::path &target, bool isContentChecked);
+
+    /**
+     * @brief Makes the target a copy of the source, copies the added and changed entries in parallel.
+     *
+     * Changed regular files of at least DeltaCopier::minimalSize bytes are updated by their deltas, smaller ones are copied
+     * next to the old ones and renamed over them. Copies keep the modification times of the originals so that the next
+     * comparison finds them identical.
+     *
+     * @param comparison The comparison of the trees.
+     * @param isExtraRemoved True to remove the entries that are only in the target.
+     * @param threadCount The number of threads.
+     * @return The numbers of copied and removed entries.
+     */
+    static MirrorResult mirror(const DirectoryComparison &comparison, bool isExtraRemoved, size_t threadCount = ThreadPool::defaultThreadCount());
+
+private:
+    /**
+     * @brief An entry of a directory read for the comparison.
+     */
+    struct Entry
+    {
+        std::string name; /**< The name of the entry. */
+        struct stat status; /**< The status, symbolic links are not followed. */
+    };
+
+    HashCache *m_hashCache; /**< The cache of content hashes, may be nullptr. */
+    size_t m_threadCount; /**< The number of threads. */
+    bool m_isContentChecked; /**< True if the contents of regular files are compared. */
+    fs::path m_source; /**< The source of the running comparison. */
+    fs::path m_target; /**< The target of the running comparison. */
+
+    std::mutex m_mutex; /**< Guards the comparison. */
+    DirectoryComparison m_comparison; /**< The comparison being built. */
+
+    /**
+     * @brief Compares a pair of directories present in both trees and queues the pairs of their subdirectories.
+     * @param pool The pool running the comparison.
+     * @param relativePath The path of the directories relative to the roots.
+     */
+    void compareDirectories(ThreadPool &pool, const fs::path &relativePath);
+
+    /**
+     * @brief Tells if two entries of the same name are equal.
+     * @param relativePath The path of the entries relative to the roots.
+     * @param source The entry in the source.
+     * @param target The entry in the target.
+     * @return True if they are equal.
+     */
+    bool isEqual(const fs::path &relativePath, const Entry &source, const Entry &target) const;
+
+    /**
+     * @brief Reads the entries of a directory sorted by name.
+     * @param directory The directory.
+     * @return The entries, the ones that vanish while being read are left out.
+     * @throws std::runtime_error If the directory cannot be read.
+     */
+    static std::vector<Entry> readDirectory(const fs::path &directory);
+
+    /**
+     * @brief Copies an entry, directories with everything below them, keeping the modification times.
+     * @param source The entry to copy.
+     * @param destination The path of the copy, nothing may be there.
+     * @param result The counts of copied entries.
+     * @param mutex Guards the counts.
+     */
+    static void copyEntry(const fs::path &source, const fs::path &destination, MirrorResult &result, std::mutex &mutex);
+};
@@ -0,0 +1,209 @@
+#include "DirectoryHandle.h"
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include "DeltaCopier.h"
+#include "SystemCall.h"
+
+DirectoryHandle::DirectoryHandle(const fs::path &directory)
+    : m_path(directory), m_descriptor(::open(directory.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC))
+{
+    if(m_descriptor < 0)
+        throw systemError("Could not open directory", directory);
+}
+
+DirectoryHandle::DirectoryHandle(const DirectoryHandle &parent, const std::string &name)
+    : m_path(parent.m_path / name), m_descriptor(::openat(parent.m_descriptor, name.c_str(), O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC))
+{
+    if(m_descriptor < 0)
+        throw systemError("Could not open directory", m_path);
+}
+
+DirectoryHandle::~DirectoryHandle()
+{
+    ::close(m_descriptor);
+}
+
+const fs::path &DirectoryHandle::getPath() const
+{
+    return m_path;
+}
+
+int DirectoryHandle::getDescriptor() const
+{
+    return m_descriptor;
+}
+
+std::vector<DirectoryEntry> DirectoryHandle::list() const
+{
+    // An O_PATH descriptor cannot be read, the directory is opened again through it
+    int descriptor = ::openat(m_descriptor, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *stream = descriptor >= 0 ? ::fdopendir(descriptor) : nullptr;
+    if(!stream)
+    {
+        if(descriptor >= 0)
+            ::close(descriptor);
+        throw systemError("Could not read directory", m_path);
+    }
+
+    std::vector<DirectoryEntry> entries;
+    while(dirent *entry = ::readdir(stream))
+    {
+        if(std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        unsigned char type = entry->d_type;
+        struct stat status;
+        if(type == DT_UNKNOWN && stat(entry->d_name, status))
+            type = IFTODT(status.st_mode);
+        entries.push_back({entry->d_name, type});
+    }
+    ::closedir(stream);
+    return entries;
+}
+
+bool DirectoryHandle::stat(const std::string &name, struct stat &status) const
+{
+    return ::fstatat(m_descriptor, name.c_str(), &status, AT_SYMLINK_NOFOLLOW) == 0;
+}
+
+int DirectoryHandle::openFile(const std::string &name, int flags, mode_t mode) const
+{
+    int descriptor = ::openat(m_descriptor, name.c_str(), flags | O_NOFOLLOW | O_CLOEXEC, mode);
+    if(descriptor < 0)
+        throw systemError("Could not open file", m_path / name);
+    return descriptor;
+}
+
+bool DirectoryHandle::rename(const std::string &name, const DirectoryHandle &destination) const
+{
+    if(::renameat(m_descriptor, name.c_str(), destination.m_descriptor, name.c_str()) == 0)
+        return true;
+    if(errno == EXDEV)
+        return false;
+    throw systemError("Could not move", m_path / name);
+}
+
+void DirectoryHandle::remove(const std::string &name) const
+{
+    if(::unlinkat(m_descriptor, name.c_str(), 0) == 0)
+        return;
+    if(errno != EISDIR || ::unlinkat(m_descriptor, name.c_str(), AT_REMOVEDIR) != 0)
+        throw systemError("Could not remove", m_path / name);
+}
+
+uintmax_t DirectoryHandle::removeAll(const std::string &name) const
+{
+    struct stat status;
+    if(!stat(name, status))
+    {
+        if(errno == ENOENT)
+            return 0;
+        throw systemError("Could not stat", m_path / name);
+    }
+    if(!S_ISDIR(status.st_mode))
+    {
+        remove(name);
+        return 1;
+    }
+
+    // The subdirectory is opened without following links, a link put in its place is not entered
+    uintmax_t removed = 0;
+    {
+        DirectoryHandle subdirectory(*this, name);
+        for(const auto& entry : subdirectory.list())
+        {
+            removed += subdirectory.removeAll(entry.name);
+        }
+    }
+    if(::unlinkat(m_descriptor, name.c_str(), AT_REMOVEDIR) != 0)
+        throw systemError("Could not remove", m_path / name);
+    return removed + 1;
+}
+
+std::string DirectoryHandle::readLink(const std::string &name) const
+{
+    std::vector<char> target(256);
+    while(true)
+    {
+        ssize_t length = ::readlinkat(m_descriptor, name.c_str(), target.data(), target.size());
+        if(length < 0)
+            throw systemError("Could not read the link", m_path / name);
+        if(size_t(length) < target.size())
+            return std::string(target.data(), length);
+        target.resize(target.size() * 2);
+    }
+}
+
+void DirectoryHandle::createLink(const std::string &target, const std::string &name) const
+{
+    if(::symlinkat(target.c_str(), m_descriptor, name.c_str()) != 0)
+        throw systemError("Could not create the link", m_path / name);
+}
+
+uintmax_t DirectoryHandle::copyFile(const std::string &name, const DirectoryHandle &destination) const
+{
+    // A fifo put in place of the file must not block the open
+    Descriptor input(openFile(name, O_RDONLY | O_NONBLOCK));
+    struct stat status;
+    if(::fstat(input.get(), &status) != 0)
+        throw systemError("Could not stat", m_path / name);
+    if(!S_ISREG(status.st_mode))
+        throw std::runtime_error((m_path / name).string() + " is not a regular file");
+
+    struct stat targetStatus;
+    if(destination.stat(name, targetStatus) && S_ISREG(targetStatus.st_mode))
+    {
+        if(targetStatus.st_dev == status.st_dev && targetStatus.st_ino == status.st_ino)
+            throw std::runtime_error("Could not copy " + (m_path / name).string() + " onto itself");
+
+        // A large older copy is updated by the delta instead of being rewritten
+        if(uintmax_t(targetStatus.st_size) >= DeltaCopier::minimalSize)
+            return DeltaCopier::update(m_path / name, destination.m_path / name).bytesWritten;
+    }
+
+    Descriptor output(destination.openFile(name, O_WRONLY | O_CREAT | O_TRUNC));
+    if(::fchmod(output.get(), status.st_mode & 07777) != 0)
+        throw systemError("Could not set the permissions of", destination.m_path / name);
+    return copyData(input.get(), output.get());
+}
+
+uintmax_t DirectoryHandle::copyData(int from, int to)
+{
+    uintmax_t copied = 0;
+    while(true)
+    {
+        ssize_t count = ::copy_file_range(from, nullptr, to, nullptr, 1 << 30, 0);
+        if(count > 0)
+        {
+            copied += count;
+            continue;
+        }
+        if(count == 0)
+            return copied;
+        if(copied > 0 || (errno != EXDEV && errno != EINVAL && errno != ENOSYS && errno != EOPNOTSUPP))
+            throw std::runtime_error(std::string("Could not copy: ") + std::strerror(errno));
+        break;
+    }
+
+    // Filesystems without copy_file_range between them get a plain read and write
+    std::vector<char> buffer(256 * 1024);
+    ssize_t count;
+    while((count = ::read(from, buffer.data(), buffer.size())) > 0)
+    {
+        for(ssize_t written = 0; written < count; )
+        {
+            ssize_t result = ::write(to, buffer.data() + written, count - written);
+            if(result < 0)
+                throw std::runtime_error(std::string("Could not write: ") + std::strerror(errno));
+            written += result;
+        }
+        copied += count;
+    }
+    if(count < 0)
+        throw std::runtime_error(std::string("Could not read: ") + std::strerror(errno));
+    return copied;
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief An entry read from a directory.
+ */
+struct DirectoryEntry
+{
+    std::string name; /**< The name in the directory. */
+    unsigned char type; /**< The type as DT_DIR, DT_REG, DT_LNK and so on, never DT_UNKNOWN. */
+};
+
+/**
+ * @class DirectoryHandle
+ * @brief An open directory that the operations on its entries are relative to.
+ *
+ * The directory is opened once with O_PATH, every other call names only an entry and goes through the
+ * *at system calls, so the kernel does not walk the whole path again and a rename of a directory above
+ * does not redirect the call to another file. Symbolic links in the names are never followed.
+ */
+class DirectoryHandle
+{
+public:
+    /**
+     * @brief Opens the directory.
+     * @param directory The path of the directory.
+     * @throws std::runtime_error If it cannot be opened.
+     */
+    explicit DirectoryHandle(const fs::path &directory);
+
+    /**
+     * @brief Opens a subdirectory, a symbolic link in its place is refused.
+     * @param parent The directory it is in.
+     * @param name The name of the subdirectory.
+     * @throws std::runtime_error If it cannot be opened.
+     */
+    DirectoryHandle(const DirectoryHandle &parent, const std::string &name);
+
+    ~DirectoryHandle();
+
+    DirectoryHandle(const DirectoryHandle &) = delete;
+    DirectoryHandle &operator=(const DirectoryHandle &) = delete;
+
+    /**
+     * @brief Gets the path the directory was opened at.
+     * @return The path.
+     */
+    const fs::path &getPath() const;
+
+    /**
+     * @brief Gets the descriptor of the directory.
+     * @return The descriptor, opened with O_PATH.
+     */
+    int getDescriptor() const;
+
+    /**
+     * @brief Reads the entries of the directory, without . and ..
+     * @return The entries in the order the directory returns them.
+     * @throws std::runtime_error If the directory cannot be read.
+     */
+    std::vector<DirectoryEntry> list() const;
+
+    /**
+     * @brief Gets the status of an entry, symbolic links are not followed.
+     * @param name The name of the entry.
+     * @param status Receives the status.
+     * @return False if the entry does not exist or cannot be stat-ed.
+     */
+    bool stat(const std::string &name, struct stat &status) const;
+
+    /**
+     * @brief Opens an entry, O_NOFOLLOW and O_CLOEXEC are added to the flags.
+     * @param name The name of the entry.
+     * @param flags The flags of open.
+     * @param mode The permissions of a created file.
+     * @return The descriptor, closed by the caller.
+     * @throws std::runtime_error If it cannot be opened.
+     */
+    int openFile(const std::string &name, int flags, mode_t mode = 0600) const;
+
+    /**
+     * @brief Moves an entry to another directory under the same name.
+     * @param name The name of the entry.
+     * @param destination The directory.
+     * @return False if the directory is on another filesystem and nothing was moved.
+     * @throws std::runtime_error If the rename fails otherwise.
+     */
+    bool rename(const std::string &name, const DirectoryHandle &destination) const;
+
+    /**
+     * @brief Removes a regular file, a symbolic link or an empty directory.
+     * @param name The name of the entry.
+     * @throws std::runtime_error If it cannot be removed.
+     */
+    void remove(const std::string &name) const;
+
+    /**
+     * @brief Removes an entry and, for a directory, everything in it; symbolic links are removed, not followed.
+     * @param name The name of the entry.
+     * @return The number of entries removed.
+     * @throws std::runtime_error If something cannot be removed.
+     */
+    uintmax_t removeAll(const std::string &name) const;
+
+    /**
+     * @brief Reads the target of a symbolic link.
+     * @param name The name of the link.
+     * @return The target.
+     * @throws std::runtime_error If it is not a link.
+     */
+    std::string readLink(const std::string &name) const;
+
+    /**
+     * @brief Creates a symbolic link.
+     * @param target The target of the link.
+     * @param name The name of the link.
+     * @throws std::runtime_error If it cannot be created.
+     */
+    void createLink(const std::string &target, const std::string &name) const;
+
+    /**
+     * @brief Copies a regular file to another directory under the same name with its permissions.
+     *
+     * An existing regular file of 1 MiB or more at the destination is updated by its delta.
+     *
+     * @param name The name of the file.
+     * @param destination The directory.
+     * @return The bytes written.
+     * @throws std::runtime_error If it is not a regular file, it would be copied onto itself or a read or a write fails.
+     */
+    uintmax_t copyFile(const std::string &name, const DirectoryHandle &destination) const;
+
+    /**
+     * @brief Copies the data of one open file to another, in the kernel when it can.
+     * @param from The source.
+     * @param to The destination.
+     * @return The bytes copied.
+     * @throws std::runtime_error If a read or a write fails.
+     */
+    static uintmax_t copyData(int from, int to);
+
+private:
+    fs::path m_path; /**< The path the directory was opened at. */
+    int m_descriptor; /**< The O_PATH descriptor of the directory. */
+};
@@ -0,0 +1,88 @@
+#include "DirectoryWatcher.h"
+#include <map>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+DirectoryWatcher::DirectoryWatcher() : m_descriptor(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)), m_watch(-1)
+{
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    if(m_descriptor >= 0)
+        ::close(m_descriptor);
+}
+
+bool DirectoryWatcher::watch(const fs::path &directory)
+{
+    if(m_watch >= 0)
+    {
+        ::inotify_rm_watch(m_descriptor, m_watch);
+        m_watch = -1;
+    }
+    readChanges();
+
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    m_watch = ::inotify_add_watch(m_descriptor, directory.c_str(), mask);
+    m_directory = m_watch >= 0 ? directory : fs::path();
+    return m_watch >= 0;
+}
+
+const fs::path &DirectoryWatcher::getDirectory() const
+{
+    return m_directory;
+}
+
+int DirectoryWatcher::getDescriptor() const
+{
+    return m_descriptor;
+}
+
+DirectoryChanges DirectoryWatcher::readChanges()
+{
+    DirectoryChanges changes;
+    if(m_descriptor < 0)
+    {
+        return changes;
+    }
+    std::map<std::string, bool> isPresent; // The last event of every name decides
+
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    while(true)
+    {
+        ssize_t length = ::read(m_descriptor, buffer, sizeof(buffer));
+        if(length <= 0)
+            break;
+
+        for(char *position = buffer; position < buffer + length; )
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(position);
+            position += sizeof(struct inotify_event) + event->len;
+
+            if(event->mask & IN_Q_OVERFLOW)
+            {
+                changes.isRescanNeeded = true;
+                continue;
+            }
+            // Events of a watch removed by watch() may still be queued
+            if(event->wd != m_watch)
+                continue;
+
+            if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                changes.isRescanNeeded = true;
+                continue;
+            }
+            if(event->len == 0)
+                continue;
+
+            isPresent[event->name] = !(event->mask & (IN_DELETE | IN_MOVED_FROM));
+        }
+    }
+
+    for(const auto& [name, present] : isPresent)
+    {
+        (present ? changes.present : changes.removed).push_back(name);
+    }
+    return changes;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Changes of the entries of a watched directory, coalesced so that every name appears once.
+ */
+struct DirectoryChanges
+{
+    std::vector<std::string> present; /**< Names created, moved in or changed, that existed at their last event. */
+    std::vector<std::string> removed; /**< Names deleted or moved out, that did not exist at their last event. */
+    bool isRescanNeeded = false; /**< True if events were lost or the directory itself went away. */
+
+    /**
+     * @brief Tells if nothing changed.
+     * @return True if there are no changes.
+     */
+    bool empty() const
+    {
+        return present.empty() && removed.empty() && !isRescanNeeded;
+    }
+};
+
+/**
+ * @class DirectoryWatcher
+ * @brief Watches the entries of one directory with inotify.
+ *
+ * The descriptor is non-blocking, so it can be polled together with the keyboard
+ * and all the queued events are read at once when it becomes readable.
+ * Without inotify the descriptor is -1, which poll() ignores, and nothing is ever reported.
+ */
+class DirectoryWatcher
+{
+public:
+    /**
+     * @brief Constructor. Creates the inotify instance.
+     */
+    DirectoryWatcher();
+
+    /**
+     * @brief Destructor. Closes the inotify instance.
+     */
+    ~DirectoryWatcher();
+
+    DirectoryWatcher(const DirectoryWatcher &) = delete;
+    DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+
+    /**
+     * @brief Watches the directory instead of the one watched so far, the pending events are dropped.
+     * @param directory The directory.
+     * @return False if the directory cannot be watched.
+     */
+    bool watch(const fs::path &directory);
+
+    /**
+     * @brief Gets the watched directory.
+     * @return The directory, empty if nothing is watched.
+     */
+    const fs::path &getDirectory() const;
+
+    /**
+     * @brief Gets the descriptor to poll for readability.
+     * @return The inotify descriptor, -1 without inotify.
+     */
+    int getDescriptor() const;
+
+    /**
+     * @brief Reads all the queued events without blocking.
+     * @return The changes since the last call.
+     */
+    DirectoryChanges readChanges();
+
+private:
+    int m_descriptor; /**< The inotify instance. */
+    int m_watch; /**< The watch of the directory, -1 if there is none. */
+    fs::path m_directory; /**< The watched directory. */
+};
@@ -0,0 +1,264 @@
+#include "DiskUsage.h"
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "SystemCall.h"
+
+DiskUsage::DiskUsage(size_t threadCount) : m_pool(threadCount), m_cancelled(false), m_pendingDirectories(0)
+{
+}
+
+DiskUsage::~DiskUsage()
+{
+    cancel();
+}
+
+void DiskUsage::start(const fs::path &directory)
+{
+    cancel();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sizes.clear();
+        m_countedLinks.clear();
+    }
+
+    auto root = std::make_shared<Node>();
+    root->path = directory;
+    if(::stat(directory.c_str(), &root->status) != 0 || !S_ISDIR(root->status.st_mode))
+    {
+        return;
+    }
+
+    m_cancelled = false;
+    m_pendingDirectories = 1;
+    m_pool.submit([this, root]
+    {
+        readDirectory(root);
+    });
+}
+
+void DiskUsage::cancel()
+{
+    m_cancelled = true;
+    try
+    {
+        m_pool.wait();
+    }
+    catch(const std::exception &e)
+    {
+        // A failed walk only leaves some sizes unknown
+    }
+    m_pendingDirectories = 0;
+}
+
+bool DiskUsage::getSize(const fs::path &directory, DirectorySize &size) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_sizes.find(directory.string());
+    if(found == m_sizes.end())
+    {
+        return false;
+    }
+    size = found->second;
+    return true;
+}
+
+bool DiskUsage::isRunning() const
+{
+    return m_pendingDirectories > 0;
+}
+
+std::string DiskUsage::formatSize(uintmax_t bytes)
+{
+    const char *units = "BKMGTPE";
+    double value = bytes;
+    size_t unit = 0;
+    while(value >= 1024 && unit < 6)
+    {
+        value /= 1024;
+        unit++;
+    }
+
+    char text[32];
+    if(unit == 0)
+        std::snprintf(text, sizeof(text), "%juB", bytes);
+    else
+        std::snprintf(text, sizeof(text), "%.1f%c", value, units[unit]);
+    return text;
+}
+
+void DiskUsage::readDirectory(const std::shared_ptr<Node> &node)
+{
+    if(m_cancelled)
+    {
+        return;
+    }
+
+    CachedDirectory contents;
+    std::vector<struct stat> statuses;
+    bool isCached = findCached(node->status, contents);
+    if(isCached)
+    {
+        // The subdirectories are only stated, their own changes show in their modification times
+        Descriptor directory(::open(node->path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+        statuses.resize(contents.subdirectories.size());
+        for(size_t i = 0; i < contents.subdirectories.size() && isCached; i++)
+        {
+            isCached = directory.get() >= 0 && ::fstatat(directory.get(), contents.subdirectories[i].c_str(), &statuses[i], AT_SYMLINK_NOFOLLOW) == 0
+                && S_ISDIR(statuses[i].st_mode);
+        }
+    }
+    if(!isCached)
+    {
+        contents = CachedDirectory();
+        statuses.clear();
+        if(!readContents(node->path, node->status, contents, statuses))
+            return;
+    }
+
+    DirectorySize own = contents.own;
+    {
+        // Like du, a file with more links is counted where the walk meets it first
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(const auto& link : contents.hardLinks)
+        {
+            if(!m_countedLinks.insert(link.identity).second)
+                continue;
+            own.apparentBytes += link.apparentBytes;
+            own.allocatedBytes += link.allocatedBytes;
+            own.fileCount++;
+        }
+    }
+
+    for(size_t i = 0; i < contents.subdirectories.size(); i++)
+    {
+        auto child = std::make_shared<Node>();
+        child->parent = node;
+        child->path = node->path / contents.subdirectories[i];
+        child->status = statuses[i];
+        {
+            std::lock_guard<std::mutex> lock(node->mutex);
+            node->pending++;
+        }
+        m_pendingDirectories++;
+        m_pool.submit([this, child]
+        {
+            readDirectory(child);
+        });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(node->mutex);
+        add(node->size, own);
+    }
+    finishPart(node);
+}
+
+bool DiskUsage::readContents(const fs::path &path, const struct stat &status, CachedDirectory &contents, std::vector<struct stat> &statuses)
+{
+    // The directory itself occupies space as well
+    contents.modified = status.st_mtim;
+    contents.own.apparentBytes = status.st_size;
+    contents.own.allocatedBytes = uintmax_t(status.st_blocks) * 512;
+
+    int descriptor = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *directory = descriptor >= 0 ? ::fdopendir(descriptor) : nullptr;
+    if(!directory)
+    {
+        // An unreadable directory counts as empty and is tried again by the next walk
+        if(descriptor >= 0)
+            ::close(descriptor);
+        return !m_cancelled;
+    }
+
+    while(!m_cancelled)
+    {
+        struct dirent *entry = ::readdir(directory);
+        if(!entry)
+            break;
+
+        std::string name = entry->d_name;
+        if(name == "." || name == "..")
+            continue;
+
+        struct stat entryStatus;
+        if(::fstatat(::dirfd(directory), entry->d_name, &entryStatus, AT_SYMLINK_NOFOLLOW) != 0)
+            continue;
+
+        if(S_ISDIR(entryStatus.st_mode))
+        {
+            contents.subdirectories.push_back(std::move(name));
+            statuses.push_back(entryStatus);
+        }
+        else if(entryStatus.st_nlink > 1)
+        {
+            contents.hardLinks.push_back(HardLink{std::make_pair(entryStatus.st_dev, entryStatus.st_ino), uintmax_t(entryStatus.st_size),
+                uintmax_t(entryStatus.st_blocks) * 512});
+        }
+        else
+        {
+            contents.own.apparentBytes += entryStatus.st_size;
+            contents.own.allocatedBytes += uintmax_t(entryStatus.st_blocks) * 512;
+            contents.own.fileCount++;
+        }
+    }
+    ::closedir(directory);
+    if(m_cancelled)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cache[std::make_pair(status.st_dev, status.st_ino)] = contents;
+    return true;
+}
+
+void DiskUsage::finishPart(std::shared_ptr<Node> node)
+{
+    while(node)
+    {
+        {
+            std::lock_guard<std::mutex> lock(node->mutex);
+            if(--node->pending > 0)
+                return;
+        }
+
+        // Nothing else touches a complete directory
+        publish(node->path, node->size);
+        m_pendingDirectories--;
+
+        std::shared_ptr<Node> parent = node->parent;
+        if(parent)
+        {
+            std::lock_guard<std::mutex> lock(parent->mutex);
+            add(parent->size, node->size);
+        }
+        node = parent;
+    }
+}
+
+void DiskUsage::add(DirectorySize &size, const DirectorySize &subtree)
+{
+    size.apparentBytes += subtree.apparentBytes;
+    size.allocatedBytes += subtree.allocatedBytes;
+    size.fileCount += subtree.fileCount;
+}
+
+bool DiskUsage::findCached(const struct stat &status, CachedDirectory &contents) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_cache.find(std::make_pair(status.st_dev, status.st_ino));
+    if(found == m_cache.end() || found->second.modified.tv_sec != status.st_mtim.tv_sec
+        || found->second.modified.tv_nsec != status.st_mtim.tv_nsec)
+    {
+        return false;
+    }
+    contents = found->second;
+    return true;
+}
+
+void DiskUsage::publish(const fs::path &path, const DirectorySize &size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sizes[path.string()] = size;
+}
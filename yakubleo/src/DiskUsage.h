@@ -0,0 +1,174 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Size of a directory tree.
+ */
+struct DirectorySize
+{
+    uintmax_t apparentBytes = 0; /**< The sum of the sizes of the entries, as ls shows them. */
+    uintmax_t allocatedBytes = 0; /**< The bytes the entries occupy on the disk, as du shows them. */
+    size_t fileCount = 0; /**< The number of entries that are not directories. */
+};
+
+/**
+ * @class DiskUsage
+ * @brief Computes the sizes of directory trees in the background.
+ *
+ * Every directory is read by one task of a thread pool, subdirectories become new tasks.
+ * A directory is complete when all its subdirectories are, its size is then published and added to its parent,
+ * so the sizes appear bottom up while the walk is still running. Like du, a file with several hard links is counted
+ * once per walk, in the first directory it is met in.
+ * What a directory holds itself, its files and the names of its subdirectories, is cached by its device, inode and
+ * modification time. A walk still stats every directory, but one that did not change is not read again; a change
+ * anywhere below invalidates only the directories it touched, the sizes of their ancestors are summed anew.
+ */
+class DiskUsage
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param threadCount The number of threads reading directories.
+     */
+    DiskUsage(size_t threadCount = ThreadPool::defaultThreadCount());
+
+    /**
+     * @brief Destructor. Cancels the running walk.
+     */
+    ~DiskUsage();
+
+    /**
+     * @brief Cancels the running walk and starts computing the size of the directory and every directory below it.
+     * @param directory The root of the walk.
+     */
+    void start(const fs::path &directory);
+
+    /**
+     * @brief Cancels the running walk, the sizes computed so far stay cached.
+     */
+    void cancel();
+
+    /**
+     * @brief Gets the size of a directory of the current walk.
+     * @param directory The directory.
+     * @param size Set to the size of the directory.
+     * @return True if the size is known, false while it is still being computed.
+     */
+    bool getSize(const fs::path &directory, DirectorySize &size) const;
+
+    /**
+     * @brief Tells if the walk still runs.
+     * @return True while some sizes are still being computed.
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief Formats a number of bytes with a binary unit.
+     * @param bytes The number of bytes.
+     * @return The number with a unit, for example "12.5M".
+     */
+    static std::string formatSize(uintmax_t bytes);
+
+private:
+    /**
+     * @brief A directory whose size is being computed.
+     */
+    struct Node
+    {
+        std::shared_ptr<Node> parent; /**< The parent, nullptr for the root of the walk. */
+        fs::path path; /**< The path to the directory. */
+        struct stat status; /**< The status of the directory. */
+        std::mutex mutex; /**< Guards the size and the counter. */
+        DirectorySize size; /**< The size of the parts of the tree done so far. */
+        size_t pending = 1; /**< The subdirectories still being computed plus one while the directory is read. */
+    };
+
+    /**
+     * @brief A file with several hard links, by its device and inode.
+     */
+    struct HardLink
+    {
+        std::pair<dev_t, ino_t> identity; /**< The device and inode of the file. */
+        uintmax_t apparentBytes; /**< The size of the file. */
+        uintmax_t allocatedBytes; /**< The bytes the file occupies on the disk. */
+    };
+
+    /**
+     * @brief What one directory holds itself, in the cache.
+     */
+    struct CachedDirectory
+    {
+        struct timespec modified; /**< The modification time of the directory when it was read. */
+        DirectorySize own; /**< The directory and its entries that are neither directories nor files with several links. */
+        std::vector<HardLink> hardLinks; /**< Its files with several links. */
+        std::vector<std::string> subdirectories; /**< The names of its subdirectories. */
+    };
+
+    ThreadPool m_pool; /**< The threads reading directories. */
+    std::atomic<bool> m_cancelled; /**< Set to stop the running walk. */
+    std::atomic<size_t> m_pendingDirectories; /**< Directories of the running walk that are not complete. */
+
+    mutable std::mutex m_mutex; /**< Guards the maps and the set. */
+    std::map<std::pair<dev_t, ino_t>, CachedDirectory> m_cache; /**< The contents of the directories read, by device and inode. */
+    std::unordered_map<std::string, DirectorySize> m_sizes; /**< Complete sizes of the current walk by path. */
+    std::set<std::pair<dev_t, ino_t>> m_countedLinks; /**< The files with several links counted by the current walk. */
+
+    /**
+     * @brief Adds the entries of one directory, from the cache or by reading it, and queues its subdirectories.
+     * @param node The directory.
+     */
+    void readDirectory(const std::shared_ptr<Node> &node);
+
+    /**
+     * @brief Reads the entries of one directory.
+     * @param path The path to the directory.
+     * @param status The status of the directory.
+     * @param contents Filled with what the directory holds, cached once the directory is read.
+     * @param statuses Filled with the statuses of the subdirectories.
+     * @return False if the walk was cancelled meanwhile.
+     */
+    bool readContents(const fs::path &path, const struct stat &status, CachedDirectory &contents, std::vector<struct stat> &statuses);
+
+    /**
+     * @brief Marks one pending part of the directory as done, completes the directory when nothing is pending.
+     * @param node The directory.
+     */
+    void finishPart(std::shared_ptr<Node> node);
+
+    /**
+     * @brief Adds the size of a subtree to the size of a directory.
+     * @param size The size of the directory.
+     * @param subtree The size of the subtree.
+     */
+    static void add(DirectorySize &size, const DirectorySize &subtree);
+
+    /**
+     * @brief Looks up the contents of a directory in the cache.
+     * @param status The status of the directory.
+     * @param contents Set to the cached contents.
+     * @return True if the directory did not change since it was read.
+     */
+    bool findCached(const struct stat &status, CachedDirectory &contents) const;
+
+    /**
+     * @brief Publishes the complete size of a directory.
+     * @param path The path to the directory.
+     * @param size The size.
+     */
+    void publish(const fs::path &path, const DirectorySize &size);
+};
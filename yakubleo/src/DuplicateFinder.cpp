@@ -0,0 +1,211 @@
+#include "DuplicateFinder.h"
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include "TreeWalker.h"
+
+DuplicateFinder::DuplicateFinder(HashCache *hashCache, size_t threadCount) : m_hashCache(hashCache), m_threadCount(threadCount)
+{
+}
+
+std::vector<DuplicateGroup> DuplicateFinder::find(const fs::path &root)
+{
+    CandidateGroups groups = groupBySize(root);
+
+    refineByHash(groups, [this](const Candidate &candidate)
+    {
+        if(m_hashCache)
+            return m_hashCache->hash(candidate.path, candidate.status, HashCache::ENDS);
+        return FileContents::hashEnds(candidate.path, candidate.size);
+    });
+
+    // Files no longer than the two ends are already hashed whole, the second hash would not tell them apart
+    CandidateGroups smallGroups;
+    CandidateGroups largeGroups;
+    for(auto& group : groups)
+    {
+        if(group.front().size <= 2 * FileContents::endSize)
+            smallGroups.push_back(std::move(group));
+        else
+            largeGroups.push_back(std::move(group));
+    }
+
+    refineByHash(largeGroups, [this](const Candidate &candidate)
+    {
+        if(m_hashCache)
+            return m_hashCache->hash(candidate.path, candidate.status, HashCache::FULL);
+        return FileContents::hash(candidate.path);
+    });
+
+    for(auto& group : largeGroups)
+    {
+        smallGroups.push_back(std::move(group));
+    }
+
+    std::vector<DuplicateGroup> duplicates = confirm(smallGroups);
+    std::sort(duplicates.begin(), duplicates.end(), [](const DuplicateGroup &first, const DuplicateGroup &second)
+    {
+        return first.size * (first.files.size() - 1) > second.size * (second.files.size() - 1);
+    });
+    return duplicates;
+}
+
+uintmax_t DuplicateFinder::wastedBytes(const std::vector<DuplicateGroup> &groups)
+{
+    uintmax_t bytes = 0;
+    for(const auto& group : groups)
+    {
+        bytes += group.size * (group.files.size() - 1);
+    }
+    return bytes;
+}
+
+DuplicateFinder::CandidateGroups DuplicateFinder::groupBySize(const fs::path &root) const
+{
+    std::mutex mutex;
+    std::unordered_map<uintmax_t, std::vector<Candidate>> bySize;
+    std::set<std::pair<dev_t, ino_t>> seenInodes;
+
+    TreeWalker walker(m_threadCount);
+    walker.walk(root, [&](const fs::path &path, const struct stat &status)
+    {
+        // Empty files have nothing to reclaim
+        if(!S_ISREG(status.st_mode) || status.st_size == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(status.st_nlink > 1 && !seenInodes.emplace(status.st_dev, status.st_ino).second)
+            return;
+        bySize[status.st_size].push_back(Candidate{path, (uintmax_t)status.st_size, status, ContentHash(), true});
+    });
+
+    CandidateGroups groups;
+    for(auto& [size, candidates] : bySize)
+    {
+        if(candidates.size() > 1)
+            groups.push_back(std::move(candidates));
+    }
+    return groups;
+}
+
+void DuplicateFinder::refineByHash(CandidateGroups &groups, const std::function<ContentHash(const Candidate &)> &hashFunction) const
+{
+    std::vector<Candidate *> candidates;
+    for(auto& group : groups)
+    {
+        for(auto& candidate : group)
+            candidates.push_back(&candidate);
+    }
+
+    ThreadPool pool(m_threadCount);
+    const size_t batchSize = 64;
+    for(size_t begin = 0; begin < candidates.size(); begin += batchSize)
+    {
+        size_t end = std::min(begin + batchSize, candidates.size());
+        pool.submit([&candidates, &hashFunction, begin, end]
+        {
+            for(size_t i = begin; i < end; i++)
+            {
+                try
+                {
+                    candidates[i]->hash = hashFunction(*candidates[i]);
+                }
+                catch(const std::exception &e)
+                {
+                    // A file that vanished or cannot be read is not reported
+                    candidates[i]->readable = false;
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    CandidateGroups refined;
+    for(auto& group : groups)
+    {
+        group.erase(std::remove_if(group.begin(), group.end(), [](const Candidate &candidate) { return !candidate.readable; }), group.end());
+        std::sort(group.begin(), group.end(), [](const Candidate &first, const Candidate &second) { return first.hash < second.hash; });
+
+        for(size_t begin = 0; begin < group.size(); )
+        {
+            size_t end = begin + 1;
+            while(end < group.size() && group[end].hash == group[begin].hash)
+                end++;
+
+            if(end - begin > 1)
+            {
+                refined.emplace_back(std::make_move_iterator(group.begin() + begin), std::make_move_iterator(group.begin() + end));
+            }
+            begin = end;
+        }
+    }
+    groups = std::move(refined);
+}
+
+std::vector<DuplicateGroup> DuplicateFinder::confirm(CandidateGroups &groups) const
+{
+    std::mutex mutex;
+    std::vector<DuplicateGroup> duplicates;
+
+    ThreadPool pool(m_threadCount);
+    for(auto& group : groups)
+    {
+        pool.submit([this, &mutex, &duplicates, &group]
+        {
+            // Hash collisions are unlikely, but a group may still split into several
+            std::vector<Candidate> remaining = std::move(group);
+            while(remaining.size() > 1)
+            {
+                const Candidate &representative = remaining.front();
+
+                std::vector<const Candidate *> confirmed{&representative};
+                std::vector<Candidate> different;
+                for(size_t i = 1; i < remaining.size(); i++)
+                {
+                    bool isEqual = false;
+                    if(m_hashCache && m_hashCache->isVerified(representative.status, remaining[i].status))
+                    {
+                        isEqual = true;
+                    }
+                    else
+                    {
+                        try
+                        {
+                            isEqual = FileContents::equal(representative.path, remaining[i].path);
+                        }
+                        catch(const std::exception &e)
+                        {
+                            continue;
+                        }
+                        if(isEqual && m_hashCache)
+                        {
+                            m_hashCache->setVerified(representative.status, remaining[i].status);
+                        }
+                    }
+
+                    if(isEqual)
+                        confirmed.push_back(&remaining[i]);
+                    else
+                        different.push_back(std::move(remaining[i]));
+                }
+
+                if(confirmed.size() > 1)
+                {
+                    std::sort(confirmed.begin(), confirmed.end(), [](const Candidate *a, const Candidate *b) { return a->path < b->path; });
+                    DuplicateGroup group{representative.size, {}, {}};
+                    for(const Candidate *candidate : confirmed)
+                    {
+                        group.files.push_back(candidate->path);
+                        group.statuses.push_back(candidate->status);
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    duplicates.push_back(std::move(group));
+                }
+                remaining = std::move(different);
+            }
+        });
+    }
+    pool.wait();
+    return duplicates;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include <sys/stat.h>
+#include "FileContents.h"
+#include "HashCache.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Regular files with identical contents.
+ */
+struct DuplicateGroup
+{
+    uintmax_t size; /**< The size of each of the files. */
+    std::vector<fs::path> files; /**< The paths to the files, at least two. */
+    std::vector<struct stat> statuses; /**< The status of every file when it was found, in the order of the files. */
+};
+
+/**
+ * @class DuplicateFinder
+ * @brief Finds all groups of identical regular files in a directory tree.
+ *
+ * The candidates are narrowed down in stages ordered from the cheapest:
+ * files are grouped by size, then by a hash of their first and last 4 KiB, then by a hash of the whole contents,
+ * and the remaining groups are confirmed by comparing the files byte by byte.
+ * Every stage processes the files in parallel. Hard links to one inode are counted once, they take no extra space.
+ * With a HashCache the hashes of unchanged files are not computed again, and groups whose files were all
+ * confirmed byte by byte in an earlier run are trusted without reading them.
+ */
+class DuplicateFinder
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param hashCache The cache of content hashes, nullptr to always read the files.
+     * @param threadCount The number of threads used by every stage.
+     */
+    DuplicateFinder(HashCache *hashCache = nullptr, size_t threadCount = ThreadPool::defaultThreadCount());
+
+    /**
+     * @brief Finds the duplicates below the root.
+     * @param root The directory to search in.
+     * @return The groups of duplicates, the groups wasting the most space first.
+     */
+    std::vector<DuplicateGroup> find(const fs::path &root);
+
+    /**
+     * @brief Computes the space the duplicates take in addition to one copy of each group.
+     * @param groups The groups of duplicates.
+     * @return The number of bytes.
+     */
+    static uintmax_t wastedBytes(const std::vector<DuplicateGroup> &groups);
+
+private:
+    /**
+     * @brief A file that may still have a duplicate.
+     */
+    struct Candidate
+    {
+        fs::path path; /**< The path to the file. */
+        uintmax_t size; /**< The size of the file. */
+        struct stat status; /**< The status of the file found by the walk. */
+        ContentHash hash; /**< The hash computed by the last stage. */
+        bool readable; /**< False if the last stage could not read the file. */
+    };
+
+    using CandidateGroups = std::vector<std::vector<Candidate>>;
+
+    HashCache *m_hashCache; /**< The cache of content hashes, may be nullptr. */
+    size_t m_threadCount; /**< The number of threads used by every stage. */
+
+    /**
+     * @brief Walks the tree and groups the regular files by size, only sizes shared by several files are kept.
+     * @param root The directory to search in.
+     * @return The groups.
+     */
+    CandidateGroups groupBySize(const fs::path &root) const;
+
+    /**
+     * @brief Hashes all the candidates in parallel and splits every group by the hash.
+     * @param groups The groups to refine, groups with a single file are dropped.
+     * @param hashFunction Computes the hash of a candidate.
+     */
+    void refineByHash(CandidateGroups &groups, const std::function<ContentHash(const Candidate &)> &hashFunction) const;
+
+    /**
+     * @brief Compares the files of every group byte by byte, in parallel over the groups.
+     * @param groups The groups to confirm.
+     * @return The confirmed groups.
+     */
+    std::vector<DuplicateGroup> confirm(CandidateGroups &groups) const;
+};
@@ -0,0 +1,385 @@
+#include "FastHash.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FASTHASH_X86 1
+#endif
+
+namespace
+{
+    __extension__ typedef unsigned __int128 Uint128;
+
+    constexpr uint64_t prime32 = 0x9E3779B1U;
+    constexpr uint64_t prime64First = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t prime64Second = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t prime64Fourth = 0x85EBCA77C2B2AE63ULL;
+
+    /**
+     * @brief The secret mixed into the input, generated once by splitmix64 from a fixed seed.
+     */
+    const std::array<uint8_t, 192> &secret()
+    {
+        static const std::array<uint8_t, 192> bytes = []
+        {
+            std::array<uint8_t, 192> generated{};
+            uint64_t state = 0x59414B55424C454FULL;
+            for(size_t i = 0; i < generated.size(); i += 8)
+            {
+                state += 0x9E3779B97F4A7C15ULL;
+                uint64_t value = state;
+                value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+                value ^= value >> 31;
+                std::memcpy(generated.data() + i, &value, 8);
+            }
+            return generated;
+        }();
+        return bytes;
+    }
+
+    inline uint64_t read64(const uint8_t *pointer)
+    {
+        uint64_t value;
+        std::memcpy(&value, pointer, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t multiplyFold(uint64_t first, uint64_t second)
+    {
+        Uint128 product = Uint128(first) * second;
+        return uint64_t(product) ^ uint64_t(product >> 64);
+    }
+
+    inline uint64_t avalanche(uint64_t hash)
+    {
+        hash ^= hash >> 37;
+        hash *= 0x165667919E3779F9ULL;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    uint64_t mergeAccumulators(const uint64_t *accumulators, const uint8_t *key, uint64_t start)
+    {
+        uint64_t result = start;
+        for(size_t i = 0; i < 4; i++)
+        {
+            result += multiplyFold(accumulators[2 * i] ^ read64(key + 16 * i), accumulators[2 * i + 1] ^ read64(key + 16 * i + 8));
+        }
+        return avalanche(result);
+    }
+
+    void accumulateScalar(uint64_t *accumulators, const uint8_t *input, size_t stripes, const uint8_t *key)
+    {
+        for(size_t stripe = 0; stripe < stripes; stripe++)
+        {
+            const uint8_t *data = input + stripe * 64;
+            const uint8_t *stripeKey = key + stripe * 8;
+            for(size_t i = 0; i < 8; i++)
+            {
+                uint64_t value = read64(data + 8 * i);
+                uint64_t keyed = value ^ read64(stripeKey + 8 * i);
+                accumulators[i ^ 1] += value;
+                accumulators[i] += (keyed & 0xFFFFFFFFULL) * (keyed >> 32);
+            }
+        }
+    }
+
+    void scrambleScalar(uint64_t *accumulators, const uint8_t *key)
+    {
+        for(size_t i = 0; i < 8; i++)
+        {
+            uint64_t accumulator = accumulators[i];
+            accumulator ^= accumulator >> 47;
+            accumulator ^= read64(key + 8 * i);
+            accumulator *= prime32;
+            accumulators[i] = accumulator;
+        }
+    }
+
+#ifdef FASTHASH_X86
+    __attribute__((target("sse2")))
+    void accumulateSse2(uint64_t *accumulators, const uint8_t *input, size_t stripes, const uint8_t *key)
+    {
+        __m128i *vectors = reinterpret_cast<__m128i *>(accumulators);
+        for(size_t stripe = 0; stripe < stripes; stripe++)
+        {
+            const __m128i *data = reinterpret_cast<const __m128i *>(input + stripe * 64);
+            const __m128i *stripeKey = reinterpret_cast<const __m128i *>(key + stripe * 8);
+            for(size_t i = 0; i < 4; i++)
+            {
+                __m128i value = _mm_loadu_si128(data + i);
+                __m128i keyed = _mm_xor_si128(value, _mm_loadu_si128(stripeKey + i));
+                __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+                vectors[i] = _mm_add_epi64(vectors[i], _mm_add_epi64(product, swapped));
+            }
+        }
+    }
+
+    __attribute__((target("sse2")))
+    void scrambleSse2(uint64_t *accumulators, const uint8_t *key)
+    {
+        __m128i *vectors = reinterpret_cast<__m128i *>(accumulators);
+        const __m128i *keys = reinterpret_cast<const __m128i *>(key);
+        const __m128i prime = _mm_set1_epi32(int(prime32));
+        for(size_t i = 0; i < 4; i++)
+        {
+            __m128i accumulator = vectors[i];
+            accumulator = _mm_xor_si128(accumulator, _mm_srli_epi64(accumulator, 47));
+            accumulator = _mm_xor_si128(accumulator, _mm_loadu_si128(keys + i));
+            __m128i low = _mm_mul_epu32(accumulator, prime);
+            __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(accumulator, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            vectors[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void accumulateAvx2(uint64_t *accumulators, const uint8_t *input, size_t stripes, const uint8_t *key)
+    {
+        __m256i *vectors = reinterpret_cast<__m256i *>(accumulators);
+        __m256i first = _mm256_load_si256(vectors);
+        __m256i second = _mm256_load_si256(vectors + 1);
+        for(size_t stripe = 0; stripe < stripes; stripe++)
+        {
+            const __m256i *data = reinterpret_cast<const __m256i *>(input + stripe * 64);
+            const __m256i *stripeKey = reinterpret_cast<const __m256i *>(key + stripe * 8);
+
+            __m256i value = _mm256_loadu_si256(data);
+            __m256i keyed = _mm256_xor_si256(value, _mm256_loadu_si256(stripeKey));
+            __m256i product = _mm256_mul_epu32(keyed, _mm256_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+            first = _mm256_add_epi64(first, _mm256_add_epi64(product, _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2))));
+
+            value = _mm256_loadu_si256(data + 1);
+            keyed = _mm256_xor_si256(value, _mm256_loadu_si256(stripeKey + 1));
+            product = _mm256_mul_epu32(keyed, _mm256_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+            second = _mm256_add_epi64(second, _mm256_add_epi64(product, _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+        _mm256_store_si256(vectors, first);
+        _mm256_store_si256(vectors + 1, second);
+    }
+
+    __attribute__((target("avx2")))
+    void scrambleAvx2(uint64_t *accumulators, const uint8_t *key)
+    {
+        __m256i *vectors = reinterpret_cast<__m256i *>(accumulators);
+        const __m256i *keys = reinterpret_cast<const __m256i *>(key);
+        const __m256i prime = _mm256_set1_epi32(int(prime32));
+        for(size_t i = 0; i < 2; i++)
+        {
+            __m256i accumulator = _mm256_load_si256(vectors + i);
+            accumulator = _mm256_xor_si256(accumulator, _mm256_srli_epi64(accumulator, 47));
+            accumulator = _mm256_xor_si256(accumulator, _mm256_loadu_si256(keys + i));
+            __m256i low = _mm256_mul_epu32(accumulator, prime);
+            __m256i high = _mm256_mul_epu32(_mm256_shuffle_epi32(accumulator, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            _mm256_store_si256(vectors + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+        }
+    }
+#endif
+}
+
+FastHash::FastHash(Implementation implementation) : m_accumulate(accumulateScalar), m_scramble(scrambleScalar)
+{
+#ifdef FASTHASH_X86
+    if(implementation == AVX2 && isSupported(AVX2))
+    {
+        m_accumulate = accumulateAvx2;
+        m_scramble = scrambleAvx2;
+    }
+    else if(implementation == SSE2 && isSupported(SSE2))
+    {
+        m_accumulate = accumulateSse2;
+        m_scramble = scrambleSse2;
+    }
+#endif
+    reset();
+}
+
+void FastHash::reset()
+{
+    const uint64_t initial[8] = {prime32, prime64First, prime64Second, 0x165667B19E3779F9ULL,
+                                 0x85EBCA77C2B2AE63ULL, 0x27D4EB2F165667C5ULL, prime64Second, 0x61C8864E7A143579ULL};
+    std::memcpy(m_accumulators, initial, sizeof(initial));
+    m_bufferedLength = 0;
+    m_totalLength = 0;
+    m_stripesInBlock = 0;
+}
+
+void FastHash::update(const void *data, size_t length)
+{
+    const uint8_t *input = static_cast<const uint8_t *>(data);
+    m_totalLength += length;
+
+    if(m_bufferedLength + length <= m_bufferSize)
+    {
+        std::memcpy(m_buffer + m_bufferedLength, input, length);
+        m_bufferedLength += length;
+        return;
+    }
+
+    // More input follows, so the whole buffer can be consumed
+    if(m_bufferedLength > 0)
+    {
+        size_t fill = m_bufferSize - m_bufferedLength;
+        std::memcpy(m_buffer + m_bufferedLength, input, fill);
+        input += fill;
+        length -= fill;
+        consumeStripes(m_accumulators, m_stripesInBlock, m_buffer, m_bufferSize / m_stripeLength);
+        m_bufferedLength = 0;
+    }
+
+    if(length > m_bufferSize)
+    {
+        size_t stripes = (length - 1) / m_stripeLength;
+        consumeStripes(m_accumulators, m_stripesInBlock, input, stripes);
+        input += stripes * m_stripeLength;
+        length -= stripes * m_stripeLength;
+
+        // digest() may need the last stripe before the kept back input
+        std::memcpy(m_buffer + m_bufferSize - m_stripeLength, input - m_stripeLength, m_stripeLength);
+    }
+
+    std::memcpy(m_buffer, input, length);
+    m_bufferedLength = length;
+}
+
+ContentHash FastHash::digest() const
+{
+    const uint8_t *key = secret().data();
+
+    if(m_totalLength <= m_shortInputLimit)
+    {
+        return hashShort(m_buffer, m_totalLength);
+    }
+
+    alignas(32) uint64_t accumulators[8];
+    std::memcpy(accumulators, m_accumulators, sizeof(accumulators));
+    size_t stripesInBlock = m_stripesInBlock;
+
+    // Every stripe but the last one is consumed the usual way
+    size_t stripes = (m_bufferedLength - 1) / m_stripeLength;
+    consumeStripes(accumulators, stripesInBlock, m_buffer, stripes);
+
+    uint8_t lastStripe[m_stripeLength];
+    if(m_bufferedLength >= m_stripeLength)
+    {
+        std::memcpy(lastStripe, m_buffer + m_bufferedLength - m_stripeLength, m_stripeLength);
+    }
+    else
+    {
+        size_t previous = m_stripeLength - m_bufferedLength;
+        std::memcpy(lastStripe, m_buffer + m_bufferSize - previous, previous);
+        std::memcpy(lastStripe + previous, m_buffer, m_bufferedLength);
+    }
+    m_accumulate(accumulators, lastStripe, 1, key + m_secretSize - m_stripeLength - 7);
+
+    ContentHash result;
+    result.low = mergeAccumulators(accumulators, key + 11, m_totalLength * prime64First);
+    result.high = mergeAccumulators(accumulators, key + m_secretSize - m_stripeLength - 11, ~(m_totalLength * prime64Second));
+    return result;
+}
+
+ContentHash FastHash::hash(const void *data, size_t length)
+{
+    if(length <= m_shortInputLimit)
+    {
+        return hashShort(static_cast<const uint8_t *>(data), length);
+    }
+
+    FastHash hasher;
+    hasher.update(data, length);
+    return hasher.digest();
+}
+
+FastHash::Implementation FastHash::bestImplementation()
+{
+    static const Implementation best = isSupported(AVX2) ? AVX2 : isSupported(SSE2) ? SSE2 : SCALAR;
+    return best;
+}
+
+bool FastHash::isSupported(Implementation implementation)
+{
+    switch(implementation)
+    {
+    case SCALAR:
+        return true;
+#ifdef FASTHASH_X86
+    case SSE2:
+        return __builtin_cpu_supports("sse2");
+    case AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const char *FastHash::name(Implementation implementation)
+{
+    switch(implementation)
+    {
+    case SSE2:
+        return "sse2";
+    case AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+void FastHash::consumeStripes(uint64_t *accumulators, size_t &stripesInBlock, const uint8_t *input, size_t stripes) const
+{
+    const uint8_t *key = secret().data();
+    while(stripes > 0)
+    {
+        size_t count = std::min(stripes, m_stripesPerBlock - stripesInBlock);
+        m_accumulate(accumulators, input, count, key + stripesInBlock * 8);
+        input += count * m_stripeLength;
+        stripes -= count;
+        stripesInBlock += count;
+
+        if(stripesInBlock == m_stripesPerBlock)
+        {
+            m_scramble(accumulators, key + m_secretSize - m_stripeLength);
+            stripesInBlock = 0;
+        }
+    }
+}
+
+ContentHash FastHash::hashShort(const uint8_t *input, size_t length)
+{
+    const uint8_t *key = secret().data();
+    uint64_t low = length * prime64First;
+    uint64_t high = length * prime64Fourth;
+
+    auto mixChunk = [&](const uint8_t *chunk, size_t keyOffset)
+    {
+        uint64_t first = read64(chunk);
+        uint64_t second = read64(chunk + 8);
+        low += multiplyFold(first ^ read64(key + keyOffset), second ^ read64(key + keyOffset + 8));
+        high += multiplyFold(first ^ read64(key + keyOffset + 16), second ^ read64(key + keyOffset + 24));
+    };
+
+    if(length < 16)
+    {
+        uint8_t chunk[16] = {0};
+        std::memcpy(chunk, input, length);
+        mixChunk(chunk, 0);
+    }
+    else
+    {
+        size_t offset = 0;
+        for(; offset + 16 <= length; offset += 16)
+        {
+            mixChunk(input + offset, offset % 160);
+        }
+        if(offset < length)
+        {
+            mixChunk(input + length - 16, 160);
+        }
+    }
+
+    return ContentHash{avalanche(low ^ (high >> 29)), avalanche(high + low)};
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "FileContents.h"
+
+/**
+ * @class FastHash
+ * @brief Non-cryptographic 128-bit hash built like XXH3, with scalar, SSE2 and AVX2 code paths.
+ *
+ * Long inputs are consumed in 64 byte stripes by eight 64-bit accumulators,
+ * each stripe is mixed with a 192 byte secret by 32x32->64 bit multiplications that map directly to
+ * vector instructions. The fastest path the CPU supports is chosen at runtime, all paths give the same result.
+ * The result does not depend on how the input is split between update() calls.
+ */
+class FastHash
+{
+public:
+    /**
+     * @brief Code path computing the hash.
+     */
+    enum Implementation
+    {
+        SCALAR, /**< Portable 64-bit code. */
+        SSE2, /**< Two accumulators per 128-bit register. */
+        AVX2 /**< Four accumulators per 256-bit register. */
+    };
+
+    /**
+     * @brief Constructor. Starts a new hash.
+     * @param implementation The code path, it has to be supported by the CPU.
+     */
+    FastHash(Implementation implementation = bestImplementation());
+
+    /**
+     * @brief Forgets the input hashed so far.
+     */
+    void reset();
+
+    /**
+     * @brief Adds the next part of the input.
+     * @param data The part of the input.
+     * @param length The length of the part.
+     */
+    void update(const void *data, size_t length);
+
+    /**
+     * @brief Computes the hash of the input added so far, more input may be added afterwards.
+     * @return The hash.
+     */
+    ContentHash digest() const;
+
+    /**
+     * @brief Hashes a block of memory at once.
+     * @param data The block.
+     * @param length The length of the block.
+     * @return The hash, the same as update() followed by digest().
+     */
+    static ContentHash hash(const void *data, size_t length);
+
+    /**
+     * @brief Gets the fastest code path supported by the CPU.
+     * @return The code path.
+     */
+    static Implementation bestImplementation();
+
+    /**
+     * @brief Tells if the CPU supports the code path.
+     * @param implementation The code path.
+     * @return True if the code path can be used.
+     */
+    static bool isSupported(Implementation implementation);
+
+    /**
+     * @brief Gets the name of the code path.
+     * @param implementation The code path.
+     * @return The name.
+     */
+    static const char *name(Implementation implementation);
+
+private:
+    static constexpr size_t m_stripeLength = 64; /**< Bytes consumed by one accumulation. */
+    static constexpr size_t m_secretSize = 192; /**< The size of the secret. */
+    static constexpr size_t m_stripesPerBlock = (m_secretSize - m_stripeLength) / 8; /**< Stripes between two scrambles. */
+    static constexpr size_t m_bufferSize = 256; /**< Input kept back until it is known not to be the end. */
+    static constexpr size_t m_shortInputLimit = 240; /**< Longer inputs use the accumulators. */
+
+    using AccumulateFunction = void (*)(uint64_t *accumulators, const uint8_t *input, size_t stripes, const uint8_t *secret);
+    using ScrambleFunction = void (*)(uint64_t *accumulators, const uint8_t *secret);
+
+    AccumulateFunction m_accumulate; /**< The chosen code path of the accumulation. */
+    ScrambleFunction m_scramble; /**< The chosen code path of the scramble. */
+
+    alignas(32) uint64_t m_accumulators[8]; /**< The accumulators. */
+    uint8_t m_buffer[m_bufferSize]; /**< The last, not yet consumed input. */
+    size_t m_bufferedLength; /**< The number of bytes in m_buffer. */
+    uint64_t m_totalLength; /**< The number of bytes added so far. */
+    size_t m_stripesInBlock; /**< Stripes consumed since the last scramble. */
+
+    /**
+     * @brief Consumes whole stripes, scrambling the accumulators after every block.
+     * @param accumulators The accumulators.
+     * @param stripesInBlock Stripes consumed since the last scramble, updated.
+     * @param input The stripes.
+     * @param stripes The number of stripes.
+     */
+    void consumeStripes(uint64_t *accumulators, size_t &stripesInBlock, const uint8_t *input, size_t stripes) const;
+
+    /**
+     * @brief Hashes inputs up to m_shortInputLimit bytes.
+     * @param input The input.
+     * @param length The length of the input.
+     * @return The hash.
+     */
+    static ContentHash hashShort(const uint8_t *input, size_t length);
+};
@@ -1,4 +1,8 @@
 #include "File.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
 
 File::File(const fs::path &pathToFile) : m_pathToFile(pathToFile), m_isSelected(false), m_isPointedAt(false)
 {
@@ -31,9 +35,9 @@ void File::dePoint()
     m_isPointedAt = false;
 }
 
-void File::selectOnRegex(const std::regex &regularExpression)
+void File::selectOnRegex(RegexMatcher &matcher)
 {
-    if(std::regex_match(m_pathToFile.filename().string(), regularExpression))
+    if(matcher.matches(m_pathToFile.filename().string()))
     {
         m_isSelected = true;
     }
@@ -44,12 +48,50 @@ std::string File::getName() const
     return m_pathToFile.filename().string();
 }
 
+void File::setLabel(const std::string &label)
+{
+    m_label = label;
+}
+
+std::string File::getLabel() const
+{
+    return m_label.empty() ? getName() : m_label;
+}
+
 fs::path File::getPath() const
 {
     return m_pathToFile;
 }
 
+void File::setParent(std::shared_ptr<const DirectoryHandle> parent)
+{
+    m_parent = std::move(parent);
+}
+
+std::shared_ptr<const DirectoryHandle> File::getParent() const
+{
+    if(m_parent)
+        return m_parent;
+    fs::path directory = m_pathToFile.parent_path();
+    return std::make_shared<const DirectoryHandle>(directory.empty() ? fs::path(".") : directory);
+}
+
+int File::openForReading() const
+{
+    // Files listed from elsewhere than one directory are opened by their paths, which costs no extra open of the directory
+    int descriptor = m_parent ? m_parent->openFile(getName(), O_RDONLY)
+        : ::open(m_pathToFile.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if(descriptor < 0)
+        throw std::runtime_error("Could not open file " + m_pathToFile.string() + ": " + std::strerror(errno));
+    return descriptor;
+}
+
 bool File::isSelected() const
 {
     return m_isSelected;
 }
+
+bool File::isPointedAt() const
+{
+    return m_isPointedAt;
+}
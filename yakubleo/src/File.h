@@ -1,9 +1,13 @@
 #pragma once
 #include <filesystem>
-#include <ncurses.h>
-#include <regex>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <vector>
+#include "AhoCorasick.h"
+#include "RegexMatcher.h"
+#include "Deduplicator.h"
+#include "DirectoryHandle.h"
 
 namespace fs = std::filesystem;
 
@@ -58,7 +62,7 @@ public:
     /**
      * selects the file if the file name matches the regular expression
     */
-    void selectOnRegex(const std::regex &regularExpression);
+    void selectOnRegex(RegexMatcher &matcher);
 
     /**
      * @brief Gets the file name.
@@ -66,12 +70,30 @@ public:
      */
     std::string getName() const;
 
+    /**
+     * @brief Sets the text shown instead of the file name.
+     * @param label The text, empty to show the file name.
+     */
+    void setLabel(const std::string &label);
+
+    /**
+     * @brief Gets the text shown in the listing.
+     * @return The label if it is set, the file name otherwise.
+     */
+    std::string getLabel() const;
+
     /**
      * @brief Gets the file path.
      * @return The file path.
      */
     fs::path getPath() const;
 
+    /**
+     * @brief Sets the open directory the file is in, the operations on the file are then relative to it.
+     * @param parent The directory, its path is the parent path of the file.
+     */
+    void setParent(std::shared_ptr<const DirectoryHandle> parent);
+
     /**
      * @brief Copies the file.
      *
@@ -94,16 +116,13 @@ public:
     virtual void remove() = 0;
 
     /**
-     * @brief Prints the file information.
+     * @brief Gets the letter that tells the kind of the file in the listing.
      *
-     * This pure virtual function is to be implemented by derived classes to print the file information.
+     * This pure virtual function is to be implemented by derived classes to return their letter.
      *
-     * @param row The row number for printing.
-     * @param column The column number for printing.
-     * @param normalColour The color pair number for normal display.
-     * @param selectedColour The color pair number for selected display.
+     * @return D for a directory, F for a regular file, S for a symbolic link.
      */
-    virtual void print(int row, int column, int normalColour, int selectedColour ) const = 0;
+    virtual char getTypeLetter() const = 0;
 
     /**
      * @brief Appends the contents of the file to the output stream.
@@ -123,6 +142,25 @@ public:
      */
     virtual void selectOnText(const std::string &text) = 0;
 
+    /**
+     * @brief Selects the file if the file contents contain any of the patterns.
+     *
+     * This pure virtual function is to be implemented by derived classes to scan the file contents once for all the patterns.
+     *
+     * @param automaton The compiled patterns.
+     * @return Indexes of the patterns found in the file.
+     */
+    virtual std::vector<size_t> selectOnPatterns(const AhoCorasick &automaton) = 0;
+
+    /**
+     * @brief Selects the file if a line of the file contents matches the regular expression.
+     *
+     * This pure virtual function is to be implemented by derived classes to search the file contents for the regular expression.
+     *
+     * @param matcher The matcher of the regular expression in search mode.
+     */
+    virtual void selectOnRegexText(RegexMatcher &matcher) = 0;
+
     /**
      * @brief Clones the file.
      * @return A pointer to the cloned file.
@@ -143,9 +181,12 @@ public:
     virtual std::string getContents() const = 0;
 
     /**
-     * @brief Changes a regular file to a symbolic link.
+     * @brief Replaces a regular file by a link to an identical file.
+     * @param fileToPointAt The file to link to.
+     * @param mode The kind of the link.
+     * @return The number of bytes reclaimed.
      */
-    virtual void changeToSymbolicLink(const File& fileToPointAt) = 0;    
+    virtual uintmax_t changeToLink(const File& fileToPointAt, Deduplicator::Mode mode) = 0;
 
     /**
      * @brief Virtual destructor for the File class.
@@ -157,10 +198,32 @@ public:
      * @return True if the file is selected, false otherwise.
      */
     bool isSelected() const;
+
+    /**
+     * @brief Checks if the cursor is on the file.
+     * @return True if the file is pointed at, false otherwise.
+     */
+    bool isPointedAt() const;
 protected:
+    /**
+     * @brief Gets the open directory the file is in, opens it when it was not set.
+     * @return The directory.
+     * @throws std::runtime_error If it cannot be opened.
+     */
+    std::shared_ptr<const DirectoryHandle> getParent() const;
+
+    /**
+     * @brief Opens the file for reading relative to its directory, or by its path when the directory was not set.
+     * @return The descriptor, closed by the caller.
+     * @throws std::runtime_error If it cannot be opened.
+     */
+    int openForReading() const;
+
     fs::path m_pathToFile; /**< The path to the file. */
+    std::shared_ptr<const DirectoryHandle> m_parent; /**< The open directory the file is in, shared by the files listed from it. */
     bool m_isSelected; /**< The selection status of the file. */
     bool m_isPointedAt; /**< The pointed status of the file. */
+    std::string m_label; /**< The text shown instead of the file name, empty for the file name. */
 };
 
 
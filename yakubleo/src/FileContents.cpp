@@ -0,0 +1,114 @@
+#include "FileContents.h"
+#include "FastHash.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    /**
+     * @brief Closes the file descriptor when it goes out of scope.
+     */
+    class FileDescriptor
+    {
+    public:
+        FileDescriptor(const fs::path &path) : m_descriptor(::open(path.c_str(), O_RDONLY | O_CLOEXEC))
+        {
+            if(m_descriptor < 0)
+            {
+                throw std::runtime_error("Could not open file " + path.string());
+            }
+        }
+
+        ~FileDescriptor()
+        {
+            ::close(m_descriptor);
+        }
+
+        int get() const
+        {
+            return m_descriptor;
+        }
+
+    private:
+        int m_descriptor;
+    };
+
+    /**
+     * @brief Reads until the buffer is full or the file ends.
+     */
+    size_t readFully(int descriptor, char *buffer, size_t length, off_t offset)
+    {
+        size_t total = 0;
+        while(total < length)
+        {
+            ssize_t count = ::pread(descriptor, buffer + total, length - total, offset + total);
+            if(count < 0)
+            {
+                throw std::runtime_error("Could not read file");
+            }
+            if(count == 0)
+                break;
+            total += count;
+        }
+        return total;
+    }
+}
+
+ContentHash FileContents::hash(const fs::path &path)
+{
+    FileDescriptor file(path);
+    posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    std::vector<char> buffer(blockSize);
+    FastHash hasher;
+    off_t offset = 0;
+    while(true)
+    {
+        size_t count = readFully(file.get(), buffer.data(), buffer.size(), offset);
+        if(count == 0)
+            break;
+        hasher.update(buffer.data(), count);
+        offset += count;
+    }
+    return hasher.digest();
+}
+
+ContentHash FileContents::hashEnds(const fs::path &path, uintmax_t size)
+{
+    FileDescriptor file(path);
+
+    std::vector<char> buffer(2 * endSize);
+    size_t count = readFully(file.get(), buffer.data(), std::min<uintmax_t>(size, endSize), 0);
+    if(size > endSize)
+    {
+        uintmax_t tailOffset = std::max<uintmax_t>(size - endSize, endSize);
+        count += readFully(file.get(), buffer.data() + count, size - tailOffset, tailOffset);
+    }
+    return FastHash::hash(buffer.data(), count);
+}
+
+bool FileContents::equal(const fs::path &first, const fs::path &second)
+{
+    FileDescriptor firstFile(first);
+    FileDescriptor secondFile(second);
+    posix_fadvise(firstFile.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(secondFile.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    std::vector<char> firstBuffer(blockSize);
+    std::vector<char> secondBuffer(blockSize);
+    off_t offset = 0;
+    while(true)
+    {
+        size_t firstCount = readFully(firstFile.get(), firstBuffer.data(), blockSize, offset);
+        size_t secondCount = readFully(secondFile.get(), secondBuffer.data(), blockSize, offset);
+        if(firstCount != secondCount || std::memcmp(firstBuffer.data(), secondBuffer.data(), firstCount) != 0)
+            return false;
+        if(firstCount < blockSize)
+            return true;
+        offset += firstCount;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief 128-bit hash of file contents.
+ */
+struct ContentHash
+{
+    uint64_t low = 0; /**< The lower half of the hash. */
+    uint64_t high = 0; /**< The upper half of the hash. */
+
+    bool operator==(const ContentHash &other) const
+    {
+        return low == other.low && high == other.high;
+    }
+
+    bool operator!=(const ContentHash &other) const
+    {
+        return !(*this == other);
+    }
+
+    bool operator<(const ContentHash &other) const
+    {
+        return high < other.high || (high == other.high && low < other.low);
+    }
+};
+
+/**
+ * @brief Hash functor so that ContentHash can key unordered containers.
+ */
+struct ContentHashHasher
+{
+    size_t operator()(const ContentHash &hash) const
+    {
+        return hash.low ^ (hash.high * 0x9E3779B97F4A7C15ULL);
+    }
+};
+
+/**
+ * @class FileContents
+ * @brief Reads file contents in fixed size blocks to hash and compare them without loading whole files into memory.
+ *
+ * The contents are hashed by FastHash.
+ */
+class FileContents
+{
+public:
+    /**
+     * @brief The size of the blocks the files are read in.
+     */
+    static constexpr size_t blockSize = 128 * 1024;
+
+    /**
+     * @brief The size of the beginning and of the end of a file hashed by hashEnds().
+     */
+    static constexpr size_t endSize = 4096;
+
+    /**
+     * @brief Hashes the whole contents of the file.
+     * @param path The path to the file.
+     * @return The hash of the contents.
+     * @throws std::runtime_error If the file cannot be read.
+     */
+    static ContentHash hash(const fs::path &path);
+
+    /**
+     * @brief Hashes the first and the last endSize bytes of the file, cheap to compute for files of any size.
+     * @param path The path to the file.
+     * @param size The size of the file.
+     * @return The hash of the beginning and of the end of the file.
+     * @throws std::runtime_error If the file cannot be read.
+     */
+    static ContentHash hashEnds(const fs::path &path, uintmax_t size);
+
+    /**
+     * @brief Compares the contents of two files block by block, stops at the first difference.
+     * @param first The path to the first file.
+     * @param second The path to the second file.
+     * @return True if the contents are equal.
+     * @throws std::runtime_error If one of the files cannot be read.
+     */
+    static bool equal(const fs::path &first, const fs::path &second);
+};
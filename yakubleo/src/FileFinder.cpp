@@ -0,0 +1,121 @@
+#include "FileFinder.h"
+#include <cstring>
+#include <dirent.h>
+
+FileFinder::FileFinder(size_t threadCount) : m_pool(threadCount), m_stopped(false), m_pendingDirectories(0), m_scannedCount(0)
+{
+}
+
+FileFinder::~FileFinder()
+{
+    stop();
+}
+
+void FileFinder::start(const fs::path &root, std::shared_ptr<const FindQuery> query)
+{
+    stop();
+
+    m_query = std::move(query);
+    m_stopped = false;
+    m_scannedCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_matches.clear();
+        m_matchers.clear();
+    }
+
+    m_pendingDirectories = 1;
+    m_pool.submit([this, root] { readDirectory(root); });
+}
+
+void FileFinder::stop()
+{
+    m_stopped = true;
+    try
+    {
+        m_pool.wait();
+    }
+    catch(const std::exception &e)
+    {
+        // The matches found before the failure are still shown
+    }
+    m_pendingDirectories = 0;
+}
+
+bool FileFinder::isRunning() const
+{
+    return m_pendingDirectories > 0;
+}
+
+std::vector<fs::path> FileFinder::getMatches(size_t from) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(from >= m_matches.size())
+        return std::vector<fs::path>();
+    return std::vector<fs::path>(m_matches.begin() + from, m_matches.end());
+}
+
+size_t FileFinder::scannedCount() const
+{
+    return m_scannedCount;
+}
+
+void FileFinder::readDirectory(const fs::path &directory)
+{
+    DIR *stream = m_stopped ? nullptr : ::opendir(directory.c_str());
+    if(!stream)
+    {
+        m_pendingDirectories--;
+        return;
+    }
+
+    FindQuery::Matchers &matchers = matchersOfThisThread();
+    std::vector<fs::path> matches;
+    int descriptor = ::dirfd(stream);
+    while(dirent *entry = ::readdir(stream))
+    {
+        if(m_stopped)
+            break;
+        if(std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        FindQuery::Candidate candidate;
+        candidate.directoryDescriptor = descriptor;
+        candidate.name = entry->d_name;
+        candidate.directoryType = entry->d_type;
+
+        m_scannedCount++;
+        if(m_query->matches(candidate, matchers))
+        {
+            matches.push_back(directory / entry->d_name);
+        }
+
+        if(FindQuery::isDirectory(candidate))
+        {
+            m_pendingDirectories++;
+            fs::path subdirectory = directory / entry->d_name;
+            m_pool.submit([this, subdirectory] { readDirectory(subdirectory); });
+        }
+    }
+    ::closedir(stream);
+
+    if(!matches.empty())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_matches.insert(m_matches.end(), matches.begin(), matches.end());
+        if(m_matches.size() >= maximalMatchCount)
+            m_stopped = true;
+    }
+    m_pendingDirectories--;
+}
+
+FindQuery::Matchers &FileFinder::matchersOfThisThread()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_matchers.find(std::this_thread::get_id());
+    if(found == m_matchers.end())
+    {
+        found = m_matchers.emplace(std::this_thread::get_id(), m_query->createMatchers()).first;
+    }
+    return found->second;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "FindQuery.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @class FileFinder
+ * @brief Evaluates a FindQuery on every entry below a directory, in parallel and in the background.
+ *
+ * Every directory is read by one task of a thread pool, the entries are checked as they are read
+ * and the matches can be taken while the walk still runs. Symbolic links are never followed.
+ */
+class FileFinder
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param threadCount The number of threads reading directories.
+     */
+    FileFinder(size_t threadCount = ThreadPool::defaultThreadCount());
+
+    /**
+     * @brief Destructor. Stops the running walk.
+     */
+    ~FileFinder();
+
+    /**
+     * @brief Stops the running walk and starts a new one.
+     * @param root The directory to search below.
+     * @param query The compiled query.
+     */
+    void start(const fs::path &root, std::shared_ptr<const FindQuery> query);
+
+    /**
+     * @brief Stops the running walk, the matches found so far are kept.
+     */
+    void stop();
+
+    /**
+     * @brief Tells if the walk still runs.
+     * @return True while the tree is being walked.
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief Gets the matches found so far.
+     * @param from The number of matches to skip, those already taken.
+     * @return The paths, in the order they were found.
+     */
+    std::vector<fs::path> getMatches(size_t from = 0) const;
+
+    /**
+     * @brief Gets the number of entries checked so far.
+     * @return The number of entries.
+     */
+    size_t scannedCount() const;
+
+    static constexpr size_t maximalMatchCount = 100000; /**< The walk stops when it finds this many matches. */
+
+private:
+    ThreadPool m_pool; /**< The threads reading directories. */
+    std::shared_ptr<const FindQuery> m_query; /**< The query of the running walk. */
+    std::atomic<bool> m_stopped; /**< Set to stop the running walk. */
+    std::atomic<size_t> m_pendingDirectories; /**< Directories queued or being read. */
+    std::atomic<size_t> m_scannedCount; /**< Entries checked. */
+
+    mutable std::mutex m_mutex; /**< Guards the matches and the matchers. */
+    std::vector<fs::path> m_matches; /**< The matches. */
+    std::unordered_map<std::thread::id, FindQuery::Matchers> m_matchers; /**< The name matchers of every thread. */
+
+    /**
+     * @brief Reads one directory, checks its entries and queues its subdirectories.
+     * @param directory The directory.
+     */
+    void readDirectory(const fs::path &directory);
+
+    /**
+     * @brief Gets the name matchers of the calling thread, creates them on the first call.
+     * @return The matchers.
+     */
+    FindQuery::Matchers &matchersOfThisThread();
+};
@@ -0,0 +1,51 @@
+#include "FileListView.h"
+#include "Tracer.h"
+
+FileListView::FileListView(int normalColourPair, int selectedColourPair) : m_normalColourPair(normalColourPair), m_selectedColourPair(selectedColourPair)
+{
+}
+
+void FileListView::print(const FileSystem &fileSystem, int initialRow, int initialColumn, int printFrom, size_t printTo) const
+{
+    Tracer::Span span(Tracer::PRINT);
+    int row = initialRow;
+    for(size_t i = printFrom; i < size_t(fileSystem.filesInCurrentDirectory()) && i < printTo; i++)
+    {
+        const File &file = fileSystem.getFileAt(i);
+        printFile(file, row, initialColumn);
+
+        // Members of an archive have the sizes of their headers, the disk usage does not know them
+        if(const auto *member = dynamic_cast<const ArchiveMember *>(&file))
+        {
+            if(file.getTypeLetter() == 'F')
+                mvprintw(row, COLS - 20, "%9s", DiskUsage::formatSize(member->getEntry().size).c_str());
+        }
+        else if(file.getTypeLetter() == 'D')
+        {
+            DirectorySize size;
+            if(fileSystem.getDiskUsage().getSize(file.getPath(), size))
+                mvprintw(row, COLS - 20, "%9s %9s", DiskUsage::formatSize(size.apparentBytes).c_str(), DiskUsage::formatSize(size.allocatedBytes).c_str());
+            else
+                mvprintw(row, COLS - 20, "%9s %9s", "...", "...");
+        }
+        row++;
+    }
+}
+
+void FileListView::printFile(const File &file, int row, int column) const
+{
+    // Regular files have a dim letter so that directories and links stand out
+    attr_t letterAttribute = file.getTypeLetter() == 'F' ? A_DIM : A_NORMAL;
+    attron(letterAttribute);
+    mvprintw(row, column, "[%c] ", file.getTypeLetter());
+    attroff(letterAttribute);
+
+    int indent = 4;
+    int colourPair = file.isSelected() ? m_selectedColourPair : m_normalColourPair;
+    attron(COLOR_PAIR(colourPair));
+    if(file.isPointedAt())
+        attron(A_REVERSE);
+    mvprintw(row, column + indent, " %s", file.getLabel().c_str());
+    attroff(A_REVERSE);
+    attroff(COLOR_PAIR(colourPair));
+}
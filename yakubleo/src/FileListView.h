@@ -0,0 +1,43 @@
+#pragma once
+#include <ncurses.h>
+#include "FileSystem.h"
+
+/**
+ * @class FileListView
+ * @brief Class printing the files of a file system in the terminal.
+ *
+ * The file system and its files only keep the state of the listing, the view decides how it looks: every file is
+ * printed as its type letter and its label, coloured by whether it is selected and reversed under the cursor.
+ */
+class FileListView
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param normalColourPair The color pair number for normal files.
+     * @param selectedColourPair The color pair number for selected files.
+     */
+    FileListView(int normalColourPair, int selectedColourPair);
+
+    /**
+     * @brief Prints the files, directories with their apparent and allocated size once it is known.
+     * @param fileSystem The file system.
+     * @param initialRow The row of the first printed file.
+     * @param initialColumn The column of the printed files.
+     * @param printFrom The index of the first printed file.
+     * @param printTo The index after the last printed file.
+     */
+    void print(const FileSystem &fileSystem, int initialRow, int initialColumn, int printFrom, size_t printTo) const;
+
+private:
+    int m_normalColourPair; /**< The color pair number for normal files. */
+    int m_selectedColourPair; /**< The color pair number for selected files. */
+
+    /**
+     * @brief Prints one file.
+     * @param file The file.
+     * @param row The row.
+     * @param column The column.
+     */
+    void printFile(const File &file, int row, int column) const;
+};
@@ -0,0 +1,435 @@
+#include "FilePreview.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILEPREVIEW_X86 1
+#endif
+
+namespace
+{
+    uint64_t countNewlinesGeneric(const char *data, uint64_t length)
+    {
+        return std::count(data, data + length, '\n');
+    }
+
+#ifdef FILEPREVIEW_X86
+    // The byte counters of a vector are summed before any of them can overflow
+    constexpr uint64_t maximalRounds = 255;
+
+    __attribute__((target("sse2")))
+    uint64_t countNewlinesSse2(const char *data, uint64_t length)
+    {
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i zero = _mm_setzero_si128();
+        __m128i total = zero;
+        uint64_t i = 0;
+        while(i + 16 <= length)
+        {
+            __m128i counters = zero;
+            uint64_t rounds = std::min((length - i) / 16, maximalRounds);
+            for(uint64_t round = 0; round < rounds; round++, i += 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(bytes, newline));
+            }
+            total = _mm_add_epi64(total, _mm_sad_epu8(counters, zero));
+        }
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), total);
+        return lanes[0] + lanes[1] + countNewlinesGeneric(data + i, length - i);
+    }
+
+    __attribute__((target("avx2")))
+    uint64_t countNewlinesAvx2(const char *data, uint64_t length)
+    {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i total = zero;
+        uint64_t i = 0;
+        while(i + 32 <= length)
+        {
+            __m256i counters = zero;
+            uint64_t rounds = std::min((length - i) / 32, maximalRounds);
+            for(uint64_t round = 0; round < rounds; round++, i += 32)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(bytes, newline));
+            }
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(counters, zero));
+        }
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), total);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + countNewlinesGeneric(data + i, length - i);
+    }
+#endif
+
+    using CountFunction = uint64_t (*)(const char *, uint64_t);
+
+    CountFunction selectCountFunction()
+    {
+#ifdef FILEPREVIEW_X86
+        if(__builtin_cpu_supports("avx2"))
+            return countNewlinesAvx2;
+        if(__builtin_cpu_supports("sse2"))
+            return countNewlinesSse2;
+#endif
+        return countNewlinesGeneric;
+    }
+}
+
+FilePreview::FilePreview(const fs::path &path) : m_path(path), m_descriptor(-1), m_data(nullptr), m_size(0), m_device(0), m_inode(0),
+    m_isPart(false), m_partOffset(0), m_mappingDelta(0),
+    m_checkpoints(1, 0), m_indexedBytes(0), m_newlineCount(0), m_stopped(false)
+{
+    map();
+    startIndexing();
+}
+
+FilePreview::FilePreview(const fs::path &path, uint64_t offset, uint64_t size) : m_path(path), m_descriptor(-1), m_data(nullptr), m_size(size),
+    m_device(0), m_inode(0), m_isPart(true), m_partOffset(offset), m_mappingDelta(offset % ::sysconf(_SC_PAGESIZE)),
+    m_checkpoints(1, 0), m_indexedBytes(0), m_newlineCount(0), m_stopped(false)
+{
+    map();
+    startIndexing();
+}
+
+FilePreview::~FilePreview()
+{
+    stopIndexing();
+    unmap();
+}
+
+bool FilePreview::update()
+{
+    if(m_isPart)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if(::stat(m_path.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        return false;
+    }
+
+    uint64_t size = status.st_size;
+    bool isReplaced = status.st_dev != m_device || status.st_ino != m_inode || size < m_size;
+    if(!isReplaced && size == m_size)
+    {
+        return false;
+    }
+
+    stopIndexing();
+    if(isReplaced || !m_data)
+    {
+        unmap();
+        map();
+    }
+    else
+    {
+        // Only the mapping grows, the index goes on from where it stopped
+        void *mapping = ::mremap(const_cast<char *>(m_data), m_size, size, MREMAP_MAYMOVE);
+        if(mapping == MAP_FAILED)
+        {
+            startIndexing();
+            throw std::runtime_error("Cannot map " + m_path.string());
+        }
+        m_data = static_cast<const char *>(mapping);
+        m_size = size;
+    }
+    startIndexing();
+    return true;
+}
+
+uint64_t FilePreview::size() const
+{
+    return readableSize();
+}
+
+bool FilePreview::isBinary() const
+{
+    uint64_t size = readableSize();
+    return size > 0 && std::memchr(m_data, 0, std::min<uint64_t>(size, 8192)) != nullptr;
+}
+
+std::string_view FilePreview::bytes(uint64_t offset, uint64_t length) const
+{
+    uint64_t size = readableSize();
+    if(offset >= size)
+    {
+        return std::string_view();
+    }
+    return std::string_view(m_data + offset, std::min(length, size - offset));
+}
+
+std::string_view FilePreview::line(uint64_t offset, uint64_t &next) const
+{
+    uint64_t size = readableSize();
+    if(offset >= size)
+    {
+        next = size;
+        return std::string_view();
+    }
+
+    uint64_t end = std::min(offset + maximalLineLength, size);
+    const char *newline = static_cast<const char *>(std::memchr(m_data + offset, '\n', end - offset));
+    if(!newline)
+    {
+        next = end;
+        return std::string_view(m_data + offset, end - offset);
+    }
+    next = newline - m_data + 1;
+    return std::string_view(m_data + offset, newline - m_data - offset);
+}
+
+uint64_t FilePreview::lineStart(uint64_t offset) const
+{
+    offset = std::min(offset, readableSize());
+    uint64_t begin = offset > maximalLineLength ? offset - maximalLineLength : 0;
+    const char *newline = static_cast<const char *>(::memrchr(m_data + begin, '\n', offset - begin));
+    return newline ? newline - m_data + 1 : begin;
+}
+
+uint64_t FilePreview::previousLine(uint64_t offset) const
+{
+    return offset == 0 ? 0 : lineStart(offset - 1);
+}
+
+bool FilePreview::lineOffset(uint64_t lineNumber, uint64_t &offset) const
+{
+    uint64_t size = readableSize();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_indexedBytes >= size)
+    {
+        uint64_t lines = countLines(size);
+        lineNumber = std::min(lineNumber, lines > 0 ? lines - 1 : 0);
+    }
+    else if(lineNumber > m_newlineCount)
+    {
+        // The line starts after a newline not counted yet
+        return false;
+    }
+
+    // At most lineStride - 1 lines are stepped over from the closest checkpoint
+    offset = std::min(m_checkpoints[lineNumber / lineStride], size);
+    for(uint64_t i = lineNumber % lineStride; i > 0 && offset < size; i--)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(m_data + offset, '\n', size - offset));
+        offset = newline ? newline - m_data + 1 : size;
+    }
+    return true;
+}
+
+bool FilePreview::lineNumberAt(uint64_t offset, uint64_t &lineNumber) const
+{
+    uint64_t size = readableSize();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(offset > m_indexedBytes || offset > size)
+    {
+        return false;
+    }
+
+    lineNumber = newlinesBefore(offset);
+    return true;
+}
+
+uint64_t FilePreview::indexedBytes() const
+{
+    return m_indexedBytes;
+}
+
+bool FilePreview::isIndexed() const
+{
+    return m_indexedBytes >= readableSize();
+}
+
+uint64_t FilePreview::lineCount() const
+{
+    uint64_t size = readableSize();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return countLines(size);
+}
+
+uint64_t FilePreview::countNewlines(const char *data, uint64_t length)
+{
+    static const CountFunction count = selectCountFunction();
+    return count(data, length);
+}
+
+uint64_t FilePreview::readableSize() const
+{
+    // The pages of the mapping past the end of a truncated file fault when they are read
+    struct stat status;
+    if(m_descriptor < 0 || ::fstat(m_descriptor, &status) != 0)
+    {
+        return m_size;
+    }
+
+    uint64_t fileSize = status.st_size;
+    return fileSize > m_partOffset ? std::min(m_size, fileSize - m_partOffset) : 0;
+}
+
+uint64_t FilePreview::newlinesBefore(uint64_t offset) const
+{
+    size_t checkpoint = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), offset) - m_checkpoints.begin() - 1;
+    return checkpoint * lineStride + countNewlines(m_data + m_checkpoints[checkpoint], offset - m_checkpoints[checkpoint]);
+}
+
+uint64_t FilePreview::countLines(uint64_t size) const
+{
+    if(size == 0)
+    {
+        return 0;
+    }
+
+    // A file truncated after it was indexed has fewer lines than the index counted
+    uint64_t newlines = m_indexedBytes > size ? newlinesBefore(size) : m_newlineCount.load();
+    return newlines + (m_data[size - 1] == '\n' ? 0 : 1);
+}
+
+void FilePreview::map()
+{
+    int descriptor = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(descriptor < 0)
+    {
+        throw std::runtime_error("Cannot open " + m_path.string());
+    }
+
+    struct stat status;
+    if(::fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        ::close(descriptor);
+        throw std::runtime_error("Cannot preview " + m_path.string());
+    }
+
+    uint64_t size = m_isPart ? m_size : status.st_size;
+    if(m_isPart && m_partOffset + size > uint64_t(status.st_size))
+    {
+        ::close(descriptor);
+        throw std::runtime_error(m_path.string() + " ends before the previewed part");
+    }
+
+    const char *data = nullptr;
+    if(size > 0)
+    {
+        void *mapping = ::mmap(nullptr, size + m_mappingDelta, PROT_READ, MAP_PRIVATE, descriptor, m_partOffset - m_mappingDelta);
+        if(mapping == MAP_FAILED)
+        {
+            ::close(descriptor);
+            throw std::runtime_error("Cannot map " + m_path.string());
+        }
+        data = static_cast<const char *>(mapping) + m_mappingDelta;
+    }
+
+    m_descriptor = descriptor;
+    m_data = data;
+    m_size = size;
+    m_device = status.st_dev;
+    m_inode = status.st_ino;
+}
+
+void FilePreview::unmap()
+{
+    if(m_data)
+    {
+        ::munmap(const_cast<char *>(m_data - m_mappingDelta), m_size + m_mappingDelta);
+    }
+    if(m_descriptor >= 0)
+    {
+        ::close(m_descriptor);
+    }
+
+    // An unmapped preview is an empty file, a new file at the path replaces it
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_descriptor = -1;
+    m_data = nullptr;
+    m_size = 0;
+    m_device = 0;
+    m_inode = 0;
+    m_checkpoints.assign(1, 0);
+    m_newlineCount = 0;
+    m_indexedBytes = 0;
+}
+
+void FilePreview::startIndexing()
+{
+    m_stopped = false;
+    m_indexer = std::thread(&FilePreview::buildIndex, this);
+}
+
+void FilePreview::stopIndexing()
+{
+    m_stopped = true;
+    if(m_indexer.joinable())
+    {
+        m_indexer.join();
+    }
+}
+
+void FilePreview::buildIndex()
+{
+    // Pieces without a checkpoint are only counted, the exact newlines are looked for in the others
+    const uint64_t pieceSize = 4096;
+    const uint64_t publishSize = 1 << 20;
+
+    // Only m_indexer changes the index, it goes on from its end
+    uint64_t newlines = m_newlineCount;
+    uint64_t nextCheckpoint = m_checkpoints.size() * lineStride;
+    std::vector<uint64_t> checkpoints;
+    std::vector<char> buffer(publishSize);
+
+    uint64_t offset = m_indexedBytes;
+    while(offset < m_size && !m_stopped)
+    {
+        ssize_t bytesRead = ::pread(m_descriptor, buffer.data(), std::min(publishSize, m_size - offset), m_partOffset + offset);
+        if(bytesRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(bytesRead <= 0)
+        {
+            // The file was truncated, update() maps it again
+            break;
+        }
+
+        for(uint64_t piece = 0; piece < uint64_t(bytesRead); piece += pieceSize)
+        {
+            uint64_t length = std::min<uint64_t>(pieceSize, bytesRead - piece);
+            uint64_t count = countNewlines(buffer.data() + piece, length);
+            if(newlines + count < nextCheckpoint)
+            {
+                newlines += count;
+                continue;
+            }
+
+            const char *position = buffer.data() + piece;
+            const char *end = position + length;
+            while((position = static_cast<const char *>(std::memchr(position, '\n', end - position))))
+            {
+                position++;
+                if(++newlines == nextCheckpoint)
+                {
+                    checkpoints.push_back(offset + (position - buffer.data()));
+                    nextCheckpoint += lineStride;
+                }
+            }
+        }
+        offset += bytesRead;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_checkpoints.insert(m_checkpoints.end(), checkpoints.begin(), checkpoints.end());
+            m_newlineCount = newlines;
+            m_indexedBytes = offset;
+        }
+        checkpoints.clear();
+    }
+}
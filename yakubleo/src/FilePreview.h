@@ -0,0 +1,224 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @class FilePreview
+ * @brief Memory mapped read-only view of a file of any size with a lazily built line index.
+ *
+ * The index keeps the offset of every lineStride-th line only and is built by a background thread
+ * reading the file and counting newlines with vector instructions, so it stays small for any file and the contents can be
+ * shown before it is complete. The thread does not touch the mapping, a file truncated meanwhile ends the index instead of faulting. Byte offsets need no index at all, jumping to a percentage is immediate.
+ *
+ * A growing file is followed by update(): the appended bytes are mapped and only they are indexed,
+ * a file replaced at the path or truncated is mapped and indexed again from its start.
+ * Until then every access is cut at the current end of the mapped file, the bytes a truncation removed are never read.
+ *
+ * A part of a file, as a member of an archive, is previewed the same way without being copied out of it.
+ */
+class FilePreview
+{
+public:
+    /**
+     * @brief Lines between two offsets kept by the index.
+     */
+    static constexpr uint64_t lineStride = 1024;
+
+    /**
+     * @brief The longest line returned in one piece, longer lines are split so that no line is read whole.
+     */
+    static constexpr uint64_t maximalLineLength = 4096;
+
+    /**
+     * @brief Constructor. Maps the file and starts indexing its lines.
+     * @param path The path to the file.
+     * @throws std::runtime_error If the file cannot be opened or mapped.
+     */
+    FilePreview(const fs::path &path);
+
+    /**
+     * @brief Constructor. Maps a part of the file and starts indexing its lines, the part is not followed by update().
+     * @param path The path to the file.
+     * @param offset The first byte of the part.
+     * @param size The size of the part.
+     * @throws std::runtime_error If the file cannot be opened or mapped or ends before the part.
+     */
+    FilePreview(const fs::path &path, uint64_t offset, uint64_t size);
+
+    /**
+     * @brief Destructor. Stops the indexing and unmaps the file.
+     */
+    ~FilePreview();
+
+    FilePreview(const FilePreview &) = delete;
+    FilePreview &operator=(const FilePreview &) = delete;
+
+    /**
+     * @brief Follows the file at the path, maps the bytes appended since the last call.
+     *
+     * A different file at the path, as after log rotation, or a truncated file replaces the mapped one,
+     * while no file is at the path the mapped one stays.
+     *
+     * @return True if the contents changed, always false for a part of a file.
+     * @throws std::runtime_error If the new file cannot be mapped.
+     */
+    bool update();
+
+    /**
+     * @brief Gets the size of the file, a truncated file is shorter than mapped.
+     * @return The size in bytes.
+     */
+    uint64_t size() const;
+
+    /**
+     * @brief Tells if the file looks binary, a zero byte in its first 8 KiB.
+     * @return True for a binary file.
+     */
+    bool isBinary() const;
+
+    /**
+     * @brief Gets the bytes of the file.
+     * @param offset The first byte.
+     * @param length The number of bytes, cut at the end of the file.
+     * @return The bytes.
+     */
+    std::string_view bytes(uint64_t offset, uint64_t length) const;
+
+    /**
+     * @brief Gets the line starting at the offset.
+     * @param offset The start of the line.
+     * @param next Set to the start of the following line, the size of the file after the last line.
+     * @return The line without its newline, at most maximalLineLength bytes.
+     */
+    std::string_view line(uint64_t offset, uint64_t &next) const;
+
+    /**
+     * @brief Finds the start of the line containing the offset, looks back at most maximalLineLength bytes.
+     * @param offset The offset.
+     * @return The start of the line.
+     */
+    uint64_t lineStart(uint64_t offset) const;
+
+    /**
+     * @brief Finds the start of the line before the line starting at the offset.
+     * @param offset The start of a line.
+     * @return The start of the previous line, 0 for the first line.
+     */
+    uint64_t previousLine(uint64_t offset) const;
+
+    /**
+     * @brief Finds the start of the line with the number.
+     * @param lineNumber The number of the line, counted from 0, numbers past the last line give the last line.
+     * @param offset Set to the start of the line.
+     * @return False if the index does not reach the line yet.
+     */
+    bool lineOffset(uint64_t lineNumber, uint64_t &offset) const;
+
+    /**
+     * @brief Finds the number of the line containing the offset.
+     * @param offset The offset.
+     * @param lineNumber Set to the number of the line, counted from 0.
+     * @return False if the index does not reach the offset yet.
+     */
+    bool lineNumberAt(uint64_t offset, uint64_t &lineNumber) const;
+
+    /**
+     * @brief Gets the number of bytes the index covers.
+     * @return The number of bytes, size() once the index is complete.
+     */
+    uint64_t indexedBytes() const;
+
+    /**
+     * @brief Tells if the index covers the whole file.
+     * @return True once every line is indexed.
+     */
+    bool isIndexed() const;
+
+    /**
+     * @brief Gets the number of lines, valid once the index is complete.
+     * @return The number of lines, a last line without a newline included.
+     */
+    uint64_t lineCount() const;
+
+    /**
+     * @brief Counts the newlines in the bytes, with AVX2 or SSE2 where the processor has them.
+     * @param data The bytes.
+     * @param length The number of bytes.
+     * @return The number of newlines.
+     */
+    static uint64_t countNewlines(const char *data, uint64_t length);
+
+private:
+    fs::path m_path; /**< The path to the file. */
+    int m_descriptor; /**< The mapped file, read by the indexer, -1 when unmapped. */
+    const char *m_data; /**< The mapped file, nullptr for an empty file. */
+    uint64_t m_size; /**< The size of the file. */
+    dev_t m_device; /**< The device of the mapped file. */
+    ino_t m_inode; /**< The inode of the mapped file. */
+    bool m_isPart; /**< True if only a part of the file is previewed. */
+    uint64_t m_partOffset; /**< The offset of the previewed part in the file. */
+    uint64_t m_mappingDelta; /**< The bytes mapped before m_data, the mapping starts at a page boundary. */
+
+    mutable std::mutex m_mutex; /**< Guards the checkpoints. */
+    std::vector<uint64_t> m_checkpoints; /**< The offset of every lineStride-th line, the first line included. */
+    std::atomic<uint64_t> m_indexedBytes; /**< The bytes the index covers. */
+    std::atomic<uint64_t> m_newlineCount; /**< The newlines in the bytes the index covers. */
+    std::atomic<bool> m_stopped; /**< Set to stop the indexing. */
+    std::thread m_indexer; /**< Builds the index. */
+
+    /**
+     * @brief Gets the bytes of the mapping that are still in the file.
+     * @return The mapped size cut at the current end of the file.
+     */
+    uint64_t readableSize() const;
+
+    /**
+     * @brief Counts the newlines before the offset, m_mutex has to be locked.
+     * @param offset The offset, at most the bytes the index covers.
+     * @return The number of newlines.
+     */
+    uint64_t newlinesBefore(uint64_t offset) const;
+
+    /**
+     * @brief Counts the lines of the complete index, m_mutex has to be locked.
+     * @param size The readable size of the file.
+     * @return The number of lines, a last line without a newline included.
+     */
+    uint64_t countLines(uint64_t size) const;
+
+    /**
+     * @brief Maps the file at the path, the preview has to be unmapped.
+     * @throws std::runtime_error If the file cannot be opened or mapped.
+     */
+    void map();
+
+    /**
+     * @brief Unmaps the file and clears the index.
+     */
+    void unmap();
+
+    /**
+     * @brief Starts indexing the bytes the index does not cover yet in m_indexer.
+     */
+    void startIndexing();
+
+    /**
+     * @brief Stops m_indexer, the bytes indexed so far stay indexed.
+     */
+    void stopIndexing();
+
+    /**
+     * @brief Counts the newlines from the end of the index to the end of the file and stores the checkpoints, runs in m_indexer.
+     *
+     * The bytes are read from m_descriptor, the index stops early at the end of a truncated file.
+     */
+    void buildIndex();
+};
@@ -1,45 +1,317 @@
 #include "FileSystem.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unordered_set>
+#include "SelectionBatch.h"
+#include "Tracer.h"
 
-FileSystem::FileSystem(const fs::path &directory)
+FileSystem::FileSystem(const fs::path &directory) : m_isArchiveListed(false), m_isFindListed(false), m_listedMatchCount(0)
 {
     loadFiles(directory);
 }
 
-void FileSystem::print(int initialRow, int initialColumn, int normalFileColourPair, int selectedFileColourPair, int printFrom, size_t totalLinesInTerminal) const
+void FileSystem::loadFiles(const fs::path &directory)
 {
+    Tracer::Span span(Tracer::LOAD_FILES);
+    m_directoryHandle = std::make_shared<const DirectoryHandle>(directory);
+    for (const auto& entry : m_directoryHandle->list())
+    {
+        std::unique_ptr<File> file = makeFile(directory / entry.name, entry.type);
+        if (file)
+        {
+            file->setParent(m_directoryHandle);
+            m_filesInDirectory.push_back(std::move(file));
+        }
+    }
 
-    int row = initialRow ;
-    int column = initialColumn;
+    if(m_selection.containsIn(directory))
+        markSelectedFiles();
+}
+
+void FileSystem::startDiskUsage(const fs::path &directory)
+{
+    m_diskUsage.start(directory);
+}
 
-    for(size_t i = printFrom; i < m_filesInDirectory.size() && i < totalLinesInTerminal; i++)
+bool FileSystem::isComputingDiskUsage() const
+{
+    return m_diskUsage.isRunning();
+}
+
+void FileSystem::startTopFiles(const fs::path &directory, TopFilesFinder::Criterion criterion, size_t count)
+{
+    m_topFilesRoot = directory;
+    m_topFilesFinder.start(directory, criterion, count);
+}
+
+void FileSystem::stopTopFiles()
+{
+    m_topFilesFinder.stop();
+}
+
+bool FileSystem::isFindingTopFiles() const
+{
+    return m_topFilesFinder.isRunning();
+}
+
+size_t FileSystem::topFilesScannedCount() const
+{
+    return m_topFilesFinder.scannedCount();
+}
+
+void FileSystem::loadTopFiles()
+{
+    clearFileSystem();
+
+    for(const auto& rankedFile : m_topFilesFinder.getResult())
     {
-        m_filesInDirectory[i]->print(row, column, normalFileColourPair, selectedFileColourPair);
-        row++;
+        // Files removed or moved since they were found are not listed
+        if(!fs::exists(fs::symlink_status(rankedFile.path)))
+            continue;
+
+        char modified[32];
+        struct tm localTime;
+        ::localtime_r(&rankedFile.modified.tv_sec, &localTime);
+        std::strftime(modified, sizeof(modified), "%Y-%m-%d %H:%M", &localTime);
+
+        char label[64];
+        std::snprintf(label, sizeof(label), "%9s  %s  ", DiskUsage::formatSize(rankedFile.size).c_str(), modified);
+
+        auto file = std::make_unique<RegularFile>(rankedFile.path);
+        file->setLabel(label + rankedFile.path.lexically_relative(m_topFilesRoot).string());
+        m_filesInDirectory.push_back(std::move(file));
     }
+    markSelectedFiles();
 }
 
-void FileSystem::loadFiles(const fs::path &directory)
+void FileSystem::startFind(const fs::path &directory, const std::string &query)
+{
+    auto compiledQuery = std::make_shared<const FindQuery>(query);
+    m_findRoot = directory;
+    m_isFindListed = false;
+    m_fileFinder.start(directory, std::move(compiledQuery));
+}
+
+void FileSystem::stopFind()
 {
-    for (const auto& entry : fs::directory_iterator(directory))
+    m_fileFinder.stop();
+}
+
+bool FileSystem::isFinding() const
+{
+    return m_fileFinder.isRunning();
+}
+
+size_t FileSystem::findScannedCount() const
+{
+    return m_fileFinder.scannedCount();
+}
+
+void FileSystem::loadFoundFiles()
+{
+    clearFileSystem();
+    m_isFindListed = true;
+    m_listedMatchCount = 0;
+    appendFoundFiles();
+}
+
+void FileSystem::appendFoundFiles()
+{
+    if(!m_isFindListed)
     {
-        if (entry.is_symlink())
-        {
-            m_filesInDirectory.emplace_back(std::make_unique<SymbolicLink>(entry.path()));
-        }
-        else if (entry.is_directory())
+        loadFoundFiles();
+        return;
+    }
+
+    // Only the new matches are stated, the search may still be adding to them
+    std::vector<fs::path> matches = m_fileFinder.getMatches(m_listedMatchCount);
+    m_listedMatchCount += matches.size();
+    for(const auto& path : matches)
+    {
+        // Files removed or moved since they were found are not listed
+        std::unique_ptr<File> file = makeFile(path);
+        if(!file)
+            continue;
+
+        file->setLabel(path.lexically_relative(m_findRoot).string());
+        if(m_selection.contains(path))
+            file->select();
+        m_filesInDirectory.push_back(std::move(file));
+    }
+}
+
+void FileSystem::loadPaths(const std::vector<fs::path> &paths)
+{
+    clearFileSystem();
+    for(const auto& path : paths)
+    {
+        std::unique_ptr<File> file = makeFile(path);
+        if(!file)
+            continue;
+
+        file->setLabel(path.string());
+        m_filesInDirectory.push_back(std::move(file));
+    }
+    markSelectedFiles();
+}
+
+void FileSystem::loadArchive(const fs::path &archive, const std::string &directory)
+{
+    Tracer::Span span(Tracer::LOAD_FILES);
+    // The listing stays as it is when the archive cannot be read
+    std::shared_ptr<const TarArchive> opened = m_archive && m_archive->getPath() == archive ? m_archive : std::make_shared<const TarArchive>(archive);
+    clearFileSystem();
+    m_archive = std::move(opened);
+
+    for(size_t index : m_archive->list(directory))
+    {
+        m_filesInDirectory.push_back(std::make_unique<ArchiveMember>(m_archive, index));
+    }
+    m_isArchiveListed = true;
+}
+
+void FileSystem::closeArchive()
+{
+    if(m_isArchiveListed)
+        clearFileSystem();
+    m_archive.reset();
+}
+
+bool FileSystem::isArchiveListed() const
+{
+    return m_isArchiveListed;
+}
+
+size_t FileSystem::skippedArchiveMembers() const
+{
+    return m_archive ? m_archive->getSkippedCount() : 0;
+}
+
+BatchResult FileSystem::extractSelectedMembers(const fs::path &destination)
+{
+    if(!m_isArchiveListed)
+        return BatchResult();
+
+    std::vector<size_t> members;
+    for(const auto& file : m_filesInDirectory)
+    {
+        if(file->isSelected())
         {
-            m_filesInDirectory.emplace_back(std::make_unique<Directory>(entry.path()));
+            members.push_back(static_cast<const ArchiveMember &>(*file).getIndex());
+            file->deSelect();
         }
-        else if (entry.is_regular_file())
+    }
+    return m_archive->extract(members, destination);
+}
+
+bool FileSystem::applyChanges(const fs::path &directory, const DirectoryChanges &changes)
+{
+    bool isDirectoryChanged = false;
+    if(!m_directoryHandle || m_directoryHandle->getPath() != directory)
+        m_directoryHandle = std::make_shared<const DirectoryHandle>(directory);
+    std::unordered_set<std::string> changedNames(changes.removed.begin(), changes.removed.end());
+    changedNames.insert(changes.present.begin(), changes.present.end());
+
+    // Files whose name changed are created again, the type behind the name may be different now
+    std::unordered_set<std::string> listedNames;
+    auto kept = std::remove_if(m_filesInDirectory.begin(), m_filesInDirectory.end(), [&](const std::unique_ptr<File> &file)
+    {
+        std::string name = file->getName();
+        if(!changedNames.count(name))
+            return false;
+
+        struct stat status;
+        bool isPresent = m_directoryHandle->stat(name, status);
+        bool isKept = isPresent && (dynamic_cast<const Directory *>(file.get()) != nullptr) == S_ISDIR(status.st_mode)
+            && (dynamic_cast<const SymbolicLink *>(file.get()) != nullptr) == S_ISLNK(status.st_mode);
+        if(isKept)
         {
-            m_filesInDirectory.emplace_back(std::make_unique<RegularFile>(entry.path()));
+            listedNames.insert(name);
+            return false;
         }
+        if(dynamic_cast<const Directory *>(file.get()))
+            isDirectoryChanged = true;
+        return true;
+    });
+    m_filesInDirectory.erase(kept, m_filesInDirectory.end());
+
+    for(const auto& name : changes.present)
+    {
+        if(listedNames.count(name))
+            continue;
+
+        struct stat status;
+        std::unique_ptr<File> file = m_directoryHandle->stat(name, status) ? makeFile(directory / name, IFTODT(status.st_mode)) : nullptr;
+        if(!file)
+            continue;
+        file->setParent(m_directoryHandle);
+        if(dynamic_cast<const Directory *>(file.get()))
+            isDirectoryChanged = true;
+        if(m_selection.contains(file->getPath()))
+            file->select();
+        m_filesInDirectory.push_back(std::move(file));
+    }
+    return isDirectoryChanged;
+}
+
+IndexStatistics FileSystem::indexDirectory(const fs::path &directory)
+{
+    return m_metadataIndex.addRoot(directory);
+}
+
+std::vector<IndexEntry> FileSystem::searchIndex(const std::string &query) const
+{
+    return m_metadataIndex.search(query, 1000);
+}
+
+fs::path FileSystem::getPathAt(int index) const
+{
+    return m_filesInDirectory.at(index)->getPath();
+}
+
+const File &FileSystem::getFileAt(int index) const
+{
+    return *m_filesInDirectory.at(index);
+}
+
+int FileSystem::indexOf(const fs::path &path) const
+{
+    for(size_t i = 0; i < m_filesInDirectory.size(); i++)
+    {
+        if(m_filesInDirectory[i]->getPath() == path)
+            return i;
     }
+    return -1;
+}
+
+std::unique_ptr<File> FileSystem::makeFile(const fs::path &path)
+{
+    struct stat status;
+    if(::lstat(path.c_str(), &status) != 0)
+        return nullptr;
+    return makeFile(path, IFTODT(status.st_mode));
+}
+
+std::unique_ptr<File> FileSystem::makeFile(const fs::path &path, unsigned char type)
+{
+    if(type == DT_LNK)
+        return std::make_unique<SymbolicLink>(path);
+    if(type == DT_DIR)
+        return std::make_unique<Directory>(path);
+    if(type == DT_REG)
+        return std::make_unique<RegularFile>(path);
+    return nullptr;
 }
 
 void FileSystem::clearFileSystem()
 {
     m_filesInDirectory.clear();
+    m_directoryHandle.reset();
+    m_isArchiveListed = false;
+    m_isFindListed = false;
 }
 
 void FileSystem::setPointedAt(int index)
@@ -56,56 +328,124 @@ void FileSystem::dePointAt(int index)
 
 void FileSystem::setSelectedAt(int index)
 {
-    if(!m_filesInDirectory.empty())
-        m_filesInDirectory[index]->select();
+    if(m_filesInDirectory.empty())
+        return;
+
+    File &file = *m_filesInDirectory[index];
+    file.select();
+    if(m_isArchiveListed)
+        return;
+    if(!file.isSelected())
+        m_selection.remove(file.getPath());
+    else if(!m_selection.add(file.getPath()))
+        file.deSelect();
 }
 
 void FileSystem::deSelectAt(int index)
 {
-    if(!m_filesInDirectory.empty())
-        m_filesInDirectory[index]->deSelect();
+    if(m_filesInDirectory.empty())
+        return;
+
+    m_filesInDirectory[index]->deSelect();
+    m_selection.remove(m_filesInDirectory[index]->getPath());
 }
 
-int FileSystem::filesInCurrentDirectory()
+int FileSystem::filesInCurrentDirectory() const
 {
     return m_filesInDirectory.size();
 }
 
-void FileSystem::copySelectedFiles(const fs::path &destination)
+BatchResult FileSystem::copySelectedFiles(const fs::path &destination)
 {
-    for(const auto& file : m_filesInDirectory)
+    if(m_isArchiveListed)
     {
-        if(file->isSelected())
-        {
-            file->copy(destination);
-        }
+        return extractSelectedMembers(destination);
     }
+
+    BatchResult result = SelectionBatch::copy(m_selection.groups(), destination);
     deSelectAllFiles();
+    return result;
+}
+
+BatchResult FileSystem::moveSelectedFiles(const fs::path &destination)
+{
+    if(m_isArchiveListed)
+        throw std::runtime_error("The members of " + m_archive->getPath().string() + " cannot be moved, the archive is read-only");
 
+    BatchResult result = SelectionBatch::move(m_selection.groups(), destination);
+    deSelectAllFiles();
+    return result;
 }
 
-void FileSystem::moveSelectedFiles(const fs::path &destination)
+RenamePlan FileSystem::planRenameOfSelectedFiles(const std::string &pattern, const std::string &replacement) const
+{
+    if(m_isArchiveListed)
+        throw std::runtime_error("The members of " + m_archive->getPath().string() + " cannot be renamed, the archive is read-only");
+
+    return BatchRenamer::plan(getSelectedPaths(), pattern, replacement);
+}
+
+size_t FileSystem::renameFiles(const RenamePlan &plan)
 {
-    for(const auto& file : m_filesInDirectory)
-    {
-        if(file->isSelected())
-        {
-            file->move(destination);
-        }
-    }
     deSelectAllFiles();
+    return BatchRenamer::rename(plan);
 }
 
-void FileSystem::removeSelectedFiles()
+BatchResult FileSystem::removeSelectedFiles()
 {
+    if(m_isArchiveListed)
+        throw std::runtime_error("The members of " + m_archive->getPath().string() + " cannot be deleted, the archive is read-only");
+
+    BatchResult result = SelectionBatch::moveToTrash(m_selection.groups(), m_trash);
+    if(result.failures == 0)
+    {
+        deSelectAllFiles();
+        return result;
+    }
+
+    // The files that could not be trashed stay selected, so they can be deleted permanently
+    for(const auto& path : m_selection.paths())
+    {
+        struct stat status;
+        if(::lstat(path.c_str(), &status) != 0)
+            m_selection.remove(path);
+    }
     for(const auto& file : m_filesInDirectory)
     {
-        if(file->isSelected())
-        {
-            file->remove();
-        }
+        if(file->isSelected() && !m_selection.contains(file->getPath()))
+            file->deSelect();
     }
+    return result;
+}
+
+BatchResult FileSystem::removeSelectedFilesPermanently()
+{
+    if(m_isArchiveListed)
+        throw std::runtime_error("The members of " + m_archive->getPath().string() + " cannot be deleted, the archive is read-only");
+
+    BatchResult result = SelectionBatch::remove(m_selection.groups());
     deSelectAllFiles();
+    return result;
+}
+
+std::vector<TrashEntry> FileSystem::listTrash() const
+{
+    return m_trash.list();
+}
+
+void FileSystem::restoreFromTrash(const TrashEntry &entry)
+{
+    m_trash.restore(entry);
+}
+
+void FileSystem::emptyTrash()
+{
+    m_trash.purgeAll();
+}
+
+const Trash &FileSystem::getTrash() const
+{
+    return m_trash;
 }
 
 void FileSystem::deSelectAllFiles()
@@ -114,25 +454,66 @@ void FileSystem::deSelectAllFiles()
     {
         file->deSelect();
     }
+    // The selection holds no members, it stays for when the archive is left
+    if(!m_isArchiveListed)
+        m_selection.clear();
 }
 
-void FileSystem::selectOnRegex(const std::regex &regexPattern)
+void FileSystem::selectOnRegex(const std::string &regexPattern)
 {
-    for(const auto& file : m_filesInDirectory)
+    std::shared_ptr<const Regex> regex = m_regexCache.get(regexPattern);
+
+    ThreadPool::parallelFor(m_filesInDirectory.size(), [&](size_t begin, size_t end)
     {
-        file->selectOnRegex(regexPattern);
-    }
+        RegexMatcher matcher(*regex, RegexMatcher::FULL_MATCH);
+        for(size_t i = begin; i < end; i++)
+        {
+            m_filesInDirectory[i]->selectOnRegex(matcher);
+        }
+    });
+    addSelectedFiles();
 }
 
-void FileSystem::appendSelectedFilesTo(std::ofstream &outputFile)
+void FileSystem::selectOnRegexText(const std::string &regexPattern)
 {
+    std::shared_ptr<const Regex> regex = m_regexCache.get(regexPattern);
+
+    // Files are expensive to read, so even short listings are split
+    ThreadPool::parallelFor(m_filesInDirectory.size(), [&](size_t begin, size_t end)
+    {
+        RegexMatcher matcher(*regex, RegexMatcher::SEARCH);
+        for(size_t i = begin; i < end; i++)
+        {
+            m_filesInDirectory[i]->selectOnRegexText(matcher);
+        }
+    }, 1);
+    addSelectedFiles();
+}
+
+BatchResult FileSystem::appendSelectedFilesTo(std::ofstream &outputFile)
+{
+    if(!m_isArchiveListed)
+    {
+        return SelectionBatch::concatenate(m_selection.groups(), outputFile);
+    }
+
+    BatchResult result;
     for(const auto& file : m_filesInDirectory)
     {
-        if(file->isSelected())
+        if(!file->isSelected())
+            continue;
+        try
         {
             file->appendContentsTo(outputFile);
+            result.doneCount++;
+        }
+        catch(const std::exception &e)
+        {
+            if(result.failures++ == 0)
+                result.firstError = e.what();
         }
     }
+    return result;
 }
 
 void FileSystem::selectOnText(const std::string &text)
@@ -141,70 +522,193 @@ void FileSystem::selectOnText(const std::string &text)
     {
         file->selectOnText(text);
     }
+    addSelectedFiles();
 }
 
-void FileSystem::deduplicateSelectedFileIn(fs::path &directoryToSearchIn)
+std::vector<std::pair<fs::path, std::vector<size_t>>> FileSystem::selectOnPatterns(const AhoCorasick &automaton)
 {
-    std::unique_ptr<File> originalFile(m_filesInDirectory[getSelectedFileIndex()]->clone());
-
+    std::vector<std::pair<fs::path, std::vector<size_t>>> matches;
+    for(const auto& file : m_filesInDirectory)
+    {
+        std::vector<size_t> matchedPatterns = file->selectOnPatterns(automaton);
+        if(!matchedPatterns.empty())
+        {
+            matches.emplace_back(file->getPath(), std::move(matchedPatterns));
+        }
+    }
+    addSelectedFiles();
+    return matches;
+}
 
-    if(!originalFile)
-        return;
+uintmax_t FileSystem::deduplicateSelectedFileIn(fs::path &directoryToSearchIn, Deduplicator::Mode mode)
+{
+    std::unique_ptr<File> originalFile = getSelectedOriginal();
 
-    
     clearFileSystem();
     
     loadFiles(directoryToSearchIn);
 
+    uintmax_t bytesReclaimed = 0;
     for(const auto& file : m_filesInDirectory)
     {
+        if(file->getPath() == originalFile->getPath())
+            continue;
+        // The files of compared subtrees are hashed once and then looked up
+        if(auto directory = dynamic_cast<Directory *>(file.get()))
+            directory->setHashCache(&m_hashCache);
         if(file->isEqualTo(*originalFile))
         {
-            file->changeToSymbolicLink(*originalFile);
+            bytesReclaimed += file->changeToLink(*originalFile, mode);
         }
     }
-
+    return bytesReclaimed;
 }
 
-void FileSystem::deduplicateSelectedFileInCurrentDirectory()
+uintmax_t FileSystem::deduplicateSelectedFileInCurrentDirectory(Deduplicator::Mode mode)
 {
-    std::unique_ptr<File> originalFile(m_filesInDirectory[getSelectedFileIndex()]->clone());
-    m_filesInDirectory.erase(m_filesInDirectory.begin() + getSelectedFileIndex());
+    std::unique_ptr<File> originalFile = getSelectedOriginal();
 
-    if(!originalFile)
-        return;
-    
+    uintmax_t bytesReclaimed = 0;
     for(const auto& file : m_filesInDirectory)
     {
+        if(file->getPath() == originalFile->getPath())
+            continue;
+        // The files of compared subtrees are hashed once and then looked up
+        if(auto directory = dynamic_cast<Directory *>(file.get()))
+            directory->setHashCache(&m_hashCache);
         if(file->isEqualTo(*originalFile))
         {
-            file->changeToSymbolicLink(*originalFile);
+            bytesReclaimed += file->changeToLink(*originalFile, mode);
         }
     }
+    return bytesReclaimed;
+}
 
+DeduplicationResult FileSystem::deduplicateGroups(const std::vector<DuplicateGroup> &groups, Deduplicator::Mode mode)
+{
+    return Deduplicator::replaceGroups(groups, mode);
 }
 
-int FileSystem::selectedFilesCount()
+std::vector<DuplicateGroup> FileSystem::findDuplicatesIn(const fs::path &directoryToSearchIn)
 {
-    int count = 0;
-    for(const auto& file : m_filesInDirectory)
+    m_hashCache.resetStatistics();
+
+    DuplicateFinder finder(&m_hashCache);
+    std::vector<DuplicateGroup> groups = finder.find(directoryToSearchIn);
+
+    m_hashCache.save();
+    return groups;
+}
+
+std::vector<SubtreeGroup> FileSystem::findIdenticalSubtreesIn(const fs::path &directoryToSearchIn)
+{
+    m_hashCache.resetStatistics();
+
+    SubtreeHasher hasher(&m_hashCache);
+    hasher.hashTree(directoryToSearchIn);
+    std::vector<SubtreeGroup> groups = hasher.findIdenticalSubtrees();
+
+    m_hashCache.save();
+    return groups;
+}
+
+DeduplicationResult FileSystem::deduplicateSubtrees(const std::vector<SubtreeGroup> &groups, Deduplicator::Mode mode)
+{
+    return Deduplicator::replaceSubtreeGroups(groups, mode);
+}
+
+DirectoryComparison FileSystem::compareDirectories(const fs::path &source, const fs::path &target, bool isContentChecked)
+{
+    m_hashCache.resetStatistics();
+
+    DirectoryComparer comparer(&m_hashCache);
+    DirectoryComparison comparison = comparer.compare(source, target, isContentChecked);
+
+    if(isContentChecked)
+        m_hashCache.save();
+    return comparison;
+}
+
+MirrorResult FileSystem::mirrorDirectories(const DirectoryComparison &comparison, bool isExtraRemoved)
+{
+    return DirectoryComparer::mirror(comparison, isExtraRemoved);
+}
+
+ChunkReport FileSystem::analyzeChunksOfSelectedFiles() const
+{
+    std::vector<fs::path> files;
+    for(const auto& path : m_selection.paths())
     {
-        if(file->isSelected())
+        if(fs::is_regular_file(fs::symlink_status(path)))
         {
-            count++;
+            files.push_back(path);
         }
     }
-    return count;
+
+    ChunkAnalyzer analyzer;
+    return analyzer.analyze(files);
 }
 
-int FileSystem::getSelectedFileIndex()
+const HashCache &FileSystem::getHashCache() const
 {
-    for(size_t i = 0; i < m_filesInDirectory.size(); i++)
+    return m_hashCache;
+}
+
+const DiskUsage &FileSystem::getDiskUsage() const
+{
+    return m_diskUsage;
+}
+
+int FileSystem::selectedFilesCount()
+{
+    if(m_isArchiveListed)
     {
-        if(m_filesInDirectory[i]->isSelected())
-        {
-            return i;
-        }
+        return std::count_if(m_filesInDirectory.begin(), m_filesInDirectory.end(), [](const auto &file) { return file->isSelected(); });
+    }
+    return m_selection.size();
+}
+
+std::vector<fs::path> FileSystem::getSelectedPaths() const
+{
+    return m_selection.paths();
+}
+
+std::unique_ptr<File> FileSystem::getSelectedOriginal() const
+{
+    if(m_isArchiveListed)
+        throw std::runtime_error("The members of " + m_archive->getPath().string() + " cannot be deduplicated, the archive is read-only");
+
+    // The selection may be in another directory than the listing
+    std::vector<fs::path> paths = m_selection.paths();
+    if(paths.size() != 1)
+        throw std::runtime_error("Exactly one file has to be selected");
+
+    std::unique_ptr<File> original = makeFile(paths.front());
+    if(!original)
+        throw std::runtime_error("Cannot deduplicate " + paths.front().string());
+    return original;
+}
+
+void FileSystem::markSelectedFiles()
+{
+    if(m_selection.empty())
+        return;
+
+    for(const auto& file : m_filesInDirectory)
+    {
+        if(!file->isSelected() && m_selection.contains(file->getPath()))
+            file->select();
+    }
+}
+
+void FileSystem::addSelectedFiles()
+{
+    if(m_isArchiveListed)
+        return;
+
+    for(const auto& file : m_filesInDirectory)
+    {
+        if(file->isSelected() && !m_selection.contains(file->getPath()) && !m_selection.add(file->getPath()))
+            file->deSelect();
     }
-    throw std::runtime_error("No file selected");
 }
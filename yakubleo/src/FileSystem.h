@@ -2,11 +2,24 @@
 #include <vector>
 #include <memory>
 #include <filesystem>
-#include <ncurses.h>
 #include "Directory.h"
 #include "RegularFile.h"
 #include "SymbolicLink.h"
-#include <regex>
+#include "RegexCache.h"
+#include "ThreadPool.h"
+#include "DuplicateFinder.h"
+#include "ChunkAnalyzer.h"
+#include "SubtreeHasher.h"
+#include "DiskUsage.h"
+#include "TopFilesFinder.h"
+#include "MetadataIndex.h"
+#include "DirectoryWatcher.h"
+#include "FileFinder.h"
+#include "DirectoryComparer.h"
+#include "BatchRenamer.h"
+#include "Trash.h"
+#include "SelectionSet.h"
+#include "ArchiveMember.h"
 
 
 
@@ -24,21 +37,187 @@ public:
      */
     FileSystem(const fs::path &directory);
 
-    /**
-     * @brief Prints the files in the file system.
-     * @param initialRow The initial row position for printing.
-     * @param initialColumn The initial column position for printing.
-     * @param normalFileColourPair The color pair number for normal files.
-     * @param selectedFileColourPair The color pair number for selected files.
-     */
-    void print(int initialRow, int initialColumn, int normalFileColourPair, int selectedFileColourPair, int printFrom, size_t totalLinesInTerminal) const;
-
     /**
      * @brief Loads the files from the specified directory.
+     *
+     * The directory is opened once, its entries are read and later reached relative to it.
+     *
      * @param directory The path to the directory.
+     * @throws std::runtime_error If the directory cannot be read.
      */
     void loadFiles(const fs::path &directory);
 
+    /**
+     * @brief Starts computing the sizes of the directories below the directory in the background.
+     * @param directory The directory.
+     */
+    void startDiskUsage(const fs::path &directory);
+
+    /**
+     * @brief Tells if the sizes of some directories are still being computed.
+     * @return True while the background walk runs.
+     */
+    bool isComputingDiskUsage() const;
+
+    /**
+     * @brief Starts searching for the largest or the oldest regular files below the directory in the background.
+     * @param directory The root of the search.
+     * @param criterion Which files are searched for.
+     * @param count The number of files to find.
+     */
+    void startTopFiles(const fs::path &directory, TopFilesFinder::Criterion criterion, size_t count);
+
+    /**
+     * @brief Stops the search for the largest or the oldest files.
+     */
+    void stopTopFiles();
+
+    /**
+     * @brief Tells if the search for the largest or the oldest files still runs.
+     * @return True while the search runs.
+     */
+    bool isFindingTopFiles() const;
+
+    /**
+     * @brief Gets the number of regular files the search for the largest or the oldest files has seen.
+     * @return The number of files.
+     */
+    size_t topFilesScannedCount() const;
+
+    /**
+     * @brief Replaces the files in the file system by the largest or the oldest files found so far.
+     *
+     * The files are labelled by their size, modification time and path relative to the root of the search,
+     * the files in the selection are marked selected and the files that no longer exist are left out.
+     */
+    void loadTopFiles();
+
+    /**
+     * @brief Starts finding the files below the directory that match the query in the background.
+     * @param directory The root of the search.
+     * @param query The query, see FindQuery.
+     * @throws std::runtime_error If the query is invalid.
+     */
+    void startFind(const fs::path &directory, const std::string &query);
+
+    /**
+     * @brief Stops finding the files matching the query.
+     */
+    void stopFind();
+
+    /**
+     * @brief Tells if the files matching the query are still being found.
+     * @return True while the search runs.
+     */
+    bool isFinding() const;
+
+    /**
+     * @brief Gets the number of entries the search for the files matching the query has checked.
+     * @return The number of entries.
+     */
+    size_t findScannedCount() const;
+
+    /**
+     * @brief Replaces the files in the file system by the files matching the query found so far.
+     *
+     * The files are labelled by their path relative to the root of the search,
+     * the files in the selection are marked selected and the files that no longer exist are left out.
+     */
+    void loadFoundFiles();
+
+    /**
+     * @brief Appends the files found since the last load to the listed files, loads them all if other files are listed.
+     */
+    void appendFoundFiles();
+
+    /**
+     * @brief Applies the changes of the directory to the listed files in one pass.
+     *
+     * Removed names are dropped, names that appeared are added at the end, the other files keep their order and state.
+     *
+     * @param directory The listed directory.
+     * @param changes The changes.
+     * @return True if a directory was added or removed.
+     */
+    bool applyChanges(const fs::path &directory, const DirectoryChanges &changes);
+
+    /**
+     * @brief Replaces the files in the file system by the files at the paths, labelled by the whole paths.
+     * @param paths The paths, the ones that no longer exist are left out.
+     */
+    void loadPaths(const std::vector<fs::path> &paths);
+
+    /**
+     * @brief Replaces the files in the file system by the members of a directory of a tar archive.
+     *
+     * The archive is opened and indexed only when it is not the archive listed last. While members are listed,
+     * selecting marks them in the listing only, the selection of the other directories is kept apart.
+     *
+     * @param archive The path to the archive.
+     * @param directory The path of the directory in the archive, empty for the top.
+     * @throws std::runtime_error If the archive cannot be read or is not a tar archive.
+     */
+    void loadArchive(const fs::path &archive, const std::string &directory);
+
+    /**
+     * @brief Closes the archive listed last.
+     */
+    void closeArchive();
+
+    /**
+     * @brief Tells if the listed files are members of an archive.
+     * @return True after loadArchive until the file system is cleared.
+     */
+    bool isArchiveListed() const;
+
+    /**
+     * @brief Gets the number of members of the archive listed last that leave the directory they are extracted into.
+     * @return The number of members, they are neither listed nor extracted, 0 without an archive.
+     */
+    size_t skippedArchiveMembers() const;
+
+    /**
+     * @brief Extracts the marked members of the listed archive directory into the directory in parallel, de selects all files after that.
+     * @param destination The destination directory.
+     * @return The counts and the bytes written.
+     */
+    BatchResult extractSelectedMembers(const fs::path &destination);
+
+    /**
+     * @brief Adds the directory to the persistent metadata index and updates the whole index.
+     * @param directory The directory.
+     * @return The statistics of the update.
+     */
+    IndexStatistics indexDirectory(const fs::path &directory);
+
+    /**
+     * @brief Searches the persistent metadata index for file names containing the query.
+     * @param query The query, the case of ASCII letters is ignored.
+     * @return At most 1000 matching paths.
+     */
+    std::vector<IndexEntry> searchIndex(const std::string &query) const;
+
+    /**
+     * @brief Gets the path to the file at the index.
+     * @param index The index of the file.
+     * @return The path.
+     */
+    fs::path getPathAt(int index) const;
+
+    /**
+     * @brief Gets the file at the index.
+     * @param index The index of the file.
+     * @return The file.
+     */
+    const File &getFileAt(int index) const;
+
+    /**
+     * @brief Finds the file with the path.
+     * @param path The path.
+     * @return The index of the file, -1 if it is not listed.
+     */
+    int indexOf(const fs::path &path) const;
+
     /**
      * @brief Clears the file system by removing all files.
      */
@@ -57,13 +236,13 @@ public:
     void dePointAt(int index);
 
     /**
-     * @brief Sets the selected state for the file at the specified index.
+     * @brief Toggles the selected state for the file at the specified index and adds it to or removes it from the selection.
      * @param index The index of the file to set the selected state.
      */
     void setSelectedAt(int index);
 
     /**
-     * @brief Clears the selected state for the file at the specified index.
+     * @brief Clears the selected state for the file at the specified index and removes it from the selection.
      * @param index The index of the file to clear the selected state.
      */
     void deSelectAt(int index);
@@ -71,40 +250,107 @@ public:
     /**
      * @brief Returns the number of files in the current directory as an integer
     */
-    int filesInCurrentDirectory();
+    int filesInCurrentDirectory() const;
 
     /**
-     * @brief Copies the selected files to the specified directory, de selects all files after that.
+     * @brief Copies the selected files of every directory to the specified directory as one batch, de selects all files after that.
+     *
+     * While archive members are listed, the marked members are extracted instead.
+     *
      * @param destination The destination directory to copy the files to.
+     * @return The files copied and the ones that could not be, the others are copied.
+     * @throws std::runtime_error If the batch cannot start, e.g. the destination cannot be opened.
      */
-    void copySelectedFiles(const fs::path &destination);
+    BatchResult copySelectedFiles(const fs::path &destination);
 
     /**
-     * @brief Moves the selected files to the specified directory, de selects all files after that.
+     * @brief Moves the selected files of every directory to the specified directory as one batch, de selects all files after that.
      * @param destination The destination directory to move the files to.
+     * @return The files moved and the ones that could not be, the others are moved.
+     * @throws std::runtime_error If the batch cannot start or archive members are listed.
+     */
+    BatchResult moveSelectedFiles(const fs::path &destination);
+
+    /**
+     * @brief Computes the new names of the selected files without renaming anything.
+     * @param pattern The regular expression whose first match in a name is replaced.
+     * @param replacement The replacement, $1 to $9 insert the groups of the match.
+     * @return The renames and the conflicts found.
+     * @throws std::runtime_error If the pattern is invalid or archive members are listed.
+     */
+    RenamePlan planRenameOfSelectedFiles(const std::string &pattern, const std::string &replacement) const;
+
+    /**
+     * @brief Runs the planned renames, de selects all files after that.
+     * @param plan The renames, without conflicts.
+     * @return The number of files renamed.
+     * @throws std::runtime_error If a file cannot be renamed, the renamed files get their old names back.
+     */
+    size_t renameFiles(const RenamePlan &plan);
+
+    /**
+     * @brief Moves the selected files of every directory to the trash as one batch, de selects all files after that.
+     * @return The files moved and the ones that could not be, they stay selected and the others are moved.
+     * @throws std::runtime_error If archive members are listed.
+     */
+    BatchResult removeSelectedFiles();
+
+    /**
+     * @brief Deletes the selected files of every directory permanently as one batch, for files that have no trash.
+     * @return The files deleted and the ones that could not be, the others are deleted.
+     * @throws std::runtime_error If archive members are listed.
+     */
+    BatchResult removeSelectedFilesPermanently();
+
+    /**
+     * @brief Lists the entries of the trashes.
+     * @return The entries, the most recently deleted first.
+     */
+    std::vector<TrashEntry> listTrash() const;
+
+    /**
+     * @brief Moves the entry of the trash back to its original path.
+     * @param entry The entry.
+     * @throws std::runtime_error If something else is at the original path or the entry was purged.
      */
-    void moveSelectedFiles(const fs::path &destination);
+    void restoreFromTrash(const TrashEntry &entry);
 
     /**
-     * @brief Removes the selected files, de selects all files after that.
+     * @brief Purges every entry of the trashes in the background.
      */
-    void removeSelectedFiles();
+    void emptyTrash();
 
     /**
-     * @brief Sets the selected state for all files to false.
+     * @brief Gets the trash, it tells how the background purge progresses.
+     * @return The trash.
+     */
+    const Trash &getTrash() const;
+
+    /**
+     * @brief Sets the selected state for all files to false and empties the selection, in a listed archive only the members are deselected.
      */
     void deSelectAllFiles();
 
     /**
-     * @brief Selects all files that match the regex pattern.
+     * @brief Selects all files whose names match the regex pattern, the files are matched in parallel.
+     * @param regexPattern The regular expression.
+     * @throws std::runtime_error If the pattern is invalid.
+     */
+    void selectOnRegex(const std::string &regexPattern);
+
+    /**
+     * @brief Selects the files with a line that matches the regex pattern, the files are searched in parallel.
+     * @param regexPattern The regular expression.
+     * @throws std::runtime_error If the pattern is invalid.
      */
-    void selectOnRegex(const std::regex &regexPattern);
+    void selectOnRegexText(const std::string &regexPattern);
 
     /**
-     * @brief Appends the selected file contents to the specified output file.
+     * @brief Appends the contents of the selected regular files of every directory to the specified output file, in the order of their paths.
      * @param outputFile The output file to append the contents to.
+     * @return The files appended and the ones that could not be read, the others are appended, the bytes written only outside archives.
      */
-    void appendSelectedFilesTo(std::ofstream &outputFile);
+    BatchResult appendSelectedFilesTo(std::ofstream &outputFile);
 
     /**
      * @brief Selects the files with the specified text in its contents.
@@ -112,21 +358,163 @@ public:
      */
     void selectOnText(const std::string &text);
 
+    /**
+     * @brief Selects the files that contain any of the patterns, every file is read only once.
+     * @param automaton The compiled patterns.
+     * @return Every file with at least one match together with the indexes of the patterns it contains.
+     */
+    std::vector<std::pair<fs::path, std::vector<size_t>>> selectOnPatterns(const AhoCorasick &automaton);
 
-    void deduplicateSelectedFileIn(fs::path &directoryToSearchIn);
 
+    /**
+     * @brief Replaces the files identical to the selected file in the directory by links to the selected file.
+     * @param directoryToSearchIn The directory with the suspected duplicates.
+     * @param mode The kind of the links.
+     * @return The number of bytes reclaimed.
+     * @throws std::runtime_error If not exactly one file is selected.
+     */
+    uintmax_t deduplicateSelectedFileIn(fs::path &directoryToSearchIn, Deduplicator::Mode mode);
 
-    void deduplicateSelectedFileInCurrentDirectory();
+    /**
+     * @brief Replaces the files identical to the selected file in the current directory by links to the selected file.
+     * @param mode The kind of the links.
+     * @return The number of bytes reclaimed.
+     * @throws std::runtime_error If not exactly one file is selected.
+     */
+    uintmax_t deduplicateSelectedFileInCurrentDirectory(Deduplicator::Mode mode);
 
     /**
-     * @brief Returns the number of selected files as an integer.
+     * @brief Keeps the first file of every group and replaces the others by links to it.
+     * @param groups The groups of duplicates.
+     * @param mode The kind of the links.
+     * @return The number of bytes reclaimed and files replaced.
      */
-    int selectedFilesCount();
+    DeduplicationResult deduplicateGroups(const std::vector<DuplicateGroup> &groups, Deduplicator::Mode mode);
+
+    /**
+     * @brief Finds all groups of identical regular files in the whole tree below the directory.
+     *
+     * Content hashes are taken from the persistent hash cache when the files did not change,
+     * the statistics of the cache are reset before the search.
+     *
+     * @param directoryToSearchIn The root of the tree.
+     * @return The groups of duplicates, the groups wasting the most space first.
+     */
+    std::vector<DuplicateGroup> findDuplicatesIn(const fs::path &directoryToSearchIn);
+
+    /**
+     * @brief Finds all groups of identical directories in the whole tree below the directory.
+     *
+     * Content hashes are taken from the persistent hash cache, the statistics of the cache are reset before the search.
+     *
+     * @param directoryToSearchIn The root of the tree.
+     * @return The groups of identical directories, reported at the highest level, the groups wasting the most space first.
+     */
+    std::vector<SubtreeGroup> findIdenticalSubtreesIn(const fs::path &directoryToSearchIn);
 
+    /**
+     * @brief Keeps the first directory of every group and replaces the others.
+     * @param groups The groups of identical directories.
+     * @param mode The kind of the links.
+     * @return The number of bytes reclaimed and directories replaced.
+     */
+    DeduplicationResult deduplicateSubtrees(const std::vector<SubtreeGroup> &groups, Deduplicator::Mode mode);
+
+    /**
+     * @brief Compares two directory trees, content hashes are taken from the hash cache.
+     * @param source The directory that is mirrored.
+     * @param target The directory that becomes its copy.
+     * @param isContentChecked True to compare the contents of regular files instead of their modification times.
+     * @return The differences.
+     */
+    DirectoryComparison compareDirectories(const fs::path &source, const fs::path &target, bool isContentChecked);
+
+    /**
+     * @brief Copies the added and changed entries of the comparison into its target.
+     * @param comparison The comparison.
+     * @param isExtraRemoved True to also remove the entries that are only in the target.
+     * @return The numbers of copied and removed entries.
+     */
+    MirrorResult mirrorDirectories(const DirectoryComparison &comparison, bool isExtraRemoved);
+
+    /**
+     * @brief Splits the selected regular files into content-defined chunks and measures the bytes they share.
+     * @return The report of the shared bytes.
+     * @throws std::runtime_error If a file cannot be read or too many files are selected.
+     */
+    ChunkReport analyzeChunksOfSelectedFiles() const;
+
+    /**
+     * @brief Gets the persistent cache of content hashes.
+     * @return The cache.
+     */
+    const HashCache &getHashCache() const;
+
+    /**
+     * @brief Gets the sizes of the directories computed in the background.
+     * @return The disk usage.
+     */
+    const DiskUsage &getDiskUsage() const;
+
+    /**
+     * @brief Returns the number of selected files in every directory as an integer, the marked members while an archive is listed.
+     */
+    int selectedFilesCount();
 
-    int getSelectedFileIndex();
+    /**
+     * @brief Gets the paths of the selected files in every directory.
+     * @return The paths, sorted by their directories and names.
+     */
+    std::vector<fs::path> getSelectedPaths() const;
 
 
 private:
+    /**
+     * @brief Creates the object of the file at the path, symbolic links are not followed.
+     * @param path The path.
+     * @return The file, nullptr if it does not exist or is neither a directory, a regular file nor a symbolic link.
+     */
+    static std::unique_ptr<File> makeFile(const fs::path &path);
+
+    /**
+     * @brief Creates the object of the file of the type.
+     * @param path The path.
+     * @param type The type as DT_LNK, DT_DIR or DT_REG.
+     * @return The file, nullptr for the other types.
+     */
+    static std::unique_ptr<File> makeFile(const fs::path &path, unsigned char type);
+
+    /**
+     * @brief Creates the object of the only selected file, which may be in any directory.
+     * @return The file.
+     * @throws std::runtime_error If not exactly one file is selected, it no longer exists or archive members are listed.
+     */
+    std::unique_ptr<File> getSelectedOriginal() const;
+
+    /**
+     * @brief Marks the listed files that are in the selection as selected.
+     */
+    void markSelectedFiles();
+
+    /**
+     * @brief Adds the listed files marked as selected to the selection, the ones that no longer exist are unmarked.
+     */
+    void addSelectedFiles();
+
     std::vector<std::unique_ptr<File>> m_filesInDirectory; /**< The files in the current directory. */
+    std::shared_ptr<const DirectoryHandle> m_directoryHandle; /**< The open current directory, the listed files are reached relative to it. */
+    RegexCache m_regexCache; /**< Recently used compiled regular expressions. */
+    HashCache m_hashCache; /**< Content hashes of files that did not change since they were hashed. */
+    DiskUsage m_diskUsage; /**< Sizes of the directories, computed in the background. */
+    TopFilesFinder m_topFilesFinder; /**< Searches for the largest or the oldest files in the background. */
+    fs::path m_topFilesRoot; /**< The root of the search for the largest or the oldest files. */
+    FileFinder m_fileFinder; /**< Finds the files matching a query in the background. */
+    fs::path m_findRoot; /**< The root of the search for the files matching a query. */
+    MetadataIndex m_metadataIndex; /**< Paths below the indexed roots for searching by name. */
+    Trash m_trash; /**< Receives the removed files and purges them in the background. */
+    SelectionSet m_selection; /**< The files selected in any directory, kept while other directories are listed. */
+    std::shared_ptr<const TarArchive> m_archive; /**< The archive listed last, kept open while its directories are browsed. */
+    bool m_isArchiveListed; /**< True while the listed files are members of m_archive. */
+    bool m_isFindListed; /**< True while the listed files are the matches of the find query. */
+    size_t m_listedMatchCount; /**< The matches of the find query taken into the listing, including those no longer existing. */
 };
\ No newline at end of file
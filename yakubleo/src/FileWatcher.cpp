@@ -0,0 +1,83 @@
+#include "FileWatcher.h"
+#include <sys/inotify.h>
+#include <unistd.h>
+
+FileWatcher::FileWatcher(const fs::path &path) : m_descriptor(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)), m_fileWatch(-1), m_directoryWatch(-1),
+    m_path(path), m_name(path.filename().string())
+{
+    if(m_descriptor < 0)
+    {
+        return;
+    }
+
+    fs::path directory = path.has_parent_path() ? path.parent_path() : fs::path(".");
+    m_directoryWatch = ::inotify_add_watch(m_descriptor, directory.c_str(), IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
+    watchFile();
+}
+
+FileWatcher::~FileWatcher()
+{
+    if(m_descriptor >= 0)
+        ::close(m_descriptor);
+}
+
+int FileWatcher::getDescriptor() const
+{
+    return m_descriptor;
+}
+
+bool FileWatcher::readChanges()
+{
+    if(m_descriptor < 0)
+    {
+        return false;
+    }
+
+    bool isChanged = false;
+    bool isReplaced = false;
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    while(true)
+    {
+        ssize_t length = ::read(m_descriptor, buffer, sizeof(buffer));
+        if(length <= 0)
+            break;
+
+        for(char *position = buffer; position < buffer + length; )
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(position);
+            position += sizeof(struct inotify_event) + event->len;
+
+            if(event->mask & IN_Q_OVERFLOW)
+            {
+                isChanged = isReplaced = true;
+            }
+            else if(event->wd == m_directoryWatch)
+            {
+                if(event->len > 0 && m_name == event->name)
+                    isChanged = isReplaced = true;
+            }
+            else if(event->wd == m_fileWatch)
+            {
+                isChanged = true;
+                if(event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))
+                    isReplaced = true;
+            }
+        }
+    }
+
+    if(isReplaced)
+    {
+        watchFile();
+    }
+    return isChanged;
+}
+
+void FileWatcher::watchFile()
+{
+    if(m_fileWatch >= 0)
+    {
+        ::inotify_rm_watch(m_descriptor, m_fileWatch);
+    }
+    // A moved or deleted file is no longer watched, the file now at the path is
+    m_fileWatch = ::inotify_add_watch(m_descriptor, m_path.c_str(), IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+}
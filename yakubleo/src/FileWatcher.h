@@ -0,0 +1,56 @@
+#pragma once
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+
+/**
+ * @class FileWatcher
+ * @brief Watches one file with inotify, including the files that replace it at its path.
+ *
+ * The file is watched for writes, truncation and being moved or deleted, its directory for a new file
+ * appearing under its name, so a rotated log is followed to the new file like tail -F does.
+ * The descriptor is non-blocking, so it can be polled together with the keyboard.
+ * Without inotify the descriptor is -1, which poll() ignores, and nothing is ever reported.
+ */
+class FileWatcher
+{
+public:
+    /**
+     * @brief Constructor. Creates the inotify instance and watches the file and its directory.
+     * @param path The path to the file.
+     */
+    FileWatcher(const fs::path &path);
+
+    /**
+     * @brief Destructor. Closes the inotify instance.
+     */
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    /**
+     * @brief Gets the descriptor to poll for readability.
+     * @return The inotify descriptor, -1 without inotify.
+     */
+    int getDescriptor() const;
+
+    /**
+     * @brief Reads all the queued events without blocking, watches the new file if the file was replaced.
+     * @return True if the file at the path may have changed.
+     */
+    bool readChanges();
+
+private:
+    int m_descriptor; /**< The inotify instance. */
+    int m_fileWatch; /**< The watch of the file, -1 while there is no file at the path. */
+    int m_directoryWatch; /**< The watch of the directory of the file. */
+    fs::path m_path; /**< The path to the file. */
+    std::string m_name; /**< The name of the file in its directory. */
+
+    /**
+     * @brief Watches the file currently at the path.
+     */
+    void watchFile();
+};
@@ -0,0 +1,363 @@
+#include "FindQuery.h"
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    char modeTypeLetter(mode_t mode)
+    {
+        switch(mode & S_IFMT)
+        {
+        case S_IFREG: return 'f';
+        case S_IFDIR: return 'd';
+        case S_IFLNK: return 'l';
+        case S_IFIFO: return 'p';
+        case S_IFSOCK: return 's';
+        case S_IFCHR: return 'c';
+        case S_IFBLK: return 'b';
+        default: return '?';
+        }
+    }
+
+    char typeLetter(unsigned char directoryType)
+    {
+        switch(directoryType)
+        {
+        case DT_REG: return 'f';
+        case DT_DIR: return 'd';
+        case DT_LNK: return 'l';
+        case DT_FIFO: return 'p';
+        case DT_SOCK: return 's';
+        case DT_CHR: return 'c';
+        case DT_BLK: return 'b';
+        default: return '?';
+        }
+    }
+
+    bool parseIdentifier(std::string_view text, uint32_t &identifier)
+    {
+        if(text.empty() || text.find_first_not_of("0123456789") != std::string_view::npos || text.size() > 9)
+            return false;
+        identifier = std::stoul(std::string(text));
+        return true;
+    }
+}
+
+FindQuery::FindQuery(const std::string &query) : m_statusMask(0), m_now(std::time(nullptr))
+{
+    std::istringstream words(query);
+    std::string word;
+    while(words >> word)
+    {
+        bool isNegated = false;
+        if(word[0] == '!')
+        {
+            isNegated = true;
+            word.erase(0, 1);
+        }
+
+        Term term = parseTerm(word);
+        term.isNegated = isNegated;
+        m_terms.push_back(term);
+    }
+
+    if(m_terms.empty())
+    {
+        throw std::runtime_error("Empty find query");
+    }
+
+    // Cheap terms first, a failing one spares the expensive ones
+    std::stable_sort(m_terms.begin(), m_terms.end(), [](const Term &first, const Term &second) { return first.cost < second.cost; });
+}
+
+FindQuery::Matchers FindQuery::createMatchers() const
+{
+    Matchers matchers;
+    for(size_t i = 0; i < m_regexes.size(); i++)
+    {
+        matchers.emplace_back(*m_regexes[i], m_regexModes[i]);
+    }
+    return matchers;
+}
+
+bool FindQuery::matches(Candidate &candidate, Matchers &matchers) const
+{
+    for(const auto& term : m_terms)
+    {
+        if(term.cost == 2 && !ensureStatus(candidate, m_statusMask))
+            return false;
+        if(evaluate(term, candidate, matchers) == term.isNegated)
+            return false;
+    }
+    return true;
+}
+
+bool FindQuery::ensureStatus(Candidate &candidate, unsigned int mask)
+{
+    if(candidate.hasStatus)
+    {
+        return true;
+    }
+    if(::statx(candidate.directoryDescriptor, candidate.name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, mask | STATX_TYPE, &candidate.status) != 0)
+    {
+        return false;
+    }
+    candidate.hasStatus = true;
+    return true;
+}
+
+bool FindQuery::isDirectory(Candidate &candidate)
+{
+    if(candidate.directoryType != DT_UNKNOWN)
+    {
+        return candidate.directoryType == DT_DIR;
+    }
+    return ensureStatus(candidate, STATX_TYPE) && S_ISDIR(candidate.status.stx_mode);
+}
+
+bool FindQuery::evaluate(const Term &term, Candidate &candidate, Matchers &matchers) const
+{
+    switch(term.kind)
+    {
+    case NAME_GLOB:
+    case NAME_REGEX:
+        return matchers[term.regexIndex].matches(candidate.name);
+    case TYPE:
+    {
+        char letter = typeLetter(candidate.directoryType);
+        if(letter == '?')
+        {
+            if(!ensureStatus(candidate, m_statusMask))
+                return false;
+            letter = modeTypeLetter(candidate.status.stx_mode);
+        }
+        return term.types.find(letter) != std::string::npos;
+    }
+    case SIZE:
+        return candidate.status.stx_size >= term.minimum && candidate.status.stx_size <= term.maximum;
+    case MODIFIED:
+    case ACCESSED:
+    {
+        const struct statx_timestamp &time = (term.kind == MODIFIED) ? candidate.status.stx_mtime : candidate.status.stx_atime;
+        uint64_t age = time.tv_sec < m_now ? uint64_t(m_now - time.tv_sec) : 0;
+        return age >= term.minimum && age <= term.maximum;
+    }
+    case USER:
+        return candidate.status.stx_uid == term.identifier;
+    case GROUP:
+        return candidate.status.stx_gid == term.identifier;
+    case PERMISSIONS:
+    {
+        uint32_t bits = candidate.status.stx_mode & 07777;
+        if(term.permissionMatch == EXACT)
+            return bits == term.permissions;
+        if(term.permissionMatch == ALL)
+            return (bits & term.permissions) == term.permissions;
+        return (bits & term.permissions) != 0;
+    }
+    case LINKS:
+        return candidate.status.stx_nlink >= term.minimum && candidate.status.stx_nlink <= term.maximum;
+    }
+    return false;
+}
+
+FindQuery::Term FindQuery::parseTerm(std::string_view text)
+{
+    size_t colon = text.find(':');
+    if(colon == std::string_view::npos || colon + 1 == text.size())
+    {
+        throw std::runtime_error("Invalid find term " + std::string(text));
+    }
+    std::string_view key = text.substr(0, colon);
+    std::string_view value = text.substr(colon + 1);
+
+    Term term;
+    if(key == "name" || key == "re")
+    {
+        term.kind = (key == "name") ? NAME_GLOB : NAME_REGEX;
+        term.regexIndex = m_regexes.size();
+        m_regexes.push_back(std::make_unique<Regex>(key == "name" ? globToRegex(value) : std::string(value)));
+        m_regexModes.push_back(key == "name" ? RegexMatcher::FULL_MATCH : RegexMatcher::SEARCH);
+        return term;
+    }
+
+    if(key == "type")
+    {
+        term.kind = TYPE;
+        term.cost = 1;
+        for(char letter : value)
+        {
+            if(letter == ',')
+                continue;
+            if(std::string_view("fdlpscb").find(letter) == std::string_view::npos)
+                throw std::runtime_error("Unknown file type " + std::string(1, letter));
+            term.types.push_back(letter);
+        }
+        m_statusMask |= STATX_TYPE;
+        return term;
+    }
+
+    term.cost = 2;
+    if(key == "size")
+    {
+        term.kind = SIZE;
+        parseRange(value, false, term);
+        m_statusMask |= STATX_SIZE;
+    }
+    else if(key == "mtime" || key == "atime")
+    {
+        // Less than 7 days ago is an age below 7 days
+        term.kind = (key == "mtime") ? MODIFIED : ACCESSED;
+        parseRange(value, true, term);
+        m_statusMask |= (key == "mtime") ? STATX_MTIME : STATX_ATIME;
+    }
+    else if(key == "user" || key == "group")
+    {
+        term.kind = (key == "user") ? USER : GROUP;
+        std::string name(value);
+        if(!parseIdentifier(value, term.identifier))
+        {
+            if(key == "user")
+            {
+                struct passwd *entry = ::getpwnam(name.c_str());
+                if(!entry)
+                    throw std::runtime_error("Unknown user " + name);
+                term.identifier = entry->pw_uid;
+            }
+            else
+            {
+                struct group *entry = ::getgrnam(name.c_str());
+                if(!entry)
+                    throw std::runtime_error("Unknown group " + name);
+                term.identifier = entry->gr_gid;
+            }
+        }
+        m_statusMask |= (key == "user") ? STATX_UID : STATX_GID;
+    }
+    else if(key == "perm")
+    {
+        term.kind = PERMISSIONS;
+        if(value[0] == '-' || value[0] == '+')
+        {
+            term.permissionMatch = (value[0] == '-') ? ALL : ANY;
+            value.remove_prefix(1);
+        }
+        if(value.empty() || value.size() > 4 || value.find_first_not_of("01234567") != std::string_view::npos)
+            throw std::runtime_error("Invalid permission bits " + std::string(value));
+        term.permissions = std::stoul(std::string(value), nullptr, 8);
+        m_statusMask |= STATX_MODE;
+    }
+    else if(key == "links")
+    {
+        term.kind = LINKS;
+        parseRange(value, false, term);
+        m_statusMask |= STATX_NLINK;
+    }
+    else
+    {
+        throw std::runtime_error("Unknown find term " + std::string(key));
+    }
+    return term;
+}
+
+uint64_t FindQuery::parseNumber(std::string_view text, bool isAge)
+{
+    size_t digits = text.find_first_not_of("0123456789");
+    size_t digitCount = (digits == std::string_view::npos) ? text.size() : digits;
+    if(digitCount == 0 || digitCount > 15 || (digits != std::string_view::npos && digits + 1 != text.size()))
+    {
+        throw std::runtime_error("Invalid number " + std::string(text));
+    }
+
+    uint64_t value = std::stoull(std::string(text.substr(0, digits)));
+    if(digits == std::string_view::npos)
+    {
+        return value;
+    }
+
+    const std::string_view units = isAge ? "smhdw" : "kMGT";
+    const uint64_t ageFactors[] = {1, 60, 3600, 86400, 604800};
+    size_t unit = units.find(text.back());
+    if(unit == std::string_view::npos)
+    {
+        throw std::runtime_error("Unknown unit " + std::string(text));
+    }
+    return isAge ? value * ageFactors[unit] : value << (10 * (unit + 1));
+}
+
+void FindQuery::parseRange(std::string_view text, bool isAge, Term &term)
+{
+    if(text[0] == '>')
+    {
+        term.minimum = parseNumber(text.substr(1), isAge) + 1;
+    }
+    else if(text[0] == '<')
+    {
+        uint64_t limit = parseNumber(text.substr(1), isAge);
+        if(limit == 0)
+            throw std::runtime_error("Nothing is below 0");
+        term.maximum = limit - 1;
+    }
+    else if(size_t dots = text.find(".."); dots != std::string_view::npos)
+    {
+        term.minimum = parseNumber(text.substr(0, dots), isAge);
+        term.maximum = parseNumber(text.substr(dots + 2), isAge);
+    }
+    else
+    {
+        term.minimum = term.maximum = parseNumber(text, isAge);
+    }
+}
+
+std::string FindQuery::globToRegex(std::string_view glob)
+{
+    std::string regex;
+    for(size_t i = 0; i < glob.size(); i++)
+    {
+        char character = glob[i];
+        if(character == '*')
+        {
+            regex += ".*";
+        }
+        else if(character == '?')
+        {
+            regex += '.';
+        }
+        else if(character == '[')
+        {
+            size_t end = glob.find(']', i + 2);
+            if(end == std::string_view::npos)
+            {
+                regex += "\\[";
+                continue;
+            }
+            std::string_view set = glob.substr(i + 1, end - i - 1);
+            regex += '[';
+            if(set[0] == '!')
+            {
+                regex += '^';
+                set.remove_prefix(1);
+            }
+            for(char member : set)
+            {
+                if(member == '\\' || member == '[')
+                    regex += '\\';
+                regex += member;
+            }
+            regex += ']';
+            i = end;
+        }
+        else
+        {
+            if(std::string_view("\\^$.|+(){}[]").find(character) != std::string_view::npos)
+                regex += '\\';
+            regex += character;
+        }
+    }
+    return regex;
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <ctime>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <vector>
+#include "Regex.h"
+#include "RegexMatcher.h"
+
+/**
+ * @class FindQuery
+ * @brief Compiled find query, a conjunction of terms evaluated on directory entries.
+ *
+ * The query is a list of terms separated by spaces, all of them have to hold, ! in front of a term negates it:
+ *   name:GLOB        the file name matches the glob (* ? [...])
+ *   re:REGEX         a part of the file name matches the regular expression
+ *   type:f,d,l,p,s,c,b  the type is one of the listed ones
+ *   size:>10M size:<1k size:1M..2G size:4096   the size in bytes, k M G T are powers of 1024
+ *   mtime:<7d mtime:>1w atime:<2h   modified or accessed less or more than the age ago, units s m h d w
+ *   user:NAME group:NAME   the owner, names or numeric ids
+ *   perm:644 perm:-600 perm:+111   the permission bits are exactly, all of or any of the octal bits
+ *   links:>1         the number of hard links, the same comparisons as size
+ *
+ * Terms are evaluated from the cheapest one: names first, then the type the directory reports,
+ * statx is called only when a term needs the status and then once for all the fields the query uses.
+ */
+class FindQuery
+{
+public:
+    /**
+     * @brief A directory entry the query is evaluated on.
+     */
+    struct Candidate
+    {
+        int directoryDescriptor; /**< The open directory of the entry. */
+        const char *name; /**< The name of the entry. */
+        unsigned char directoryType; /**< The type from readdir, DT_UNKNOWN if the filesystem does not report it. */
+        bool hasStatus = false; /**< True once status is filled in. */
+        struct statx status; /**< The status, filled in on demand. */
+    };
+
+    /**
+     * @brief Compiles the query.
+     * @param query The query.
+     * @throws std::runtime_error If the query is empty or a term is invalid.
+     */
+    FindQuery(const std::string &query);
+
+    /**
+     * @brief The matchers of the name patterns of one thread, the query itself is shared by the threads.
+     */
+    using Matchers = std::vector<RegexMatcher>;
+
+    /**
+     * @brief Creates the matchers a thread evaluates the query with.
+     * @return The matchers.
+     */
+    Matchers createMatchers() const;
+
+    /**
+     * @brief Evaluates the query.
+     * @param candidate The entry, its status is filled in if the query needs it.
+     * @param matchers The matchers of the calling thread, see createMatchers().
+     * @return True if all the terms hold.
+     */
+    bool matches(Candidate &candidate, Matchers &matchers) const;
+
+    /**
+     * @brief Fills in the status of the entry unless it is filled in already.
+     * @param candidate The entry.
+     * @param mask The statx fields needed.
+     * @return False if the entry cannot be stat-ed.
+     */
+    static bool ensureStatus(Candidate &candidate, unsigned int mask);
+
+    /**
+     * @brief Tells if the entry is a directory, calls statx only if readdir did not tell.
+     * @param candidate The entry.
+     * @return True for a directory, symbolic links are never followed.
+     */
+    static bool isDirectory(Candidate &candidate);
+
+private:
+    /**
+     * @brief Kind of a term.
+     */
+    enum Kind
+    {
+        NAME_GLOB, /**< name: */
+        NAME_REGEX, /**< re: */
+        TYPE, /**< type: */
+        SIZE, /**< size: */
+        MODIFIED, /**< mtime: */
+        ACCESSED, /**< atime: */
+        USER, /**< user: */
+        GROUP, /**< group: */
+        PERMISSIONS, /**< perm: */
+        LINKS /**< links: */
+    };
+
+    /**
+     * @brief How a permission term compares the bits.
+     */
+    enum PermissionMatch
+    {
+        EXACT, /**< The bits are exactly the given ones. */
+        ALL, /**< All the given bits are set. */
+        ANY /**< Some of the given bits are set. */
+    };
+
+    /**
+     * @brief One compiled term.
+     */
+    struct Term
+    {
+        Kind kind; /**< What the term checks. */
+        bool isNegated = false; /**< True if the term has to fail. */
+        int cost = 0; /**< 0 name only, 1 type from readdir, 2 status. */
+        size_t regexIndex = 0; /**< The compiled pattern of a name term. */
+        std::string types; /**< The allowed type letters of a type term. */
+        uint64_t minimum = 0; /**< The smallest allowed value of a range term. */
+        uint64_t maximum = UINT64_MAX; /**< The largest allowed value of a range term. */
+        uint32_t identifier = 0; /**< The user or group id. */
+        uint32_t permissions = 0; /**< The permission bits. */
+        PermissionMatch permissionMatch = EXACT; /**< How the permission bits are compared. */
+    };
+
+    std::vector<Term> m_terms; /**< The terms, the cheapest first. */
+    std::vector<std::unique_ptr<Regex>> m_regexes; /**< The compiled patterns of the name terms. */
+    std::vector<RegexMatcher::Mode> m_regexModes; /**< The way every pattern is matched. */
+    unsigned int m_statusMask; /**< The statx fields the terms need. */
+    time_t m_now; /**< The time the query was compiled, ages are measured from it. */
+
+    /**
+     * @brief Evaluates one term, without its negation.
+     * @param term The term.
+     * @param candidate The entry.
+     * @param matchers The matchers of the calling thread.
+     * @return True if the term holds.
+     */
+    bool evaluate(const Term &term, Candidate &candidate, Matchers &matchers) const;
+
+    /**
+     * @brief Parses one term.
+     * @param text The term without the negation.
+     * @return The term.
+     * @throws std::runtime_error If the term is invalid.
+     */
+    Term parseTerm(std::string_view text);
+
+    /**
+     * @brief Parses a number with an optional unit suffix.
+     * @param text The number.
+     * @param isAge True for ages with units s m h d w, false for sizes with units k M G T.
+     * @return The value, in bytes or seconds.
+     * @throws std::runtime_error If the number is invalid.
+     */
+    static uint64_t parseNumber(std::string_view text, bool isAge);
+
+    /**
+     * @brief Parses a comparison: >N, <N, N..M or N.
+     * @param text The comparison.
+     * @param isAge True for ages, false for sizes and counts.
+     * @param term The term whose minimum and maximum are set.
+     * @throws std::runtime_error If the comparison is invalid.
+     */
+    static void parseRange(std::string_view text, bool isAge, Term &term);
+
+    /**
+     * @brief Converts a glob to a regular expression matching whole names.
+     * @param glob The glob.
+     * @return The regular expression.
+     */
+    static std::string globToRegex(std::string_view glob);
+};
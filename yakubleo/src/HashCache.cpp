@@ -0,0 +1,268 @@
+#include "HashCache.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr char magic[8] = {'Y', 'K', 'H', 'C', 'A', 'C', 'H', '3'};
+
+    int64_t nanoseconds(const struct timespec &time)
+    {
+        return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+}
+
+HashCache::HashCache() : HashCache(defaultStorePath())
+{
+}
+
+HashCache::HashCache(const fs::path &storePath) : m_storePath(storePath), m_isModified(false), m_hits(0), m_lookups(0), m_bytesHashed(0)
+{
+    load();
+}
+
+HashCache::~HashCache()
+{
+    try
+    {
+        save();
+    }
+    catch(const std::exception &e)
+    {
+        // The cache only saves time, losing it is harmless
+    }
+}
+
+ContentHash HashCache::hash(const fs::path &path, const struct stat &status, Kind kind)
+{
+    uint32_t flag = (kind == ENDS) ? m_hasEnds : m_hasFull;
+    m_lookups++;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Record *record = findValid(status);
+        if(record && (record->flags & flag))
+        {
+            m_hits++;
+            return (kind == ENDS) ? record->endsHash : record->fullHash;
+        }
+    }
+
+    ContentHash hash;
+    if(kind == ENDS)
+    {
+        hash = FileContents::hashEnds(path, status.st_size);
+        m_bytesHashed += std::min<uintmax_t>(status.st_size, 2 * FileContents::endSize);
+    }
+    else
+    {
+        hash = FileContents::hash(path);
+        m_bytesHashed += status.st_size;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Record *record = findValid(status);
+    if(!record)
+    {
+        Record fresh{};
+        fresh.device = status.st_dev;
+        fresh.inode = status.st_ino;
+        fresh.size = status.st_size;
+        fresh.modificationTime = nanoseconds(status.st_mtim);
+        fresh.changeTime = nanoseconds(status.st_ctim);
+        fresh.lastUsed = std::time(nullptr);
+        record = &(m_records[{fresh.device, fresh.inode}] = fresh);
+    }
+
+    if(kind == ENDS)
+        record->endsHash = hash;
+    else
+        record->fullHash = hash;
+    record->flags |= flag;
+    m_isModified = true;
+    return hash;
+}
+
+bool HashCache::isVerified(const struct stat &first, const struct stat &second)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Record *firstRecord = findValid(first);
+    Record *secondRecord = findValid(second);
+    return isPartner(firstRecord, second) || isPartner(secondRecord, first);
+}
+
+void HashCache::setVerified(const struct stat &first, const struct stat &second)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const struct stat *statuses[2] = {&first, &second};
+    for(int i = 0; i < 2; i++)
+    {
+        Record *record = findValid(*statuses[i]);
+        const struct stat &partner = *statuses[1 - i];
+        if(!record || isPartner(record, partner))
+            continue;
+        record->partnerDevice = partner.st_dev;
+        record->partnerInode = partner.st_ino;
+        record->partnerChangeTime = nanoseconds(partner.st_ctim);
+        record->flags |= m_verified;
+        m_isModified = true;
+    }
+}
+
+void HashCache::save()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_storePath.empty() || !m_isModified)
+    {
+        return;
+    }
+
+    fs::create_directories(m_storePath.parent_path());
+    fs::path temporaryPath = m_storePath;
+    temporaryPath += ".tmp";
+
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        if(!output.is_open())
+        {
+            throw std::runtime_error("Could not write hash cache " + temporaryPath.string());
+        }
+
+        uint64_t count = m_records.size();
+        output.write(magic, sizeof(magic));
+        output.write(reinterpret_cast<const char *>(&count), sizeof(count));
+        for(const auto& [key, record] : m_records)
+        {
+            output.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        }
+        if(!output)
+        {
+            throw std::runtime_error("Could not write hash cache " + temporaryPath.string());
+        }
+    }
+
+    fs::rename(temporaryPath, m_storePath);
+    m_isModified = false;
+}
+
+size_t HashCache::hitCount() const
+{
+    return m_hits;
+}
+
+size_t HashCache::lookupCount() const
+{
+    return m_lookups;
+}
+
+uintmax_t HashCache::bytesHashed() const
+{
+    return m_bytesHashed;
+}
+
+void HashCache::resetStatistics()
+{
+    m_hits = 0;
+    m_lookups = 0;
+    m_bytesHashed = 0;
+}
+
+fs::path HashCache::defaultStorePath()
+{
+    if(const char *cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome)
+    {
+        return fs::path(cacheHome) / "yakubleo" / "hashes";
+    }
+    if(const char *home = std::getenv("HOME"); home && *home)
+    {
+        return fs::path(home) / ".cache" / "yakubleo" / "hashes";
+    }
+    return fs::path();
+}
+
+void HashCache::load()
+{
+    if(m_storePath.empty())
+    {
+        return;
+    }
+
+    int descriptor = ::open(m_storePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(descriptor < 0)
+    {
+        return;
+    }
+
+    struct stat status;
+    const size_t headerSize = sizeof(magic) + sizeof(uint64_t);
+    if(::fstat(descriptor, &status) != 0 || size_t(status.st_size) < headerSize)
+    {
+        ::close(descriptor);
+        return;
+    }
+
+    void *mapping = ::mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if(mapping == MAP_FAILED)
+    {
+        return;
+    }
+
+    const char *data = static_cast<const char *>(mapping);
+    uint64_t count;
+    std::memcpy(&count, data + sizeof(magic), sizeof(count));
+    if(std::memcmp(data, magic, sizeof(magic)) == 0 && (status.st_size - headerSize) / sizeof(Record) >= count)
+    {
+        // Files are not stated here, the entries of deleted files are only recognized by not being used
+        int64_t oldest = std::time(nullptr) - maximalIdleTime;
+        m_records.reserve(count);
+        for(uint64_t i = 0; i < count; i++)
+        {
+            Record record;
+            std::memcpy(&record, data + headerSize + i * sizeof(Record), sizeof(Record));
+            if(record.lastUsed < oldest)
+                m_isModified = true;
+            else
+                m_records.emplace(std::make_pair(record.device, record.inode), record);
+        }
+    }
+    ::munmap(mapping, status.st_size);
+}
+
+HashCache::Record *HashCache::findValid(const struct stat &status)
+{
+    auto found = m_records.find({uint64_t(status.st_dev), uint64_t(status.st_ino)});
+    if(found == m_records.end())
+    {
+        return nullptr;
+    }
+
+    Record &record = found->second;
+    if(record.size != uint64_t(status.st_size) || record.modificationTime != nanoseconds(status.st_mtim) || record.changeTime != nanoseconds(status.st_ctim))
+    {
+        m_records.erase(found);
+        m_isModified = true;
+        return nullptr;
+    }
+
+    // The time of use is written at most once a day, looking up an unchanged tree keeps the cache clean
+    int64_t now = std::time(nullptr);
+    if(now - record.lastUsed > 24 * 60 * 60)
+    {
+        record.lastUsed = now;
+        m_isModified = true;
+    }
+    return &record;
+}
+
+bool HashCache::isPartner(const Record *record, const struct stat &partner)
+{
+    return record && (record->flags & m_verified) && record->partnerDevice == uint64_t(partner.st_dev)
+        && record->partnerInode == uint64_t(partner.st_ino) && record->partnerChangeTime == nanoseconds(partner.st_ctim);
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <sys/stat.h>
+#include <unordered_map>
+#include "FileContents.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @class HashCache
+ * @brief Persistent cache of content hashes keyed by the device and inode of the file.
+ *
+ * An entry is valid only while the size, the modification time and the change time of the file stay the same,
+ * so edited, truncated or replaced files are hashed again automatically. Entries not looked up for maximalIdleTime,
+ * mostly of files deleted meanwhile, are dropped when the cache is loaded.
+ * The cache is stored as a flat array of fixed size records, it is memory mapped when loaded
+ * and written to a temporary file renamed over the old one when saved.
+ */
+class HashCache
+{
+public:
+    /**
+     * @brief Kind of the cached hash.
+     */
+    enum Kind
+    {
+        ENDS, /**< FileContents::hashEnds() */
+        FULL /**< FileContents::hash() */
+    };
+
+    /**
+     * @brief Constructor. Loads the cache from the default location, $XDG_CACHE_HOME/yakubleo or ~/.cache/yakubleo.
+     */
+    HashCache();
+
+    /**
+     * @brief Constructor. Loads the cache from the file, an empty path keeps the cache in memory only.
+     * @param storePath The file the cache is stored in.
+     */
+    HashCache(const fs::path &storePath);
+
+    /**
+     * @brief Destructor. Saves the cache, errors are ignored.
+     */
+    ~HashCache();
+
+    HashCache(const HashCache &) = delete;
+    HashCache &operator=(const HashCache &) = delete;
+
+    /**
+     * @brief Gets the hash of the file from the cache or computes and stores it.
+     * @param path The path to the file.
+     * @param status The status of the file, obtained by stat.
+     * @param kind The kind of the hash.
+     * @return The hash.
+     * @throws std::runtime_error If the hash has to be computed and the file cannot be read.
+     */
+    ContentHash hash(const fs::path &path, const struct stat &status, Kind kind);
+
+    /**
+     * @brief How long an entry stays in the cache without being looked up, in seconds.
+     */
+    static constexpr int64_t maximalIdleTime = 90 * 24 * 60 * 60;
+
+    /**
+     * @brief Tells if the two files were confirmed byte by byte to be equal and neither changed since.
+     * @param first The status of one file.
+     * @param second The status of the other file.
+     * @return True if the entry of one of them records the comparison with the other one as it is now.
+     */
+    bool isVerified(const struct stat &first, const struct stat &second);
+
+    /**
+     * @brief Records that the two files were confirmed byte by byte to be equal.
+     * @param first The status of one file.
+     * @param second The status of the other file.
+     */
+    void setVerified(const struct stat &first, const struct stat &second);
+
+    /**
+     * @brief Writes the cache to its file.
+     * @throws std::runtime_error If the file cannot be written.
+     */
+    void save();
+
+    /**
+     * @brief Gets the number of lookups answered from the cache since the counters were reset.
+     */
+    size_t hitCount() const;
+
+    /**
+     * @brief Gets the number of lookups since the counters were reset.
+     */
+    size_t lookupCount() const;
+
+    /**
+     * @brief Gets the number of bytes read to compute hashes that were not in the cache.
+     */
+    uintmax_t bytesHashed() const;
+
+    /**
+     * @brief Sets all the counters to zero.
+     */
+    void resetStatistics();
+
+private:
+    /**
+     * @brief One entry of the cache, also the layout of a record in the stored file.
+     */
+    struct Record
+    {
+        uint64_t device; /**< The device of the file. */
+        uint64_t inode; /**< The inode of the file. */
+        uint64_t size; /**< The size of the file when it was hashed. */
+        int64_t modificationTime; /**< The modification time in nanoseconds when it was hashed. */
+        int64_t changeTime; /**< The change time in nanoseconds when it was hashed. */
+        ContentHash endsHash; /**< The hash of the ends of the file. */
+        ContentHash fullHash; /**< The hash of the whole file. */
+        uint64_t partnerDevice; /**< The device of the file it was confirmed equal to. */
+        uint64_t partnerInode; /**< The inode of the file it was confirmed equal to. */
+        int64_t partnerChangeTime; /**< The change time of that file in nanoseconds when they were compared. */
+        int64_t lastUsed; /**< When the entry was last looked up, in seconds since the epoch. */
+        uint32_t flags; /**< Which hashes are valid and if the partner is. */
+        uint32_t reserved; /**< Padding, always zero. */
+    };
+
+    /**
+     * @brief Hash functor of the (device, inode) key.
+     */
+    struct KeyHasher
+    {
+        size_t operator()(const std::pair<uint64_t, uint64_t> &key) const
+        {
+            return key.first * 0x9E3779B97F4A7C15ULL ^ key.second;
+        }
+    };
+
+    static constexpr uint32_t m_hasEnds = 1; /**< Flag of a valid endsHash. */
+    static constexpr uint32_t m_hasFull = 2; /**< Flag of a valid fullHash. */
+    static constexpr uint32_t m_verified = 4; /**< Flag of a valid partner, a file confirmed to be a duplicate. */
+
+    fs::path m_storePath; /**< The file the cache is stored in, empty for an in-memory cache. */
+    std::unordered_map<std::pair<uint64_t, uint64_t>, Record, KeyHasher> m_records; /**< The entries. */
+    std::mutex m_mutex; /**< Guards the entries. */
+    bool m_isModified; /**< True if there are unsaved changes. */
+
+    std::atomic<size_t> m_hits; /**< Lookups answered from the cache. */
+    std::atomic<size_t> m_lookups; /**< All lookups. */
+    std::atomic<uintmax_t> m_bytesHashed; /**< Bytes read on cache misses. */
+
+    /**
+     * @brief Gets the default location of the store.
+     * @return The path, empty if there is no home directory.
+     */
+    static fs::path defaultStorePath();
+
+    /**
+     * @brief Reads the stored file, a missing or damaged file leaves the cache empty.
+     */
+    void load();
+
+    /**
+     * @brief Tells if the entry records the comparison with the file as it is now.
+     * @param record The entry, may be nullptr.
+     * @param partner The status of the other file.
+     * @return True if the file is the partner of the entry and did not change since they were compared.
+     */
+    static bool isPartner(const Record *record, const struct stat &partner);
+
+    /**
+     * @brief Finds the valid entry of the file.
+     * @param status The status of the file.
+     * @return The entry, nullptr if there is none or it is stale. Has to be called with m_mutex locked.
+     */
+    Record *findValid(const struct stat &status);
+};
@@ -0,0 +1,630 @@
+#include "MetadataIndex.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr char magic[8] = {'Y', 'K', 'I', 'N', 'D', 'E', 'X', '1'};
+
+    /**
+     * @brief The fixed part of the file after the magic, all offsets are from the start of the file.
+     */
+    struct Header
+    {
+        uint64_t entryCount;
+        uint64_t rootsOffset;
+        uint64_t rootCount;
+        uint64_t blockOffsetsOffset;
+        uint64_t blockCount;
+        uint64_t recordsOffset;
+        uint64_t recordsSize;
+        uint64_t trigramsOffset;
+        uint64_t trigramCount;
+        uint64_t postingsOffset;
+        uint64_t postingsSize;
+    };
+
+    int64_t nanoseconds(const struct timespec &time)
+    {
+        return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+
+    char typeOf(mode_t mode)
+    {
+        if(S_ISREG(mode))
+            return 'F';
+        if(S_ISDIR(mode))
+            return 'D';
+        if(S_ISLNK(mode))
+            return 'S';
+        return 'O';
+    }
+
+    std::string lowercase(std::string_view text)
+    {
+        std::string result(text);
+        for(char &character : result)
+        {
+            if(character >= 'A' && character <= 'Z')
+                character += 'a' - 'A';
+        }
+        return result;
+    }
+
+    std::string_view fileName(std::string_view path)
+    {
+        size_t slash = path.find_last_of('/');
+        if(slash == std::string_view::npos || path.size() == 1)
+            return path;
+        return path.substr(slash + 1);
+    }
+
+    uint32_t trigramKey(const char *bytes)
+    {
+        return (uint32_t(uint8_t(bytes[0])) << 16) | (uint32_t(uint8_t(bytes[1])) << 8) | uint8_t(bytes[2]);
+    }
+
+    void appendVarint(std::string &output, uint64_t value)
+    {
+        while(value >= 0x80)
+        {
+            output.push_back(char(value | 0x80));
+            value >>= 7;
+        }
+        output.push_back(char(value));
+    }
+
+    /**
+     * @brief Reads variable length integers and bytes, a damaged file stops it instead of reading past the end.
+     */
+    class Reader
+    {
+    public:
+        Reader(const uint8_t *position, const uint8_t *end) : m_position(position), m_end(end)
+        {
+        }
+
+        uint64_t varint()
+        {
+            uint64_t value = 0;
+            for(int shift = 0; shift < 64; shift += 7)
+            {
+                if(m_position == m_end)
+                    throw std::runtime_error("Damaged index");
+                uint8_t byte = *m_position++;
+                value |= uint64_t(byte & 0x7F) << shift;
+                if(!(byte & 0x80))
+                    return value;
+            }
+            throw std::runtime_error("Damaged index");
+        }
+
+        const uint8_t *bytes(uint64_t count)
+        {
+            if(uint64_t(m_end - m_position) < count)
+                throw std::runtime_error("Damaged index");
+            const uint8_t *start = m_position;
+            m_position += count;
+            return start;
+        }
+
+    private:
+        const uint8_t *m_position;
+        const uint8_t *m_end;
+    };
+}
+
+MetadataIndex::MetadataIndex() : MetadataIndex(defaultStorePath())
+{
+}
+
+MetadataIndex::MetadataIndex(const fs::path &storePath) : m_storePath(storePath), m_data(nullptr), m_dataSize(0), m_entryCount(0),
+    m_records(nullptr), m_recordsEnd(nullptr), m_blockOffsets(nullptr), m_trigrams(nullptr), m_trigramCount(0), m_postings(nullptr), m_postingsEnd(nullptr)
+{
+    load();
+}
+
+MetadataIndex::~MetadataIndex()
+{
+    unload();
+}
+
+const std::vector<fs::path> &MetadataIndex::getRoots() const
+{
+    return m_roots;
+}
+
+uint64_t MetadataIndex::size() const
+{
+    return m_entryCount;
+}
+
+IndexStatistics MetadataIndex::addRoot(const fs::path &root)
+{
+    fs::path absoluteRoot = fs::absolute(root).lexically_normal();
+    if(!absoluteRoot.has_filename() && absoluteRoot != absoluteRoot.root_path())
+        absoluteRoot = absoluteRoot.parent_path();
+
+    auto isInside = [](const fs::path &path, const fs::path &directory)
+    {
+        std::string relative = path.lexically_relative(directory).string();
+        return !relative.empty() && relative.compare(0, 2, "..") != 0;
+    };
+
+    for(const auto& indexedRoot : m_roots)
+    {
+        if(isInside(absoluteRoot, indexedRoot))
+            return update(m_roots);
+    }
+
+    // Roots below the new one become a part of it
+    std::vector<fs::path> roots;
+    for(const auto& indexedRoot : m_roots)
+    {
+        if(!isInside(indexedRoot, absoluteRoot))
+            roots.push_back(indexedRoot);
+    }
+    roots.push_back(absoluteRoot);
+    return update(roots);
+}
+
+IndexStatistics MetadataIndex::update(const std::vector<fs::path> &roots)
+{
+    // Directories of the previous index, their entries are reused when they did not change
+    std::unordered_map<std::string, uint64_t> previous;
+    decode(0, m_entryCount, [&](uint64_t number, const BuildRecord &record)
+    {
+        if(record.type == 'D')
+            previous.emplace(record.path, number);
+        return true;
+    });
+
+    IndexStatistics statistics;
+    std::vector<BuildRecord> records;
+    std::vector<fs::path> indexedRoots;
+    for(const auto& root : roots)
+    {
+        struct stat status;
+        if(::stat(root.c_str(), &status) != 0 || !S_ISDIR(status.st_mode))
+            continue;
+
+        indexedRoots.push_back(root);
+        size_t rootRecord = records.size();
+        records.push_back(BuildRecord{root.string(), 'D', uint64_t(status.st_size), nanoseconds(status.st_mtim), 0});
+        indexDirectory(rootRecord, previous, records, statistics);
+        records[rootRecord].subtreeCount = records.size() - rootRecord - 1;
+    }
+
+    write(records, indexedRoots);
+    unload();
+    load();
+
+    statistics.entryCount = records.size();
+    return statistics;
+}
+
+std::vector<IndexEntry> MetadataIndex::search(const std::string &query, size_t limit) const
+{
+    std::vector<IndexEntry> result;
+    if(query.empty() || limit == 0)
+    {
+        return result;
+    }
+    std::string needle = lowercase(query);
+
+    auto check = [&](uint64_t number, const BuildRecord &record)
+    {
+        if(lowercase(fileName(record.path)).find(needle) != std::string::npos)
+            result.push_back(IndexEntry{record.path, record.type, record.size, record.modified});
+        return result.size() < limit;
+    };
+
+    // Queries too short for a trigram check every record
+    if(needle.size() < 3)
+    {
+        decode(0, m_entryCount, check);
+        return result;
+    }
+
+    std::vector<const Trigram *> lists;
+    for(size_t i = 0; i + 3 <= needle.size(); i++)
+    {
+        uint32_t key = trigramKey(needle.data() + i);
+        const Trigram *found = std::lower_bound(m_trigrams, m_trigrams + m_trigramCount, key, [](const Trigram &trigram, uint32_t value)
+        {
+            return trigram.key < value;
+        });
+        if(found == m_trigrams + m_trigramCount || found->key != key)
+            return result;
+        lists.push_back(found);
+    }
+    std::sort(lists.begin(), lists.end(), [](const Trigram *first, const Trigram *second)
+    {
+        return first->count != second->count ? first->count < second->count : first < second;
+    });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+    auto readList = [this](const Trigram *trigram)
+    {
+        std::vector<uint64_t> numbers(trigram->count);
+        Reader reader(m_postings + trigram->offset, m_postingsEnd);
+        uint64_t number = 0;
+        for(auto& value : numbers)
+        {
+            number += reader.varint();
+            value = number;
+        }
+        return numbers;
+    };
+
+    // The shortest lists first, checking a few candidates is cheaper than reading a long list
+    std::vector<uint64_t> candidates = readList(lists.front());
+    for(size_t i = 1; i < lists.size() && candidates.size() > m_blockSize; i++)
+    {
+        std::vector<uint64_t> other = readList(lists[i]);
+        std::vector<uint64_t> common;
+        std::set_intersection(candidates.begin(), candidates.end(), other.begin(), other.end(), std::back_inserter(common));
+        candidates.swap(common);
+    }
+
+    for(uint64_t candidate : candidates)
+    {
+        bool isFull = false;
+        decode(candidate, candidate + 1, [&](uint64_t number, const BuildRecord &record)
+        {
+            isFull = !check(number, record);
+            return true;
+        });
+        if(isFull)
+            break;
+    }
+    return result;
+}
+
+void MetadataIndex::load()
+{
+    m_roots.clear();
+    if(m_storePath.empty())
+    {
+        return;
+    }
+
+    int descriptor = ::open(m_storePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(descriptor < 0)
+    {
+        return;
+    }
+
+    struct stat status;
+    if(::fstat(descriptor, &status) != 0 || size_t(status.st_size) < sizeof(magic) + sizeof(Header))
+    {
+        ::close(descriptor);
+        return;
+    }
+
+    void *mapping = ::mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    ::close(descriptor);
+    if(mapping == MAP_FAILED)
+    {
+        return;
+    }
+    m_data = static_cast<const uint8_t *>(mapping);
+    m_dataSize = status.st_size;
+
+    Header header;
+    std::memcpy(&header, m_data + sizeof(magic), sizeof(header));
+    auto fits = [this](uint64_t offset, uint64_t count, uint64_t elementSize)
+    {
+        return offset <= m_dataSize && count <= (m_dataSize - offset) / elementSize;
+    };
+    if(std::memcmp(m_data, magic, sizeof(magic)) != 0 || !fits(header.blockOffsetsOffset, header.blockCount, sizeof(uint64_t))
+        || !fits(header.recordsOffset, header.recordsSize, 1) || !fits(header.trigramsOffset, header.trigramCount, sizeof(Trigram))
+        || !fits(header.postingsOffset, header.postingsSize, 1) || header.blockOffsetsOffset % alignof(uint64_t) != 0
+        || header.trigramsOffset % alignof(Trigram) != 0 || header.blockCount != (header.entryCount + m_blockSize - 1) / m_blockSize)
+    {
+        unload();
+        return;
+    }
+
+    try
+    {
+        Reader reader(m_data + header.rootsOffset, m_data + m_dataSize);
+        for(uint64_t i = 0; i < header.rootCount; i++)
+        {
+            uint64_t length = reader.varint();
+            const uint8_t *bytes = reader.bytes(length);
+            m_roots.emplace_back(std::string(reinterpret_cast<const char *>(bytes), length));
+        }
+    }
+    catch(const std::exception &e)
+    {
+        unload();
+        return;
+    }
+
+    m_entryCount = header.entryCount;
+    m_blockOffsets = reinterpret_cast<const uint64_t *>(m_data + header.blockOffsetsOffset);
+    m_records = m_data + header.recordsOffset;
+    m_recordsEnd = m_records + header.recordsSize;
+    m_trigrams = reinterpret_cast<const Trigram *>(m_data + header.trigramsOffset);
+    m_trigramCount = header.trigramCount;
+    m_postings = m_data + header.postingsOffset;
+    m_postingsEnd = m_postings + header.postingsSize;
+}
+
+void MetadataIndex::unload()
+{
+    if(m_data)
+    {
+        ::munmap(const_cast<uint8_t *>(m_data), m_dataSize);
+    }
+    m_data = nullptr;
+    m_dataSize = 0;
+    m_entryCount = 0;
+    m_records = m_recordsEnd = nullptr;
+    m_blockOffsets = nullptr;
+    m_trigrams = nullptr;
+    m_trigramCount = 0;
+    m_postings = m_postingsEnd = nullptr;
+    m_roots.clear();
+}
+
+template<typename Function>
+void MetadataIndex::decode(uint64_t first, uint64_t last, Function function) const
+{
+    last = std::min(last, m_entryCount);
+    if(first >= last)
+    {
+        return;
+    }
+
+    try
+    {
+        uint64_t number = first - first % m_blockSize;
+        if(m_blockOffsets[number / m_blockSize] > uint64_t(m_recordsEnd - m_records))
+            throw std::runtime_error("Damaged index");
+        Reader reader(m_records + m_blockOffsets[number / m_blockSize], m_recordsEnd);
+
+        BuildRecord record{"", 'O', 0, 0, 0};
+        for(; number < last; number++)
+        {
+            uint64_t shared = reader.varint();
+            uint64_t suffixLength = reader.varint();
+            if(shared > record.path.size())
+                throw std::runtime_error("Damaged index");
+            record.path.resize(shared);
+            record.path.append(reinterpret_cast<const char *>(reader.bytes(suffixLength)), suffixLength);
+            record.type = char(*reader.bytes(1));
+            record.size = reader.varint();
+            record.modified = int64_t(reader.varint());
+            record.subtreeCount = reader.varint();
+
+            if(number >= first && !function(number, record))
+                return;
+        }
+    }
+    catch(const std::exception &e)
+    {
+        // A damaged index only loses the rest of the records
+    }
+}
+
+void MetadataIndex::indexDirectory(size_t directory, const std::unordered_map<std::string, uint64_t> &previous,
+    std::vector<BuildRecord> &records, IndexStatistics &statistics) const
+{
+    std::string directoryPath = records[directory].path;
+    std::string prefix = directoryPath.back() == '/' ? directoryPath : directoryPath + "/";
+    std::vector<BuildRecord> entries;
+
+    auto found = previous.find(directoryPath);
+    BuildRecord old{"", 'O', 0, 0, 0};
+    if(found != previous.end())
+    {
+        decode(found->second, found->second + 1, [&](uint64_t, const BuildRecord &record)
+        {
+            old = record;
+            return true;
+        });
+    }
+
+    if(found != previous.end() && old.modified == records[directory].modified)
+    {
+        // Nothing was added, removed or renamed here, the entries are the same as before
+        statistics.directoriesReused++;
+        uint64_t end = found->second + 1 + old.subtreeCount;
+        uint64_t next = found->second + 1;
+        while(next < end)
+        {
+            // Decoding restarts behind large subdirectories instead of going through them
+            uint64_t resume = end;
+            decode(next, end, [&](uint64_t number, const BuildRecord &record)
+            {
+                if(number != next)
+                    return true;
+                next = number + 1 + record.subtreeCount;
+                entries.push_back(BuildRecord{record.path, record.type, record.size, record.modified, 0});
+                if(record.subtreeCount > m_blockSize)
+                {
+                    resume = next;
+                    return false;
+                }
+                return true;
+            });
+            if(resume == end)
+                break;
+        }
+
+        // Subdirectories may have changed even if this one did not
+        for(auto& entry : entries)
+        {
+            struct stat status;
+            if(entry.type == 'D' && ::lstat(entry.path.c_str(), &status) == 0)
+                entry.modified = nanoseconds(status.st_mtim);
+        }
+    }
+    else
+    {
+        statistics.directoriesRead++;
+        DIR *stream = ::opendir(directoryPath.c_str());
+        if(!stream)
+        {
+            return;
+        }
+
+        int descriptor = ::dirfd(stream);
+        while(dirent *entry = ::readdir(stream))
+        {
+            if(std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+                continue;
+
+            struct stat status;
+            if(::fstatat(descriptor, entry->d_name, &status, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            entries.push_back(BuildRecord{prefix + entry->d_name, typeOf(status.st_mode), uint64_t(status.st_size), nanoseconds(status.st_mtim), 0});
+        }
+        ::closedir(stream);
+
+        std::sort(entries.begin(), entries.end(), [](const BuildRecord &first, const BuildRecord &second) { return first.path < second.path; });
+    }
+
+    for(auto& entry : entries)
+    {
+        size_t record = records.size();
+        records.push_back(std::move(entry));
+        if(records[record].type == 'D')
+        {
+            indexDirectory(record, previous, records, statistics);
+            records[record].subtreeCount = records.size() - record - 1;
+        }
+    }
+}
+
+void MetadataIndex::write(const std::vector<BuildRecord> &records, const std::vector<fs::path> &roots) const
+{
+    if(m_storePath.empty())
+    {
+        throw std::runtime_error("There is no location to store the index in");
+    }
+
+    std::string rootsData;
+    for(const auto& root : roots)
+    {
+        appendVarint(rootsData, root.string().size());
+        rootsData += root.string();
+    }
+
+    std::string recordsData;
+    std::vector<uint64_t> blockOffsets;
+    std::map<uint32_t, std::vector<uint64_t>> trigramLists;
+    const std::string *previousPath = nullptr;
+    for(uint64_t number = 0; number < records.size(); number++)
+    {
+        const BuildRecord &record = records[number];
+        uint64_t shared = 0;
+        if(number % m_blockSize == 0)
+        {
+            blockOffsets.push_back(recordsData.size());
+        }
+        else
+        {
+            size_t limit = std::min(previousPath->size(), record.path.size());
+            while(shared < limit && (*previousPath)[shared] == record.path[shared])
+                shared++;
+        }
+
+        appendVarint(recordsData, shared);
+        appendVarint(recordsData, record.path.size() - shared);
+        recordsData.append(record.path, shared, std::string::npos);
+        recordsData.push_back(record.type);
+        appendVarint(recordsData, record.size);
+        appendVarint(recordsData, uint64_t(record.modified));
+        appendVarint(recordsData, record.subtreeCount);
+        previousPath = &record.path;
+
+        std::string name = lowercase(fileName(record.path));
+        for(size_t i = 0; i + 3 <= name.size(); i++)
+        {
+            std::vector<uint64_t> &list = trigramLists[trigramKey(name.data() + i)];
+            if(list.empty() || list.back() != number)
+                list.push_back(number);
+        }
+    }
+
+    std::vector<Trigram> trigrams;
+    std::string postingsData;
+    for(const auto& [key, list] : trigramLists)
+    {
+        trigrams.push_back(Trigram{key, uint32_t(list.size()), postingsData.size()});
+        uint64_t last = 0;
+        for(uint64_t number : list)
+        {
+            appendVarint(postingsData, number - last);
+            last = number;
+        }
+    }
+
+    auto aligned = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+    Header header;
+    header.entryCount = records.size();
+    header.rootsOffset = sizeof(magic) + sizeof(Header);
+    header.rootCount = roots.size();
+    header.blockOffsetsOffset = aligned(header.rootsOffset + rootsData.size());
+    header.blockCount = blockOffsets.size();
+    header.trigramsOffset = header.blockOffsetsOffset + blockOffsets.size() * sizeof(uint64_t);
+    header.trigramCount = trigrams.size();
+    header.recordsOffset = header.trigramsOffset + trigrams.size() * sizeof(Trigram);
+    header.recordsSize = recordsData.size();
+    header.postingsOffset = header.recordsOffset + recordsData.size();
+    header.postingsSize = postingsData.size();
+
+    fs::create_directories(m_storePath.parent_path());
+    fs::path temporaryPath = m_storePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        if(!output.is_open())
+        {
+            throw std::runtime_error("Could not write index " + temporaryPath.string());
+        }
+
+        const char padding[8] = {};
+        output.write(magic, sizeof(magic));
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output.write(rootsData.data(), rootsData.size());
+        output.write(padding, header.blockOffsetsOffset - header.rootsOffset - rootsData.size());
+        output.write(reinterpret_cast<const char *>(blockOffsets.data()), blockOffsets.size() * sizeof(uint64_t));
+        output.write(reinterpret_cast<const char *>(trigrams.data()), trigrams.size() * sizeof(Trigram));
+        output.write(recordsData.data(), recordsData.size());
+        output.write(postingsData.data(), postingsData.size());
+        if(!output)
+        {
+            throw std::runtime_error("Could not write index " + temporaryPath.string());
+        }
+    }
+
+    // The old file stays mapped until it is unloaded, renaming over it does not disturb the mapping
+    fs::rename(temporaryPath, m_storePath);
+}
+
+fs::path MetadataIndex::defaultStorePath()
+{
+    if(const char *cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome)
+    {
+        return fs::path(cacheHome) / "yakubleo" / "index";
+    }
+    if(const char *home = std::getenv("HOME"); home && *home)
+    {
+        return fs::path(home) / ".cache" / "yakubleo" / "index";
+    }
+    return fs::path();
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief A path found in the MetadataIndex.
+ */
+struct IndexEntry
+{
+    fs::path path; /**< The path. */
+    char type; /**< 'F' regular file, 'D' directory, 'S' symbolic link, 'O' other. */
+    uint64_t size; /**< The size when the path was indexed. */
+    int64_t modified; /**< The modification time in nanoseconds when the path was indexed. */
+};
+
+/**
+ * @brief Outcome of updating the MetadataIndex.
+ */
+struct IndexStatistics
+{
+    size_t entryCount = 0; /**< The number of indexed paths. */
+    size_t directoriesRead = 0; /**< Directories whose entries were read from the disk. */
+    size_t directoriesReused = 0; /**< Directories whose entries were taken from the previous index. */
+};
+
+/**
+ * @class MetadataIndex
+ * @brief Persistent index of the paths below configured roots for locate-style name search.
+ *
+ * The paths are stored in depth-first order, front coded against the previous path, in blocks of 64 records,
+ * so any record is decoded from the start of its block. Every trigram of the lowercase file names has a list
+ * of the records containing it, a search intersects the lists of the trigrams of the query and checks only
+ * the records left. The file is memory mapped, opening the index reads nothing else.
+ *
+ * Updating reads again only the directories whose modification time changed, the entries of the others
+ * are taken from the previous index, their subdirectories are still checked.
+ */
+class MetadataIndex
+{
+public:
+    /**
+     * @brief Constructor. Opens the index in the default location, $XDG_CACHE_HOME/yakubleo or ~/.cache/yakubleo.
+     */
+    MetadataIndex();
+
+    /**
+     * @brief Constructor. Opens the index in the file, a missing or damaged file gives an empty index.
+     * @param storePath The file the index is stored in.
+     */
+    MetadataIndex(const fs::path &storePath);
+
+    /**
+     * @brief Destructor. Unmaps the file.
+     */
+    ~MetadataIndex();
+
+    MetadataIndex(const MetadataIndex &) = delete;
+    MetadataIndex &operator=(const MetadataIndex &) = delete;
+
+    /**
+     * @brief Gets the indexed roots.
+     * @return The roots.
+     */
+    const std::vector<fs::path> &getRoots() const;
+
+    /**
+     * @brief Gets the number of indexed paths.
+     * @return The number of paths.
+     */
+    uint64_t size() const;
+
+    /**
+     * @brief Adds a root unless it or a directory above it is indexed already, then updates the index.
+     * @param root The root.
+     * @return The statistics of the update.
+     * @throws std::runtime_error If the index cannot be written.
+     */
+    IndexStatistics addRoot(const fs::path &root);
+
+    /**
+     * @brief Indexes the roots again and replaces the stored index.
+     * @param roots The roots, the roots that no longer exist are dropped.
+     * @return The statistics of the update.
+     * @throws std::runtime_error If the index cannot be written.
+     */
+    IndexStatistics update(const std::vector<fs::path> &roots);
+
+    /**
+     * @brief Finds the paths whose file name contains the query, ignoring the case of ASCII letters.
+     * @param query The query.
+     * @param limit The maximal number of results.
+     * @return The paths in depth-first order.
+     */
+    std::vector<IndexEntry> search(const std::string &query, size_t limit) const;
+
+private:
+    /**
+     * @brief A path while the index is being built.
+     */
+    struct BuildRecord
+    {
+        std::string path; /**< The path. */
+        char type; /**< The type, see IndexEntry. */
+        uint64_t size; /**< The size. */
+        int64_t modified; /**< The modification time in nanoseconds. */
+        uint64_t subtreeCount; /**< The number of records below a directory. */
+    };
+
+    /**
+     * @brief A trigram and its list of records in the file.
+     */
+    struct Trigram
+    {
+        uint32_t key; /**< Three lowercase bytes. */
+        uint32_t count; /**< The number of records in the list. */
+        uint64_t offset; /**< The start of the list in the postings. */
+    };
+
+    static constexpr uint64_t m_blockSize = 64; /**< Records per front coding block. */
+
+    fs::path m_storePath; /**< The file the index is stored in, empty for an in-memory index. */
+    std::vector<fs::path> m_roots; /**< The indexed roots. */
+
+    const uint8_t *m_data; /**< The mapped file, nullptr if there is no index. */
+    size_t m_dataSize; /**< The size of the mapped file. */
+    uint64_t m_entryCount; /**< The number of records. */
+    const uint8_t *m_records; /**< The front coded records. */
+    const uint8_t *m_recordsEnd; /**< The end of the records. */
+    const uint64_t *m_blockOffsets; /**< The start of every block in the records. */
+    const Trigram *m_trigrams; /**< The trigrams sorted by their keys. */
+    uint64_t m_trigramCount; /**< The number of trigrams. */
+    const uint8_t *m_postings; /**< The delta coded record lists. */
+    const uint8_t *m_postingsEnd; /**< The end of the lists. */
+
+    /**
+     * @brief Maps the stored index, leaves the index empty if the file is missing or damaged.
+     */
+    void load();
+
+    /**
+     * @brief Unmaps the stored index.
+     */
+    void unload();
+
+    /**
+     * @brief Decodes the records in [first, last) and calls the function for each of them.
+     * @param first The first record.
+     * @param last The record after the last one.
+     * @param function Called with the number and the contents of every record, returns false to stop.
+     */
+    template<typename Function>
+    void decode(uint64_t first, uint64_t last, Function function) const;
+
+    /**
+     * @brief Indexes the entries of a directory and everything below them.
+     * @param directory The record of the directory.
+     * @param previous The directories of the previous index by their paths.
+     * @param records The records built so far.
+     * @param statistics The statistics of the update.
+     */
+    void indexDirectory(size_t directory, const std::unordered_map<std::string, uint64_t> &previous,
+        std::vector<BuildRecord> &records, IndexStatistics &statistics) const;
+
+    /**
+     * @brief Writes the records, the roots and the trigram lists into the store file.
+     * @param records The records.
+     * @param roots The roots.
+     */
+    void write(const std::vector<BuildRecord> &records, const std::vector<fs::path> &roots) const;
+
+    /**
+     * @brief Gets the default location of the index.
+     * @return The path, empty if there is no home directory.
+     */
+    static fs::path defaultStorePath();
+};
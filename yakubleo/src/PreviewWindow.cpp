@@ -0,0 +1,358 @@
+#include "PreviewWindow.h"
+#include "SmallWindow.h"
+#include <algorithm>
+#include <cstdio>
+#include <poll.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr uint64_t hexRowSize = 16;
+    constexpr size_t tabSize = 8;
+    constexpr size_t horizontalStep = 8;
+
+    int visibleRows()
+    {
+        return LINES > 2 ? LINES - 2 : 1;
+    }
+
+    bool isPrintable(unsigned char character)
+    {
+        // Only ASCII is printed as it is, the terminal locale is not set up for anything else
+        return character >= 0x20 && character < 0x7f;
+    }
+}
+
+PreviewWindow::PreviewWindow(const fs::path &path) : m_path(path), m_title(path.string()), m_isPart(false), m_preview(path),
+    m_top(0), m_column(0), m_isHex(m_preview.isBinary())
+{
+}
+
+PreviewWindow::PreviewWindow(const fs::path &path, uint64_t offset, uint64_t size, const std::string &title) : m_path(path),
+    m_title(title), m_isPart(true), m_preview(path, offset, size), m_top(0), m_column(0), m_isHex(m_preview.isBinary())
+{
+}
+
+void PreviewWindow::show()
+{
+    while(true)
+    {
+        // Another process may have truncated the file under the shown part
+        if(m_top > m_preview.size())
+            scrollToEnd();
+        print();
+
+        int ch = m_follower ? readKeyFollowing() : readKey();
+        m_message.clear();
+        if(m_follower && ch != ERR)
+        {
+            // Changes not shown yet in this frame, a truncation above all, must not be drawn from the old mapping
+            m_follower.reset();
+            followFile();
+            if(ch == 'F')
+                continue;
+        }
+
+        switch(ch)
+        {
+        case ERR:
+            break;
+        case KEY_DOWN:
+            scrollDown(1);
+            break;
+        case KEY_UP:
+            scrollUp(1);
+            break;
+        case KEY_NPAGE:
+        case ' ':
+            scrollDown(visibleRows());
+            break;
+        case KEY_PPAGE:
+            scrollUp(visibleRows());
+            break;
+        case KEY_RIGHT:
+            m_column += horizontalStep;
+            break;
+        case KEY_LEFT:
+            m_column = m_column > horizontalStep ? m_column - horizontalStep : 0;
+            break;
+        case KEY_HOME:
+        case 'g':
+            m_top = 0;
+            break;
+        case KEY_END:
+        case 'G':
+            scrollToEnd();
+            break;
+        case ':':
+            goToLine();
+            break;
+        case '%':
+            goToPercentage();
+            break;
+        case 'h':
+            m_isHex = !m_isHex;
+            m_top = rowStart(m_top);
+            break;
+        case 'F':
+            if(m_isPart)
+            {
+                m_message = "Only a whole file can be followed";
+                break;
+            }
+            m_follower = std::make_unique<FileWatcher>(m_path);
+            followFile();
+            break;
+        default:
+            clear();
+            return;
+        }
+    }
+}
+
+int PreviewWindow::readKey() const
+{
+    // The status row follows the background index until it is complete
+    timeout(m_preview.isIndexed() ? -1 : 250);
+    int ch = getch();
+    timeout(-1);
+    return ch;
+}
+
+int PreviewWindow::readKeyFollowing()
+{
+    // Keys already read by ncurses do not make the terminal readable again
+    nodelay(stdscr, true);
+    int ch = getch();
+    nodelay(stdscr, false);
+    if(ch != ERR)
+    {
+        return ch;
+    }
+
+    struct pollfd descriptors[2] = {{STDIN_FILENO, POLLIN, 0}, {m_follower->getDescriptor(), POLLIN, 0}};
+    if(::poll(descriptors, 2, m_preview.isIndexed() ? -1 : 250) <= 0 || (descriptors[0].revents & POLLIN))
+    {
+        return (descriptors[0].revents & POLLIN) ? getch() : ERR;
+    }
+
+    // The writes of the rest of the frame are shown together, the keyboard still interrupts the wait
+    auto frameEnd = m_lastFrame + std::chrono::milliseconds(1000 / frameRate);
+    auto now = std::chrono::steady_clock::now();
+    if(now < frameEnd)
+    {
+        int remaining = std::chrono::duration_cast<std::chrono::milliseconds>(frameEnd - now).count() + 1;
+        if(::poll(descriptors, 1, remaining) > 0)
+            return getch();
+    }
+
+    m_lastFrame = std::chrono::steady_clock::now();
+    if(m_follower->readChanges())
+    {
+        followFile();
+    }
+    return ERR;
+}
+
+void PreviewWindow::followFile()
+{
+    try
+    {
+        m_preview.update();
+    }
+    catch(const std::exception &e)
+    {
+        m_message = e.what();
+    }
+    scrollToEnd();
+}
+
+void PreviewWindow::scrollToEnd()
+{
+    m_top = m_preview.size();
+    scrollUp(visibleRows());
+}
+
+uint64_t PreviewWindow::nextRow(uint64_t offset) const
+{
+    if(m_isHex)
+    {
+        return std::min(offset + hexRowSize, m_preview.size());
+    }
+    uint64_t next;
+    m_preview.line(offset, next);
+    return next;
+}
+
+uint64_t PreviewWindow::previousRow(uint64_t offset) const
+{
+    if(m_isHex)
+    {
+        return offset > 0 ? (offset - 1) / hexRowSize * hexRowSize : 0;
+    }
+    return m_preview.previousLine(offset);
+}
+
+uint64_t PreviewWindow::rowStart(uint64_t offset) const
+{
+    if(m_isHex)
+    {
+        return offset / hexRowSize * hexRowSize;
+    }
+    return m_preview.lineStart(offset);
+}
+
+void PreviewWindow::scrollDown(int rows)
+{
+    // The row after the last shown one moves together with the first shown one
+    uint64_t bottom = m_top;
+    for(int i = 0; i < visibleRows() && bottom < m_preview.size(); i++)
+    {
+        bottom = nextRow(bottom);
+    }
+
+    for(int i = 0; i < rows && bottom < m_preview.size(); i++)
+    {
+        m_top = nextRow(m_top);
+        bottom = nextRow(bottom);
+    }
+}
+
+void PreviewWindow::scrollUp(int rows)
+{
+    for(int i = 0; i < rows && m_top > 0; i++)
+    {
+        m_top = previousRow(m_top);
+    }
+}
+
+void PreviewWindow::goToLine()
+{
+    SmallWindow inputWindow("Go to line");
+    std::string input = inputWindow.input();
+    if(input.empty() || input.size() > 18 || input.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return;
+    }
+
+    uint64_t lineNumber = std::stoull(input);
+    uint64_t offset;
+    if(!m_preview.lineOffset(lineNumber > 0 ? lineNumber - 1 : 0, offset))
+    {
+        m_message = "Line " + input + " is not indexed yet";
+        return;
+    }
+    m_top = rowStart(offset);
+}
+
+void PreviewWindow::goToPercentage()
+{
+    SmallWindow inputWindow("Go to percentage of the file");
+    std::string input = inputWindow.input();
+
+    double percentage;
+    try
+    {
+        size_t parsed;
+        percentage = std::stod(input, &parsed);
+        if(parsed != input.size() || percentage < 0 || percentage > 100)
+            return;
+    }
+    catch(const std::exception &e)
+    {
+        return;
+    }
+
+    m_top = rowStart(uint64_t(m_preview.size() * (percentage / 100)));
+}
+
+void PreviewWindow::print() const
+{
+    clear();
+    attron(A_BOLD);
+    mvprintw(0, 0, "%s%s", m_title.c_str(), m_isHex ? " (hex)" : "");
+    attroff(A_BOLD);
+
+    uint64_t offset = m_top;
+    for(int row = 1; row <= visibleRows() && offset < m_preview.size(); row++)
+    {
+        std::string text;
+        uint64_t next;
+        if(m_isHex)
+        {
+            text = formatHexRow(offset);
+            next = nextRow(offset);
+        }
+        else
+        {
+            text = formatLine(m_preview.line(offset, next));
+        }
+        mvaddnstr(row, 0, text.c_str(), COLS);
+        offset = next;
+    }
+
+    std::string position;
+    uint64_t lineNumber;
+    if(!m_isHex && m_preview.lineNumberAt(m_top, lineNumber))
+    {
+        position = "line " + std::to_string(lineNumber + 1) + "/" + (m_preview.isIndexed() ? std::to_string(m_preview.lineCount()) : "?") + ", ";
+    }
+
+    char status[128];
+    double shown = m_preview.size() > 0 ? 100.0 * m_top / m_preview.size() : 100;
+    if(m_preview.isIndexed())
+        std::snprintf(status, sizeof(status), "%.1f%%", shown);
+    else
+        std::snprintf(status, sizeof(status), "%.1f%%, indexed %.0f%%", shown, 100.0 * m_preview.indexedBytes() / m_preview.size());
+
+    attron(A_DIM);
+    mvprintw(LINES - 1, 0, "%s%s, %s", position.c_str(), status,
+        m_message.empty() ? m_follower ? "following, any key stops" : "arrows PgUp PgDn g G scroll, : line, % percentage, h hex, F follow, q closes" : m_message.c_str());
+    attroff(A_DIM);
+    refresh();
+}
+
+std::string PreviewWindow::formatLine(std::string_view line) const
+{
+    std::string text;
+    for(char character : line)
+    {
+        if(character == '\t')
+            text.append(tabSize - text.size() % tabSize, ' ');
+        else
+            text.push_back(isPrintable(character) ? character : '.');
+        if(text.size() >= m_column + size_t(COLS))
+            break;
+    }
+    return m_column < text.size() ? text.substr(m_column) : std::string();
+}
+
+std::string PreviewWindow::formatHexRow(uint64_t offset) const
+{
+    std::string_view bytes = m_preview.bytes(offset, hexRowSize);
+
+    char text[16];
+    std::snprintf(text, sizeof(text), "%012llx ", static_cast<unsigned long long>(offset));
+    std::string row = text;
+    for(uint64_t i = 0; i < hexRowSize; i++)
+    {
+        if(i % 8 == 0)
+            row += ' ';
+        if(i < bytes.size())
+        {
+            std::snprintf(text, sizeof(text), "%02x ", static_cast<unsigned char>(bytes[i]));
+            row += text;
+        }
+        else
+        {
+            row += "   ";
+        }
+    }
+
+    row += " |";
+    for(char character : bytes)
+    {
+        row.push_back(isPrintable(character) ? character : '.');
+    }
+    return row + "|";
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <ncurses.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "FilePreview.h"
+#include "FileWatcher.h"
+
+/**
+ * @class PreviewWindow
+ * @brief Class representing a full screen viewer of the contents of a file.
+ *
+ * Text is shown line by line, binary files as hexadecimal rows of 16 bytes. The file is memory mapped
+ * and only the shown part is read, the line numbers appear as the background index reaches them.
+ *
+ * In the follow mode the end of the file is shown as it grows, like tail -F: inotify wakes the viewer up,
+ * only the appended bytes are mapped and indexed, and the screen is redrawn at most frameRate times a second.
+ */
+class PreviewWindow
+{
+public:
+    /**
+     * @brief Constructor. Maps the file, binary files start in the hexadecimal mode.
+     * @param path The path to the file.
+     * @throws std::runtime_error If the file cannot be mapped.
+     */
+    PreviewWindow(const fs::path &path);
+
+    /**
+     * @brief Constructor. Maps a part of the file, as a member of an archive, the part cannot be followed.
+     * @param path The path to the file.
+     * @param offset The first byte of the part.
+     * @param size The size of the part.
+     * @param title The name shown instead of the path.
+     * @throws std::runtime_error If the part cannot be mapped.
+     */
+    PreviewWindow(const fs::path &path, uint64_t offset, uint64_t size, const std::string &title);
+
+    /**
+     * @brief Shows the file until the user presses q or a key the viewer does not use.
+     *
+     * Arrow keys and PgUp and PgDn scroll, g and G go to the start and to the end, : goes to a line,
+     * % goes to a percentage of the file, h switches between text and hexadecimal, F starts following the file,
+     * any key stops following it.
+     */
+    void show();
+
+    /**
+     * @brief The most screen updates a second in the follow mode.
+     */
+    static constexpr int frameRate = 30;
+
+private:
+    fs::path m_path; /**< The path to the file. */
+    std::string m_title; /**< The name shown in the status row. */
+    bool m_isPart; /**< True if only a part of the file is shown. */
+    FilePreview m_preview; /**< The mapped file. */
+    uint64_t m_top; /**< The offset of the first shown line or row. */
+    size_t m_column; /**< The first shown column of the lines. */
+    bool m_isHex; /**< True in the hexadecimal mode. */
+    std::string m_message; /**< A message shown in the status row until the next key. */
+    std::unique_ptr<FileWatcher> m_follower; /**< Watches the file in the follow mode, nullptr otherwise. */
+    std::chrono::steady_clock::time_point m_lastFrame; /**< When the growth of the file was last shown. */
+
+    /**
+     * @brief Waits for a key, wakes up regularly while the index is being built.
+     * @return The key, ERR if the screen only has to be redrawn.
+     */
+    int readKey() const;
+
+    /**
+     * @brief Waits for a key or for the file to grow, follows the file at most once a frame.
+     * @return The key, ERR if the screen only has to be redrawn.
+     */
+    int readKeyFollowing();
+
+    /**
+     * @brief Maps what was appended to the file or the file that replaced it and scrolls to the end.
+     */
+    void followFile();
+
+    /**
+     * @brief Scrolls to the end of the file.
+     */
+    void scrollToEnd();
+
+    /**
+     * @brief Gets the offset of the line or row after the one at the offset.
+     * @param offset The start of a line or row.
+     * @return The start of the next one, the size of the file after the last one.
+     */
+    uint64_t nextRow(uint64_t offset) const;
+
+    /**
+     * @brief Gets the offset of the line or row before the one at the offset.
+     * @param offset The start of a line or row.
+     * @return The start of the previous one, 0 for the first one.
+     */
+    uint64_t previousRow(uint64_t offset) const;
+
+    /**
+     * @brief Gets the start of the line or row containing the offset.
+     * @param offset The offset.
+     * @return The start.
+     */
+    uint64_t rowStart(uint64_t offset) const;
+
+    /**
+     * @brief Scrolls down, stops when the last line or row is shown on the last row of the screen.
+     * @param rows The number of rows.
+     */
+    void scrollDown(int rows);
+
+    /**
+     * @brief Scrolls up.
+     * @param rows The number of rows.
+     */
+    void scrollUp(int rows);
+
+    /**
+     * @brief Asks for a line number and shows the file from that line.
+     */
+    void goToLine();
+
+    /**
+     * @brief Asks for a percentage and shows the file from the line at that part of the file.
+     */
+    void goToPercentage();
+
+    /**
+     * @brief Prints the shown part of the file and the status row.
+     */
+    void print() const;
+
+    /**
+     * @brief Formats a line with tabs expanded and control characters replaced by dots.
+     * @param line The line.
+     * @return The printable line starting at m_column.
+     */
+    std::string formatLine(std::string_view line) const;
+
+    /**
+     * @brief Formats 16 bytes as a hexadecimal row.
+     * @param offset The offset of the row.
+     * @return The offset, the bytes in hexadecimal and the printable ones.
+     */
+    std::string formatHexRow(uint64_t offset) const;
+};
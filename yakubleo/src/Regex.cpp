@@ -0,0 +1,581 @@
+#include "Regex.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+    constexpr int maxRepetition = 1000; // upper bound of {m,n}
+    constexpr size_t maxStates = 100000; // upper bound of the NFA size
+    constexpr int maxNesting = 1000; // upper bound of nested groups and of the depth of the parsed pattern
+
+    /**
+     * @brief Node of the parsed pattern.
+     */
+    struct Node
+    {
+        enum Type { EMPTY, BYTES, CONCAT, ALTERNATE, REPEAT, BEGIN, END } type = EMPTY;
+        std::bitset<256> bytes; // for BYTES
+        std::vector<std::unique_ptr<Node>> children; // for CONCAT, ALTERNATE and REPEAT
+        int min = 0; // for REPEAT
+        int max = -1; // for REPEAT, -1 means unbounded
+        int height = 1; // nodes on the longest path down from this one
+    };
+
+    /**
+     * @brief Recursive descent parser of the pattern.
+     */
+    class Parser
+    {
+    public:
+        Parser(const std::string &pattern, size_t begin, size_t end) : m_pattern(pattern), m_position(begin), m_end(end)
+        {
+        }
+
+        std::unique_ptr<Node> parse()
+        {
+            std::unique_ptr<Node> node = parseAlternation();
+            if(m_position != m_end)
+            {
+                fail("unmatched ')'");
+            }
+            return node;
+        }
+
+    private:
+        const std::string &m_pattern;
+        size_t m_position;
+        size_t m_end;
+        int m_depth = 0; // groups open at m_position
+
+        [[noreturn]] void fail(const std::string &reason) const
+        {
+            throw std::runtime_error("Invalid regex pattern: " + reason);
+        }
+
+        bool atEnd() const
+        {
+            return m_position >= m_end;
+        }
+
+        char peek() const
+        {
+            return m_pattern[m_position];
+        }
+
+        // The parsed tree is walked recursively, its depth is bounded like the depth of the groups
+        void adopt(Node &parent, std::unique_ptr<Node> child)
+        {
+            parent.height = std::max(parent.height, child->height + 1);
+            if(parent.height > maxNesting)
+                fail("pattern is nested too deeply");
+            parent.children.push_back(std::move(child));
+        }
+
+        std::unique_ptr<Node> parseAlternation()
+        {
+            std::unique_ptr<Node> first = parseConcatenation();
+            if(atEnd() || peek() != '|')
+            {
+                return first;
+            }
+
+            auto alternation = std::make_unique<Node>();
+            alternation->type = Node::ALTERNATE;
+            adopt(*alternation, std::move(first));
+            while(!atEnd() && peek() == '|')
+            {
+                m_position++;
+                adopt(*alternation, parseConcatenation());
+            }
+            return alternation;
+        }
+
+        std::unique_ptr<Node> parseConcatenation()
+        {
+            auto concatenation = std::make_unique<Node>();
+            concatenation->type = Node::CONCAT;
+            while(!atEnd() && peek() != '|' && peek() != ')')
+            {
+                adopt(*concatenation, parseRepetition());
+            }
+
+            if(concatenation->children.size() == 1)
+            {
+                return std::move(concatenation->children.front());
+            }
+            return concatenation;
+        }
+
+        std::unique_ptr<Node> parseRepetition()
+        {
+            std::unique_ptr<Node> atom = parseAtom();
+
+            // Assertions match no text, a quantifier after them has nothing to repeat
+            if(atom->type == Node::BEGIN || atom->type == Node::END)
+            {
+                if(!atEnd() && (peek() == '*' || peek() == '+' || peek() == '?' || peek() == '{'))
+                    fail("nothing to repeat");
+                return atom;
+            }
+
+            while(!atEnd())
+            {
+                int min = 0;
+                int max = -1;
+                char ch = peek();
+                if(ch == '*')
+                {
+                    m_position++;
+                }
+                else if(ch == '+')
+                {
+                    min = 1;
+                    m_position++;
+                }
+                else if(ch == '?')
+                {
+                    max = 1;
+                    m_position++;
+                }
+                else if(ch == '{' && parseBounds(min, max))
+                {
+                }
+                else
+                {
+                    break;
+                }
+
+                // Lazy quantifiers match the same set of strings
+                if(!atEnd() && peek() == '?')
+                {
+                    m_position++;
+                }
+
+                auto repetition = std::make_unique<Node>();
+                repetition->type = Node::REPEAT;
+                repetition->min = min;
+                repetition->max = max;
+                adopt(*repetition, std::move(atom));
+                atom = std::move(repetition);
+            }
+            return atom;
+        }
+
+        bool parseBounds(int &min, int &max)
+        {
+            size_t position = m_position + 1;
+            auto readNumber = [&](int &number)
+            {
+                size_t start = position;
+                number = 0;
+                while(position < m_end && isdigit((unsigned char)m_pattern[position]))
+                {
+                    number = number * 10 + (m_pattern[position] - '0');
+                    if(number > maxRepetition)
+                        fail("repetition count is too large");
+                    position++;
+                }
+                return position > start;
+            };
+
+            if(!readNumber(min))
+                return false;
+
+            max = min;
+            if(position < m_end && m_pattern[position] == ',')
+            {
+                position++;
+                if(!readNumber(max))
+                    max = -1;
+            }
+
+            if(position >= m_end || m_pattern[position] != '}')
+                return false;
+            if(max != -1 && max < min)
+                fail("bad repetition bounds");
+
+            m_position = position + 1;
+            return true;
+        }
+
+        std::unique_ptr<Node> parseAtom()
+        {
+            char ch = peek();
+            m_position++;
+
+            auto node = std::make_unique<Node>();
+            node->type = Node::BYTES;
+
+            switch(ch)
+            {
+            case '(':
+                if(!atEnd() && peek() == '?')
+                {
+                    if(m_position + 1 < m_end && m_pattern[m_position + 1] == ':')
+                        m_position += 2;
+                    else
+                        fail("lookarounds are not supported");
+                }
+                if(++m_depth > maxNesting)
+                    fail("pattern is nested too deeply");
+                node = parseAlternation();
+                if(atEnd() || peek() != ')')
+                    fail("missing ')'");
+                m_depth--;
+                m_position++;
+                return node;
+            case '.':
+                node->bytes.set();
+                node->bytes.reset('\n');
+                return node;
+            case '[':
+                parseBracket(node->bytes);
+                return node;
+            case '\\':
+                parseEscape(node->bytes);
+                return node;
+            case '*':
+            case '+':
+            case '?':
+                fail("nothing to repeat");
+            case '^':
+                node->type = Node::BEGIN;
+                return node;
+            case '$':
+                node->type = Node::END;
+                return node;
+            default:
+                node->bytes.set((unsigned char)ch);
+                return node;
+            }
+        }
+
+        void parseEscape(std::bitset<256> &bytes)
+        {
+            if(atEnd())
+                fail("trailing backslash");
+
+            char ch = peek();
+            m_position++;
+
+            switch(ch)
+            {
+            case 'd':
+            case 'D':
+                for(int c = '0'; c <= '9'; c++)
+                    bytes.set(c);
+                break;
+            case 'w':
+            case 'W':
+                for(int c = 0; c < 256; c++)
+                    if(isalnum(c) || c == '_')
+                        bytes.set(c);
+                break;
+            case 's':
+            case 'S':
+                for(char c : std::string(" \t\n\r\f\v"))
+                    bytes.set((unsigned char)c);
+                break;
+            case 'n':
+                bytes.set('\n');
+                return;
+            case 't':
+                bytes.set('\t');
+                return;
+            case 'r':
+                bytes.set('\r');
+                return;
+            case 'f':
+                bytes.set('\f');
+                return;
+            case 'v':
+                bytes.set('\v');
+                return;
+            case 'b':
+            case 'B':
+                fail("word boundaries are not supported");
+            default:
+                if(isdigit((unsigned char)ch))
+                    fail("backreferences are not supported");
+                bytes.set((unsigned char)ch);
+                return;
+            }
+
+            if(isupper((unsigned char)ch))
+            {
+                bytes.flip();
+            }
+        }
+
+        void parseBracket(std::bitset<256> &bytes)
+        {
+            bool negated = false;
+            if(!atEnd() && peek() == '^')
+            {
+                negated = true;
+                m_position++;
+            }
+
+            bool first = true;
+            while(true)
+            {
+                if(atEnd())
+                    fail("missing ']'");
+
+                char ch = peek();
+                if(ch == ']' && !first)
+                {
+                    m_position++;
+                    break;
+                }
+                first = false;
+                m_position++;
+
+                if(ch == '\\')
+                {
+                    std::bitset<256> escaped;
+                    parseEscape(escaped);
+                    bytes |= escaped;
+                    continue;
+                }
+
+                unsigned char low = ch;
+                if(m_position + 1 < m_end && peek() == '-' && m_pattern[m_position + 1] != ']')
+                {
+                    unsigned char high = m_pattern[m_position + 1];
+                    if(high == '\\')
+                        fail("escapes cannot end a range");
+                    if(high < low)
+                        fail("bad range in brackets");
+                    for(int c = low; c <= high; c++)
+                        bytes.set(c);
+                    m_position += 2;
+                }
+                else
+                {
+                    bytes.set(low);
+                }
+            }
+
+            if(negated)
+            {
+                bytes.flip();
+            }
+        }
+    };
+
+    /**
+     * @brief Builds the Thompson NFA backwards, every node is compiled with its continuation already known.
+     */
+    class Compiler
+    {
+    public:
+        Compiler(std::vector<Regex::State> &states, std::vector<std::bitset<256>> &byteSets) : m_states(states), m_byteSets(byteSets)
+        {
+        }
+
+        int compile(const Node &node, int next)
+        {
+            if(m_states.size() > maxStates)
+                throw std::runtime_error("Invalid regex pattern: pattern is too large");
+
+            switch(node.type)
+            {
+            case Node::EMPTY:
+                return next;
+            case Node::BYTES:
+                return addState(Regex::BYTE_SET, byteSetIndex(node.bytes), next, -1);
+            case Node::BEGIN:
+                return addState(Regex::ASSERT_BEGIN, 0, next, -1);
+            case Node::END:
+                return addState(Regex::ASSERT_END, 0, next, -1);
+            case Node::CONCAT:
+                for(auto child = node.children.rbegin(); child != node.children.rend(); ++child)
+                {
+                    next = compile(**child, next);
+                }
+                return next;
+            case Node::ALTERNATE:
+            {
+                int start = compile(*node.children.back(), next);
+                for(size_t i = node.children.size() - 1; i-- > 0; )
+                {
+                    start = addState(Regex::SPLIT, 0, compile(*node.children[i], next), start);
+                }
+                return start;
+            }
+            case Node::REPEAT:
+            {
+                const Node &child = *node.children.front();
+                if(node.max == -1)
+                {
+                    int loop = addState(Regex::SPLIT, 0, -1, next);
+                    m_states[loop].out = compile(child, loop);
+                    next = loop;
+                }
+                else
+                {
+                    for(int i = node.min; i < node.max; i++)
+                    {
+                        next = addState(Regex::SPLIT, 0, compile(child, next), next);
+                    }
+                }
+                for(int i = 0; i < node.min; i++)
+                {
+                    next = compile(child, next);
+                }
+                return next;
+            }
+            }
+            return next;
+        }
+
+        int addState(Regex::StateType type, uint32_t setIndex, int out, int alternative)
+        {
+            m_states.push_back({type, setIndex, out, alternative});
+            return m_states.size() - 1;
+        }
+
+    private:
+        std::vector<Regex::State> &m_states;
+        std::vector<std::bitset<256>> &m_byteSets;
+        std::map<std::string, uint32_t> m_byteSetIndexes; // deduplicates identical sets
+
+        uint32_t byteSetIndex(const std::bitset<256> &bytes)
+        {
+            auto [iterator, inserted] = m_byteSetIndexes.emplace(bytes.to_string(), m_byteSets.size());
+            if(inserted)
+            {
+                m_byteSets.push_back(bytes);
+            }
+            return iterator->second;
+        }
+    };
+
+    /**
+     * @brief Collects the literal bytes every match has to start with.
+     */
+    void collectLiteralPrefix(const Node &node, std::string &prefix)
+    {
+        if(node.type == Node::BEGIN)
+        {
+            return;
+        }
+
+        if(node.type == Node::BYTES && node.bytes.count() == 1)
+        {
+            for(int c = 0; c < 256; c++)
+                if(node.bytes.test(c))
+                    prefix.push_back((char)c);
+            return;
+        }
+
+        if(node.type == Node::CONCAT)
+        {
+            for(const auto& child : node.children)
+            {
+                // '^' at the start matches no text, the literal follows it
+                if(child->type == Node::BEGIN && &child == &node.children.front())
+                    continue;
+                if(child->type != Node::BYTES || child->bytes.count() != 1)
+                    break;
+                collectLiteralPrefix(*child, prefix);
+            }
+        }
+    }
+
+    /**
+     * @brief Tells if every match of the node starts with '^'.
+     */
+    bool startsWithBegin(const Node &node)
+    {
+        switch(node.type)
+        {
+        case Node::BEGIN:
+            return true;
+        case Node::CONCAT:
+            return !node.children.empty() && startsWithBegin(*node.children.front());
+        case Node::ALTERNATE:
+            return std::all_of(node.children.begin(), node.children.end(), [](const auto& child) { return startsWithBegin(*child); });
+        default:
+            return false;
+        }
+    }
+}
+
+Regex::Regex(const std::string &pattern) : m_pattern(pattern), m_byteClassCount(0), m_anchoredAtStart(false)
+{
+    Parser parser(pattern, 0, pattern.size());
+    std::unique_ptr<Node> root = parser.parse();
+    m_anchoredAtStart = startsWithBegin(*root);
+
+    Compiler compiler(m_states, m_byteSets);
+    int match = compiler.addState(MATCH, 0, -1, -1);
+    m_startState = compiler.compile(*root, match);
+
+    collectLiteralPrefix(*root, m_literalPrefix);
+    computeByteClasses();
+}
+
+const std::string &Regex::getPattern() const
+{
+    return m_pattern;
+}
+
+const std::vector<Regex::State> &Regex::getStates() const
+{
+    return m_states;
+}
+
+int Regex::getStartState() const
+{
+    return m_startState;
+}
+
+bool Regex::accepts(const State &state, unsigned char byte) const
+{
+    return m_byteSets[state.setIndex].test(byte);
+}
+
+uint8_t Regex::byteClass(unsigned char byte) const
+{
+    return m_byteClasses[byte];
+}
+
+size_t Regex::byteClassCount() const
+{
+    return m_byteClassCount;
+}
+
+const std::string &Regex::getLiteralPrefix() const
+{
+    return m_literalPrefix;
+}
+
+bool Regex::isAnchoredAtStart() const
+{
+    return m_anchoredAtStart;
+}
+
+void Regex::computeByteClasses()
+{
+    // Two bytes are in the same class if every byte set either contains both or neither of them
+    std::map<std::vector<bool>, uint8_t> classes;
+    for(int byte = 0; byte < 256; byte++)
+    {
+        std::vector<bool> signature(m_byteSets.size());
+        for(size_t set = 0; set < m_byteSets.size(); set++)
+        {
+            signature[set] = m_byteSets[set].test(byte);
+        }
+
+        auto [iterator, inserted] = classes.emplace(std::move(signature), m_byteClassCount);
+        if(inserted)
+        {
+            m_byteClassCount++;
+        }
+        m_byteClasses[byte] = iterator->second;
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @class Regex
+ * @brief Regular expression compiled into a Thompson NFA.
+ *
+ * Supports the usual subset of the ECMAScript syntax: literals, '.', bracket expressions,
+ * the \\d \\w \\s escapes and their negations, groups, alternation and the * + ? {m,n} quantifiers.
+ * '^' and '$' match at the beginning and at the end of the text anywhere in the pattern, as without the multiline flag.
+ * Backreferences and lookarounds are rejected, they cannot be matched in linear time.
+ * The NFA is simulated by RegexMatcher, so matching time is always linear in the input length.
+ */
+class Regex
+{
+public:
+    /**
+     * @brief Type of a NFA state.
+     */
+    enum StateType
+    {
+        BYTE_SET, /**< Consumes one byte from m_byteSets[setIndex] and continues to out. */
+        SPLIT, /**< Continues to both out and alternative without consuming input. */
+        ASSERT_BEGIN, /**< Continues to out without consuming input at the beginning of the text only. */
+        ASSERT_END, /**< Continues to out without consuming input at the end of the text only. */
+        MATCH /**< The pattern was matched. */
+    };
+
+    /**
+     * @brief A state of the NFA.
+     */
+    struct State
+    {
+        StateType type; /**< The type of the state. */
+        uint32_t setIndex; /**< Index of the byte set for BYTE_SET states. */
+        int out; /**< The next state. */
+        int alternative; /**< The second next state for SPLIT states. */
+    };
+
+    /**
+     * @brief Compiles the pattern.
+     * @param pattern The regular expression.
+     * @throws std::runtime_error If the pattern is invalid or uses an unsupported feature.
+     */
+    Regex(const std::string &pattern);
+
+    /**
+     * @brief Gets the pattern the regex was compiled from.
+     * @return The pattern.
+     */
+    const std::string &getPattern() const;
+
+    /**
+     * @brief Gets the states of the NFA.
+     * @return The states.
+     */
+    const std::vector<State> &getStates() const;
+
+    /**
+     * @brief Gets the index of the initial NFA state.
+     * @return The index of the initial state.
+     */
+    int getStartState() const;
+
+    /**
+     * @brief Tells if a BYTE_SET state accepts the byte.
+     * @param state The state.
+     * @param byte The byte.
+     * @return True if the byte is in the set of the state.
+     */
+    bool accepts(const State &state, unsigned char byte) const;
+
+    /**
+     * @brief Gets the equivalence class of a byte, bytes of one class are never told apart by the pattern.
+     * @param byte The byte.
+     * @return The class of the byte.
+     */
+    uint8_t byteClass(unsigned char byte) const;
+
+    /**
+     * @brief Gets the number of byte equivalence classes.
+     * @return The number of classes.
+     */
+    size_t byteClassCount() const;
+
+    /**
+     * @brief Gets the literal every match has to start with.
+     * @return The literal prefix, may be empty.
+     */
+    const std::string &getLiteralPrefix() const;
+
+    /**
+     * @brief Tells if every match starts with '^', so it can start only at the beginning of the text.
+     */
+    bool isAnchoredAtStart() const;
+
+private:
+    std::string m_pattern; /**< The source pattern. */
+    std::vector<State> m_states; /**< The states of the NFA. */
+    std::vector<std::bitset<256>> m_byteSets; /**< Bytes accepted by BYTE_SET states. */
+    int m_startState; /**< The initial state. */
+    std::array<uint8_t, 256> m_byteClasses; /**< Equivalence class of every byte. */
+    size_t m_byteClassCount; /**< The number of equivalence classes. */
+    std::string m_literalPrefix; /**< The literal every match starts with. */
+    bool m_anchoredAtStart; /**< True if every match starts with '^'. */
+
+    /**
+     * @brief Splits the bytes into classes that all byte sets of the pattern treat the same.
+     */
+    void computeByteClasses();
+};
@@ -0,0 +1,28 @@
+#include "RegexCache.h"
+
+RegexCache::RegexCache(size_t capacity) : m_capacity(capacity)
+{
+}
+
+std::shared_ptr<const Regex> RegexCache::get(const std::string &pattern)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto found = m_index.find(pattern);
+    if(found != m_index.end())
+    {
+        m_entries.splice(m_entries.begin(), m_entries, found->second);
+        return found->second->second;
+    }
+
+    auto regex = std::make_shared<const Regex>(pattern);
+    m_entries.emplace_front(pattern, regex);
+    m_index[pattern] = m_entries.begin();
+
+    if(m_entries.size() > m_capacity)
+    {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+    return regex;
+}
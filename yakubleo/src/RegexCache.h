@@ -0,0 +1,39 @@
+#pragma once
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Regex.h"
+
+/**
+ * @class RegexCache
+ * @brief Least recently used cache of compiled regular expressions.
+ *
+ * Users tend to repeat the same few patterns, the cache saves parsing and compiling them again.
+ */
+class RegexCache
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param capacity The number of compiled patterns kept in the cache.
+     */
+    RegexCache(size_t capacity = 32);
+
+    /**
+     * @brief Gets the compiled pattern, compiles it on a cache miss.
+     * @param pattern The regular expression.
+     * @return The compiled pattern.
+     * @throws std::runtime_error If the pattern is invalid.
+     */
+    std::shared_ptr<const Regex> get(const std::string &pattern);
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const Regex>>;
+
+    size_t m_capacity; /**< The maximal number of entries. */
+    std::list<Entry> m_entries; /**< The entries, the most recently used first. */
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index; /**< The entries by their pattern. */
+    std::mutex m_mutex; /**< Guards the entries. */
+};
@@ -0,0 +1,200 @@
+#include "RegexMatcher.h"
+#include <algorithm>
+
+RegexMatcher::RegexMatcher(const Regex &regex, Mode mode) : m_regex(regex), m_mode(mode), m_startState(0), m_innerStartState(0),
+    m_generation(0)
+{
+    m_restartEverywhere = (m_mode == SEARCH && !m_regex.isAnchoredAtStart());
+    m_marks.assign(m_regex.getStates().size(), 0);
+    resetCache();
+
+    // The only text whose beginning is also its end
+    m_generation++;
+    std::vector<int> empty;
+    addClosure(m_regex.getStartState(), empty, true, true);
+    m_matchesEmpty = std::any_of(empty.begin(), empty.end(), [&](int state) { return m_regex.getStates()[state].type == Regex::MATCH; });
+}
+
+bool RegexMatcher::matches(std::string_view text)
+{
+    if(text.empty())
+    {
+        return m_matchesEmpty;
+    }
+
+    // Cheap rejection before the automaton touches the text
+    int state = m_startState;
+    const std::string &prefix = m_regex.getLiteralPrefix();
+    if(!prefix.empty())
+    {
+        if(m_restartEverywhere)
+        {
+            size_t position = text.find(prefix);
+            if(position == std::string_view::npos)
+                return false;
+            text.remove_prefix(position);
+            if(position > 0)
+                state = m_innerStartState;
+        }
+        else if(text.compare(0, prefix.size(), prefix) != 0)
+        {
+            return false;
+        }
+    }
+
+    // A search is decided by the first match, states waiting for '$' do not accept before the end
+    bool stopOnFirstMatch = (m_mode == SEARCH);
+    size_t classCount = m_regex.byteClassCount();
+
+    if(stopOnFirstMatch && m_accepting[state])
+        return true;
+
+    for(unsigned char byte : text)
+    {
+        int next = m_transitions[state * classCount + m_regex.byteClass(byte)];
+        if(next == -1)
+        {
+            next = computeTransition(state, byte);
+        }
+        if(next == m_deadState)
+        {
+            return false;
+        }
+
+        state = next;
+        if(stopOnFirstMatch && m_accepting[state])
+        {
+            return true;
+        }
+    }
+    return m_acceptingAtEnd[state];
+}
+
+void RegexMatcher::addClosure(int state, std::vector<int> &set, bool atBeginning, bool atEnd)
+{
+    const std::vector<Regex::State> &states = m_regex.getStates();
+
+    std::vector<int> stack{state};
+    while(!stack.empty())
+    {
+        int current = stack.back();
+        stack.pop_back();
+        if(current < 0 || m_marks[current] == m_generation)
+            continue;
+        m_marks[current] = m_generation;
+
+        if(states[current].type == Regex::SPLIT)
+        {
+            stack.push_back(states[current].alternative);
+            stack.push_back(states[current].out);
+        }
+        else if(states[current].type == Regex::ASSERT_BEGIN)
+        {
+            if(atBeginning)
+                stack.push_back(states[current].out);
+        }
+        else if(states[current].type == Regex::ASSERT_END && atEnd)
+        {
+            stack.push_back(states[current].out);
+        }
+        else
+        {
+            set.push_back(current);
+        }
+    }
+}
+
+int RegexMatcher::dfaStateFor(std::vector<int> &&set)
+{
+    std::sort(set.begin(), set.end());
+
+    auto found = m_dfaStateIndexes.find(set);
+    if(found != m_dfaStateIndexes.end())
+    {
+        return found->second;
+    }
+
+    bool accepting = false;
+    for(int state : set)
+    {
+        if(m_regex.getStates()[state].type == Regex::MATCH)
+            accepting = true;
+    }
+
+    int index = m_dfaStates.size();
+    m_acceptingAtEnd.push_back(accepting || acceptsAtEnd(set));
+    m_dfaStateIndexes.emplace(set, index);
+    m_dfaStates.push_back(std::move(set));
+    m_accepting.push_back(accepting);
+    m_transitions.resize(m_transitions.size() + m_regex.byteClassCount(), -1);
+    return index;
+}
+
+bool RegexMatcher::acceptsAtEnd(const std::vector<int> &set)
+{
+    const std::vector<Regex::State> &states = m_regex.getStates();
+
+    m_generation++;
+    std::vector<int> reached;
+    for(int state : set)
+    {
+        if(states[state].type == Regex::ASSERT_END)
+            addClosure(states[state].out, reached, false, true);
+    }
+    return std::any_of(reached.begin(), reached.end(), [&](int state) { return states[state].type == Regex::MATCH; });
+}
+
+int RegexMatcher::computeTransition(int dfaState, unsigned char byte)
+{
+    const std::vector<Regex::State> &states = m_regex.getStates();
+
+    m_generation++;
+    std::vector<int> next;
+    for(int state : m_dfaStates[dfaState])
+    {
+        if(states[state].type == Regex::BYTE_SET && m_regex.accepts(states[state], byte))
+        {
+            addClosure(states[state].out, next);
+        }
+    }
+    if(m_restartEverywhere)
+    {
+        addClosure(m_regex.getStartState(), next);
+    }
+
+    if(next.empty())
+    {
+        m_transitions[dfaState * m_regex.byteClassCount() + m_regex.byteClass(byte)] = m_deadState;
+        return m_deadState;
+    }
+
+    // Bound the memory, pathological patterns may otherwise create exponentially many states
+    if(m_dfaStates.size() >= m_maxDfaStates)
+    {
+        resetCache();
+        return dfaStateFor(std::move(next));
+    }
+
+    int nextState = dfaStateFor(std::move(next));
+    m_transitions[dfaState * m_regex.byteClassCount() + m_regex.byteClass(byte)] = nextState;
+    return nextState;
+}
+
+void RegexMatcher::resetCache()
+{
+    m_dfaStateIndexes.clear();
+    m_dfaStates.clear();
+    m_accepting.clear();
+    m_acceptingAtEnd.clear();
+    m_transitions.clear();
+
+    m_generation++;
+    std::vector<int> start;
+    addClosure(m_regex.getStartState(), start, true);
+    m_startState = dfaStateFor(std::move(start));
+
+    m_generation++;
+    std::vector<int> innerStart;
+    addClosure(m_regex.getStartState(), innerStart);
+    m_innerStartState = dfaStateFor(std::move(innerStart));
+}
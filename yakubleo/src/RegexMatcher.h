@@ -0,0 +1,100 @@
+#pragma once
+#include <map>
+#include <string_view>
+#include <vector>
+#include "Regex.h"
+
+/**
+ * @class RegexMatcher
+ * @brief Lazy DFA built on demand from the NFA of a Regex.
+ *
+ * Every DFA state is a set of NFA states, it is created the first time the input reaches it
+ * and its transitions are filled in as they are used. Each input byte costs one table lookup once
+ * the needed states exist and at most one NFA step otherwise, so matching is linear in the input length.
+ * The matcher is not thread safe, every thread creates its own one for the shared Regex.
+ *
+ * '^' is passed only by the closure of the initial state, '$' states stay in the sets until the text ends
+ * and are passed only when it is decided whether the last state accepts.
+ */
+class RegexMatcher
+{
+public:
+    /**
+     * @brief Type of the match.
+     */
+    enum Mode
+    {
+        FULL_MATCH, /**< The whole text has to match, as std::regex_match does. */
+        SEARCH /**< A part of the text has to match, as std::regex_search does. */
+    };
+
+    /**
+     * @brief Constructor. Prepares an empty DFA for the regex.
+     * @param regex The compiled regex, has to outlive the matcher.
+     * @param mode The type of the match.
+     */
+    RegexMatcher(const Regex &regex, Mode mode);
+
+    /**
+     * @brief Matches the text against the regex.
+     * @param text The text, a file name or a single line of a file.
+     * @return True if the text matches.
+     */
+    bool matches(std::string_view text);
+
+private:
+    const Regex &m_regex; /**< The compiled regex. */
+    Mode m_mode; /**< The type of the match. */
+    bool m_restartEverywhere; /**< True if a match may start at any position of the text. */
+
+    std::map<std::vector<int>, int> m_dfaStateIndexes; /**< Index of every DFA state by its set of NFA states. */
+    std::vector<std::vector<int>> m_dfaStates; /**< The sets of NFA states of the DFA states. */
+    std::vector<bool> m_accepting; /**< True for DFA states that contain the MATCH state. */
+    std::vector<bool> m_acceptingAtEnd; /**< True for DFA states that reach the MATCH state when the text ends there. */
+    std::vector<int> m_transitions; /**< DFA transitions, state * byte class count + class, -1 if not computed yet. */
+    int m_startState; /**< The initial DFA state at the beginning of the text. */
+    int m_innerStartState; /**< The initial DFA state inside the text, after a skipped part. */
+    bool m_matchesEmpty; /**< True if the empty text matches. */
+
+    std::vector<int> m_marks; /**< Generation marks of the NFA states, used while computing a closure. */
+    int m_generation; /**< The current generation. */
+
+    static constexpr size_t m_maxDfaStates = 4096; /**< The cache is flushed when it grows above this size. */
+    static constexpr int m_deadState = -2; /**< Transition into the empty set, nothing can match anymore. */
+
+    /**
+     * @brief Adds the NFA state and all states reachable from it without consuming input.
+     * @param state The NFA state.
+     * @param set The set the states are added to.
+     * @param atBeginning True at the beginning of the text, '^' is passed, it ends the path otherwise.
+     * @param atEnd True at the end of the text, '$' is passed, it is added to the set otherwise.
+     */
+    void addClosure(int state, std::vector<int> &set, bool atBeginning = false, bool atEnd = false);
+
+    /**
+     * @brief Tells if a set of NFA states reaches the MATCH state when the text ends, past its '$' states.
+     * @param set The set of NFA states, not at the beginning of the text.
+     * @return True if the set accepts at the end of the text.
+     */
+    bool acceptsAtEnd(const std::vector<int> &set);
+
+    /**
+     * @brief Finds or creates the DFA state for a set of NFA states.
+     * @param set The set of NFA states.
+     * @return The index of the DFA state.
+     */
+    int dfaStateFor(std::vector<int> &&set);
+
+    /**
+     * @brief Computes the transition of a DFA state on a byte.
+     * @param dfaState The DFA state.
+     * @param byte The byte.
+     * @return The next DFA state, m_deadState if no match is possible anymore.
+     */
+    int computeTransition(int dfaState, unsigned char byte);
+
+    /**
+     * @brief Forgets all DFA states and creates the initial one.
+     */
+    void resetCache();
+};
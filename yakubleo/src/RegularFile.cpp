@@ -1,4 +1,81 @@
 #include "RegularFile.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "FileContents.h"
+#include "Tracer.h"
+
+namespace
+{
+    /**
+     * @brief Reads an open file in blocks or by lines, closes it when it goes out of scope.
+     */
+    class InputFile
+    {
+    public:
+        InputFile(int descriptor, const fs::path &path) : m_descriptor(descriptor), m_path(path), m_buffer(64 * 1024), m_begin(0), m_end(0)
+        {
+        }
+
+        ~InputFile()
+        {
+            ::close(m_descriptor);
+        }
+
+        InputFile(const InputFile &) = delete;
+        InputFile &operator=(const InputFile &) = delete;
+
+        /**
+         * @brief Reads the next block, not to be mixed with getLine.
+         * @return The number of bytes read, 0 at the end.
+         */
+        size_t read(char *data, size_t size)
+        {
+            ssize_t count = ::read(m_descriptor, data, size);
+            if(count < 0)
+                throw std::runtime_error("Could not read " + m_path.string() + ": " + std::strerror(errno));
+            return count;
+        }
+
+        /**
+         * @brief Reads the next line without its newline, like std::getline.
+         * @return False at the end.
+         */
+        bool getLine(std::string &line)
+        {
+            line.clear();
+            while(true)
+            {
+                if(m_begin == m_end)
+                {
+                    m_begin = 0;
+                    m_end = read(m_buffer.data(), m_buffer.size());
+                    if(m_end == 0)
+                        return !line.empty();
+                }
+                const char *start = m_buffer.data() + m_begin;
+                const char *newline = static_cast<const char *>(std::memchr(start, '\n', m_end - m_begin));
+                if(newline)
+                {
+                    line.append(start, newline);
+                    m_begin += newline - start + 1;
+                    return true;
+                }
+                line.append(start, m_end - m_begin);
+                m_begin = m_end;
+            }
+        }
+
+    private:
+        int m_descriptor;
+        fs::path m_path;
+        std::vector<char> m_buffer;
+        size_t m_begin;
+        size_t m_end;
+    };
+}
 
 RegularFile::RegularFile(const fs::path &pathToFile) : File(pathToFile)
 {
@@ -9,92 +86,109 @@ RegularFile::RegularFile(const fs::path &pathToFile) : File(pathToFile)
 
 void RegularFile::copy(const fs::path &destination)
 {
-    fs::path destinationFilename = destination / m_pathToFile.filename();
-    fs::copy_file(m_pathToFile, destinationFilename, fs::copy_options::overwrite_existing);
+    Tracer::Span span(Tracer::COPY);
+    DirectoryHandle destinationDirectory(destination);
+    span.addBytes(getParent()->copyFile(getName(), destinationDirectory));
 }
 
 void RegularFile::move(const fs::path &destination)
 {
-    fs::rename(m_pathToFile, destination / m_pathToFile.filename());
+    Tracer::Span span(Tracer::MOVE);
+    if(!getParent()->rename(getName(), DirectoryHandle(destination)))
+        throw std::runtime_error("Could not move " + m_pathToFile.string() + " to another filesystem");
 }
 
 void RegularFile::remove()
 {
-    fs::remove(m_pathToFile);
+    Tracer::Span span(Tracer::REMOVE);
+    getParent()->remove(getName());
 }
 
-void RegularFile::print(int row, int column, int normalColour, int selectedColour) const
+char RegularFile::getTypeLetter() const
 {
-    attron(A_DIM);
-    mvprintw(row, column, "[F] ");
-    attroff(A_DIM);
+    return 'F';
+}
 
-    int indent = 4;
-    if(m_isPointedAt)
+void RegularFile::appendContentsTo(std::ofstream &outputStream) const
+{
+    Tracer::Span span(Tracer::APPEND_CONTENTS);
+    InputFile inputFile(openForReading(), m_pathToFile);
+
+    std::vector<char> buffer(64 * 1024);
+    while (size_t count = inputFile.read(buffer.data(), buffer.size()))
     {
-        
-        attron(COLOR_PAIR(normalColour));
-        attron(A_REVERSE);
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(A_REVERSE);
-        attroff(COLOR_PAIR(normalColour));
+        if(!outputStream.write(buffer.data(), count))
+            throw std::runtime_error("Could not write the contents of " + m_pathToFile.string());
+        span.addBytes(count);
     }
-    else if(m_isSelected)
+}
+
+void RegularFile::selectOnText(const std::string &text)
+{
+    Tracer::Span span(Tracer::SELECT_ON_TEXT);
+    InputFile inputFile(openForReading(), m_pathToFile);
+
+    std::string fileContents;
+    while (inputFile.getLine(fileContents)) 
     {
-        attron(COLOR_PAIR(selectedColour));
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(COLOR_PAIR(selectedColour));
+        span.addBytes(fileContents.size() + 1);
+        if(fileContents.find(text) != std::string::npos)
+        {
+            m_isSelected = true;
+            break;
+        }
     }
-    else
+}
+
+std::vector<size_t> RegularFile::selectOnPatterns(const AhoCorasick &automaton)
+{
+    Tracer::Span span(Tracer::SELECT_ON_TEXT);
+    InputFile inputFile(openForReading(), m_pathToFile);
+
+    std::vector<bool> matched(automaton.patternCount(), false);
+    size_t matchedCount = 0;
+    uint32_t state = 0;
+
+    std::vector<char> buffer(64 * 1024);
+    while (matchedCount < automaton.patternCount())
     {
-        attron(COLOR_PAIR(normalColour));
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(COLOR_PAIR(normalColour));
+        size_t count = inputFile.read(buffer.data(), buffer.size());
+        if(count == 0)
+            break;
+        span.addBytes(count);
+        state = automaton.scan(buffer.data(), count, state, matched, matchedCount);
     }
 
-    if(m_isPointedAt && m_isSelected)
+    std::vector<size_t> matchedPatterns;
+    for(size_t i = 0; i < matched.size(); i++)
     {
-        attron(COLOR_PAIR(selectedColour));
-        attron(A_REVERSE);
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(A_REVERSE);
-        attroff(COLOR_PAIR(selectedColour));
+        if(matched[i])
+        {
+            matchedPatterns.push_back(i);
+        }
     }
-}
 
-void RegularFile::appendContentsTo(std::ofstream &outputStream) const
-{
-    std::ifstream inputFile(m_pathToFile);
-    if (inputFile.is_open()) 
+    if(!matchedPatterns.empty())
     {
-        outputStream << inputFile.rdbuf();
-        inputFile.close();
-    } 
-    else 
-    {
-        throw std::runtime_error("Could not open file " + m_pathToFile.string());
+        m_isSelected = true;
     }
+    return matchedPatterns;
 }
 
-void RegularFile::selectOnText(const std::string &text)
+void RegularFile::selectOnRegexText(RegexMatcher &matcher)
 {
-    std::ifstream inputFile(m_pathToFile);
-    if (inputFile.is_open()) 
+    Tracer::Span span(Tracer::SELECT_ON_TEXT);
+    InputFile inputFile(openForReading(), m_pathToFile);
+
+    std::string line;
+    while (inputFile.getLine(line)) 
     {
-        std::string fileContents;
-        while (std::getline(inputFile, fileContents)) 
+        span.addBytes(line.size() + 1);
+        if(matcher.matches(line))
         {
-            if(fileContents.find(text) != std::string::npos)
-            {
-                m_isSelected = true;
-                break;
-            }
+            m_isSelected = true;
+            break;
         }
-        inputFile.close();
-    } 
-    else 
-    {
-        throw std::runtime_error("Could not open file " + m_pathToFile.string());
     }
 }
 
@@ -105,26 +199,40 @@ File *RegularFile::clone() const
 
 bool RegularFile::isEqualTo(const File &otherFile) const
 {
-    return getContents() == otherFile.getContents();
+    Tracer::Span span(Tracer::IS_EQUAL_TO);
+    const fs::path &otherPath = otherFile.getPath();
+    if(!fs::is_regular_file(fs::symlink_status(otherPath)))
+    {
+        return false;
+    }
+
+    // Files of different sizes are never read
+    struct stat status;
+    if(!(m_parent ? m_parent->stat(getName(), status) : ::lstat(m_pathToFile.c_str(), &status) == 0))
+        throw std::runtime_error("Could not stat " + m_pathToFile.string() + ": " + std::strerror(errno));
+    uintmax_t size = status.st_size;
+    if(size != fs::file_size(otherPath))
+    {
+        return false;
+    }
+    span.addBytes(size);
+    return FileContents::equal(m_pathToFile, otherPath);
 }
 
 std::string RegularFile::getContents() const
 {
-    std::ifstream file(m_pathToFile);
+    InputFile inputFile(openForReading(), m_pathToFile);
 
-    if(!file.is_open())
+    std::string contents;
+    std::vector<char> buffer(64 * 1024);
+    while (size_t count = inputFile.read(buffer.data(), buffer.size()))
     {
-        throw std::runtime_error("Could not open file " + m_pathToFile.string());
+        contents.append(buffer.data(), count);
     }
-
-    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return contents;
 }
 
-void RegularFile::changeToSymbolicLink(const File &fileToPointAt)
+uintmax_t RegularFile::changeToLink(const File &fileToPointAt, Deduplicator::Mode mode)
 {
-    fs::path pathToPointAt = fileToPointAt.getPath();
-    fs::path currentPath = m_pathToFile;
-
-    fs::remove(currentPath);
-    fs::create_symlink(pathToPointAt, currentPath);
+    return Deduplicator::replace(fileToPointAt.getPath(), m_pathToFile, mode);
 }
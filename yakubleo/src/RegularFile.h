@@ -1,6 +1,5 @@
 #pragma once
 #include <filesystem>
-#include <ncurses.h>
 #include "File.h"
 
 /**
@@ -47,16 +46,10 @@ public:
     void remove() override;
 
     /**
-     * @brief Prints the regular file name.
-     *
-     * This function prints the regular file name.
-     *
-     * @param row The row number for printing.
-     * @param column The column number for printing.
-     * @param normalColour The color pair number for normal display.
-     * @param selectedColour The color pair for number selected display.
+     * @brief Gets the letter of a regular file.
+     * @return F.
      */
-    void print(int row, int column, int normalColour, int selectedColour) const override;
+    char getTypeLetter() const override;
 
     /**
      * @brief Appends the contents of the regular file to the output stream.
@@ -72,6 +65,23 @@ public:
      */
     void selectOnText(const std::string &text) override;
 
+    /**
+     * @brief Selects the regular file if the file contents contain any of the patterns.
+     *
+     * The file is read once in fixed size chunks, the reading stops as soon as all the patterns are found.
+     *
+     * @param automaton The compiled patterns.
+     * @return Indexes of the patterns found in the file.
+     */
+    std::vector<size_t> selectOnPatterns(const AhoCorasick &automaton) override;
+
+    /**
+     * @brief Selects the regular file if a line of the file contents matches the regular expression.
+     *
+     * @param matcher The matcher of the regular expression in search mode.
+     */
+    void selectOnRegexText(RegexMatcher &matcher) override;
+
     /**
      * @brief Clones the regular file.
      *
@@ -84,6 +94,8 @@ public:
     /**
      * @brief Compares the regular file to another file.
      *
+     * The sizes are compared first, the contents are then compared block by block without reading the whole files into memory.
+     *
      * @param otherFile The other file to compare the regular file to.
      * @return True if the regular file is equal to the other file, false otherwise.
      */
@@ -97,9 +109,13 @@ public:
     std::string getContents() const override;
 
     /**
-     * @brief Changes the regular file to a symbolic link.
+     * @brief Replaces the regular file by a link to an identical file.
+     *
+     * The link is created under a temporary name and renamed over the regular file.
      *
-     * @param fileToPointAt The file to point the symbolic link to.
+     * @param fileToPointAt The file to link to.
+     * @param mode The kind of the link.
+     * @return The number of bytes reclaimed.
      */
-    void changeToSymbolicLink(const File &fileToPointAt) override;
+    uintmax_t changeToLink(const File &fileToPointAt, Deduplicator::Mode mode) override;
 };
\ No newline at end of file
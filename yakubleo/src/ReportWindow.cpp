@@ -0,0 +1,54 @@
+#include "ReportWindow.h"
+#include <algorithm>
+
+ReportWindow::ReportWindow(const std::string &title, const std::vector<std::string> &lines) : m_title(title), m_lines(lines)
+{
+}
+
+void ReportWindow::show() const
+{
+    size_t firstLine = 0;
+    size_t visibleLines = LINES > 2 ? LINES - 2 : 1;
+
+    while(true)
+    {
+        printFrom(firstLine);
+
+        int ch = getch();
+        if(ch == KEY_UP)
+        {
+            if(firstLine > 0)
+                firstLine--;
+        }
+        else if(ch == KEY_DOWN)
+        {
+            if(firstLine + visibleLines < m_lines.size())
+                firstLine++;
+        }
+        else
+        {
+            break;
+        }
+    }
+    clear();
+}
+
+void ReportWindow::printFrom(size_t firstLine) const
+{
+    clear();
+    attron(A_BOLD);
+    mvprintw(0, 0, "%s", m_title.c_str());
+    attroff(A_BOLD);
+
+    int row = 1;
+    for(size_t i = firstLine; i < m_lines.size() && row < LINES - 1; i++)
+    {
+        mvprintw(row, 0, "%s", m_lines[i].c_str());
+        row++;
+    }
+
+    attron(A_DIM);
+    mvprintw(LINES - 1, 0, "%zu/%zu, arrow keys scroll, any other key closes", std::min(firstLine + 1, m_lines.size()), m_lines.size());
+    attroff(A_DIM);
+    refresh();
+}
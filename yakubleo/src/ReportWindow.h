@@ -0,0 +1,38 @@
+#pragma once
+#include <ncurses.h>
+#include <string>
+#include <vector>
+
+/**
+ * @class ReportWindow
+ * @brief Class representing a full screen scrollable report.
+ *
+ * The ReportWindow class shows the results of operations that produce more than a single message.
+ */
+class ReportWindow
+{
+public:
+    /**
+     * @brief Constructor. Stores the report that is going to be shown.
+     * @param title The title printed on the first row.
+     * @param lines The lines of the report.
+     */
+    ReportWindow(const std::string &title, const std::vector<std::string> &lines);
+
+    /**
+     * @brief Shows the report until the user presses a key other than the arrow keys.
+     *
+     * Arrow keys up and down scroll the report.
+     */
+    void show() const;
+
+private:
+    std::string m_title; /**< The title of the report. */
+    std::vector<std::string> m_lines; /**< The lines of the report. */
+
+    /**
+     * @brief Prints the lines of the report starting at the specified line.
+     * @param firstLine The index of the first line to print.
+     */
+    void printFrom(size_t firstLine) const;
+};
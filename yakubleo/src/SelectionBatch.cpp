@@ -0,0 +1,206 @@
+#include "SelectionBatch.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+#include <unordered_map>
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include "SystemCall.h"
+
+namespace
+{
+    /**
+     * @brief Files of the selection handed to one call of the body of parallelFor.
+     */
+    constexpr size_t filesPerPart = 8;
+}
+
+BatchResult SelectionBatch::copy(const std::vector<SelectionGroup> &groups, const fs::path &destination)
+{
+    checkNames(groups);
+    DirectoryHandle destinationDirectory(destination);
+
+    return run(groups, [&](const DirectoryHandle &directory, const std::string &name, const struct stat &status)
+    {
+        Tracer::Span span(Tracer::COPY);
+        uintmax_t bytes = copyEntry(directory, name, status, destinationDirectory);
+        span.addBytes(bytes);
+        return bytes;
+    }, true);
+}
+
+BatchResult SelectionBatch::move(const std::vector<SelectionGroup> &groups, const fs::path &destination)
+{
+    checkNames(groups);
+    DirectoryHandle destinationDirectory(destination);
+
+    return run(groups, [&](const DirectoryHandle &directory, const std::string &name, const struct stat &status)
+    {
+        Tracer::Span span(Tracer::MOVE);
+        if(directory.rename(name, destinationDirectory))
+            return uintmax_t(0);
+
+        // Another filesystem gets a copy, the original is removed only once the copy is complete
+        uintmax_t bytes = copyEntry(directory, name, status, destinationDirectory);
+        directory.removeAll(name);
+        span.addBytes(bytes);
+        return bytes;
+    }, true);
+}
+
+BatchResult SelectionBatch::moveToTrash(const std::vector<SelectionGroup> &groups, Trash &trash)
+{
+    return run(groups, [&](const DirectoryHandle &directory, const std::string &name, const struct stat &status)
+    {
+        Tracer::Span span(Tracer::REMOVE);
+        trash.moveToTrash(directory.getPath() / name);
+        return uintmax_t(0);
+    }, true);
+}
+
+BatchResult SelectionBatch::remove(const std::vector<SelectionGroup> &groups)
+{
+    return run(groups, [](const DirectoryHandle &directory, const std::string &name, const struct stat &status)
+    {
+        Tracer::Span span(Tracer::REMOVE);
+        directory.removeAll(name);
+        return uintmax_t(0);
+    }, true);
+}
+
+BatchResult SelectionBatch::concatenate(const std::vector<SelectionGroup> &groups, std::ostream &output)
+{
+    std::vector<char> buffer(256 * 1024);
+    return run(groups, [&](const DirectoryHandle &directory, const std::string &name, const struct stat &status)
+    {
+        // Directories and links have no contents of their own
+        if(!S_ISREG(status.st_mode))
+            return uintmax_t(0);
+
+        Tracer::Span span(Tracer::APPEND_CONTENTS);
+        Descriptor input(directory.openFile(name, O_RDONLY));
+
+        uintmax_t bytes = 0;
+        ssize_t count;
+        while((count = ::read(input.get(), buffer.data(), buffer.size())) > 0)
+        {
+            if(!output.write(buffer.data(), count))
+                throw std::runtime_error("Could not write the contents of " + (directory.getPath() / name).string());
+            bytes += count;
+        }
+        if(count < 0)
+            throw systemError("Could not read", directory.getPath() / name);
+        span.addBytes(bytes);
+        return bytes;
+    }, false);
+}
+
+BatchResult SelectionBatch::run(const std::vector<SelectionGroup> &groups, const Action &action, bool isParallel)
+{
+    BatchResult result;
+    std::mutex mutex;
+    std::atomic<size_t> doneCount(0);
+    std::atomic<uintmax_t> bytes(0);
+    auto fail = [&](const std::string &error, size_t count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(result.failures == 0)
+            result.firstError = error;
+        result.failures += count;
+    };
+
+    for(size_t windowStart = 0; windowStart < groups.size(); windowStart += maximalOpenDirectories)
+    {
+        size_t windowEnd = std::min(groups.size(), windowStart + maximalOpenDirectories);
+
+        // Every file of the window as the index of its group and its index in the group
+        std::vector<std::unique_ptr<DirectoryHandle>> directories(windowEnd - windowStart);
+        std::vector<std::pair<size_t, size_t>> files;
+        for(size_t i = windowStart; i < windowEnd; i++)
+        {
+            try
+            {
+                directories[i - windowStart] = std::make_unique<DirectoryHandle>(groups[i].directory);
+            }
+            catch(const std::exception &e)
+            {
+                fail(e.what(), groups[i].names.size());
+                continue;
+            }
+            for(size_t j = 0; j < groups[i].names.size(); j++)
+            {
+                files.emplace_back(i, j);
+            }
+        }
+
+        auto body = [&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i++)
+            {
+                const SelectedName &name = groups[files[i].first].names[files[i].second];
+                const DirectoryHandle &directory = *directories[files[i].first - windowStart];
+                try
+                {
+                    struct stat status;
+                    if(!directory.stat(name.name, status))
+                        throw systemError("Could not stat", directory.getPath() / name.name);
+                    if(uint64_t(status.st_dev) != name.key.device || uint64_t(status.st_ino) != name.key.inode)
+                        throw std::runtime_error((directory.getPath() / name.name).string() + " was replaced since it was selected");
+
+                    bytes += action(directory, name.name, status);
+                    doneCount++;
+                }
+                catch(const std::exception &e)
+                {
+                    fail(e.what(), 1);
+                }
+            }
+        };
+
+        if(isParallel)
+            ThreadPool::parallelFor(files.size(), body, filesPerPart);
+        else
+            body(0, files.size());
+    }
+
+    result.doneCount = doneCount;
+    result.bytes = bytes;
+    return result;
+}
+
+void SelectionBatch::checkNames(const std::vector<SelectionGroup> &groups)
+{
+    std::unordered_map<std::string, const fs::path *> directories;
+    for(const auto& group : groups)
+    {
+        for(const auto& name : group.names)
+        {
+            auto [found, isInserted] = directories.try_emplace(name.name, &group.directory);
+            if(!isInserted)
+                throw std::runtime_error("Selected files in " + found->second->string() + " and " + group.directory.string() + " are both named " + name.name);
+        }
+    }
+}
+
+uintmax_t SelectionBatch::copyEntry(const DirectoryHandle &directory, const std::string &name, const struct stat &status, const DirectoryHandle &destination)
+{
+    if(S_ISDIR(status.st_mode))
+    {
+        fs::copy(directory.getPath() / name, destination.getPath() / name, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
+        return 0;
+    }
+    if(S_ISLNK(status.st_mode))
+    {
+        destination.createLink(directory.readLink(name), name);
+        return 0;
+    }
+    if(!S_ISREG(status.st_mode))
+        throw std::runtime_error((directory.getPath() / name).string() + " is not a regular file, a directory or a link");
+
+    return directory.copyFile(name, destination);
+}
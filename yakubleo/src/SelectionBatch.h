@@ -0,0 +1,119 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include "DirectoryHandle.h"
+#include "SelectionSet.h"
+#include "Trash.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief The outcome of an operation on a whole selection.
+ */
+struct BatchResult
+{
+    size_t doneCount = 0; /**< The number of files the operation succeeded on. */
+    size_t failures = 0; /**< The number of files it failed on. */
+    uintmax_t bytes = 0; /**< The bytes copied or written. */
+    std::string firstError; /**< Why the first failed file failed. */
+};
+
+/**
+ * @class SelectionBatch
+ * @brief Runs copy, move, trash and concatenate over the files selected in any number of directories as one job.
+ *
+ * The groups of the selection are taken a window of directories at a time: every directory of the window is opened
+ * once as a DirectoryHandle, its files are reached relative to that handle, and the files of the whole window
+ * are split among threads, so a selection spread over thousands of small directories keeps all the threads busy.
+ * Before a file is touched its (device, inode) is compared with the one it had when it was selected, so a file that
+ * was replaced meanwhile fails instead of being processed in its place. A failed file does not stop the others.
+ */
+class SelectionBatch
+{
+public:
+    /**
+     * @brief The number of directories kept open at once.
+     */
+    static constexpr size_t maximalOpenDirectories = 256;
+
+    /**
+     * @brief Copies the files into the destination directory, existing copies of 1 MiB or more are updated by their deltas.
+     * @param groups The selection.
+     * @param destination The directory.
+     * @return The counts, the bytes copied.
+     * @throws std::runtime_error If the destination cannot be opened or two selected files have the same name.
+     */
+    static BatchResult copy(const std::vector<SelectionGroup> &groups, const fs::path &destination);
+
+    /**
+     * @brief Moves the files into the destination directory, by rename on the same filesystem and by copy and remove between filesystems.
+     * @param groups The selection.
+     * @param destination The directory.
+     * @return The counts, the bytes copied between filesystems.
+     * @throws std::runtime_error If the destination cannot be opened or two selected files have the same name.
+     */
+    static BatchResult move(const std::vector<SelectionGroup> &groups, const fs::path &destination);
+
+    /**
+     * @brief Moves the files to the trash of their filesystems.
+     * @param groups The selection.
+     * @param trash The trash.
+     * @return The counts.
+     */
+    static BatchResult moveToTrash(const std::vector<SelectionGroup> &groups, Trash &trash);
+
+    /**
+     * @brief Deletes the files permanently, a directory with everything in it.
+     * @param groups The selection.
+     * @return The counts.
+     */
+    static BatchResult remove(const std::vector<SelectionGroup> &groups);
+
+    /**
+     * @brief Appends the contents of the regular files to the output, in the order of the groups and the names.
+     * @param groups The selection.
+     * @param output The output.
+     * @return The counts, the bytes appended.
+     */
+    static BatchResult concatenate(const std::vector<SelectionGroup> &groups, std::ostream &output);
+
+private:
+    /**
+     * @brief Does the operation on one file.
+     * @param directory The directory of the file.
+     * @param name The name of the file, its identity is checked already.
+     * @param status The status of the file.
+     * @return The bytes copied or written.
+     */
+    using Action = std::function<uintmax_t(const DirectoryHandle &directory, const std::string &name, const struct stat &status)>;
+
+    /**
+     * @brief Runs the action on every selected file, a window of directories at a time.
+     * @param groups The selection.
+     * @param action The operation.
+     * @param isParallel True to split the files of a window among threads, false to keep their order.
+     * @return The counts.
+     */
+    static BatchResult run(const std::vector<SelectionGroup> &groups, const Action &action, bool isParallel);
+
+    /**
+     * @brief Checks that the files can go to one directory.
+     * @param groups The selection.
+     * @throws std::runtime_error If two files have the same name.
+     */
+    static void checkNames(const std::vector<SelectionGroup> &groups);
+
+    /**
+     * @brief Copies one file, a directory with everything in it.
+     * @param directory The directory of the file.
+     * @param name The name of the file.
+     * @param status The status of the file.
+     * @param destination The destination directory.
+     * @return The bytes copied.
+     */
+    static uintmax_t copyEntry(const DirectoryHandle &directory, const std::string &name, const struct stat &status, const DirectoryHandle &destination);
+};
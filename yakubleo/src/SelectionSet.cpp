@@ -0,0 +1,117 @@
+#include "SelectionSet.h"
+#include <algorithm>
+#include <sys/stat.h>
+
+bool SelectionSet::add(const fs::path &path)
+{
+    struct stat status;
+    if(::lstat(path.c_str(), &status) != 0)
+        return false;
+
+    FileKey key{uint64_t(status.st_dev), uint64_t(status.st_ino)};
+    auto location = m_locations.find(key);
+    if(location != m_locations.end())
+    {
+        // The same file selected through another path is kept once, at the path seen last
+        erase(location->second);
+        m_locations.erase(location);
+    }
+
+    auto directory = m_directories.try_emplace(path.parent_path().string()).first;
+    directory->second.device = key.device;
+    auto [name, isInserted] = directory->second.names.try_emplace(path.filename().string(), key);
+    if(!isInserted)
+    {
+        // Another file was selected at this path before it was replaced
+        m_locations.erase(name->second);
+        name->second = key;
+    }
+    m_locations[key] = {&directory->first, &name->first};
+    return true;
+}
+
+void SelectionSet::remove(const fs::path &path)
+{
+    auto directory = m_directories.find(path.parent_path().string());
+    if(directory == m_directories.end())
+        return;
+    auto name = directory->second.names.find(path.filename().string());
+    if(name == directory->second.names.end())
+        return;
+
+    FileKey key = name->second;
+    erase(m_locations.at(key));
+    m_locations.erase(key);
+}
+
+bool SelectionSet::contains(const fs::path &path) const
+{
+    auto directory = m_directories.find(path.parent_path().string());
+    return directory != m_directories.end() && directory->second.names.count(path.filename().string()) > 0;
+}
+
+bool SelectionSet::containsIn(const fs::path &directory) const
+{
+    return m_directories.count(directory.string()) > 0;
+}
+
+void SelectionSet::clear()
+{
+    m_locations.clear();
+    m_directories.clear();
+}
+
+size_t SelectionSet::size() const
+{
+    return m_locations.size();
+}
+
+bool SelectionSet::empty() const
+{
+    return m_locations.empty();
+}
+
+std::vector<fs::path> SelectionSet::paths() const
+{
+    std::vector<fs::path> paths;
+    paths.reserve(size());
+    for(const auto& group : groups())
+    {
+        for(const auto& name : group.names)
+        {
+            paths.push_back(group.directory / name.name);
+        }
+    }
+    return paths;
+}
+
+std::vector<SelectionGroup> SelectionSet::groups() const
+{
+    std::vector<SelectionGroup> groups;
+    groups.reserve(m_directories.size());
+    for(const auto& [directory, selected] : m_directories)
+    {
+        SelectionGroup group{directory, selected.device, {}};
+        group.names.reserve(selected.names.size());
+        for(const auto& [name, key] : selected.names)
+        {
+            group.names.push_back({name, key});
+        }
+        std::sort(group.names.begin(), group.names.end(), [](const SelectedName &first, const SelectedName &second) { return first.name < second.name; });
+        groups.push_back(std::move(group));
+    }
+
+    std::sort(groups.begin(), groups.end(), [](const SelectionGroup &first, const SelectionGroup &second)
+    {
+        return first.device != second.device ? first.device < second.device : first.directory < second.directory;
+    });
+    return groups;
+}
+
+void SelectionSet::erase(const Location &location)
+{
+    auto directory = m_directories.find(*location.directory);
+    directory->second.names.erase(*location.name);
+    if(directory->second.names.empty())
+        m_directories.erase(directory);
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief The identity of a file, it does not change when the file is renamed.
+ */
+struct FileKey
+{
+    uint64_t device; /**< The device of the file. */
+    uint64_t inode; /**< The inode of the file. */
+
+    bool operator==(const FileKey &other) const
+    {
+        return device == other.device && inode == other.inode;
+    }
+};
+
+/**
+ * @brief A selected file of a directory.
+ */
+struct SelectedName
+{
+    std::string name; /**< The name in the directory. */
+    FileKey key; /**< The identity the file had when it was selected. */
+};
+
+/**
+ * @brief The selected files of one directory.
+ */
+struct SelectionGroup
+{
+    fs::path directory; /**< The directory. */
+    uint64_t device; /**< The device of its files. */
+    std::vector<SelectedName> names; /**< The selected files sorted by their names. */
+};
+
+/**
+ * @class SelectionSet
+ * @brief The files selected in any directory, kept while the listing changes.
+ *
+ * Every file is known by its (device, inode) and by the path it was selected at. The paths are stored as names in
+ * a hash map per directory, so checking whether a listed file is selected needs no system call, and the identities
+ * in a second hash map point at those names, so selecting the same file through another path or after it was renamed
+ * keeps one entry. Both maps are hash tables, which stay constant time per file with millions of files. The groups
+ * of the selection by device and directory let an operation open every directory once.
+ */
+class SelectionSet
+{
+public:
+    /**
+     * @brief Selects a file.
+     * @param path The absolute path of the file.
+     * @return False if it does not exist.
+     */
+    bool add(const fs::path &path);
+
+    /**
+     * @brief Unselects a file.
+     * @param path The absolute path of the file.
+     */
+    void remove(const fs::path &path);
+
+    /**
+     * @brief Tells if the file at the path is selected.
+     * @param path The absolute path of the file.
+     * @return True if it is.
+     */
+    bool contains(const fs::path &path) const;
+
+    /**
+     * @brief Tells if a file of the directory is selected.
+     * @param directory The absolute path of the directory.
+     * @return True if one is.
+     */
+    bool containsIn(const fs::path &directory) const;
+
+    /**
+     * @brief Unselects everything.
+     */
+    void clear();
+
+    /**
+     * @brief Gets the number of selected files.
+     * @return The number.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Tells if nothing is selected.
+     * @return True if nothing is.
+     */
+    bool empty() const;
+
+    /**
+     * @brief Gets the paths of the selected files.
+     * @return The paths sorted by their directories and names.
+     */
+    std::vector<fs::path> paths() const;
+
+    /**
+     * @brief Groups the selected files by their devices and directories.
+     * @return The groups sorted by the devices and the directories.
+     */
+    std::vector<SelectionGroup> groups() const;
+
+private:
+    /**
+     * @brief Hash functor of the (device, inode) key.
+     */
+    struct KeyHasher
+    {
+        size_t operator()(const FileKey &key) const
+        {
+            return key.device * 0x9E3779B97F4A7C15ULL ^ key.inode;
+        }
+    };
+
+    /**
+     * @brief The selected files of one directory by their names.
+     */
+    struct Directory
+    {
+        uint64_t device = 0; /**< The device of the last file selected in it. */
+        std::unordered_map<std::string, FileKey> names; /**< The identities of the selected files by their names. */
+    };
+
+    /**
+     * @brief Where a selected file is, the pointers stay valid because the hash maps keep their nodes in place.
+     */
+    struct Location
+    {
+        const std::string *directory; /**< The key of its directory in m_directories. */
+        const std::string *name; /**< The key of its name in the names of the directory. */
+    };
+
+    std::unordered_map<std::string, Directory> m_directories; /**< The selected files by their directories. */
+    std::unordered_map<FileKey, Location, KeyHasher> m_locations; /**< Where every selected file is. */
+
+    /**
+     * @brief Removes the name from its directory and the directory if it becomes empty.
+     * @param location Where the file is.
+     */
+    void erase(const Location &location);
+};
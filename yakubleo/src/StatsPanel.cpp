@@ -0,0 +1,49 @@
+#include "StatsPanel.h"
+#include <cstdio>
+#include "DiskUsage.h"
+
+void StatsPanel::print() const
+{
+    int row = LINES - 1 - height();
+    attron(A_REVERSE);
+    mvprintw(row, 0, "%-16s %8s %8s %8s %8s %8s %8s %8s", "operation", "calls", "bytes", "bytes/s", "p50", "p90", "p99", "max");
+    clrtoeol();
+    attroff(A_REVERSE);
+
+    for(const auto& probe : Tracer::statistics())
+    {
+        row++;
+        move(row, 0);
+        clrtoeol();
+        if(probe.count == 0)
+        {
+            mvprintw(row, 0, "%-16s %8s", probe.name, "-");
+            continue;
+        }
+
+        std::string throughput = probe.bytes && probe.totalNanoseconds ? DiskUsage::formatSize(probe.bytes * 1e9 / probe.totalNanoseconds) : "-";
+        mvprintw(row, 0, "%-16s %8llu %8s %8s %8s %8s %8s %8s", probe.name, (unsigned long long)probe.count,
+                 DiskUsage::formatSize(probe.bytes).c_str(), throughput.c_str(), formatDuration(probe.p50Nanoseconds).c_str(),
+                 formatDuration(probe.p90Nanoseconds).c_str(), formatDuration(probe.p99Nanoseconds).c_str(),
+                 formatDuration(probe.maximalNanoseconds).c_str());
+    }
+}
+
+int StatsPanel::height()
+{
+    return Tracer::PROBE_COUNT + 1;
+}
+
+std::string StatsPanel::formatDuration(uint64_t nanoseconds)
+{
+    char text[32];
+    if(nanoseconds < 1000)
+        std::snprintf(text, sizeof(text), "%lluns", (unsigned long long)nanoseconds);
+    else if(nanoseconds < 1000000)
+        std::snprintf(text, sizeof(text), "%.1fus", nanoseconds / 1e3);
+    else if(nanoseconds < 1000000000)
+        std::snprintf(text, sizeof(text), "%.1fms", nanoseconds / 1e6);
+    else
+        std::snprintf(text, sizeof(text), "%.2fs", nanoseconds / 1e9);
+    return text;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <ncurses.h>
+#include <string>
+#include "Tracer.h"
+
+/**
+ * @class StatsPanel
+ * @brief Class printing the statistics of the tracer over the bottom of the listing.
+ *
+ * Every probe that was called gets a row with its calls, bytes, throughput and latency percentiles, so it shows at
+ * a glance whether an operation spends its time reading directories, copying data, searching or printing.
+ */
+class StatsPanel
+{
+public:
+    /**
+     * @brief Prints the panel so that it ends on the row above the last one.
+     */
+    void print() const;
+
+    /**
+     * @brief Gets the number of rows the panel takes.
+     * @return The rows, a header and one per probe.
+     */
+    static int height();
+
+private:
+    /**
+     * @brief Formats a latency with a unit that keeps it short.
+     * @param nanoseconds The latency.
+     * @return E.g. 850ns, 12.3us, 4.5ms or 1.20s.
+     */
+    static std::string formatDuration(uint64_t nanoseconds);
+};
@@ -0,0 +1,243 @@
+#include "SubtreeHasher.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+#include "FastHash.h"
+#include "TreeWalker.h"
+
+SubtreeHasher::SubtreeHasher(HashCache *hashCache, size_t threadCount) : m_hashCache(hashCache), m_threadCount(threadCount)
+{
+}
+
+void SubtreeHasher::hashTree(const fs::path &root)
+{
+    readTree(root);
+    hashEntries();
+    hashDirectories();
+}
+
+ContentHash SubtreeHasher::getHash(const fs::path &directory) const
+{
+    fs::path key = directory.has_filename() ? directory : directory.parent_path();
+    auto found = m_directoryIndexes.find(key.string());
+    if(found == m_directoryIndexes.end())
+    {
+        throw std::runtime_error("Directory was not hashed " + directory.string());
+    }
+    return m_directories[found->second].hash;
+}
+
+std::vector<SubtreeGroup> SubtreeHasher::findIdenticalSubtrees() const
+{
+    std::unordered_map<ContentHash, std::vector<size_t>, ContentHashHasher> byHash;
+    for(size_t index = 0; index < m_directories.size(); index++)
+    {
+        if(m_directories[index].fileCount > 0 && m_directories[index].isComplete)
+            byHash[m_directories[index].hash].push_back(index);
+    }
+
+    auto isDuplicated = [&](size_t index)
+    {
+        auto found = byHash.find(m_directories[index].hash);
+        return index != 0 && found != byHash.end() && found->second.size() > 1;
+    };
+
+    std::vector<SubtreeGroup> groups;
+    for(const auto& [hash, members] : byHash)
+    {
+        if(members.size() < 2)
+            continue;
+
+        // Members whose parents are identical are covered by the group of the parents, one of them is enough
+        std::map<std::pair<uint64_t, uint64_t>, size_t> representatives;
+        for(size_t member : members)
+        {
+            size_t parent = m_directories[member].parent;
+            std::pair<uint64_t, uint64_t> key = isDuplicated(parent)
+                ? std::make_pair(m_directories[parent].hash.low, m_directories[parent].hash.high)
+                : std::make_pair(uint64_t(member), uint64_t(0));
+            auto [found, inserted] = representatives.emplace(key, member);
+            if(!inserted && m_directories[member].path < m_directories[found->second].path)
+                found->second = member;
+        }
+        if(representatives.size() < 2)
+            continue;
+
+        SubtreeGroup group{hash, m_directories[members.front()].size, m_directories[members.front()].fileCount, {}};
+        for(const auto& [key, member] : representatives)
+        {
+            group.directories.push_back(m_directories[member].path);
+        }
+        std::sort(group.directories.begin(), group.directories.end());
+        groups.push_back(std::move(group));
+    }
+
+    std::sort(groups.begin(), groups.end(), [](const SubtreeGroup &first, const SubtreeGroup &second)
+    {
+        return first.size * (first.directories.size() - 1) > second.size * (second.directories.size() - 1);
+    });
+    return groups;
+}
+
+bool SubtreeHasher::isIdentical(const fs::path &first, const fs::path &second, HashCache *hashCache)
+{
+    // Like the groups of identical subtrees, empty directories are never identical
+    SubtreeHasher hasher(hashCache);
+    hasher.hashTree(first);
+    const DirectoryNode &firstRoot = hasher.m_directories.front();
+    if(!firstRoot.isComplete || firstRoot.fileCount == 0)
+        return false;
+    ContentHash hash = firstRoot.hash;
+
+    hasher.hashTree(second);
+    const DirectoryNode &secondRoot = hasher.m_directories.front();
+    return secondRoot.isComplete && secondRoot.hash == hash;
+}
+
+void SubtreeHasher::readTree(const fs::path &root)
+{
+    fs::path rootPath = root.has_filename() ? root : root.parent_path();
+
+    m_directories.clear();
+    m_directoryIndexes.clear();
+    m_directories.push_back(DirectoryNode{rootPath, 0, 0, {}, ContentHash()});
+    m_directoryIndexes.emplace(rootPath.string(), 0);
+
+    std::mutex mutex;
+    TreeWalker walker(m_threadCount);
+    walker.walk(rootPath, [&](const fs::path &path, const struct stat &status)
+    {
+        Entry entry{path.filename().string(), 'O', status, 0, ContentHash()};
+        if(S_ISREG(status.st_mode))
+            entry.type = 'F';
+        else if(S_ISLNK(status.st_mode))
+            entry.type = 'S';
+        else if(S_ISDIR(status.st_mode))
+            entry.type = 'D';
+
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t parent = m_directoryIndexes.at(path.parent_path().string());
+        if(entry.type == 'D')
+        {
+            entry.directoryIndex = m_directories.size();
+            m_directoryIndexes.emplace(path.string(), entry.directoryIndex);
+            m_directories.push_back(DirectoryNode{path, parent, m_directories[parent].depth + 1, {}, ContentHash()});
+        }
+        m_directories[parent].entries.push_back(std::move(entry));
+    }, [&](const fs::path &directory)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        m_directories[m_directoryIndexes.at(directory.string())].isComplete = false;
+    });
+}
+
+void SubtreeHasher::hashEntries()
+{
+    std::vector<std::pair<const DirectoryNode *, Entry *>> entries;
+    for(auto& directory : m_directories)
+    {
+        for(auto& entry : directory.entries)
+        {
+            if(entry.type != 'D')
+                entries.emplace_back(&directory, &entry);
+        }
+    }
+
+    ThreadPool pool(m_threadCount);
+    const size_t batchSize = 64;
+    for(size_t begin = 0; begin < entries.size(); begin += batchSize)
+    {
+        size_t end = std::min(begin + batchSize, entries.size());
+        pool.submit([this, &entries, begin, end]
+        {
+            for(size_t i = begin; i < end; i++)
+            {
+                Entry &entry = *entries[i].second;
+                fs::path path = entries[i].first->path / entry.name;
+                try
+                {
+                    if(entry.type == 'F')
+                    {
+                        entry.hash = m_hashCache ? m_hashCache->hash(path, entry.status, HashCache::FULL) : FileContents::hash(path);
+                    }
+                    else if(entry.type == 'S')
+                    {
+                        std::string target = fs::read_symlink(path).string();
+                        entry.hash = FastHash::hash(target.data(), target.size());
+                    }
+                    else
+                    {
+                        uint64_t identity[2] = {uint64_t(entry.status.st_mode), uint64_t(entry.status.st_rdev)};
+                        entry.hash = FastHash::hash(identity, sizeof(identity));
+                    }
+                }
+                catch(const std::exception &e)
+                {
+                    // The directory of an unreadable entry is not compared
+                    entry.isHashed = false;
+                }
+            }
+        });
+    }
+    pool.wait();
+}
+
+void SubtreeHasher::hashDirectories()
+{
+    size_t maximalDepth = 0;
+    for(const auto& directory : m_directories)
+    {
+        maximalDepth = std::max(maximalDepth, directory.depth);
+    }
+
+    std::vector<std::vector<size_t>> levels(maximalDepth + 1);
+    for(size_t index = 0; index < m_directories.size(); index++)
+    {
+        levels[m_directories[index].depth].push_back(index);
+    }
+
+    for(size_t depth = maximalDepth + 1; depth-- > 0; )
+    {
+        const std::vector<size_t> &level = levels[depth];
+        ThreadPool::parallelFor(level.size(), [&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i++)
+            {
+                DirectoryNode &directory = m_directories[level[i]];
+                std::sort(directory.entries.begin(), directory.entries.end(), [](const Entry &first, const Entry &second)
+                {
+                    return first.name < second.name;
+                });
+
+                FastHash hasher;
+                for(auto& entry : directory.entries)
+                {
+                    if(entry.type == 'D')
+                    {
+                        const DirectoryNode &subdirectory = m_directories[entry.directoryIndex];
+                        entry.hash = subdirectory.hash;
+                        directory.isComplete = directory.isComplete && subdirectory.isComplete;
+                        directory.size += subdirectory.size;
+                        directory.fileCount += subdirectory.fileCount;
+                    }
+                    else if(!entry.isHashed)
+                    {
+                        directory.isComplete = false;
+                    }
+                    if(entry.type == 'F')
+                    {
+                        directory.size += entry.status.st_size;
+                        directory.fileCount++;
+                    }
+
+                    hasher.update(entry.name.data(), entry.name.size() + 1);
+                    hasher.update(&entry.type, 1);
+                    hasher.update(&entry.hash, sizeof(entry.hash));
+                }
+                directory.hash = hasher.digest();
+            }
+        }, 64);
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+#include "FileContents.h"
+#include "HashCache.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Directories with identical contents.
+ */
+struct SubtreeGroup
+{
+    ContentHash hash; /**< The Merkle hash of the directories. */
+    uintmax_t size; /**< The size of the regular files in one of the directories. */
+    size_t fileCount; /**< The number of regular files in one of the directories. */
+    std::vector<fs::path> directories; /**< The identical directories, at least two. */
+};
+
+/**
+ * @class SubtreeHasher
+ * @brief Computes a Merkle hash of every directory of a tree, identical subtrees get identical hashes.
+ *
+ * The hash of a directory covers the sorted names, types and hashes of its entries: content hashes of regular files,
+ * targets of symbolic links and hashes of subdirectories. The tree is read by one parallel walk,
+ * the regular files are then hashed in parallel and the directories are hashed bottom up, one depth level at a time.
+ * A directory with anything unreadable below it is never reported identical to another one.
+ */
+class SubtreeHasher
+{
+public:
+    /**
+     * @brief Constructor.
+     * @param hashCache The cache of content hashes, nullptr to always read the files.
+     * @param threadCount The number of threads.
+     */
+    SubtreeHasher(HashCache *hashCache = nullptr, size_t threadCount = ThreadPool::defaultThreadCount());
+
+    /**
+     * @brief Hashes the root and every directory below it.
+     * @param root The root of the tree.
+     */
+    void hashTree(const fs::path &root);
+
+    /**
+     * @brief Gets the hash of a directory of the last hashed tree.
+     * @param directory The directory.
+     * @return The hash.
+     * @throws std::runtime_error If the directory is not in the tree.
+     */
+    ContentHash getHash(const fs::path &directory) const;
+
+    /**
+     * @brief Finds the groups of identical non-empty and completely read directories of the last hashed tree.
+     *
+     * A match is reported at the highest level only: when the parents of some directories are identical as well,
+     * only one of them stays in the group, the parents are reported in a group of their own.
+     *
+     * @return The groups, the groups wasting the most space first.
+     */
+    std::vector<SubtreeGroup> findIdenticalSubtrees() const;
+
+    /**
+     * @brief Tells if two directories have the same names, types and contents by their Merkle hashes.
+     * @param first The first directory.
+     * @param second The second directory.
+     * @param hashCache The cache of content hashes, nullptr to always read the files.
+     * @return True if both were read completely, hold some regular files and have the same hash.
+     */
+    static bool isIdentical(const fs::path &first, const fs::path &second, HashCache *hashCache = nullptr);
+
+private:
+    /**
+     * @brief An entry of a directory.
+     */
+    struct Entry
+    {
+        std::string name; /**< The name of the entry. */
+        char type; /**< 'F' regular file, 'D' directory, 'S' symbolic link, 'O' other. */
+        struct stat status; /**< The status of the entry. */
+        size_t directoryIndex; /**< The node of a subdirectory. */
+        ContentHash hash; /**< The content hash of the entry. */
+        bool isHashed = true; /**< False if the entry could not be read. */
+    };
+
+    /**
+     * @brief A directory of the tree.
+     */
+    struct DirectoryNode
+    {
+        fs::path path; /**< The path to the directory. */
+        size_t parent; /**< The node of the parent, the root points to itself. */
+        size_t depth; /**< The distance from the root. */
+        std::vector<Entry> entries; /**< The entries of the directory. */
+        ContentHash hash; /**< The Merkle hash. */
+        uintmax_t size = 0; /**< The size of the regular files in the subtree. */
+        size_t fileCount = 0; /**< The number of regular files in the subtree. */
+        bool isComplete = true; /**< False if something in the subtree could not be read. */
+    };
+
+    HashCache *m_hashCache; /**< The cache of content hashes, may be nullptr. */
+    size_t m_threadCount; /**< The number of threads. */
+    std::vector<DirectoryNode> m_directories; /**< The directories of the last hashed tree, the root first. */
+    std::unordered_map<std::string, size_t> m_directoryIndexes; /**< The node of every directory by its path. */
+
+    /**
+     * @brief Reads the tree into m_directories.
+     * @param root The root of the tree.
+     */
+    void readTree(const fs::path &root);
+
+    /**
+     * @brief Computes the hashes of the entries that are not directories, in parallel.
+     */
+    void hashEntries();
+
+    /**
+     * @brief Computes the hashes of the directories from the deepest ones up.
+     */
+    void hashDirectories();
+};
@@ -1,4 +1,6 @@
 #include "SymbolicLink.h"
+#include <stdexcept>
+#include "Tracer.h"
 
 SymbolicLink::SymbolicLink(const fs::path &pathToFile) : File(pathToFile)
 {
@@ -7,60 +9,27 @@ SymbolicLink::SymbolicLink(const fs::path &pathToFile) : File(pathToFile)
 
 void SymbolicLink::copy(const fs::path &destination)
 {
-    fs::path destinationFilename = destination / m_pathToFile.filename();
-
-    fs::copy_symlink(m_pathToFile, destinationFilename);
-
+    Tracer::Span span(Tracer::COPY);
+    DirectoryHandle destinationDirectory(destination);
+    destinationDirectory.createLink(getParent()->readLink(getName()), getName());
 }
 
 void SymbolicLink::move(const fs::path &destination)
 {
-    fs::rename(m_pathToFile, destination / m_pathToFile.filename());
+    Tracer::Span span(Tracer::MOVE);
+    if(!getParent()->rename(getName(), DirectoryHandle(destination)))
+        throw std::runtime_error("Could not move " + m_pathToFile.string() + " to another filesystem");
 }
 
 void SymbolicLink::remove()
 {
-    fs::remove(m_pathToFile);
+    Tracer::Span span(Tracer::REMOVE);
+    getParent()->remove(getName());
 }
 
-void SymbolicLink::print(int row, int column, int normalColour, int selectedColour )const
+char SymbolicLink::getTypeLetter() const
 {
-    attron(A_NORMAL);
-    mvprintw(row, column, "[S] ");
-    attroff(A_NORMAL);
-
-
-    int indent = 4;
-    if(m_isPointedAt)
-    {
-        
-        attron(COLOR_PAIR(normalColour));
-        attron(A_REVERSE);
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(A_REVERSE);
-        attroff(COLOR_PAIR(normalColour));
-    }
-    else if(m_isSelected)
-    {
-        attron(COLOR_PAIR(selectedColour));
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(COLOR_PAIR(selectedColour));
-    }
-    else
-    {
-        attron(COLOR_PAIR(normalColour));
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(COLOR_PAIR(normalColour));
-    }
-
-    if(m_isPointedAt && m_isSelected)
-    {
-        attron(COLOR_PAIR(selectedColour));
-        attron(A_REVERSE);
-        mvprintw(row, column + indent, " %s", m_pathToFile.filename().c_str());
-        attroff(A_REVERSE);
-        attroff(COLOR_PAIR(selectedColour));
-    }
+    return 'S';
 }
 
 void SymbolicLink::appendContentsTo(std::ofstream &outputStream) const
@@ -73,6 +42,16 @@ void SymbolicLink::selectOnText(const std::string &text)
     // Do nothing
 }
 
+std::vector<size_t> SymbolicLink::selectOnPatterns(const AhoCorasick &automaton)
+{
+    return {};
+}
+
+void SymbolicLink::selectOnRegexText(RegexMatcher &matcher)
+{
+    // Do nothing
+}
+
 File *SymbolicLink::clone() const
 {
     return new SymbolicLink(*this);
@@ -88,7 +67,7 @@ std::string SymbolicLink::getContents() const
     return "";
 }
 
-void SymbolicLink::changeToSymbolicLink(const File &fileToPointAt)
+uintmax_t SymbolicLink::changeToLink(const File &fileToPointAt, Deduplicator::Mode mode)
 {
-    // Do nothing
+    return 0;
 }
@@ -1,6 +1,5 @@
 #pragma once
 #include <filesystem>
-#include <ncurses.h>
 #include "File.h"
 #include <fstream>
 
@@ -44,16 +43,10 @@ public:
     void remove() override;
 
     /**
-     * @brief Prints the symbolic link name.
-     *
-     * This function prints the symbolic link name.
-     *
-     * @param row The row number for printing.
-     * @param column The column number for printing.
-     * @param normalColour The color pair number for normal display.
-     * @param selectedColour The color pair number for selected display.
+     * @brief Gets the letter of a symbolic link.
+     * @return S.
      */
-    void print(int row, int column, int normalColour, int selectedColour ) const override;
+    char getTypeLetter() const override;
 
 
     /**
@@ -66,6 +59,19 @@ public:
      */
     void selectOnText(const std::string &text) override;
 
+    /**
+     * @brief Ignores the patterns so that only regular files are selected.
+     * @param automaton The compiled patterns.
+     * @return Empty vector.
+     */
+    std::vector<size_t> selectOnPatterns(const AhoCorasick &automaton) override;
+
+    /**
+     * @brief Ignores the regular expression so that only regular files are selected.
+     * @param matcher The matcher of the regular expression.
+     */
+    void selectOnRegexText(RegexMatcher &matcher) override;
+
     /**
      * @brief Clones the symbolic link.
      *
@@ -89,8 +95,10 @@ public:
     std::string getContents() const override;
 
     /**
-     * @brief Does nothing. So that only regular files can be changed to symbolic links.
+     * @brief Does nothing. So that only regular files can be changed to links.
      * @param fileToPointAt The file to point at.
+     * @param mode The kind of the link.
+     * @return 0.
      */
-    void changeToSymbolicLink(const File &fileToPointAt) override;
+    uintmax_t changeToLink(const File &fileToPointAt, Deduplicator::Mode mode) override;
 };
\ No newline at end of file
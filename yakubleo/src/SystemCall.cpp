@@ -0,0 +1,43 @@
+#include "SystemCall.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::runtime_error systemError(const std::string &message, const fs::path &path)
+{
+    return std::runtime_error(message + " " + path.string() + ": " + std::strerror(errno));
+}
+
+int renameNoReplace(int fromDirectory, const std::string &from, int toDirectory, const std::string &to)
+{
+    int renamed = ::renameat2(fromDirectory, from.c_str(), toDirectory, to.c_str(), RENAME_NOREPLACE);
+    if(renamed != 0 && errno == EINVAL)
+    {
+        struct stat status;
+        if(::fstatat(toDirectory, to.c_str(), &status, AT_SYMLINK_NOFOLLOW) == 0)
+        {
+            errno = EEXIST;
+            return -1;
+        }
+        renamed = ::renameat(fromDirectory, from.c_str(), toDirectory, to.c_str());
+    }
+    return renamed;
+}
+
+Descriptor::Descriptor(int descriptor) : m_descriptor(descriptor)
+{
+}
+
+Descriptor::~Descriptor()
+{
+    if(m_descriptor >= 0)
+        ::close(m_descriptor);
+}
+
+int Descriptor::get() const
+{
+    return m_descriptor;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Makes the exception of a failed system call, with the text of errno.
+ * @param message What failed, e.g. "Could not open".
+ * @param path The path it failed on.
+ * @return The exception to throw.
+ */
+std::runtime_error systemError(const std::string &message, const fs::path &path);
+
+/**
+ * @brief Renames an entry unless something already has the new name.
+ *
+ * Filesystems without RENAME_NOREPLACE get the check and the rename separately.
+ *
+ * @param fromDirectory The directory of the entry, AT_FDCWD for paths relative to the working directory.
+ * @param from The name of the entry.
+ * @param toDirectory The directory of the new name.
+ * @param to The new name.
+ * @return 0 on success, -1 with errno set otherwise, EEXIST if the new name is taken.
+ */
+int renameNoReplace(int fromDirectory, const std::string &from, int toDirectory, const std::string &to);
+
+/**
+ * @class Descriptor
+ * @brief Closes the file descriptor when it goes out of scope.
+ */
+class Descriptor
+{
+public:
+    /**
+     * @brief Takes over the descriptor.
+     * @param descriptor The descriptor, negative for none.
+     */
+    Descriptor(int descriptor);
+
+    ~Descriptor();
+
+    Descriptor(const Descriptor &) = delete;
+    Descriptor &operator=(const Descriptor &) = delete;
+
+    /**
+     * @brief Gets the descriptor.
+     * @return The descriptor, negative for none.
+     */
+    int get() const;
+
+private:
+    int m_descriptor; /**< The owned descriptor. */
+};
@@ -0,0 +1,633 @@
+#include "TarArchive.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include "SystemCall.h"
+
+namespace
+{
+    constexpr char magic[8] = {'Y', 'K', 'T', 'A', 'R', 'I', 'X', '2'};
+
+    constexpr uint64_t blockSize = 512;
+
+    /**
+     * @brief The largest long name or pax header read, anything larger is a corrupted archive.
+     */
+    constexpr uint64_t maximalHeaderDataSize = 1 << 20;
+
+    int64_t nanoseconds(const struct timespec &time)
+    {
+        return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+
+    /**
+     * @brief Parses a numeric field of a header, octal text or a GNU base-256 number.
+     */
+    uint64_t parseNumber(const char *field, size_t length)
+    {
+        if(static_cast<unsigned char>(field[0]) & 0x80)
+        {
+            uint64_t value = static_cast<unsigned char>(field[0]) & 0x7F;
+            for(size_t i = 1; i < length; i++)
+            {
+                value = value << 8 | static_cast<unsigned char>(field[i]);
+            }
+            return value;
+        }
+
+        size_t i = 0;
+        while(i < length && (field[i] == ' ' || field[i] == '\0'))
+            i++;
+        uint64_t value = 0;
+        for(; i < length && field[i] >= '0' && field[i] <= '7'; i++)
+        {
+            value = value * 8 + (field[i] - '0');
+        }
+        return value;
+    }
+
+    /**
+     * @brief Gets a text field of a header, it ends at the first zero byte or at its length.
+     */
+    std::string parseText(const char *field, size_t length)
+    {
+        return std::string(field, ::strnlen(field, length));
+    }
+
+    bool isZeroBlock(const char *block)
+    {
+        return std::all_of(block, block + blockSize, [](char byte) { return byte == '\0'; });
+    }
+
+    /**
+     * @brief Checks the checksum of a header, old archives summed signed bytes.
+     */
+    bool isChecksumValid(const char *block)
+    {
+        uint64_t unsignedSum = 0;
+        int64_t signedSum = 0;
+        for(size_t i = 0; i < blockSize; i++)
+        {
+            bool isChecksumField = i >= 148 && i < 156;
+            unsignedSum += isChecksumField ? ' ' : static_cast<unsigned char>(block[i]);
+            signedSum += isChecksumField ? ' ' : static_cast<signed char>(block[i]);
+        }
+        uint64_t checksum = parseNumber(block + 148, 8);
+        return checksum == unsignedSum || int64_t(checksum) == signedSum;
+    }
+
+    /**
+     * @brief Makes the path of a member relative and lexically normal, a directory loses its trailing /.
+     */
+    std::string normalizePath(const std::string &path)
+    {
+        std::string normal = fs::path(path).lexically_normal().relative_path().string();
+        while(!normal.empty() && normal.back() == '/')
+            normal.pop_back();
+        return normal == "." ? "" : normal;
+    }
+
+    /**
+     * @brief Tells if a normalized member path leaves the directory it is extracted into.
+     */
+    bool isEscaping(const std::string &path)
+    {
+        return path == ".." || path.compare(0, 3, "../") == 0;
+    }
+
+    /**
+     * @brief Parses the records "LENGTH KEY=VALUE\n" of a pax header.
+     */
+    std::unordered_map<std::string, std::string> parsePax(const std::string &data)
+    {
+        std::unordered_map<std::string, std::string> records;
+        size_t position = 0;
+        while(position < data.size())
+        {
+            size_t space = data.find(' ', position);
+            if(space == std::string::npos)
+                break;
+            size_t length = std::strtoull(data.c_str() + position, nullptr, 10);
+            if(length <= space - position || position + length > data.size())
+                break;
+            size_t equals = data.find('=', space);
+            if(equals < position + length)
+                records[data.substr(space + 1, equals - space - 1)] = data.substr(equals + 1, position + length - equals - 2);
+            position += length;
+        }
+        return records;
+    }
+}
+
+TarArchive::TarArchive(const fs::path &archive)
+    : m_path(archive), m_descriptor(::open(archive.c_str(), O_RDONLY | O_CLOEXEC)), m_isIndexCached(false),
+    m_skippedCount(0)
+{
+    if(m_descriptor < 0)
+        throw systemError("Could not open archive", archive);
+
+    struct stat status;
+    if(::fstat(m_descriptor, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        ::close(m_descriptor);
+        throw std::runtime_error(archive.string() + " is not a regular file");
+    }
+
+    try
+    {
+        m_isIndexCached = loadIndex(status);
+        if(!m_isIndexCached)
+        {
+            scan(status.st_size);
+            buildTree();
+            saveIndex(status);
+        }
+        else
+        {
+            buildTree();
+        }
+    }
+    catch(...)
+    {
+        ::close(m_descriptor);
+        throw;
+    }
+}
+
+TarArchive::~TarArchive()
+{
+    ::close(m_descriptor);
+}
+
+bool TarArchive::isArchiveName(const fs::path &path)
+{
+    return path.extension() == ".tar";
+}
+
+const fs::path &TarArchive::getPath() const
+{
+    return m_path;
+}
+
+const std::vector<TarEntry> &TarArchive::getEntries() const
+{
+    return m_entries;
+}
+
+std::vector<size_t> TarArchive::list(const std::string &directory) const
+{
+    auto children = m_children.find(directory);
+    return children != m_children.end() ? children->second : std::vector<size_t>();
+}
+
+bool TarArchive::isIndexCached() const
+{
+    return m_isIndexCached;
+}
+
+size_t TarArchive::getSkippedCount() const
+{
+    return m_skippedCount;
+}
+
+size_t TarArchive::read(const TarEntry &entry, uint64_t offset, char *buffer, size_t size) const
+{
+    if(offset >= entry.size)
+        return 0;
+    size = std::min<uint64_t>(size, entry.size - offset);
+
+    size_t done = 0;
+    while(done < size)
+    {
+        ssize_t count = ::pread(m_descriptor, buffer + done, size - done, entry.dataOffset + offset + done);
+        if(count < 0)
+            throw systemError("Could not read archive", m_path);
+        if(count == 0)
+            break;
+        done += count;
+    }
+    return done;
+}
+
+BatchResult TarArchive::extract(const std::vector<size_t> &entries, const fs::path &destination) const
+{
+    BatchResult result;
+    std::mutex mutex;
+    std::atomic<size_t> doneCount(0);
+    std::atomic<uintmax_t> bytes(0);
+    auto fail = [&](const std::string &error)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(result.failures++ == 0)
+            result.firstError = error;
+    };
+
+    // Every selected member with the members below it, the paths relative to the directory of the selected member
+    std::vector<std::pair<size_t, fs::path>> directories, files, links;
+    for(size_t selected : entries)
+    {
+        const std::string &selectedPath = m_entries.at(selected).path;
+        size_t baseLength = selectedPath.rfind('/') == std::string::npos ? 0 : selectedPath.rfind('/') + 1;
+
+        std::vector<size_t> pending{selected};
+        while(!pending.empty())
+        {
+            size_t index = pending.back();
+            pending.pop_back();
+            const TarEntry &entry = m_entries[index];
+            if(isEscaping(entry.path))
+            {
+                fail("The member " + entry.path + " leaves the destination");
+                continue;
+            }
+
+            fs::path target = destination / entry.path.substr(baseLength);
+            if(entry.type == '5')
+            {
+                directories.emplace_back(index, target);
+                std::vector<size_t> children = list(entry.path);
+                pending.insert(pending.end(), children.begin(), children.end());
+            }
+            else if(entry.type == '2')
+                links.emplace_back(index, target);
+            else
+                files.emplace_back(index, target);
+        }
+    }
+
+    std::sort(directories.begin(), directories.end(), [](const auto &first, const auto &second) { return first.second < second.second; });
+    for(const auto& [index, target] : directories)
+    {
+        std::error_code error;
+        fs::create_directories(target, error);
+        if(error)
+            fail("Could not create " + target.string() + ": " + error.message());
+        else
+            doneCount++;
+    }
+
+    ThreadPool::parallelFor(files.size(), [&](size_t begin, size_t end)
+    {
+        std::vector<char> buffer(1 << 20);
+        for(size_t i = begin; i < end; i++)
+        {
+            const TarEntry &entry = m_entries[files[i].first];
+            const fs::path &target = files[i].second;
+            try
+            {
+                Tracer::Span span(Tracer::COPY);
+                std::error_code error;
+                fs::create_directories(target.parent_path(), error);
+                Descriptor output(::open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600));
+                if(output.get() < 0)
+                    throw systemError("Could not create", target);
+
+                for(uint64_t offset = 0; offset < entry.size; )
+                {
+                    size_t count = read(entry, offset, buffer.data(), buffer.size());
+                    if(count == 0)
+                        throw std::runtime_error("The archive ends inside " + entry.path);
+                    for(size_t written = 0; written < count; )
+                    {
+                        ssize_t result = ::write(output.get(), buffer.data() + written, count - written);
+                        if(result < 0)
+                            throw systemError("Could not write", target);
+                        written += result;
+                    }
+                    offset += count;
+                }
+
+                struct timespec times[2] = {{0, UTIME_OMIT}, {time_t(entry.modified), 0}};
+                ::futimens(output.get(), times);
+                if(::fchmod(output.get(), entry.mode) != 0)
+                    throw systemError("Could not set the permissions of", target);
+                span.addBytes(entry.size);
+                bytes += entry.size;
+                doneCount++;
+            }
+            catch(const std::exception &e)
+            {
+                fail(e.what());
+            }
+        }
+    }, 1);
+
+    for(const auto& [index, target] : links)
+    {
+        if(::symlink(m_entries[index].linkTarget.c_str(), target.c_str()) != 0)
+            fail(systemError("Could not create the link", target).what());
+        else
+            doneCount++;
+    }
+
+    // The permissions of the directories may forbid writing into them, they are set last
+    for(const auto& [index, target] : directories)
+    {
+        std::error_code error;
+        fs::permissions(target, fs::perms(m_entries[index].mode), error);
+    }
+
+    result.doneCount = doneCount;
+    result.bytes = bytes;
+    return result;
+}
+
+fs::path TarArchive::indexPathOf(const fs::path &archive)
+{
+    return archive.parent_path() / ("." + archive.filename().string() + ".index");
+}
+
+void TarArchive::scan(uint64_t archiveSize)
+{
+    // Headers of small members lie close together, they are read a window at a time
+    std::vector<char> window(64 * 1024);
+    uint64_t windowStart = 0;
+    uint64_t windowLength = 0;
+    auto readBlock = [&](uint64_t offset) -> const char *
+    {
+        if(offset < windowStart || offset + blockSize > windowStart + windowLength)
+        {
+            ssize_t count = ::pread(m_descriptor, window.data(), window.size(), offset);
+            if(count < 0)
+                throw systemError("Could not read archive", m_path);
+            windowStart = offset;
+            windowLength = count;
+            if(offset == 0 && count > 0 && uint64_t(count) < blockSize)
+                throw std::runtime_error(m_path.string() + " is not a tar archive");
+            if(uint64_t(count) < blockSize)
+                return nullptr;
+        }
+        return window.data() + (offset - windowStart);
+    };
+    auto readData = [&](uint64_t offset, uint64_t size)
+    {
+        if(size > maximalHeaderDataSize)
+            throw std::runtime_error(m_path.string() + " has a corrupted header at " + std::to_string(offset));
+        std::string data(size, '\0');
+        if(::pread(m_descriptor, data.data(), size, offset) != ssize_t(size))
+            throw std::runtime_error(m_path.string() + " ends inside a header at " + std::to_string(offset));
+        return data;
+    };
+
+    std::unordered_map<std::string, size_t> indexes;
+    std::string longName;
+    std::string longLink;
+    std::unordered_map<std::string, std::string> pax;
+    uint64_t offset = 0;
+    while(const char *block = readBlock(offset))
+    {
+        if(isZeroBlock(block))
+            break;
+        if(!isChecksumValid(block))
+        {
+            if(offset == 0)
+                throw std::runtime_error(m_path.string() + " is not a tar archive");
+            throw std::runtime_error(m_path.string() + " has a corrupted header at " + std::to_string(offset));
+        }
+
+        char type = block[156];
+        uint64_t size = parseNumber(block + 124, 12);
+        uint64_t dataOffset = offset + blockSize;
+        // Pax records describe the member after all the extended headers, not the next extended header
+        bool isExtendedHeader = type == 'L' || type == 'K' || type == 'x' || type == 'g';
+        if(auto found = pax.find("size"); found != pax.end() && !isExtendedHeader)
+            size = std::strtoull(found->second.c_str(), nullptr, 10);
+        // Base-256 and pax sizes are unbounded, a size past the end would wrap the offset around
+        if(size > archiveSize - dataOffset)
+            throw std::runtime_error(m_path.string() + " ends inside the member at " + std::to_string(offset));
+        uint64_t nextOffset = dataOffset + (size + blockSize - 1) / blockSize * blockSize;
+        if(nextOffset <= offset)
+            throw std::runtime_error(m_path.string() + " has a corrupted header at " + std::to_string(offset));
+        offset = nextOffset;
+
+        // Extended headers describe the member that follows them
+        if(type == 'L' || type == 'K')
+        {
+            std::string data = readData(dataOffset, size);
+            (type == 'L' ? longName : longLink) = data.substr(0, data.find('\0'));
+            continue;
+        }
+        if(type == 'x')
+        {
+            for(auto& [key, value] : parsePax(readData(dataOffset, size)))
+            {
+                pax[key] = value;
+            }
+            continue;
+        }
+        if(type == 'g')
+            continue;
+
+        std::string name = parseText(block, 100);
+        std::string prefix = parseText(block + 345, 155);
+        if(std::memcmp(block + 257, "ustar", 5) == 0 && !prefix.empty() && block[262] == '\0')
+            name = prefix + "/" + name;
+        if(!longName.empty())
+            name = longName;
+        if(auto found = pax.find("path"); found != pax.end())
+            name = found->second;
+
+        TarEntry entry;
+        entry.path = normalizePath(name);
+        entry.type = type;
+        entry.size = size;
+        entry.dataOffset = dataOffset;
+        entry.mode = parseNumber(block + 100, 8) & 07777;
+        entry.modified = parseNumber(block + 136, 12);
+        if(auto found = pax.find("mtime"); found != pax.end())
+            entry.modified = std::strtoll(found->second.c_str(), nullptr, 10);
+        entry.linkTarget = !longLink.empty() ? longLink : parseText(block + 157, 100);
+        if(auto found = pax.find("linkpath"); found != pax.end())
+            entry.linkTarget = found->second;
+        longName.clear();
+        longLink.clear();
+        pax.clear();
+
+        // Like tar, members leaving the directory they are extracted into are skipped, and counted to be reported
+        if(isEscaping(entry.path))
+        {
+            m_skippedCount++;
+            continue;
+        }
+
+        if(entry.type == '\0' || entry.type == '7')
+            entry.type = '0';
+        if(entry.type == '1')
+        {
+            // A hard link shares the data of a member before it
+            auto target = indexes.find(normalizePath(entry.linkTarget));
+            if(target == indexes.end() || m_entries[target->second].type != '0')
+                continue;
+            entry.type = '0';
+            entry.size = m_entries[target->second].size;
+            entry.dataOffset = m_entries[target->second].dataOffset;
+            entry.linkTarget.clear();
+        }
+        if(entry.path.empty() || (entry.type != '0' && entry.type != '2' && entry.type != '5'))
+            continue;
+        if(entry.type == '5')
+            entry.size = 0;
+
+        // A member added again later replaces the earlier one, as when tar extracts it
+        auto [existing, isInserted] = indexes.try_emplace(entry.path, m_entries.size());
+        if(isInserted)
+            m_entries.push_back(std::move(entry));
+        else
+            m_entries[existing->second] = std::move(entry);
+    }
+}
+
+void TarArchive::buildTree()
+{
+    std::unordered_map<std::string, size_t> indexes;
+    for(size_t i = 0; i < m_entries.size(); i++)
+    {
+        indexes.emplace(m_entries[i].path, i);
+    }
+
+    // The directories added on the way are in m_entries too and get their parents in turn
+    for(size_t i = 0; i < m_entries.size(); i++)
+    {
+        size_t slash = m_entries[i].path.rfind('/');
+        std::string parent = slash == std::string::npos ? "" : m_entries[i].path.substr(0, slash);
+        if(!parent.empty() && indexes.try_emplace(parent, m_entries.size()).second)
+            m_entries.push_back({parent, '5', 0, 0, 0755, m_entries[i].modified, ""});
+        m_children[parent].push_back(i);
+    }
+
+    for(auto& [directory, children] : m_children)
+    {
+        std::sort(children.begin(), children.end(), [this](size_t first, size_t second) { return m_entries[first].path < m_entries[second].path; });
+    }
+}
+
+bool TarArchive::loadIndex(const struct stat &status)
+{
+    for(const fs::path &indexPath : {indexPathOf(m_path), cacheIndexPath()})
+    {
+        std::ifstream input(indexPath, std::ios::binary);
+        if(!input.is_open())
+            continue;
+
+        char fileMagic[sizeof(magic)];
+        uint64_t size, inode, count, skipped;
+        int64_t modified;
+        input.read(fileMagic, sizeof(fileMagic));
+        input.read(reinterpret_cast<char *>(&size), sizeof(size));
+        input.read(reinterpret_cast<char *>(&modified), sizeof(modified));
+        input.read(reinterpret_cast<char *>(&inode), sizeof(inode));
+        input.read(reinterpret_cast<char *>(&count), sizeof(count));
+        input.read(reinterpret_cast<char *>(&skipped), sizeof(skipped));
+        if(!input || std::memcmp(fileMagic, magic, sizeof(magic)) != 0 || size != uint64_t(status.st_size)
+            || modified != nanoseconds(status.st_mtim) || inode != uint64_t(status.st_ino))
+            continue;
+
+        std::vector<TarEntry> entries;
+        for(uint64_t i = 0; i < count && input; i++)
+        {
+            TarEntry entry;
+            uint32_t pathLength, linkLength;
+            input.read(&entry.type, sizeof(entry.type));
+            input.read(reinterpret_cast<char *>(&entry.mode), sizeof(entry.mode));
+            input.read(reinterpret_cast<char *>(&entry.size), sizeof(entry.size));
+            input.read(reinterpret_cast<char *>(&entry.dataOffset), sizeof(entry.dataOffset));
+            input.read(reinterpret_cast<char *>(&entry.modified), sizeof(entry.modified));
+            input.read(reinterpret_cast<char *>(&pathLength), sizeof(pathLength));
+            input.read(reinterpret_cast<char *>(&linkLength), sizeof(linkLength));
+            if(!input || pathLength > maximalHeaderDataSize || linkLength > maximalHeaderDataSize)
+                break;
+            entry.path.resize(pathLength);
+            entry.linkTarget.resize(linkLength);
+            input.read(entry.path.data(), pathLength);
+            input.read(entry.linkTarget.data(), linkLength);
+            entries.push_back(std::move(entry));
+        }
+        if(!input || entries.size() != count)
+            continue;
+
+        m_entries = std::move(entries);
+        m_skippedCount = skipped;
+        return true;
+    }
+    return false;
+}
+
+void TarArchive::saveIndex(const struct stat &status) const
+{
+    // The index only saves time, an archive in a read-only directory keeps it in the cache directory
+    for(const fs::path &indexPath : {indexPathOf(m_path), cacheIndexPath()})
+    {
+        if(indexPath.empty())
+            continue;
+
+        std::error_code error;
+        fs::create_directories(indexPath.parent_path(), error);
+        fs::path temporaryPath = indexPath;
+        temporaryPath += ".tmp";
+        {
+            std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+            if(!output.is_open())
+                continue;
+
+            uint64_t size = status.st_size;
+            int64_t modified = nanoseconds(status.st_mtim);
+            uint64_t inode = status.st_ino;
+            uint64_t count = m_entries.size();
+            uint64_t skipped = m_skippedCount;
+            output.write(magic, sizeof(magic));
+            output.write(reinterpret_cast<const char *>(&size), sizeof(size));
+            output.write(reinterpret_cast<const char *>(&modified), sizeof(modified));
+            output.write(reinterpret_cast<const char *>(&inode), sizeof(inode));
+            output.write(reinterpret_cast<const char *>(&count), sizeof(count));
+            output.write(reinterpret_cast<const char *>(&skipped), sizeof(skipped));
+            for(const auto& entry : m_entries)
+            {
+                uint32_t pathLength = entry.path.size();
+                uint32_t linkLength = entry.linkTarget.size();
+                output.write(&entry.type, sizeof(entry.type));
+                output.write(reinterpret_cast<const char *>(&entry.mode), sizeof(entry.mode));
+                output.write(reinterpret_cast<const char *>(&entry.size), sizeof(entry.size));
+                output.write(reinterpret_cast<const char *>(&entry.dataOffset), sizeof(entry.dataOffset));
+                output.write(reinterpret_cast<const char *>(&entry.modified), sizeof(entry.modified));
+                output.write(reinterpret_cast<const char *>(&pathLength), sizeof(pathLength));
+                output.write(reinterpret_cast<const char *>(&linkLength), sizeof(linkLength));
+                output.write(entry.path.data(), pathLength);
+                output.write(entry.linkTarget.data(), linkLength);
+            }
+            if(!output)
+            {
+                output.close();
+                fs::remove(temporaryPath, error);
+                continue;
+            }
+        }
+        fs::rename(temporaryPath, indexPath, error);
+        if(!error)
+            return;
+        fs::remove(temporaryPath, error);
+    }
+}
+
+fs::path TarArchive::cacheIndexPath() const
+{
+    std::string name = std::to_string(std::hash<std::string>()(fs::absolute(m_path).string())) + ".index";
+    if(const char *cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome)
+    {
+        return fs::path(cacheHome) / "yakubleo" / "archives" / name;
+    }
+    if(const char *home = std::getenv("HOME"); home && *home)
+    {
+        return fs::path(home) / ".cache" / "yakubleo" / "archives" / name;
+    }
+    return fs::path();
+}
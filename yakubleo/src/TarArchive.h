@@ -0,0 +1,159 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SelectionBatch.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief A member of a tar archive.
+ */
+struct TarEntry
+{
+    std::string path; /**< The path in the archive, without a leading ./ or / and without a trailing /. */
+    char type; /**< '0' a regular file, '5' a directory, '2' a symbolic link; hard links are resolved to the data of their targets. */
+    uint64_t size; /**< The size of the data. */
+    uint64_t dataOffset; /**< The offset of the data in the archive. */
+    uint32_t mode; /**< The permission bits. */
+    int64_t modified; /**< The modification time in seconds since the epoch. */
+    std::string linkTarget; /**< The target of a symbolic link. */
+};
+
+/**
+ * @class TarArchive
+ * @brief A tar archive read as a tree of directories without extracting it.
+ *
+ * Opening the archive reads only the 512-byte headers: the data of every member is skipped by its size,
+ * so a 100 GB backup is indexed by reading a few megabytes. The index is saved next to the archive, or in
+ * $XDG_CACHE_HOME/yakubleo/archives when the directory of the archive is not writable, and reused while the
+ * size, the modification time and the inode of the archive stay the same. Members are read at their data
+ * offsets with pread, so several threads read and extract them at once.
+ *
+ * The ustar, GNU (long names, base-256 sizes) and pax (path, linkpath, size, mtime) headers are understood.
+ */
+class TarArchive
+{
+public:
+    /**
+     * @brief Opens the archive, loads its index or indexes it.
+     * @param archive The path to the archive.
+     * @throws std::runtime_error If the archive cannot be read or is not a tar archive.
+     */
+    explicit TarArchive(const fs::path &archive);
+
+    ~TarArchive();
+
+    TarArchive(const TarArchive &) = delete;
+    TarArchive &operator=(const TarArchive &) = delete;
+
+    /**
+     * @brief Tells if the file looks like a tar archive by its name.
+     * @param path The path to the file.
+     * @return True for names ending with .tar.
+     */
+    static bool isArchiveName(const fs::path &path);
+
+    /**
+     * @brief Gets the path to the archive.
+     * @return The path.
+     */
+    const fs::path &getPath() const;
+
+    /**
+     * @brief Gets the members of the archive.
+     * @return The members in the order of the archive, with the directories only implied by the paths of other members.
+     */
+    const std::vector<TarEntry> &getEntries() const;
+
+    /**
+     * @brief Gets the members directly in a directory of the archive.
+     * @param directory The path of the directory in the archive, empty for the top.
+     * @return The indexes of the members sorted by their names.
+     */
+    std::vector<size_t> list(const std::string &directory) const;
+
+    /**
+     * @brief Tells if the index was loaded from its cache instead of reading the headers.
+     * @return True if it was.
+     */
+    bool isIndexCached() const;
+
+    /**
+     * @brief Gets the number of members left out of the index because their paths leave the directory they are extracted into.
+     * @return The number of members, as tar they are never extracted.
+     */
+    size_t getSkippedCount() const;
+
+    /**
+     * @brief Reads data of a member.
+     * @param entry The member.
+     * @param offset The first byte in the member.
+     * @param buffer Receives the bytes.
+     * @param size The number of bytes.
+     * @return The number of bytes read, less at the end of the member.
+     * @throws std::runtime_error If the archive cannot be read.
+     */
+    size_t read(const TarEntry &entry, uint64_t offset, char *buffer, size_t size) const;
+
+    /**
+     * @brief Extracts members into the directory, a directory member with everything below it.
+     *
+     * The regular files are written in parallel, the directories are created before them and the
+     * symbolic links after them, so no member is written through a link of the archive.
+     * Members whose paths leave the destination with .. are not extracted.
+     *
+     * @param entries The indexes of the members.
+     * @param destination The directory, the members keep their paths below the directory they are in.
+     * @return The counts and the bytes written.
+     */
+    BatchResult extract(const std::vector<size_t> &entries, const fs::path &destination) const;
+
+    /**
+     * @brief Gets the path the index of an archive is saved at next to it.
+     * @param archive The path to the archive.
+     * @return The path of the index.
+     */
+    static fs::path indexPathOf(const fs::path &archive);
+
+private:
+    fs::path m_path; /**< The path to the archive. */
+    int m_descriptor; /**< The open archive. */
+    std::vector<TarEntry> m_entries; /**< The members. */
+    std::unordered_map<std::string, std::vector<size_t>> m_children; /**< The members by the directories they are in. */
+    bool m_isIndexCached; /**< True if the index was loaded from its cache. */
+    size_t m_skippedCount; /**< The members whose paths leave the destination with .., not in m_entries. */
+
+    /**
+     * @brief Reads the headers of the archive into m_entries.
+     * @param archiveSize The size of the archive file, no member may reach past it.
+     * @throws std::runtime_error If the archive is not a tar archive.
+     */
+    void scan(uint64_t archiveSize);
+
+    /**
+     * @brief Adds the directories only implied by the paths of the members and fills m_children.
+     */
+    void buildTree();
+
+    /**
+     * @brief Loads the index if it was saved for the archive as it is now.
+     * @param status The status of the archive.
+     * @return False if there is no valid index.
+     */
+    bool loadIndex(const struct stat &status);
+
+    /**
+     * @brief Saves the index next to the archive or in the cache directory, a failure is ignored.
+     * @param status The status of the archive.
+     */
+    void saveIndex(const struct stat &status) const;
+
+    /**
+     * @brief Gets the path the index is saved at when the directory of the archive is not writable.
+     * @return The path, empty without a cache directory.
+     */
+    fs::path cacheIndexPath() const;
+};
@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount) : m_pendingTasks(0), m_stopping(false)
+{
+    threadCount = std::max<size_t>(threadCount, 1);
+    for(size_t i = 0; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_taskAvailable.notify_all();
+
+    for(auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+        m_pendingTasks++;
+    }
+    m_taskAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_allDone.wait(lock, [this] { return m_pendingTasks == 0; });
+
+    if(m_firstError)
+    {
+        std::exception_ptr error = m_firstError;
+        m_firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+size_t ThreadPool::threadCount() const
+{
+    return m_workers.size();
+}
+
+size_t ThreadPool::defaultThreadCount()
+{
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t begin, size_t end)> &body, size_t minimalPart)
+{
+    size_t parts = std::min(defaultThreadCount(), std::max<size_t>(count / std::max<size_t>(minimalPart, 1), 1));
+    if(parts <= 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(parts);
+    for(size_t part = 0; part < parts; part++)
+    {
+        size_t begin = count * part / parts;
+        size_t end = count * (part + 1) / parts;
+        threads.emplace_back([&body, &errors, part, begin, end]
+        {
+            try
+            {
+                body(begin, end);
+            }
+            catch(...)
+            {
+                errors[part] = std::current_exception();
+            }
+        });
+    }
+
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+    for(auto& error : errors)
+    {
+        if(error)
+            std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskAvailable.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            if(m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        try
+        {
+            task();
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(!m_firstError)
+                m_firstError = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_pendingTasks == 0)
+            m_allDone.notify_all();
+    }
+}
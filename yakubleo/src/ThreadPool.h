@@ -0,0 +1,80 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads executing submitted tasks.
+ *
+ * The first exception thrown by a task is kept and rethrown by wait(),
+ * so errors of parallel operations reach the user interface the same way as errors of sequential ones.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Constructor. Starts the worker threads.
+     * @param threadCount The number of worker threads.
+     */
+    ThreadPool(size_t threadCount = defaultThreadCount());
+
+    /**
+     * @brief Destructor. Finishes the queued tasks and joins the worker threads.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Queues a task for execution.
+     * @param task The task.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Waits until all the submitted tasks finish.
+     * @throws The first exception thrown by a task.
+     */
+    void wait();
+
+    /**
+     * @brief Gets the number of worker threads.
+     * @return The number of worker threads.
+     */
+    size_t threadCount() const;
+
+    /**
+     * @brief Gets the number of threads the hardware runs concurrently, at least 1.
+     * @return The number of threads.
+     */
+    static size_t defaultThreadCount();
+
+    /**
+     * @brief Splits the range [0, count) into contiguous parts and processes them in parallel.
+     * @param count The size of the range.
+     * @param body Called with the bounds of every part.
+     * @param minimalPart Ranges shorter than this are not split at all.
+     */
+    static void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)> &body, size_t minimalPart = 1024);
+
+private:
+    std::vector<std::thread> m_workers; /**< The worker threads. */
+    std::deque<std::function<void()>> m_tasks; /**< The queued tasks. */
+    std::mutex m_mutex; /**< Guards the queue and the counters. */
+    std::condition_variable m_taskAvailable; /**< Signalled when a task is queued or the pool stops. */
+    std::condition_variable m_allDone; /**< Signalled when the last pending task finishes. */
+    size_t m_pendingTasks; /**< Queued and running tasks. */
+    bool m_stopping; /**< True when the destructor runs. */
+    std::exception_ptr m_firstError; /**< The first exception thrown by a task. */
+
+    /**
+     * @brief The loop of a worker thread.
+     */
+    void workerLoop();
+};
@@ -0,0 +1,147 @@
+#include "TopFilesFinder.h"
+#include <algorithm>
+
+TopFilesFinder::TopFilesFinder(size_t threadCount) : m_threadCount(threadCount), m_criterion(LARGEST), m_count(0), m_running(false), m_scannedCount(0)
+{
+}
+
+TopFilesFinder::~TopFilesFinder()
+{
+    stop();
+}
+
+void TopFilesFinder::start(const fs::path &root, Criterion criterion, size_t count)
+{
+    stop();
+
+    m_criterion = criterion;
+    m_count = count;
+    m_scannedCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_heaps.clear();
+    }
+
+    m_walker = std::make_unique<TreeWalker>(m_threadCount);
+    m_running = true;
+    m_thread = std::thread([this, root]
+    {
+        try
+        {
+            m_walker->walk(root, [this](const fs::path &path, const struct stat &status)
+            {
+                if(S_ISREG(status.st_mode))
+                {
+                    m_scannedCount++;
+                    offer(RankedFile{path, uintmax_t(status.st_size), status.st_mtim});
+                }
+            });
+        }
+        catch(const std::exception &e)
+        {
+            // The files found before the failure are still shown
+        }
+        m_running = false;
+    });
+}
+
+void TopFilesFinder::stop()
+{
+    if(m_walker)
+    {
+        m_walker->stop();
+    }
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    m_walker.reset();
+}
+
+bool TopFilesFinder::isRunning() const
+{
+    return m_running;
+}
+
+std::vector<RankedFile> TopFilesFinder::getResult() const
+{
+    std::vector<RankedFile> result;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(const auto& [thread, heap] : m_heaps)
+        {
+            std::lock_guard<std::mutex> heapLock(heap->mutex);
+            result.insert(result.end(), heap->files.begin(), heap->files.end());
+        }
+    }
+
+    auto better = [this](const RankedFile &first, const RankedFile &second) { return isBetter(first, second); };
+    if(result.size() > m_count)
+    {
+        std::nth_element(result.begin(), result.begin() + m_count, result.end(), better);
+        result.resize(m_count);
+    }
+    std::sort(result.begin(), result.end(), better);
+    return result;
+}
+
+size_t TopFilesFinder::scannedCount() const
+{
+    return m_scannedCount;
+}
+
+bool TopFilesFinder::isBetter(const RankedFile &first, const RankedFile &second) const
+{
+    if(m_criterion == LARGEST)
+    {
+        return first.size > second.size;
+    }
+    if(first.modified.tv_sec != second.modified.tv_sec)
+    {
+        return first.modified.tv_sec < second.modified.tv_sec;
+    }
+    return first.modified.tv_nsec < second.modified.tv_nsec;
+}
+
+TopFilesFinder::WorkerHeap &TopFilesFinder::heapOfThisThread()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_ptr<WorkerHeap> &heap = m_heaps[std::this_thread::get_id()];
+    if(!heap)
+    {
+        heap = std::make_unique<WorkerHeap>();
+    }
+    return *heap;
+}
+
+void TopFilesFinder::offer(RankedFile &&file)
+{
+    if(m_count == 0)
+    {
+        return;
+    }
+
+    thread_local TopFilesFinder *owner = nullptr;
+    thread_local WorkerHeap *heap = nullptr;
+    if(owner != this || !heap)
+    {
+        heap = &heapOfThisThread();
+        owner = this;
+    }
+
+    // The better file is "less" so that the worst kept one is on the top of the heap
+    auto better = [this](const RankedFile &first, const RankedFile &second) { return isBetter(first, second); };
+
+    std::lock_guard<std::mutex> lock(heap->mutex);
+    if(heap->files.size() < m_count)
+    {
+        heap->files.push_back(std::move(file));
+        std::push_heap(heap->files.begin(), heap->files.end(), better);
+    }
+    else if(isBetter(file, heap->files.front()))
+    {
+        std::pop_heap(heap->files.begin(), heap->files.end(), better);
+        heap->files.back() = std::move(file);
+        std::push_heap(heap->files.begin(), heap->files.end(), better);
+    }
+}
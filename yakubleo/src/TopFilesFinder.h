@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ThreadPool.h"
+#include "TreeWalker.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief A regular file found by TopFilesFinder.
+ */
+struct RankedFile
+{
+    fs::path path; /**< The path to the file. */
+    uintmax_t size; /**< The size of the file. */
+    struct timespec modified; /**< The last modification time of the file. */
+};
+
+/**
+ * @class TopFilesFinder
+ * @brief Finds the largest or the oldest regular files of a tree in the background.
+ *
+ * Every walking thread keeps its own bounded heap of the best files it has seen,
+ * the heaps are merged whenever the current result is asked for, so the memory stays O(k) per thread
+ * however big the tree is, and the result can be shown while the walk still runs.
+ */
+class TopFilesFinder
+{
+public:
+    /**
+     * @brief Which files are the best ones.
+     */
+    enum Criterion
+    {
+        LARGEST, /**< The largest files first. */
+        OLDEST /**< The files modified longest ago first. */
+    };
+
+    /**
+     * @brief Constructor.
+     * @param threadCount The number of threads walking the tree.
+     */
+    TopFilesFinder(size_t threadCount = ThreadPool::defaultThreadCount());
+
+    /**
+     * @brief Destructor. Stops the running walk.
+     */
+    ~TopFilesFinder();
+
+    /**
+     * @brief Stops the running walk and starts a new one.
+     * @param root The root of the tree.
+     * @param criterion Which files are the best ones.
+     * @param count The number of files to keep.
+     */
+    void start(const fs::path &root, Criterion criterion, size_t count);
+
+    /**
+     * @brief Stops the running walk, the files found so far are kept.
+     */
+    void stop();
+
+    /**
+     * @brief Tells if the walk still runs.
+     * @return True while the tree is being walked.
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief Gets the best files found so far.
+     * @return At most count files, the best first.
+     */
+    std::vector<RankedFile> getResult() const;
+
+    /**
+     * @brief Gets the number of regular files seen so far.
+     * @return The number of files.
+     */
+    size_t scannedCount() const;
+
+private:
+    /**
+     * @brief The heap of one walking thread, the worst kept file on top.
+     */
+    struct WorkerHeap
+    {
+        std::mutex mutex; /**< Guards the heap against merging. */
+        std::vector<RankedFile> files; /**< The heap. */
+    };
+
+    size_t m_threadCount; /**< The number of threads walking the tree. */
+    Criterion m_criterion; /**< Which files are the best ones. */
+    size_t m_count; /**< The number of files to keep. */
+
+    std::unique_ptr<TreeWalker> m_walker; /**< Walks the tree. */
+    std::thread m_thread; /**< Waits for the walk so that the caller does not have to. */
+    std::atomic<bool> m_running; /**< True while the tree is being walked. */
+    std::atomic<size_t> m_scannedCount; /**< The number of regular files seen. */
+
+    mutable std::mutex m_mutex; /**< Guards the map of heaps. */
+    std::unordered_map<std::thread::id, std::unique_ptr<WorkerHeap>> m_heaps; /**< The heap of every walking thread. */
+
+    /**
+     * @brief Tells if the first file is better than the second one.
+     * @param first The first file.
+     * @param second The second file.
+     * @return True if the first file is better.
+     */
+    bool isBetter(const RankedFile &first, const RankedFile &second) const;
+
+    /**
+     * @brief Gets the heap of the calling thread, creates it on the first call.
+     * @return The heap.
+     */
+    WorkerHeap &heapOfThisThread();
+
+    /**
+     * @brief Offers a file to the heap of the calling thread.
+     * @param file The file.
+     */
+    void offer(RankedFile &&file);
+};
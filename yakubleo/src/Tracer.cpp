@@ -0,0 +1,343 @@
+#include "Tracer.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    const char *const probeNames[Tracer::PROBE_COUNT] =
+    {
+        "loadFiles", "print", "copy", "move", "remove", "moveToTrash", "appendContentsTo", "selectOnText", "isEqualTo"
+    };
+
+    /**
+     * @brief Adds to a counter only its own thread writes, without the cost of a locked read-modify-write.
+     */
+    void add(std::atomic<uint64_t> &counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    struct ProbeCounters
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> totalNanoseconds{0};
+        std::atomic<uint64_t> maximalNanoseconds{0};
+        std::array<std::atomic<uint64_t>, Tracer::bucketCount> buckets{};
+    };
+
+    /**
+     * @brief A finished span, the fields are atomic because the trace is read while the owner keeps writing.
+     */
+    struct SpanRecord
+    {
+        std::atomic<uint64_t> start{0};
+        std::atomic<uint64_t> duration{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> probeAndThread{0}; /**< The probe in the low byte, the thread id above it. */
+    };
+
+    /**
+     * @brief What one thread records, owned by one thread at a time.
+     */
+    struct ThreadBuffer
+    {
+        std::array<ProbeCounters, Tracer::PROBE_COUNT> probes;
+        std::array<SpanRecord, Tracer::spanCapacity> spans;
+        std::atomic<uint64_t> spanCount{0};
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::vector<ThreadBuffer *> freeBuffers;
+    };
+
+    Registry &registry()
+    {
+        // Never destroyed, threads still running at exit may record into their buffers
+        static Registry *registry = new Registry;
+        return *registry;
+    }
+
+    /**
+     * @brief Takes a buffer for the thread on its first span and gives it back when the thread ends.
+     */
+    class ThreadSlot
+    {
+    public:
+        ThreadSlot() : m_threadId(::syscall(SYS_gettid))
+        {
+            Registry &shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if(!shared.freeBuffers.empty())
+            {
+                m_buffer = shared.freeBuffers.back();
+                shared.freeBuffers.pop_back();
+            }
+            else
+            {
+                shared.buffers.push_back(std::make_unique<ThreadBuffer>());
+                m_buffer = shared.buffers.back().get();
+            }
+        }
+
+        ~ThreadSlot()
+        {
+            Registry &shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.freeBuffers.push_back(m_buffer);
+        }
+
+        ThreadBuffer &buffer()
+        {
+            return *m_buffer;
+        }
+
+        uint64_t threadId() const
+        {
+            return m_threadId;
+        }
+
+    private:
+        ThreadBuffer *m_buffer;
+        uint64_t m_threadId;
+    };
+
+    const auto startTime = std::chrono::steady_clock::now();
+
+    std::ofstream openOutput(const fs::path &path)
+    {
+        std::ofstream output(path, std::ios::trunc);
+        if(!output)
+            throw std::runtime_error("Cannot write " + path.string());
+        return output;
+    }
+}
+
+std::atomic<bool> Tracer::s_isEnabled(true);
+
+Tracer::Span::Span(Probe probe) : m_probe(probe), m_start(isEnabled() ? now() : 0), m_bytes(0)
+{
+}
+
+Tracer::Span::~Span()
+{
+    if(m_start)
+        record(m_probe, m_start, now(), m_bytes);
+}
+
+void Tracer::Span::addBytes(uint64_t bytes)
+{
+    m_bytes += bytes;
+}
+
+void Tracer::setEnabled(bool isEnabled)
+{
+    s_isEnabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+bool Tracer::isEnabled()
+{
+    return s_isEnabled.load(std::memory_order_relaxed);
+}
+
+const char *Tracer::name(Probe probe)
+{
+    return probeNames[probe];
+}
+
+size_t Tracer::bucketOf(uint64_t nanoseconds)
+{
+    if(nanoseconds < 16)
+        return nanoseconds;
+    size_t exponent = 63 - __builtin_clzll(nanoseconds);
+    return (exponent - 3) * 16 + ((nanoseconds >> (exponent - 4)) & 15);
+}
+
+uint64_t Tracer::lowerBoundOf(size_t bucket)
+{
+    if(bucket < 16)
+        return bucket;
+    size_t exponent = bucket / 16 + 3;
+    return uint64_t(16 + bucket % 16) << (exponent - 4);
+}
+
+uint64_t Tracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count() + 1;
+}
+
+void Tracer::record(Probe probe, uint64_t start, uint64_t end, uint64_t bytes)
+{
+    thread_local ThreadSlot slot;
+    ThreadBuffer &buffer = slot.buffer();
+    uint64_t duration = end - start;
+
+    ProbeCounters &counters = buffer.probes[probe];
+    add(counters.count, 1);
+    add(counters.bytes, bytes);
+    add(counters.totalNanoseconds, duration);
+    add(counters.buckets[bucketOf(duration)], 1);
+    if(duration > counters.maximalNanoseconds.load(std::memory_order_relaxed))
+        counters.maximalNanoseconds.store(duration, std::memory_order_relaxed);
+
+    uint64_t index = buffer.spanCount.load(std::memory_order_relaxed);
+    SpanRecord &span = buffer.spans[index % spanCapacity];
+    span.start.store(start, std::memory_order_relaxed);
+    span.duration.store(duration, std::memory_order_relaxed);
+    span.bytes.store(bytes, std::memory_order_relaxed);
+    span.probeAndThread.store(slot.threadId() << 8 | probe, std::memory_order_relaxed);
+    buffer.spanCount.store(index + 1, std::memory_order_release);
+}
+
+std::vector<ProbeStatistics> Tracer::statistics()
+{
+    std::vector<ProbeStatistics> statistics(PROBE_COUNT);
+    std::vector<std::array<uint64_t, bucketCount>> buckets(PROBE_COUNT);
+
+    Registry &shared = registry();
+    {
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        for(const auto& buffer : shared.buffers)
+        {
+            for(size_t probe = 0; probe < PROBE_COUNT; probe++)
+            {
+                const ProbeCounters &counters = buffer->probes[probe];
+                ProbeStatistics &sum = statistics[probe];
+                sum.count += counters.count.load(std::memory_order_relaxed);
+                sum.bytes += counters.bytes.load(std::memory_order_relaxed);
+                sum.totalNanoseconds += counters.totalNanoseconds.load(std::memory_order_relaxed);
+                sum.maximalNanoseconds = std::max(sum.maximalNanoseconds, counters.maximalNanoseconds.load(std::memory_order_relaxed));
+                for(size_t bucket = 0; bucket < bucketCount; bucket++)
+                {
+                    buckets[probe][bucket] += counters.buckets[bucket].load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    for(size_t probe = 0; probe < PROBE_COUNT; probe++)
+    {
+        ProbeStatistics &sum = statistics[probe];
+        sum.name = probeNames[probe];
+
+        // The counts of the buckets are read one by one, their total is the count the percentiles refer to
+        uint64_t total = 0;
+        for(size_t bucket = 0; bucket < bucketCount; bucket++)
+        {
+            if(buckets[probe][bucket])
+                sum.histogram.emplace_back(lowerBoundOf(bucket), buckets[probe][bucket]);
+            total += buckets[probe][bucket];
+        }
+
+        uint64_t seen = 0;
+        for(const auto& [lowerBound, count] : sum.histogram)
+        {
+            seen += count;
+            if(sum.p50Nanoseconds == 0 && seen * 100 >= total * 50)
+                sum.p50Nanoseconds = lowerBound;
+            if(sum.p90Nanoseconds == 0 && seen * 100 >= total * 90)
+                sum.p90Nanoseconds = lowerBound;
+            if(sum.p99Nanoseconds == 0 && seen * 100 >= total * 99)
+                sum.p99Nanoseconds = lowerBound;
+        }
+    }
+    return statistics;
+}
+
+void Tracer::reset()
+{
+    // A span finishing on another thread meanwhile may keep a part of its counts
+    Registry &shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for(const auto& buffer : shared.buffers)
+    {
+        for(auto& counters : buffer->probes)
+        {
+            counters.count.store(0, std::memory_order_relaxed);
+            counters.bytes.store(0, std::memory_order_relaxed);
+            counters.totalNanoseconds.store(0, std::memory_order_relaxed);
+            counters.maximalNanoseconds.store(0, std::memory_order_relaxed);
+            for(auto& bucket : counters.buckets)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        buffer->spanCount.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Tracer::writeJson(const fs::path &path)
+{
+    std::ofstream output = openOutput(path);
+    output << "{\"probes\":[";
+    bool isFirst = true;
+    for(const auto& probe : statistics())
+    {
+        output << (isFirst ? "\n" : ",\n") << "{\"name\":\"" << probe.name << "\",\"count\":" << probe.count
+               << ",\"bytes\":" << probe.bytes << ",\"totalNs\":" << probe.totalNanoseconds
+               << ",\"p50Ns\":" << probe.p50Nanoseconds << ",\"p90Ns\":" << probe.p90Nanoseconds
+               << ",\"p99Ns\":" << probe.p99Nanoseconds << ",\"maxNs\":" << probe.maximalNanoseconds << ",\"histogram\":[";
+        for(size_t i = 0; i < probe.histogram.size(); i++)
+        {
+            output << (i ? "," : "") << "[" << probe.histogram[i].first << "," << probe.histogram[i].second << "]";
+        }
+        output << "]}";
+        isFirst = false;
+    }
+    output << "\n]}\n";
+    if(!output.flush())
+        throw std::runtime_error("Cannot write " + path.string());
+}
+
+size_t Tracer::writeChromeTrace(const fs::path &path)
+{
+    struct Copied
+    {
+        uint64_t start, duration, bytes, probeAndThread;
+    };
+    std::vector<Copied> spans;
+
+    Registry &shared = registry();
+    {
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        for(const auto& buffer : shared.buffers)
+        {
+            // Spans written while they are copied may be torn, the trace is a diagnostic and keeps them
+            uint64_t count = buffer->spanCount.load(std::memory_order_acquire);
+            for(uint64_t i = count - std::min<uint64_t>(count, spanCapacity); i < count; i++)
+            {
+                const SpanRecord &span = buffer->spans[i % spanCapacity];
+                spans.push_back({span.start.load(std::memory_order_relaxed), span.duration.load(std::memory_order_relaxed),
+                                 span.bytes.load(std::memory_order_relaxed), span.probeAndThread.load(std::memory_order_relaxed)});
+            }
+        }
+    }
+    std::sort(spans.begin(), spans.end(), [](const Copied &first, const Copied &second) { return first.start < second.start; });
+
+    std::ofstream output = openOutput(path);
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char number[64];
+    for(size_t i = 0; i < spans.size(); i++)
+    {
+        size_t probe = spans[i].probeAndThread & 0xff;
+        std::snprintf(number, sizeof(number), "\"ts\":%.3f,\"dur\":%.3f", spans[i].start / 1000.0, spans[i].duration / 1000.0);
+        output << (i ? ",\n" : "\n") << "{\"name\":\"" << probeNames[probe] << "\",\"cat\":\"yakubleo\",\"ph\":\"X\"," << number
+               << ",\"pid\":" << ::getpid() << ",\"tid\":" << (spans[i].probeAndThread >> 8)
+               << ",\"args\":{\"bytes\":" << spans[i].bytes << "}}";
+    }
+    output << "\n]}\n";
+    if(!output.flush())
+        throw std::runtime_error("Cannot write " + path.string());
+    return spans.size();
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief The latency and the throughput of one instrumented operation.
+ */
+struct ProbeStatistics
+{
+    const char *name; /**< The name of the operation. */
+    uint64_t count = 0; /**< The number of calls. */
+    uint64_t bytes = 0; /**< The bytes the calls read or wrote. */
+    uint64_t totalNanoseconds = 0; /**< The time of all the calls. */
+    uint64_t p50Nanoseconds = 0; /**< The median latency. */
+    uint64_t p90Nanoseconds = 0; /**< The 90th percentile of the latency. */
+    uint64_t p99Nanoseconds = 0; /**< The 99th percentile of the latency. */
+    uint64_t maximalNanoseconds = 0; /**< The longest call. */
+    std::vector<std::pair<uint64_t, uint64_t>> histogram; /**< The lower bounds of the nonempty buckets in nanoseconds and their counts. */
+};
+
+/**
+ * @class Tracer
+ * @brief Counts the calls, the bytes and the latencies of the hot operations, cheaply enough to stay always on.
+ *
+ * Every thread records into its own buffer, so a span costs two clock reads and a few stores without locks or
+ * atomic read-modify-writes. The latencies go to HDR-style histograms: 16 linear buckets in every power of two,
+ * so any percentile is known within 6.25 % over the whole range from nanoseconds to minutes. The last spans of
+ * every thread are kept in a ring for the Chrome trace. Buffers of finished threads are reused by new threads,
+ * so the short-lived threads of ThreadPool::parallelFor do not make the memory grow.
+ */
+class Tracer
+{
+public:
+    /**
+     * @brief The instrumented operations.
+     */
+    enum Probe
+    {
+        LOAD_FILES, /**< Reading a directory into the listing. */
+        PRINT, /**< Printing the listing. */
+        COPY, /**< Copying a file or a directory. */
+        MOVE, /**< Moving a file or a directory. */
+        REMOVE, /**< Removing a file or a directory. */
+        MOVE_TO_TRASH, /**< Moving a file or a directory to the trash. */
+        APPEND_CONTENTS, /**< Appending a file to the concatenated output. */
+        SELECT_ON_TEXT, /**< Searching a file for a text, for patterns or for a regular expression. */
+        IS_EQUAL_TO, /**< Comparing the contents of two files. */
+        PROBE_COUNT /**< The number of probes. */
+    };
+
+    /**
+     * @class Span
+     * @brief Measures one call of an operation from its construction to its destruction.
+     */
+    class Span
+    {
+    public:
+        /**
+         * @brief Constructor. Starts the measurement if the tracer is enabled.
+         * @param probe The operation.
+         */
+        explicit Span(Probe probe);
+
+        /**
+         * @brief Destructor. Records the call.
+         */
+        ~Span();
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+        /**
+         * @brief Adds bytes the call read or wrote.
+         * @param bytes The number of bytes.
+         */
+        void addBytes(uint64_t bytes);
+
+    private:
+        Probe m_probe; /**< The operation. */
+        uint64_t m_start; /**< When the call started, 0 if the tracer was disabled. */
+        uint64_t m_bytes; /**< The bytes of the call. */
+    };
+
+    /**
+     * @brief Enables or disables recording, it is enabled at the start.
+     * @param isEnabled True to record.
+     */
+    static void setEnabled(bool isEnabled);
+
+    /**
+     * @brief Tells if spans are recorded.
+     * @return True if they are.
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Gets the name of a probe.
+     * @param probe The probe.
+     * @return The name.
+     */
+    static const char *name(Probe probe);
+
+    /**
+     * @brief Sums the buffers of all the threads.
+     * @return The statistics of every probe, in the order of the probes.
+     */
+    static std::vector<ProbeStatistics> statistics();
+
+    /**
+     * @brief Forgets everything recorded so far.
+     */
+    static void reset();
+
+    /**
+     * @brief Writes the statistics with the histograms as JSON.
+     * @param path The output file.
+     * @throws std::runtime_error If the file cannot be written.
+     */
+    static void writeJson(const fs::path &path);
+
+    /**
+     * @brief Writes the last spans of every thread in the Chrome trace event format, for chrome://tracing or Perfetto.
+     * @param path The output file.
+     * @return The number of spans written.
+     * @throws std::runtime_error If the file cannot be written.
+     */
+    static size_t writeChromeTrace(const fs::path &path);
+
+    /**
+     * @brief The number of buckets of a histogram, enough for any 64-bit latency.
+     */
+    static constexpr size_t bucketCount = 61 * 16;
+
+    /**
+     * @brief Gets the bucket of a latency.
+     * @param nanoseconds The latency.
+     * @return The index of the bucket.
+     */
+    static size_t bucketOf(uint64_t nanoseconds);
+
+    /**
+     * @brief Gets the smallest latency of a bucket.
+     * @param bucket The index of the bucket.
+     * @return The latency in nanoseconds.
+     */
+    static uint64_t lowerBoundOf(size_t bucket);
+
+    /**
+     * @brief The number of spans every thread keeps for the Chrome trace.
+     */
+    static constexpr size_t spanCapacity = 4096;
+
+private:
+    static std::atomic<bool> s_isEnabled; /**< True while spans are recorded. */
+
+    /**
+     * @brief Records a finished span in the buffer of the calling thread.
+     */
+    static void record(Probe probe, uint64_t start, uint64_t end, uint64_t bytes);
+
+    /**
+     * @brief Gets the time since the start of the program.
+     * @return Nanoseconds, never 0.
+     */
+    static uint64_t now();
+};
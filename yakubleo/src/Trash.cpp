@@ -0,0 +1,598 @@
+#include "Trash.h"
+#include "Tracer.h"
+#include "SystemCall.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr int ioprioWhoProcess = 1;
+    constexpr int ioprioClassIdle = 3;
+    constexpr int ioprioClassShift = 13;
+    constexpr int lowestNiceness = 19;
+    const char *infoSuffix = ".trashinfo";
+    const char *ownerKey = "X-Yakubleo-Trashed=true";
+
+    bool isDirectory(const fs::path &path)
+    {
+        struct stat status;
+        return ::lstat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+    }
+
+    void makeDirectory(const fs::path &path)
+    {
+        if(::mkdir(path.c_str(), 0700) != 0 && errno != EEXIST)
+            throw systemError("Could not create", path);
+    }
+
+    std::string unescapeMountPoint(const std::string &escaped)
+    {
+        // /proc/self/mounts writes spaces, tabs, newlines and backslashes as octal escapes
+        std::string mountPoint;
+        for(size_t i = 0; i < escaped.size(); i++)
+        {
+            if(escaped[i] == '\\' && i + 3 < escaped.size())
+            {
+                mountPoint.push_back(char(std::strtol(escaped.substr(i + 1, 3).c_str(), nullptr, 8)));
+                i += 3;
+            }
+            else
+            {
+                mountPoint.push_back(escaped[i]);
+            }
+        }
+        return mountPoint;
+    }
+}
+
+Trash::Trash(size_t threadCount) : m_pool(threadCount), m_walker(threadCount), m_isPurgeRequested(false), m_isEmptyRequested(false),
+    m_isPurging(false), m_stopped(false), m_purgedBytes(0)
+{
+    m_purger = std::thread(&Trash::runPurger, this);
+}
+
+Trash::~Trash()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_condition.notify_all();
+    m_walker.stop();
+    m_purger.join();
+}
+
+void Trash::moveToTrash(const fs::path &path)
+{
+    Tracer::Span span(Tracer::MOVE_TO_TRASH);
+    // The parent is resolved, so the trash is found on the filesystem the file really is on
+    fs::path absolutePath = fs::absolute(path);
+    absolutePath = fs::canonical(absolutePath.parent_path()) / absolutePath.filename();
+
+    struct stat status;
+    if(::lstat(absolutePath.c_str(), &status) != 0)
+        throw systemError("Could not stat", path);
+    fs::path trashDirectory = trashFor(absolutePath, status);
+
+    // The info file reserves the name in the trash, it is created first as the specification requires
+    std::string baseName = absolutePath.filename().string();
+    std::string name = baseName;
+    int infoDescriptor;
+    for(int attempt = 2; ; attempt++)
+    {
+        fs::path infoPath = trashDirectory / "info" / (name + infoSuffix);
+        infoDescriptor = ::open(infoPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if(infoDescriptor >= 0)
+            break;
+        if(errno != EEXIST || attempt == 10000)
+            throw systemError("Could not create", infoPath);
+        name = baseName + "." + std::to_string(attempt);
+    }
+    fs::path infoPath = trashDirectory / "info" / (name + infoSuffix);
+
+    char date[32];
+    time_t now = std::time(nullptr);
+    struct tm local;
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", ::localtime_r(&now, &local));
+    std::string info = "[Trash Info]\nPath=" + encodePath(absolutePath.string()) + "\nDeletionDate=" + date + "\n" + ownerKey + "\n";
+
+    bool isWritten = ::write(infoDescriptor, info.data(), info.size()) == ssize_t(info.size());
+    ::close(infoDescriptor);
+    if(!isWritten || renameNoReplace(AT_FDCWD, absolutePath, AT_FDCWD, trashDirectory / "files" / name) != 0)
+    {
+        int renameError = errno;
+        ::unlink(infoPath.c_str());
+        errno = renameError;
+        throw systemError("Could not move to the trash", path);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isPurgeRequested = true;
+    }
+    m_condition.notify_one();
+}
+
+std::vector<TrashEntry> Trash::list() const
+{
+    std::vector<TrashEntry> entries;
+    for(const auto& trashDirectory : existingTrashDirectories())
+    {
+        std::vector<TrashEntry> read = readEntries(trashDirectory);
+        entries.insert(entries.end(), read.begin(), read.end());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(auto& entry : entries)
+        {
+            auto size = m_sizes.find((entry.trashDirectory / "files" / entry.name).string());
+            if(size != m_sizes.end())
+            {
+                entry.size = size->second;
+                entry.isSizeKnown = true;
+            }
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const TrashEntry &first, const TrashEntry &second) { return first.deletionTime > second.deletionTime; });
+    return entries;
+}
+
+void Trash::restore(const TrashEntry &entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fs::path source = entry.trashDirectory / "files" / entry.name;
+    struct stat status;
+    if(::lstat(source.c_str(), &status) != 0)
+        throw std::runtime_error(entry.originalPath.string() + " is no longer in the trash");
+
+    fs::create_directories(entry.originalPath.parent_path());
+    if(renameNoReplace(AT_FDCWD, source, AT_FDCWD, entry.originalPath) != 0)
+        throw systemError("Could not restore", entry.originalPath);
+
+    fs::path infoPath = entry.trashDirectory / "info" / (entry.name + infoSuffix);
+    ::unlink(infoPath.c_str());
+    m_sizes.erase(source.string());
+}
+
+void Trash::purgeAll()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isPurgeRequested = true;
+        m_isEmptyRequested = true;
+    }
+    m_condition.notify_one();
+}
+
+bool Trash::isPurging() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_isPurging || m_isPurgeRequested;
+}
+
+uintmax_t Trash::purgedBytes() const
+{
+    return m_purgedBytes;
+}
+
+void Trash::runPurger()
+{
+    lowerPriority();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true)
+    {
+        m_condition.wait(lock, [this] { return m_stopped || m_isPurgeRequested; });
+        if(m_stopped)
+            break;
+
+        bool isEmptied = m_isEmptyRequested;
+        m_isPurgeRequested = false;
+        m_isEmptyRequested = false;
+        m_isPurging = true;
+        lock.unlock();
+        try
+        {
+            purge(isEmptied);
+        }
+        catch(const std::exception &e)
+        {
+            // The trash stays as it is until the next purge
+        }
+        lock.lock();
+        m_isPurging = false;
+    }
+}
+
+void Trash::purge(bool isEmptied)
+{
+    time_t now = std::time(nullptr);
+    for(const auto& trashDirectory : existingTrashDirectories())
+    {
+        // Purges interrupted by quitting are finished first
+        std::error_code error;
+        for(const auto& expunged : fs::directory_iterator(trashDirectory / "expunged", error))
+        {
+            if(m_stopped)
+                return;
+            removeTree(expunged.path());
+        }
+
+        std::vector<TrashEntry> entries = readEntries(trashDirectory);
+        if(!isEmptied)
+        {
+            // Entries of other programs and entries of an unknown age are left to their owners
+            entries.erase(std::remove_if(entries.begin(), entries.end(), [](const TrashEntry &entry) { return !entry.isOwn || entry.deletionTime == 0; }), entries.end());
+        }
+        std::sort(entries.begin(), entries.end(), [](const TrashEntry &first, const TrashEntry &second) { return first.deletionTime < second.deletionTime; });
+
+        uintmax_t limit = std::numeric_limits<uintmax_t>::max();
+        uintmax_t total = 0;
+        struct statvfs filesystem;
+        if(!isEmptied && ::statvfs(trashDirectory.c_str(), &filesystem) == 0)
+        {
+            limit = uintmax_t(filesystem.f_blocks) * filesystem.f_frsize / 100 * maximalShare;
+            for(const auto& entry : entries)
+            {
+                if(m_stopped)
+                    return;
+                total += measure(entry);
+            }
+        }
+
+        // The oldest entries go first, until the rest is young enough and fits in the limit
+        for(const auto& entry : entries)
+        {
+            if(m_stopped)
+                return;
+            if(!isEmptied && now - entry.deletionTime <= maximalAge && total <= limit)
+                break;
+            total -= std::min(total, measure(entry));
+            expunge(entry);
+        }
+    }
+}
+
+void Trash::expunge(const TrashEntry &entry)
+{
+    fs::path source = entry.trashDirectory / "files" / entry.name;
+    fs::path expunged = entry.trashDirectory / "expunged";
+    fs::path target;
+    uintmax_t size = measure(entry);
+    {
+        // Restore cannot take the entry once it is in the expunged directory
+        std::lock_guard<std::mutex> lock(m_mutex);
+        struct stat status;
+        if(::lstat(source.c_str(), &status) != 0)
+            return;
+
+        makeDirectory(expunged);
+        for(int attempt = 0; ; attempt++)
+        {
+            target = expunged / (entry.name + "." + std::to_string(attempt));
+            if(renameNoReplace(AT_FDCWD, source, AT_FDCWD, target) == 0)
+                break;
+            if(errno != EEXIST || attempt == 10000)
+                throw systemError("Could not purge", source);
+        }
+
+        fs::path infoPath = entry.trashDirectory / "info" / (entry.name + infoSuffix);
+        ::unlink(infoPath.c_str());
+        m_sizes.erase(source.string());
+    }
+
+    removeTree(target);
+    m_purgedBytes += size;
+}
+
+void Trash::removeTree(const fs::path &path)
+{
+    if(!isDirectory(path))
+    {
+        ::unlink(path.c_str());
+        return;
+    }
+
+    std::vector<fs::path> directories;
+    std::mutex mutex;
+    m_pool.submit([this, path, &directories, &mutex] { unlinkDirectory(path, directories, mutex); });
+    try
+    {
+        m_pool.wait();
+    }
+    catch(const std::exception &e)
+    {
+        // What cannot be unlinked stays in the expunged directory
+    }
+
+    // A directory path is longer than the paths of its ancestors, the longest are empty first
+    std::sort(directories.begin(), directories.end(), [](const fs::path &first, const fs::path &second) { return first.native().size() > second.native().size(); });
+    for(const auto& directory : directories)
+    {
+        ::rmdir(directory.c_str());
+    }
+}
+
+void Trash::unlinkDirectory(const fs::path &directory, std::vector<fs::path> &directories, std::mutex &mutex)
+{
+    lowerPriority();
+    if(m_stopped)
+        return;
+
+    int descriptor = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if(descriptor < 0 && errno == EACCES && ::chmod(directory.c_str(), S_IRWXU) == 0)
+        descriptor = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if(descriptor < 0)
+        return;
+
+    // Entries of a directory without write permission cannot be unlinked
+    struct stat status;
+    if(::fstat(descriptor, &status) == 0 && (status.st_mode & S_IRWXU) != S_IRWXU)
+        ::fchmod(descriptor, status.st_mode | S_IRWXU);
+
+    DIR *stream = ::fdopendir(descriptor);
+    if(!stream)
+    {
+        ::close(descriptor);
+        return;
+    }
+
+    while(dirent *entry = ::readdir(stream))
+    {
+        if(std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        bool isSubdirectory = entry->d_type == DT_DIR;
+        if(entry->d_type == DT_UNKNOWN)
+        {
+            struct stat entryStatus;
+            isSubdirectory = ::fstatat(descriptor, entry->d_name, &entryStatus, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(entryStatus.st_mode);
+        }
+
+        if(isSubdirectory)
+        {
+            fs::path subdirectory = directory / entry->d_name;
+            m_pool.submit([this, subdirectory, &directories, &mutex] { unlinkDirectory(subdirectory, directories, mutex); });
+        }
+        else
+        {
+            ::unlinkat(descriptor, entry->d_name, 0);
+        }
+    }
+    ::closedir(stream);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    directories.push_back(directory);
+}
+
+uintmax_t Trash::measure(const TrashEntry &entry)
+{
+    fs::path path = entry.trashDirectory / "files" / entry.name;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto size = m_sizes.find(path.string());
+        if(size != m_sizes.end())
+            return size->second;
+    }
+
+    struct stat status;
+    if(::lstat(path.c_str(), &status) != 0)
+        return 0;
+
+    std::atomic<uintmax_t> bytes(uintmax_t(status.st_blocks) * 512);
+    if(S_ISDIR(status.st_mode))
+    {
+        m_walker.walk(path, [this, &bytes](const fs::path &, const struct stat &entryStatus)
+        {
+            lowerPriority();
+            if(m_stopped)
+                m_walker.stop();
+            bytes += uintmax_t(entryStatus.st_blocks) * 512;
+        });
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sizes[path.string()] = bytes;
+    return bytes;
+}
+
+fs::path Trash::trashFor(const fs::path &path, const struct stat &status)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_trashDirectories.find(status.st_dev);
+    if(found != m_trashDirectories.end())
+        return found->second;
+
+    // The home trash takes the files of its filesystem, its nearest existing ancestor tells which one that is
+    fs::path homeTrash = homeTrashDirectory();
+    fs::path existing = homeTrash;
+    struct stat homeStatus;
+    bool isHomeFound;
+    while(!(isHomeFound = ::stat(existing.c_str(), &homeStatus) == 0) && existing.has_relative_path())
+    {
+        existing = existing.parent_path();
+    }
+
+    fs::path trashDirectory;
+    if(isHomeFound && homeStatus.st_dev == status.st_dev)
+    {
+        fs::create_directories(homeTrash.parent_path());
+        trashDirectory = homeTrash;
+    }
+    else
+    {
+        // The top directory is the highest ancestor on the same filesystem
+        fs::path top = path.parent_path();
+        struct stat parentStatus;
+        while(top.has_relative_path() && ::stat(top.parent_path().c_str(), &parentStatus) == 0 && parentStatus.st_dev == status.st_dev)
+        {
+            top = top.parent_path();
+        }
+        trashDirectory = top / (".Trash-" + std::to_string(::getuid()));
+    }
+
+    makeDirectory(trashDirectory);
+    makeDirectory(trashDirectory / "files");
+    makeDirectory(trashDirectory / "info");
+
+    struct stat trashStatus;
+    if(::lstat(trashDirectory.c_str(), &trashStatus) != 0 || !S_ISDIR(trashStatus.st_mode) || trashStatus.st_dev != status.st_dev)
+        throw std::runtime_error("There is no trash on the filesystem of " + path.string());
+
+    m_trashDirectories[status.st_dev] = trashDirectory;
+    return trashDirectory;
+}
+
+std::vector<fs::path> Trash::existingTrashDirectories()
+{
+    std::vector<fs::path> trashDirectories;
+    fs::path homeTrash = homeTrashDirectory();
+    if(isDirectory(homeTrash))
+        trashDirectories.push_back(homeTrash);
+
+    std::ifstream mounts("/proc/self/mounts");
+    std::string device;
+    std::string mountPoint;
+    std::string rest;
+    std::string trashName = ".Trash-" + std::to_string(::getuid());
+    while(mounts >> device >> mountPoint && std::getline(mounts, rest))
+    {
+        fs::path trashDirectory = fs::path(unescapeMountPoint(mountPoint)) / trashName;
+        if(isDirectory(trashDirectory) && std::find(trashDirectories.begin(), trashDirectories.end(), trashDirectory) == trashDirectories.end())
+            trashDirectories.push_back(trashDirectory);
+    }
+    return trashDirectories;
+}
+
+std::vector<TrashEntry> Trash::readEntries(const fs::path &trashDirectory)
+{
+    std::vector<TrashEntry> entries;
+    DIR *stream = ::opendir((trashDirectory / "info").c_str());
+    if(!stream)
+        return entries;
+
+    size_t suffixLength = std::strlen(infoSuffix);
+    while(dirent *infoEntry = ::readdir(stream))
+    {
+        std::string infoName = infoEntry->d_name;
+        if(infoName.size() <= suffixLength || infoName.compare(infoName.size() - suffixLength, suffixLength, infoSuffix) != 0)
+            continue;
+
+        TrashEntry entry;
+        entry.trashDirectory = trashDirectory;
+        entry.name = infoName.substr(0, infoName.size() - suffixLength);
+        struct stat status;
+        if(::lstat((trashDirectory / "files" / entry.name).c_str(), &status) != 0)
+            continue;
+
+        std::ifstream info(trashDirectory / "info" / infoName);
+        std::string line;
+        while(std::getline(info, line))
+        {
+            if(line.compare(0, 5, "Path=") == 0)
+            {
+                // Paths in the trash of a top directory may be relative to it
+                fs::path originalPath = decodePath(line.substr(5));
+                entry.originalPath = originalPath.is_absolute() ? originalPath : trashDirectory.parent_path() / originalPath;
+            }
+            else if(line == ownerKey)
+            {
+                entry.isOwn = true;
+            }
+            else if(line.compare(0, 13, "DeletionDate=") == 0)
+            {
+                struct tm local = {};
+                if(::strptime(line.c_str() + 13, "%Y-%m-%dT%H:%M:%S", &local))
+                {
+                    local.tm_isdst = -1;
+                    entry.deletionTime = std::mktime(&local);
+                }
+            }
+        }
+
+        if(!entry.originalPath.empty())
+            entries.push_back(std::move(entry));
+    }
+    ::closedir(stream);
+    return entries;
+}
+
+fs::path Trash::homeTrashDirectory()
+{
+    if(const char *dataHome = std::getenv("XDG_DATA_HOME"); dataHome && *dataHome)
+    {
+        return fs::path(dataHome) / "Trash";
+    }
+    if(const char *home = std::getenv("HOME"); home && *home)
+    {
+        return fs::path(home) / ".local" / "share" / "Trash";
+    }
+    return fs::temp_directory_path() / "yakubleo-trash";
+}
+
+std::string Trash::encodePath(const std::string &path)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    std::string encoded;
+    for(unsigned char character : path)
+    {
+        if(std::isalnum(character) || std::strchr("/-._~", character))
+        {
+            encoded.push_back(character);
+        }
+        else
+        {
+            encoded.push_back('%');
+            encoded.push_back(digits[character >> 4]);
+            encoded.push_back(digits[character & 0xf]);
+        }
+    }
+    return encoded;
+}
+
+std::string Trash::decodePath(const std::string &encoded)
+{
+    std::string path;
+    for(size_t i = 0; i < encoded.size(); i++)
+    {
+        if(encoded[i] == '%' && i + 2 < encoded.size() && std::isxdigit(static_cast<unsigned char>(encoded[i + 1])) && std::isxdigit(static_cast<unsigned char>(encoded[i + 2])))
+        {
+            path.push_back(char(std::stoi(encoded.substr(i + 1, 2), nullptr, 16)));
+            i += 2;
+        }
+        else
+        {
+            path.push_back(encoded[i]);
+        }
+    }
+    return path;
+}
+
+void Trash::lowerPriority()
+{
+    thread_local bool isLowered = false;
+    if(isLowered)
+        return;
+    isLowered = true;
+
+    // Both calls change only the calling thread on Linux
+    pid_t thread = ::syscall(SYS_gettid);
+    ::setpriority(PRIO_PROCESS, thread, lowestNiceness);
+    ::syscall(SYS_ioprio_set, ioprioWhoProcess, thread, ioprioClassIdle << ioprioClassShift);
+}
@@ -0,0 +1,213 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ThreadPool.h"
+#include "TreeWalker.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief A file or directory in the trash.
+ */
+struct TrashEntry
+{
+    fs::path trashDirectory; /**< The trash it is in. */
+    std::string name; /**< Its name in the files directory of the trash. */
+    fs::path originalPath; /**< Where it was before it was deleted. */
+    time_t deletionTime = 0; /**< When it was deleted, 0 if the info file does not tell. */
+    bool isOwn = false; /**< True if this program moved it to the trash, only such entries are purged by the limits. */
+    uintmax_t size = 0; /**< The bytes it occupies on the disk, valid once isSizeKnown is set. */
+    bool isSizeKnown = false; /**< True if the purger already measured the entry. */
+};
+
+/**
+ * @class Trash
+ * @brief Deletes files by moving them to a trash on their own filesystem and purges the trash in the background.
+ *
+ * The trashes follow the FreeDesktop trash specification, so the file managers of the desktop show and restore the
+ * same entries: files of the filesystem of the home directory go to $XDG_DATA_HOME/Trash, files of other filesystems
+ * to .Trash-$UID in the top directory of their filesystem. Deleting writes one small info file and renames the file
+ * into the trash, so it costs the same for a file and for a tree of millions of files and can be undone.
+ *
+ * After every deletion a purger thread at the lowest CPU and I/O priority keeps the entries this program deleted, marked
+ * in their info files, within their limits: those older than maximalAge are purged, and the oldest of them while they
+ * occupy more than maximalShare percent of their filesystem. Entries of other programs and entries without a readable
+ * deletion date are only purged when the trash is emptied.
+ * A purged entry is first renamed into the expunged directory of its trash, then its tree is unlinked by a thread pool
+ * one directory per task. Purges interrupted by quitting are finished the next time.
+ */
+class Trash
+{
+public:
+    /**
+     * @brief How long entries stay in the trash.
+     */
+    static constexpr time_t maximalAge = 30 * 24 * 60 * 60;
+
+    /**
+     * @brief The part of its filesystem a trash may occupy, in percent.
+     */
+    static constexpr uintmax_t maximalShare = 10;
+
+    /**
+     * @brief Constructor. Starts the purger, it waits for the first deletion or request.
+     * @param threadCount The number of threads unlinking purged trees.
+     */
+    Trash(size_t threadCount = ThreadPool::defaultThreadCount());
+
+    /**
+     * @brief Destructor. Stops the purger, the entries being purged are finished the next time.
+     */
+    ~Trash();
+
+    Trash(const Trash &) = delete;
+    Trash &operator=(const Trash &) = delete;
+
+    /**
+     * @brief Moves the file to the trash of its filesystem.
+     * @param path The file, a directory is moved with everything in it.
+     * @throws std::runtime_error If the trash cannot be created or the file cannot be renamed into it.
+     */
+    void moveToTrash(const fs::path &path);
+
+    /**
+     * @brief Lists the entries of the home trash and of the trashes in the top directories of the mounted filesystems.
+     * @return The entries, the most recently deleted first.
+     */
+    std::vector<TrashEntry> list() const;
+
+    /**
+     * @brief Moves the entry back to its original path, the missing parent directories are created.
+     * @param entry The entry.
+     * @throws std::runtime_error If something else is at the original path or the entry was purged.
+     */
+    void restore(const TrashEntry &entry);
+
+    /**
+     * @brief Asks the purger to purge every entry of every trash.
+     */
+    void purgeAll();
+
+    /**
+     * @brief Tells if the purger is purging or measuring the trashes.
+     * @return True while it works.
+     */
+    bool isPurging() const;
+
+    /**
+     * @brief Gets the number of bytes the purger has reclaimed so far.
+     * @return The number of bytes.
+     */
+    uintmax_t purgedBytes() const;
+
+private:
+    ThreadPool m_pool; /**< The threads unlinking purged trees. */
+    TreeWalker m_walker; /**< Measures the entries. */
+
+    mutable std::mutex m_mutex; /**< Guards the members below and keeps the purger and restore from taking the same entry. */
+    std::condition_variable m_condition; /**< Wakes the purger. */
+    std::map<dev_t, fs::path> m_trashDirectories; /**< The trash of every filesystem used so far. */
+    std::unordered_map<std::string, uintmax_t> m_sizes; /**< The sizes of the measured entries by their paths in the trash. */
+    bool m_isPurgeRequested; /**< Set to make the purger apply the limits or empty the trashes. */
+    bool m_isEmptyRequested; /**< Set to make the purger purge everything. */
+    bool m_isPurging; /**< True while the purger works. */
+    std::atomic<bool> m_stopped; /**< Set to stop the purger. */
+    std::atomic<uintmax_t> m_purgedBytes; /**< The bytes reclaimed. */
+
+    std::thread m_purger; /**< Applies the limits in the background. */
+
+    /**
+     * @brief Waits for requests and purges, runs in the purger thread.
+     */
+    void runPurger();
+
+    /**
+     * @brief Purges the own entries beyond the limits, or all the entries, of every trash.
+     * @param isEmptied True to purge everything.
+     */
+    void purge(bool isEmptied);
+
+    /**
+     * @brief Moves the entry to the expunged directory of its trash and unlinks it.
+     * @param entry The entry.
+     */
+    void expunge(const TrashEntry &entry);
+
+    /**
+     * @brief Unlinks a tree, every directory is emptied by one task of the thread pool.
+     * @param path The root of the tree.
+     */
+    void removeTree(const fs::path &path);
+
+    /**
+     * @brief Unlinks the entries of one directory and queues its subdirectories.
+     * @param directory The directory.
+     * @param directories Collects the emptied directories.
+     * @param mutex Guards the directories.
+     */
+    void unlinkDirectory(const fs::path &directory, std::vector<fs::path> &directories, std::mutex &mutex);
+
+    /**
+     * @brief Gets the bytes the entry occupies, measures it on the first call.
+     * @param entry The entry.
+     * @return The number of bytes.
+     */
+    uintmax_t measure(const TrashEntry &entry);
+
+    /**
+     * @brief Finds the trash for the file, creates it if needed.
+     * @param path The absolute path of the file.
+     * @param status The status of the file.
+     * @return The trash directory.
+     * @throws std::runtime_error If the trash cannot be created.
+     */
+    fs::path trashFor(const fs::path &path, const struct stat &status);
+
+    /**
+     * @brief Gets the trash directories that exist.
+     * @return The home trash and the trashes in the top directories of the mounted filesystems.
+     */
+    static std::vector<fs::path> existingTrashDirectories();
+
+    /**
+     * @brief Reads the entries of a trash from its info files.
+     * @param trashDirectory The trash.
+     * @return The entries whose files exist.
+     */
+    static std::vector<TrashEntry> readEntries(const fs::path &trashDirectory);
+
+    /**
+     * @brief Gets the path of the home trash.
+     * @return $XDG_DATA_HOME/Trash or ~/.local/share/Trash.
+     */
+    static fs::path homeTrashDirectory();
+
+    /**
+     * @brief Encodes a path for the Path key of an info file.
+     * @param path The path.
+     * @return The path with the bytes other than letters, digits, slashes and -._~ percent-encoded.
+     */
+    static std::string encodePath(const std::string &path);
+
+    /**
+     * @brief Decodes the Path key of an info file.
+     * @param encoded The encoded path.
+     * @return The path.
+     */
+    static std::string decodePath(const std::string &encoded);
+
+    /**
+     * @brief Lowers the CPU and I/O priority of the calling thread to the idle level, once per thread.
+     */
+    static void lowerPriority();
+};
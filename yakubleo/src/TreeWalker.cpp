@@ -0,0 +1,66 @@
+#include "TreeWalker.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <cstring>
+
+TreeWalker::TreeWalker(size_t threadCount) : m_pool(threadCount), m_stopped(false)
+{
+}
+
+void TreeWalker::walk(const fs::path &root, const Visitor &visitor, const FailureHandler &onFailure)
+{
+    m_stopped = false;
+    m_pool.submit([this, root, &visitor, &onFailure] { walkDirectory(root, visitor, onFailure); });
+    m_pool.wait();
+}
+
+void TreeWalker::stop()
+{
+    m_stopped = true;
+}
+
+void TreeWalker::walkDirectory(const fs::path &directory, const Visitor &visitor, const FailureHandler &onFailure)
+{
+    DIR *stream = ::opendir(directory.c_str());
+    if(!stream)
+    {
+        if(onFailure)
+            onFailure(directory);
+        return;
+    }
+
+    int descriptor = ::dirfd(stream);
+    while(dirent *entry = ::readdir(stream))
+    {
+        if(m_stopped)
+            break;
+
+        if(std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        struct stat status;
+        if(::fstatat(descriptor, entry->d_name, &status, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            if(onFailure)
+                onFailure(directory);
+            continue;
+        }
+
+        fs::path path = directory / entry->d_name;
+        try
+        {
+            visitor(path, status);
+        }
+        catch(...)
+        {
+            ::closedir(stream);
+            throw;
+        }
+
+        if(S_ISDIR(status.st_mode))
+        {
+            m_pool.submit([this, path, &visitor, &onFailure] { walkDirectory(path, visitor, onFailure); });
+        }
+    }
+    ::closedir(stream);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <sys/stat.h>
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @class TreeWalker
+ * @brief Walks a directory tree in parallel, every directory is read by one task of a thread pool.
+ *
+ * Entries are read with readdir and stat-ed with fstatat relative to the open directory,
+ * symbolic links are reported but never followed. Directories that cannot be opened and entries that cannot be
+ * stat-ed are skipped, the walk tells about them only when it is given a failure handler.
+ */
+class TreeWalker
+{
+public:
+    /**
+     * @brief Called for every entry below the root, from several threads at once.
+     */
+    using Visitor = std::function<void(const fs::path &path, const struct stat &status)>;
+
+    /**
+     * @brief Called for every directory that could not be read completely, from several threads at once.
+     */
+    using FailureHandler = std::function<void(const fs::path &directory)>;
+
+    /**
+     * @brief Constructor.
+     * @param threadCount The number of threads reading directories.
+     */
+    TreeWalker(size_t threadCount = ThreadPool::defaultThreadCount());
+
+    /**
+     * @brief Walks the tree below the root and returns when all the entries were visited.
+     * @param root The directory to start at, it is not visited itself.
+     * @param visitor Called for every entry, has to be thread safe.
+     * @param onFailure Called for every directory that could not be opened or has entries that could not be stat-ed, may be empty.
+     * @throws The first exception thrown by the visitor.
+     */
+    void walk(const fs::path &root, const Visitor &visitor, const FailureHandler &onFailure = FailureHandler());
+
+    /**
+     * @brief Stops the running walk, no more directories are read. May be called from any thread.
+     */
+    void stop();
+
+private:
+    ThreadPool m_pool; /**< The threads reading directories. */
+    std::atomic<bool> m_stopped; /**< Set by stop(), the running walk skips the rest of the tree. */
+
+    /**
+     * @brief Reads one directory and queues its subdirectories.
+     * @param directory The directory.
+     * @param visitor Called for every entry.
+     * @param onFailure Called if the directory cannot be read completely, may be empty.
+     */
+    void walkDirectory(const fs::path &directory, const Visitor &visitor, const FailureHandler &onFailure);
+};
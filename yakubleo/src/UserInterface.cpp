@@ -1,8 +1,18 @@
 #include "UserInterface.h"
 #include "SmallWindow.h"
+#include "ReportWindow.h"
+#include "PreviewWindow.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <poll.h>
+#include <unistd.h>
 
 
-UserInterface::UserInterface() : m_currentDir(fs::current_path()), m_fileSystem(m_currentDir), m_selectedRow(0), m_printFrom(0)
+UserInterface::UserInterface() : m_currentDir(fs::current_path()), m_fileSystem(m_currentDir), m_selectedRow(0),
+    m_fileListView(m_normalFileColorPair, m_selectedFileColorPair), m_printFrom(0),
+    m_listing(DIRECTORY_LISTING), m_resultsPending(false), m_indexSearchMilliseconds(0), m_isStatsShown(false)
 {
     // Initialize screen
     // Setup memory
@@ -24,6 +34,8 @@ UserInterface::UserInterface() : m_currentDir(fs::current_path()), m_fileSystem(
     keypad(stdscr, true);
 
     m_fileSystem.setPointedAt(m_selectedRow); // Set the first file to be pointed at to highlight it
+    m_fileSystem.startDiskUsage(m_currentDir);
+    m_watcher.watch(m_currentDir);
 
     // scrollok(stdscr, TRUE); // Allow scrolling
 }
@@ -70,7 +82,7 @@ void UserInterface::moveArrowKey(Direction currentDirection)
             m_selectedRow++;
             m_fileSystem.setPointedAt(m_selectedRow);
 
-            if(m_selectedRow >= m_printFrom + LINES - 2)
+            if(m_selectedRow >= m_printFrom + listingHeight())
             {
                 m_printFrom++;
                 clear();
@@ -85,20 +97,128 @@ void UserInterface::moveArrowKey(Direction currentDirection)
 
 void UserInterface::open()
 {
-    int row = 0;
-    for (const auto &entry : fs::directory_iterator(m_currentDir))
+    if(m_listing == INDEX_SEARCH_LISTING || m_listing == FIND_LISTING)
     {
-        if (row == m_selectedRow)
+        openSearchResult();
+        return;
+    }
+    if(m_listing == ARCHIVE_LISTING)
+    {
+        openArchiveMember();
+        return;
+    }
+    if(m_listing != DIRECTORY_LISTING && m_listing != TOP_FILES_LISTING)
+    {
+        return;
+    }
+
+    // The listing changes while it is shown, the order of the directory on the disk may differ from it
+    if(m_selectedRow >= m_fileSystem.filesInCurrentDirectory())
+    {
+        return;
+    }
+
+    fs::path path = m_fileSystem.getPathAt(m_selectedRow);
+    if(m_listing == DIRECTORY_LISTING && fs::is_directory(path))
+    {
+        m_currentDir = path;
+        refreshScreenAndClearDirectory();
+    }
+    else if(m_listing == DIRECTORY_LISTING && TarArchive::isArchiveName(path) && fs::is_regular_file(path))
+    {
+        openArchive(path);
+    }
+    else if(fs::is_regular_file(path))
+    {
+        previewFile(path);
+    }
+}
+
+void UserInterface::previewFile(const fs::path &path)
+{
+    try
+    {
+        PreviewWindow preview(path);
+        preview.show();
+    }
+    catch(const std::exception &e)
+    {
+        printErrorMessage(e.what());
+    }
+}
+
+int UserInterface::readKey(int timeoutMilliseconds)
+{
+    // Keys already read by ncurses do not make the terminal readable again
+    nodelay(stdscr, true);
+    int ch = getch();
+    nodelay(stdscr, false);
+    if(ch != ERR)
+    {
+        return ch;
+    }
+
+    struct pollfd descriptors[2] = {{STDIN_FILENO, POLLIN, 0}, {m_watcher.getDescriptor(), POLLIN, 0}};
+    if(::poll(descriptors, 2, timeoutMilliseconds) <= 0)
+    {
+        return ERR;
+    }
+
+    if(descriptors[1].revents & POLLIN)
+    {
+        handleDirectoryChanges();
+    }
+    if(descriptors[0].revents & POLLIN)
+    {
+        return getch();
+    }
+    return ERR;
+}
+
+void UserInterface::handleDirectoryChanges()
+{
+    DirectoryChanges changes = m_watcher.readChanges();
+    if(m_listing != DIRECTORY_LISTING || changes.empty())
+    {
+        return;
+    }
+
+    if(changes.isRescanNeeded)
+    {
+        while(!fs::is_directory(m_currentDir) && m_currentDir != m_currentDir.parent_path())
         {
-            if (entry.is_directory())
-            {
-                m_currentDir = entry.path();
-                refreshScreenAndClearDirectory();
-                return;
-            }
+            m_currentDir = m_currentDir.parent_path();
         }
-        row++;
+        refreshScreenAndClearDirectory();
+        return;
+    }
+
+    fs::path pointedPath;
+    if(m_selectedRow < m_fileSystem.filesInCurrentDirectory())
+        pointedPath = m_fileSystem.getPathAt(m_selectedRow);
+
+    bool isDirectoryChanged = m_fileSystem.applyChanges(m_currentDir, changes);
+
+    int totalRows = m_fileSystem.filesInCurrentDirectory();
+    int index = m_fileSystem.indexOf(pointedPath);
+    if(index >= 0)
+    {
+        m_selectedRow = index;
+    }
+    else
+    {
+        m_selectedRow = std::max(0, std::min(m_selectedRow, totalRows - 1));
+        m_fileSystem.setPointedAt(m_selectedRow);
     }
+    if(m_printFrom > m_selectedRow)
+        m_printFrom = m_selectedRow;
+    if(m_selectedRow >= m_printFrom + listingHeight())
+        m_printFrom = m_selectedRow - (listingHeight() - 1);
+
+    // Only the rows that differ are sent to the terminal
+    erase();
+    if(isDirectoryChanged)
+        m_fileSystem.startDiskUsage(m_currentDir);
 }
 
 void UserInterface::moveToUpperDirectory()
@@ -113,9 +233,15 @@ void UserInterface::selectOrUnselectFile()
 }
 bool UserInterface::processInput()
 {
-    int ch = getch();
+    // Wake up regularly while directory sizes, the largest files or the found files are computed so they appear as they finish
+    bool isComputing = m_fileSystem.isComputingDiskUsage() || m_resultsPending || m_isStatsShown;
+    int ch = readKey(isComputing ? 250 : -1);
     switch (ch)
     {
+    case ERR:
+        if(m_resultsPending)
+            refreshResults();
+        break;
     case KEY_UP:
         moveArrowKey(UP);
         break;
@@ -135,11 +261,59 @@ bool UserInterface::processInput()
         }
         break;
     case 'u':
-        moveToUpperDirectory();
+        if(m_listing == ARCHIVE_LISTING)
+            moveUpInArchive();
+        else if(m_listing != DIRECTORY_LISTING)
+            leaveResults();
+        else
+            moveToUpperDirectory();
+        break;
+    case 'L':
+        try
+        {
+            handleIndexDirectory();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
+        break;
+    case 'l':
+        try
+        {
+            handleIndexSearch();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
+        break;
+    case 'k':
+        try
+        {
+            handleTopFiles();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
+        break;
+    case 'f':
+        try
+        {
+            handleFind();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
         break;
     case 's':
         selectOrUnselectFile();
         break;
+    case 'x':
+        m_fileSystem.deSelectAllFiles();
+        break;
     case 'c':
         try
         {
@@ -147,7 +321,7 @@ bool UserInterface::processInput()
         }
         catch(const std::exception& e)
         {
-            printErrorMessage("Cannot copy one of the files.");
+            printErrorMessage(e.what());
         }
         break;
     case 'm':
@@ -157,7 +331,17 @@ bool UserInterface::processInput()
         }
         catch(const std::exception& e)
         {
-            printErrorMessage("Cannot move one of the files.");
+            printErrorMessage(e.what());
+        }
+        break;
+    case 'R':
+        try
+        {
+            handleBatchRename();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
         }
         break;
     case 'd':
@@ -167,7 +351,31 @@ bool UserInterface::processInput()
         }
         catch(const std::exception& e)
         {
-            printErrorMessage("Cannot remove one of the files.");
+            printErrorMessage(e.what());
+            refreshScreenAndClearDirectory();
+        }
+        break;
+    case 'i':
+        toggleStats();
+        break;
+    case 'I':
+        try
+        {
+            handleTraceDump();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
+        break;
+    case 'D':
+        try
+        {
+            handleTrash();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
         }
         break;
     case 'a':
@@ -210,6 +418,16 @@ bool UserInterface::processInput()
             printErrorMessage("Cannot search for text in one of the files.");
         }
         break;
+    case 'g':
+        try
+        {
+            handleRegexTextSearch();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
+        break;
     case 'p':
         try
         {
@@ -220,6 +438,46 @@ bool UserInterface::processInput()
             printErrorMessage(e.what());
         }
         break;
+    case 'P':
+        try
+        {
+            handleDuplicateReport();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
+        break;
+    case 'T':
+        try
+        {
+            handleSubtreeReport();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
+        break;
+    case 'M':
+        try
+        {
+            handleMirror();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
+        break;
+    case 'n':
+        try
+        {
+            handleNearDuplicateReport();
+        }
+        catch(const std::exception& e)
+        {
+            printErrorMessage(e.what());
+        }
+        break;
     case 'q':
         return false;
     default:
@@ -230,8 +488,22 @@ bool UserInterface::processInput()
 
 void UserInterface::print()
 {
-    mvprintw(0, 0, "%s", m_currentDir.c_str());
-    m_fileSystem.print(1, 0, m_normalFileColorPair, m_selectedFileColorPair, m_printFrom, size_t(m_printFrom + LINES - 2) );
+    if(m_listing == TOP_FILES_LISTING)
+        mvprintw(0, 0, "%s: %zu files scanned%s", m_currentDir.c_str(), m_fileSystem.topFilesScannedCount(), m_resultsPending ? " ..." : "");
+    else if(m_listing == FIND_LISTING)
+        mvprintw(0, 0, "Find \"%s\" in %s: %d found, %zu scanned%s", m_findQuery.c_str(), m_currentDir.c_str(), m_fileSystem.filesInCurrentDirectory(),
+            m_fileSystem.findScannedCount(), m_resultsPending ? " ..." : "");
+    else if(m_listing == ARCHIVE_LISTING)
+        mvprintw(0, 0, "%s: /%s", m_archivePath.c_str(), m_archiveDirectory.c_str());
+    else if(m_listing == INDEX_SEARCH_LISTING)
+        mvprintw(0, 0, "Index search \"%s\": %d paths in %.3f ms", m_indexQuery.c_str(), m_fileSystem.filesInCurrentDirectory(), m_indexSearchMilliseconds);
+    else
+        mvprintw(0, 0, "%s", m_currentDir.c_str());
+    if(m_fileSystem.selectedFilesCount() > 0)
+        printw("  [%d selected]", m_fileSystem.selectedFilesCount());
+    m_fileListView.print(m_fileSystem, 1, 0, m_printFrom, size_t(m_printFrom + listingHeight()));
+    if(m_isStatsShown)
+        m_statsPanel.print();
     refresh();
 }
 
@@ -245,8 +517,19 @@ void UserInterface::handleCopy()
         return;
     }
 
-    m_fileSystem.copySelectedFiles(destination);
+    if(m_listing == ARCHIVE_LISTING)
+    {
+        BatchResult result = m_fileSystem.extractSelectedMembers(destination);
+        std::string message = "Extracted " + std::to_string(result.doneCount) + " entries, " + DiskUsage::formatSize(result.bytes);
+        if(result.failures > 0)
+            throw std::runtime_error(message + ", " + std::to_string(result.failures) + " not extracted: " + result.firstError);
+        printMessage(message);
+        return;
+    }
 
+    BatchResult result = m_fileSystem.copySelectedFiles(destination);
+    if(result.failures > 0)
+        throw std::runtime_error(std::to_string(result.failures) + " files not copied: " + result.firstError);
 }
 
 void UserInterface::handleMove()
@@ -259,18 +542,182 @@ void UserInterface::handleMove()
         return;
     }
 
-    m_fileSystem.moveSelectedFiles(destination);
+    BatchResult result = m_fileSystem.moveSelectedFiles(destination);
+    if(result.failures > 0)
+        throw std::runtime_error(std::to_string(result.failures) + " files not moved: " + result.firstError);
+
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::handleBatchRename()
+{
+    if(m_fileSystem.selectedFilesCount() == 0)
+    {
+        printErrorMessage("No files selected");
+        return;
+    }
+
+    SmallWindow patternWindow("Rename: regular expression in the names");
+    std::string pattern = patternWindow.input();
+    if(pattern.empty())
+    {
+        refreshScreenAndClearDirectory();
+        return;
+    }
+    SmallWindow replacementWindow("Replace with ($1 groups, $& the match)");
+    std::string replacement = replacementWindow.input();
+
+    RenamePlan plan = m_fileSystem.planRenameOfSelectedFiles(pattern, replacement);
+
+    std::vector<std::string> reportLines;
+    reportLines.push_back(std::to_string(plan.renames.size()) + " renamed, " + std::to_string(plan.unchangedCount) + " unchanged, "
+        + std::to_string(plan.conflicts.size()) + " conflicts");
+    for(const auto& conflict : plan.conflicts)
+    {
+        reportLines.push_back("! " + conflict);
+    }
+    for(const auto& rename : plan.renames)
+    {
+        reportLines.push_back(rename.from.lexically_relative(m_currentDir).string() + " -> " + rename.to.filename().string());
+    }
+
+    ReportWindow report("Rename /" + pattern + "/" + replacement + "/", reportLines);
+    report.show();
+
+    if(plan.conflicts.empty() && !plan.renames.empty())
+    {
+        SmallWindow confirmWindow("Rename the files: no (0) yes (1)");
+        if(confirmWindow.input() == "1")
+        {
+            auto start = std::chrono::steady_clock::now();
+            size_t renamed = m_fileSystem.renameFiles(plan);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            char message[96];
+            std::snprintf(message, sizeof(message), "Renamed %zu files in %.3f s", renamed, seconds);
+            printMessage(message);
+        }
+    }
 
-    
     refreshScreenAndClearDirectory();
 }
 
 void UserInterface::handleRemove()
 {
-    m_fileSystem.removeSelectedFiles();
+    BatchResult result = m_fileSystem.removeSelectedFiles();
+    if(result.failures > 0)
+    {
+        std::string message = std::to_string(result.failures) + " files not moved to the trash: " + result.firstError;
+
+        // The files left selected have no trash on their filesystem, e.g. behind a bind mount
+        int remaining = m_fileSystem.selectedFilesCount();
+        if(remaining == 0)
+            throw std::runtime_error(message);
+        printErrorMessage(message);
+        std::string title = "Delete the " + std::to_string(remaining) + " files permanently: no (0) yes (1)";
+        SmallWindow confirmWindow(title.c_str());
+        if(confirmWindow.input() == "1")
+        {
+            BatchResult permanent = m_fileSystem.removeSelectedFilesPermanently();
+            if(permanent.failures > 0)
+                throw std::runtime_error(std::to_string(permanent.failures) + " files not deleted: " + permanent.firstError);
+        }
+    }
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::handleTrash()
+{
+    std::vector<TrashEntry> entries = m_fileSystem.listTrash();
+    const Trash &trash = m_fileSystem.getTrash();
+
+    uintmax_t knownBytes = 0;
+    std::vector<std::string> reportLines;
+    reportLines.push_back("");
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        const TrashEntry &entry = entries[i];
+        char date[32] = "?               ";
+        struct tm local;
+        if(entry.deletionTime != 0)
+            std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M", ::localtime_r(&entry.deletionTime, &local));
+        char line[96];
+        std::snprintf(line, sizeof(line), "%5zu  %s  %10s  ", i + 1, date, entry.isSizeKnown ? DiskUsage::formatSize(entry.size).c_str() : "?");
+        reportLines.push_back(line + entry.originalPath.string());
+        knownBytes += entry.size;
+    }
+
+    char summary[192];
+    std::snprintf(summary, sizeof(summary), "%zu entries, %s measured, %s purged%s; entries deleted here are kept %ld days and below %ju %% of their filesystem",
+        entries.size(), DiskUsage::formatSize(knownBytes).c_str(), DiskUsage::formatSize(trash.purgedBytes()).c_str(),
+        trash.isPurging() ? ", purging" : "", long(Trash::maximalAge / (24 * 60 * 60)), Trash::maximalShare);
+    reportLines[0] = summary;
+
+    ReportWindow report("Trash", reportLines);
+    report.show();
+
+    if(!entries.empty())
+    {
+        SmallWindow restoreWindow("Restore numbers (1 3-5), empty trash (*)");
+        std::string input = restoreWindow.input();
+        if(input == "*")
+        {
+            m_fileSystem.emptyTrash();
+            printMessage("Emptying the trash in the background");
+        }
+        else if(!input.empty())
+        {
+            size_t restored = 0;
+            std::string firstError;
+            std::vector<size_t> numbers = parseNumbers(input, entries.size());
+            for(size_t number : numbers)
+            {
+                try
+                {
+                    m_fileSystem.restoreFromTrash(entries[number - 1]);
+                    restored++;
+                }
+                catch(const std::exception &e)
+                {
+                    if(firstError.empty())
+                        firstError = e.what();
+                }
+            }
+            printMessage("Restored " + std::to_string(restored) + " of " + std::to_string(numbers.size()) + " entries"
+                + (firstError.empty() ? "" : ", " + firstError));
+        }
+    }
+
     refreshScreenAndClearDirectory();
 }
 
+std::vector<size_t> UserInterface::parseNumbers(const std::string &input, size_t maximum)
+{
+    std::vector<size_t> numbers;
+    size_t position = 0;
+    while(position < input.size())
+    {
+        size_t end = input.find_first_of(" ,", position);
+        if(end == std::string::npos)
+            end = input.size();
+        std::string part = input.substr(position, end - position);
+        position = end + 1;
+
+        size_t dash = part.find('-');
+        std::string first = part.substr(0, dash);
+        std::string last = dash == std::string::npos ? first : part.substr(dash + 1);
+        if(first.empty() || last.empty() || first.size() > 9 || last.size() > 9
+            || (first + last).find_first_not_of("0123456789") != std::string::npos)
+            continue;
+
+        for(size_t number = std::stoul(first); number <= std::min<size_t>(std::stoul(last), maximum); number++)
+        {
+            if(number > 0)
+                numbers.push_back(number);
+        }
+    }
+    return numbers;
+}
+
 void UserInterface::handleCreate()
 {
     SmallWindow inputWindow("Enter file type: RF (1), D (2), SL (3)");
@@ -341,6 +788,34 @@ void UserInterface::handleCreateSymbolicLink(const std::string &fileName)
     
 }
 
+int UserInterface::listingHeight() const
+{
+    return LINES - 2 - (m_isStatsShown ? StatsPanel::height() : 0);
+}
+
+void UserInterface::toggleStats()
+{
+    m_isStatsShown = !m_isStatsShown;
+    if(m_selectedRow >= m_printFrom + listingHeight())
+        m_printFrom = std::max(0, m_selectedRow - (listingHeight() - 1));
+    clear();
+}
+
+void UserInterface::handleTraceDump()
+{
+    SmallWindow inputWindow("Trace path prefix (.json .trace.json)");
+    std::string prefix = inputWindow.input();
+    if(prefix.empty())
+    {
+        clear();
+        return;
+    }
+
+    Tracer::writeJson(prefix + ".json");
+    size_t spanCount = Tracer::writeChromeTrace(prefix + ".trace.json");
+    printMessage("Wrote the statistics to " + prefix + ".json and " + std::to_string(spanCount) + " spans to " + prefix + ".trace.json");
+}
+
 void UserInterface::printErrorMessage(const std::string &message) const
 {
     clear();
@@ -349,11 +824,58 @@ void UserInterface::printErrorMessage(const std::string &message) const
     clear();
 }
 
+void UserInterface::printMessage(const std::string &message) const
+{
+    clear();
+    mvprintw(0, 0, "%s", message.c_str());
+    getch();
+    clear();
+}
+
+bool UserInterface::askDeduplicationMode(const char *prompt, Deduplicator::Mode &mode)
+{
+    SmallWindow inputWindow(prompt);
+    std::string selectedOption = inputWindow.input();
+
+    if(selectedOption == "1")
+        mode = Deduplicator::SYMBOLIC_LINK;
+    else if(selectedOption == "2")
+        mode = Deduplicator::HARD_LINK;
+    else if(selectedOption == "3")
+        mode = Deduplicator::REFLINK;
+    else
+        return false;
+    return true;
+}
+
 void UserInterface::refreshScreenAndClearDirectory()
 {
     removeScreenLeftovers();
+    if(m_listing != DIRECTORY_LISTING)
+    {
+        // Files removed or moved by the last operation disappear from the list
+        if(m_listing == TOP_FILES_LISTING)
+            m_fileSystem.loadTopFiles();
+        else if(m_listing == FIND_LISTING)
+            m_fileSystem.loadFoundFiles();
+        else if(m_listing == ARCHIVE_LISTING)
+            m_fileSystem.loadArchive(m_archivePath, m_archiveDirectory);
+        else
+            loadIndexSearch();
+        m_fileSystem.setPointedAt(m_selectedRow);
+        return;
+    }
+
+
+    // Events queued so far are part of the listing loaded next
+    if(m_watcher.getDirectory() != m_currentDir)
+        m_watcher.watch(m_currentDir);
+    else
+        m_watcher.readChanges();
+
     m_fileSystem.loadFiles(m_currentDir);
     m_fileSystem.setPointedAt(m_selectedRow);
+    m_fileSystem.startDiskUsage(m_currentDir);
 }
 
 void UserInterface::handleRegex()
@@ -361,20 +883,17 @@ void UserInterface::handleRegex()
     SmallWindow inputWindow("Enter regex pattern");
     std::string inputString = inputWindow.input();
     
-    std::regex regexPattern;
     try
     {
-        regexPattern = inputString;
+        m_fileSystem.selectOnRegex(inputString);
     }
     catch(const std::exception& e)
     {
-        printErrorMessage("Invalid regex pattern");
+        printErrorMessage(e.what());
         refreshScreenAndClearDirectory();
         return;
     }
 
-    m_fileSystem.selectOnRegex(regexPattern);
-
     clear();
 
 }
@@ -397,19 +916,59 @@ void UserInterface::handleConcatenate()
         return;
     }
 
-    m_fileSystem.appendSelectedFilesTo(outputFile);
+    BatchResult result = m_fileSystem.appendSelectedFilesTo(outputFile);
 
     outputFile.close();
+    if(result.failures > 0)
+        throw std::runtime_error(std::to_string(result.failures) + " files not appended: " + result.firstError);
 
     refreshScreenAndClearDirectory();
 }
 
 void UserInterface::handleTextSearch()
 {
-    SmallWindow inputWindow("Enter text to search for");
+    SmallWindow inputWindow("Enter text to search for (a|b, @file)");
     std::string textToSearchFor = inputWindow.input();
 
-    m_fileSystem.selectOnText(textToSearchFor);
+    AhoCorasick automaton(AhoCorasick::parsePatterns(textToSearchFor, m_currentDir));
+    if(automaton.patternCount() == 0)
+    {
+        clear();
+        return;
+    }
+
+    auto matches = m_fileSystem.selectOnPatterns(automaton);
+
+    if(automaton.patternCount() > 1)
+    {
+        std::vector<std::string> reportLines;
+        for(const auto& [path, matchedPatterns] : matches)
+        {
+            std::string line = path.filename().string() + ":";
+            for(size_t pattern : matchedPatterns)
+            {
+                line += " " + automaton.getPattern(pattern);
+            }
+            reportLines.push_back(line);
+        }
+        if(reportLines.empty())
+        {
+            reportLines.push_back("No file contains any of the patterns.");
+        }
+
+        ReportWindow report("Patterns found in " + m_currentDir.string(), reportLines);
+        report.show();
+    }
+
+    clear();
+}
+
+void UserInterface::handleRegexTextSearch()
+{
+    SmallWindow inputWindow("Enter regex to search file contents for");
+    std::string inputString = inputWindow.input();
+
+    m_fileSystem.selectOnRegexText(inputString);
 
     clear();
 }
@@ -426,14 +985,465 @@ void UserInterface::handleDeduplicate()
     SmallWindow inputWindow("Enter directory you suspect has duplicates");
     fs::path directoryToSearchIn = inputWindow.getDestinationDirectory();
 
+    if(directoryToSearchIn.empty())
+    {
+        return;
+    }
+
+    Deduplicator::Mode mode;
+    if(!askDeduplicationMode("Replace by: symlink (1), hardlink (2), reflink (3)", mode))
+    {
+        refreshScreenAndClearDirectory();
+        return;
+    }
+
+    uintmax_t bytesReclaimed;
     if(directoryToSearchIn == m_currentDir)
     {
-        m_fileSystem.deduplicateSelectedFileInCurrentDirectory();
+        bytesReclaimed = m_fileSystem.deduplicateSelectedFileInCurrentDirectory(mode);
+    }
+    else
+    {
+        bytesReclaimed = m_fileSystem.deduplicateSelectedFileIn(directoryToSearchIn, mode);
+    }
+
+    printMessage("Reclaimed " + std::to_string(bytesReclaimed) + " bytes");
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::handleDuplicateReport()
+{
+    SmallWindow inputWindow("Enter directory tree to search for duplicates");
+    fs::path directoryToSearchIn = inputWindow.getDestinationDirectory();
+
+    if(directoryToSearchIn.empty())
+    {
+        return;
+    }
+
+    mvprintw(0, 0, "Searching for duplicates in %s ...", directoryToSearchIn.c_str());
+    refresh();
+
+    std::vector<DuplicateGroup> groups = m_fileSystem.findDuplicatesIn(directoryToSearchIn);
+
+    std::vector<std::string> reportLines;
+    reportLines.push_back(std::to_string(groups.size()) + " groups, " + std::to_string(DuplicateFinder::wastedBytes(groups)) + " bytes in redundant copies");
+
+    const HashCache &hashCache = m_fileSystem.getHashCache();
+    reportLines.push_back("Hash cache: " + std::to_string(hashCache.hitCount()) + " of " + std::to_string(hashCache.lookupCount())
+        + " hashes reused, " + std::to_string(hashCache.bytesHashed()) + " bytes hashed");
+    for(const auto& group : groups)
+    {
+        reportLines.push_back("");
+        reportLines.push_back(std::to_string(group.files.size()) + " copies of " + std::to_string(group.size) + " bytes:");
+        for(const auto& file : group.files)
+        {
+            reportLines.push_back("    " + file.string());
+        }
+    }
+
+    ReportWindow report("Duplicates in " + directoryToSearchIn.string(), reportLines);
+    report.show();
+
+    Deduplicator::Mode mode;
+    if(!groups.empty() && askDeduplicationMode("Replace: no (0) symlink (1) hardlink (2) reflink (3)", mode))
+    {
+        DeduplicationResult result = m_fileSystem.deduplicateGroups(groups, mode);
+        printMessage("Replaced " + std::to_string(result.filesReplaced) + " files, reclaimed " + std::to_string(result.bytesReclaimed)
+            + " bytes, " + std::to_string(result.failures) + " failed" + (result.failures ? ": " + result.firstError : ""));
+    }
+
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::handleNearDuplicateReport()
+{
+    if(m_fileSystem.selectedFilesCount() < 2)
+    {
+        printErrorMessage("Please select at least two files");
+        return;
+    }
+
+    mvprintw(0, 0, "Chunking the selected files ...");
+    refresh();
+
+    ChunkReport chunkReport = m_fileSystem.analyzeChunksOfSelectedFiles();
+
+    auto percentOf = [](uintmax_t part, uintmax_t whole)
+    {
+        return std::to_string(whole == 0 ? 0 : part * 100 / whole) + "%";
+    };
+
+    std::vector<std::string> reportLines;
+    reportLines.push_back(std::to_string(chunkReport.totalBytes) + " bytes in " + std::to_string(chunkReport.chunkCount) + " chunks, "
+        + std::to_string(chunkReport.storedBytes) + " bytes in " + std::to_string(chunkReport.distinctChunkCount) + " distinct chunks ("
+        + percentOf(chunkReport.storedBytes, chunkReport.totalBytes) + " of the total)");
+
+    reportLines.push_back("");
+    for(size_t i = 0; i < chunkReport.files.size(); i++)
+    {
+        reportLines.push_back(chunkReport.files[i].filename().string() + ": " + std::to_string(chunkReport.fileSizes[i]) + " bytes, "
+            + percentOf(chunkReport.uniqueBytes[i], chunkReport.fileSizes[i]) + " not repeated inside the file");
+    }
+
+    reportLines.push_back("");
+    for(size_t first = 0; first < chunkReport.files.size(); first++)
+    {
+        for(size_t second = first + 1; second < chunkReport.files.size(); second++)
+        {
+            uintmax_t shared = chunkReport.sharedBytes[first][second];
+            reportLines.push_back(chunkReport.files[first].filename().string() + " <-> " + chunkReport.files[second].filename().string() + ": "
+                + std::to_string(shared) + " bytes shared (" + percentOf(shared, chunkReport.fileSizes[first]) + " / "
+                + percentOf(shared, chunkReport.fileSizes[second]) + ")");
+        }
+    }
+
+    ReportWindow report("Chunks shared by the selected files", reportLines);
+    report.show();
+}
+
+void UserInterface::handleSubtreeReport()
+{
+    SmallWindow inputWindow("Enter directory tree to search for identical directories");
+    fs::path directoryToSearchIn = inputWindow.getDestinationDirectory();
+
+    if(directoryToSearchIn.empty())
+    {
+        return;
+    }
+
+    mvprintw(0, 0, "Hashing directories in %s ...", directoryToSearchIn.c_str());
+    refresh();
+
+    std::vector<SubtreeGroup> groups = m_fileSystem.findIdenticalSubtreesIn(directoryToSearchIn);
+
+    uintmax_t wastedBytes = 0;
+    for(const auto& group : groups)
+    {
+        wastedBytes += group.size * (group.directories.size() - 1);
+    }
+
+    std::vector<std::string> reportLines;
+    reportLines.push_back(std::to_string(groups.size()) + " groups, " + std::to_string(wastedBytes) + " bytes in redundant copies");
+
+    const HashCache &hashCache = m_fileSystem.getHashCache();
+    reportLines.push_back("Hash cache: " + std::to_string(hashCache.hitCount()) + " of " + std::to_string(hashCache.lookupCount())
+        + " hashes reused, " + std::to_string(hashCache.bytesHashed()) + " bytes hashed");
+    for(const auto& group : groups)
+    {
+        reportLines.push_back("");
+        reportLines.push_back(std::to_string(group.directories.size()) + " copies of " + std::to_string(group.fileCount) + " files, "
+            + std::to_string(group.size) + " bytes:");
+        for(const auto& directory : group.directories)
+        {
+            reportLines.push_back("    " + directory.string());
+        }
+    }
+
+    ReportWindow report("Identical directories in " + directoryToSearchIn.string(), reportLines);
+    report.show();
+
+    Deduplicator::Mode mode;
+    if(!groups.empty() && askDeduplicationMode("Collapse: no (0) symlink (1) hardlink (2) reflink (3)", mode))
+    {
+        DeduplicationResult result = m_fileSystem.deduplicateSubtrees(groups, mode);
+        printMessage("Collapsed " + std::to_string(result.filesReplaced) + " directories, reclaimed " + std::to_string(result.bytesReclaimed)
+            + " bytes, " + std::to_string(result.failures) + " failed" + (result.failures ? ": " + result.firstError : ""));
+    }
+
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::handleMirror()
+{
+    SmallWindow targetWindow("Enter directory to compare with");
+    fs::path target = targetWindow.getDestinationDirectory();
+
+    if(target.empty())
+    {
+        return;
+    }
+
+    SmallWindow contentWindow("Compare contents: no (0) yes (1)");
+    bool isContentChecked = contentWindow.input() == "1";
+
+    mvprintw(0, 0, "Comparing %s with %s ...", m_currentDir.c_str(), target.c_str());
+    refresh();
+
+    auto start = std::chrono::steady_clock::now();
+    DirectoryComparison comparison = m_fileSystem.compareDirectories(m_currentDir, target, isContentChecked);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t counts[3] = {0, 0, 0};
+    std::vector<std::string> reportLines;
+    reportLines.push_back("");
+    for(const auto& entry : comparison.differences)
+    {
+        counts[entry.difference]++;
+        const char *marks[] = {"+ ", "- ", "* "};
+        std::string line = marks[entry.difference] + entry.relativePath.string() + (entry.isDirectory ? "/" : "");
+        if(!entry.isDirectory)
+            line += "  " + DiskUsage::formatSize(entry.size);
+        reportLines.push_back(line);
+    }
+    for(const auto& path : comparison.unreadableDirectories)
+    {
+        reportLines.push_back("! " + (path.empty() ? std::string(".") : path.string()) + "/");
+    }
+    char summary[192];
+    std::snprintf(summary, sizeof(summary), "%zu added (+), %zu removed (-), %zu changed (*), %zu identical (%s), %zu unreadable (!) in %.2f s",
+        counts[ComparedEntry::ADDED], counts[ComparedEntry::REMOVED], counts[ComparedEntry::CHANGED], comparison.identicalCount,
+        DiskUsage::formatSize(comparison.identicalBytes).c_str(), comparison.unreadableDirectories.size(), seconds);
+    reportLines[0] = summary;
+
+    ReportWindow report("Compare " + m_currentDir.string() + " with " + target.string(), reportLines);
+    report.show();
+
+    if(!comparison.differences.empty())
+    {
+        SmallWindow mirrorWindow("Mirror: no (0) copy (1) copy, delete extras (2)");
+        std::string option = mirrorWindow.input();
+        if(option == "1" || option == "2")
+        {
+            MirrorResult result = m_fileSystem.mirrorDirectories(comparison, option == "2");
+            printMessage("Copied " + std::to_string(result.entriesCopied) + " entries, " + std::to_string(result.bytesCopied) + " bytes ("
+                + std::to_string(result.bytesWritten) + " written), removed "
+                + std::to_string(result.entriesRemoved) + ", " + std::to_string(result.failures) + " failed");
+        }
+    }
+
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::handleTopFiles()
+{
+    SmallWindow criterionWindow("Largest (1) or oldest (2) files");
+    std::string criterionOption = criterionWindow.input();
+
+    TopFilesFinder::Criterion criterion;
+    if(criterionOption == "1")
+        criterion = TopFilesFinder::LARGEST;
+    else if(criterionOption == "2")
+        criterion = TopFilesFinder::OLDEST;
+    else
+        return;
+
+    SmallWindow countWindow("Number of files (100 if empty)");
+    std::string countString = countWindow.input();
+
+    size_t count = 100;
+    if(!countString.empty())
+    {
+        if(countString.find_first_not_of("0123456789") != std::string::npos || countString.size() > 9)
+            throw std::runtime_error("Invalid number of files");
+        count = std::stoul(countString);
+    }
+
+    m_fileSystem.startTopFiles(m_currentDir, criterion, count);
+    m_fileSystem.stopFind();
+    m_listing = TOP_FILES_LISTING;
+    m_resultsPending = true;
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::handleFind()
+{
+    SmallWindow queryWindow("Find (name: type: size: mtime: user: ...)");
+    std::string query = queryWindow.input();
+
+    if(query.empty())
+    {
+        return;
+    }
+
+    m_fileSystem.startFind(m_currentDir, query);
+    m_fileSystem.stopTopFiles();
+    m_findQuery = query;
+    m_listing = FIND_LISTING;
+    m_resultsPending = true;
+    m_selectedRow = 0;
+    m_printFrom = 0;
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::refreshResults()
+{
+    clear();
+    if(m_listing == TOP_FILES_LISTING)
+    {
+        m_resultsPending = m_fileSystem.isFindingTopFiles();
+        m_fileSystem.loadTopFiles();
     }
     else
     {
-        m_fileSystem.deduplicateSelectedFileIn(directoryToSearchIn);
+        m_resultsPending = m_fileSystem.isFinding();
+        m_fileSystem.appendFoundFiles();
+    }
+
+    int totalRows = m_fileSystem.filesInCurrentDirectory();
+    if(m_selectedRow >= totalRows)
+        m_selectedRow = totalRows > 0 ? totalRows - 1 : 0;
+    if(m_printFrom > m_selectedRow)
+        m_printFrom = m_selectedRow;
+    m_fileSystem.setPointedAt(m_selectedRow);
+}
+
+void UserInterface::leaveResults()
+{
+    m_fileSystem.stopTopFiles();
+    m_fileSystem.stopFind();
+    m_listing = DIRECTORY_LISTING;
+    m_resultsPending = false;
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::handleIndexDirectory()
+{
+    mvprintw(0, 0, "Indexing %s ...", m_currentDir.c_str());
+    refresh();
+
+    IndexStatistics statistics = m_fileSystem.indexDirectory(m_currentDir);
+    printMessage("Indexed " + std::to_string(statistics.entryCount) + " paths, " + std::to_string(statistics.directoriesRead)
+        + " directories read, " + std::to_string(statistics.directoriesReused) + " unchanged");
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::handleIndexSearch()
+{
+    SmallWindow inputWindow("Search the index for file names");
+    std::string query = inputWindow.input();
+
+    if(query.empty())
+    {
+        return;
     }
 
+    m_fileSystem.stopTopFiles();
+    m_fileSystem.stopFind();
+    m_resultsPending = false;
+    m_indexQuery = query;
+    m_listing = INDEX_SEARCH_LISTING;
     refreshScreenAndClearDirectory();
 }
+
+void UserInterface::loadIndexSearch()
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<IndexEntry> entries = m_fileSystem.searchIndex(m_indexQuery);
+    m_indexSearchMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<fs::path> paths;
+    for(const auto& entry : entries)
+    {
+        paths.push_back(entry.path);
+    }
+    m_fileSystem.loadPaths(paths);
+}
+
+void UserInterface::openSearchResult()
+{
+    if(m_selectedRow >= m_fileSystem.filesInCurrentDirectory())
+    {
+        return;
+    }
+
+    fs::path path = m_fileSystem.getPathAt(m_selectedRow);
+    m_fileSystem.stopTopFiles();
+    m_fileSystem.stopFind();
+    m_resultsPending = false;
+    m_currentDir = path.parent_path();
+    m_listing = DIRECTORY_LISTING;
+    refreshScreenAndClearDirectory();
+
+    int index = m_fileSystem.indexOf(path);
+    if(index < 0)
+    {
+        return;
+    }
+
+    m_fileSystem.dePointAt(m_selectedRow);
+    m_selectedRow = index;
+    m_fileSystem.setPointedAt(m_selectedRow);
+    if(m_selectedRow >= listingHeight())
+        m_printFrom = m_selectedRow - (listingHeight() - 1);
+}
+
+void UserInterface::openArchive(const fs::path &archive)
+{
+    mvprintw(0, 0, "Indexing %s ...", archive.c_str());
+    clrtoeol();
+    refresh();
+
+    try
+    {
+        m_fileSystem.loadArchive(archive, "");
+    }
+    catch(const std::exception &e)
+    {
+        printErrorMessage(e.what());
+        return;
+    }
+
+    m_archivePath = archive;
+    m_archiveDirectory.clear();
+    m_listing = ARCHIVE_LISTING;
+    if(size_t skipped = m_fileSystem.skippedArchiveMembers())
+        printMessage(std::to_string(skipped) + " members leave the archive with .., they are not listed");
+    refreshScreenAndClearDirectory();
+}
+
+void UserInterface::openArchiveMember()
+{
+    if(m_selectedRow >= m_fileSystem.filesInCurrentDirectory())
+    {
+        return;
+    }
+
+    const auto &member = static_cast<const ArchiveMember &>(m_fileSystem.getFileAt(m_selectedRow));
+    const TarEntry &entry = member.getEntry();
+    if(entry.type == '5')
+    {
+        m_archiveDirectory = entry.path;
+        refreshScreenAndClearDirectory();
+    }
+    else if(entry.type == '0')
+    {
+        try
+        {
+            // The member is mapped straight from the archive, nothing is extracted
+            PreviewWindow preview(m_archivePath, entry.dataOffset, entry.size, member.getPath().string());
+            preview.show();
+        }
+        catch(const std::exception &e)
+        {
+            printErrorMessage(e.what());
+        }
+    }
+}
+
+void UserInterface::moveUpInArchive()
+{
+    if(!m_archiveDirectory.empty())
+    {
+        size_t slash = m_archiveDirectory.rfind('/');
+        m_archiveDirectory = slash == std::string::npos ? "" : m_archiveDirectory.substr(0, slash);
+        refreshScreenAndClearDirectory();
+        return;
+    }
+
+    m_fileSystem.closeArchive();
+    m_listing = DIRECTORY_LISTING;
+    refreshScreenAndClearDirectory();
+
+    int index = m_fileSystem.indexOf(m_archivePath);
+    if(index < 0)
+    {
+        return;
+    }
+
+    m_fileSystem.dePointAt(m_selectedRow);
+    m_selectedRow = index;
+    m_fileSystem.setPointedAt(m_selectedRow);
+    if(m_selectedRow >= listingHeight())
+        m_printFrom = m_selectedRow - (listingHeight() - 1);
+}
@@ -4,8 +4,9 @@
 #include <memory>
 #include <string>
 #include "FileSystem.h"
+#include "FileListView.h"
+#include "StatsPanel.h"
 #include <fstream>
-#include <regex>
 
 namespace fs = std::filesystem;
 
@@ -48,8 +49,31 @@ private:
 
     static constexpr int m_normalFileColorPair = 1; /**< The color pair number for normal display. */
     static constexpr int m_selectedFileColorPair = 2; /**< The color pair number for selected display. */
+    FileListView m_fileListView; /**< Prints the files of the file system. */
 
     int m_printFrom; /**< The index of the first file to be printed. */
+    /**
+     * @brief What the listing shows.
+     */
+    enum Listing
+    {
+        DIRECTORY_LISTING, /**< The files of m_currentDir. */
+        TOP_FILES_LISTING, /**< The largest or the oldest files below m_currentDir. */
+        INDEX_SEARCH_LISTING, /**< The paths of the metadata index matching m_indexQuery. */
+        FIND_LISTING, /**< The files below m_currentDir matching m_findQuery. */
+        ARCHIVE_LISTING /**< The members of m_archiveDirectory in the archive m_archivePath. */
+    };
+
+    Listing m_listing; /**< What the listing shows. */
+    bool m_resultsPending; /**< True until the listing shows the final result of the search for the largest or the oldest files or of the find query. */
+    DirectoryWatcher m_watcher; /**< Reports the changes of m_currentDir made by other processes. */
+    std::string m_indexQuery; /**< The last query of the metadata index. */
+    double m_indexSearchMilliseconds; /**< How long the last query of the metadata index took. */
+    std::string m_findQuery; /**< The last find query. */
+    fs::path m_archivePath; /**< The archive browsed in m_currentDir. */
+    std::string m_archiveDirectory; /**< The directory listed in the archive, empty for its top. */
+    StatsPanel m_statsPanel; /**< Prints the statistics of the tracer. */
+    bool m_isStatsShown; /**< True while the statistics are shown under the listing. */
 
 private:
     /**
@@ -74,10 +98,28 @@ private:
     void moveArrowKey(Direction currentDirection);
 
     /**
-     * @brief Opens the selected file or directory.
+     * @brief Opens the selected file or directory, regular files are shown in the preview.
      */
     void open();
 
+    /**
+     * @brief Shows the contents of the file in a full screen preview until the user closes it.
+     * @param path The path to the file.
+     */
+    void previewFile(const fs::path &path);
+
+    /**
+     * @brief Waits for a key, applying the changes of the current directory while waiting.
+     * @param timeoutMilliseconds The longest wait, -1 to wait for a key or a change.
+     * @return The key, ERR if the wait ended without a key.
+     */
+    int readKey(int timeoutMilliseconds);
+
+    /**
+     * @brief Reads the changes of the current directory and applies them to the listing, the cursor stays on its file.
+     */
+    void handleDirectoryChanges();
+
     /**
      * @brief Moves to the upper directory.
      */
@@ -99,10 +141,38 @@ private:
     void handleMove();
 
     /**
-     * @brief Handles the remove command.
+     * @brief Renames the selected files by a regular expression and a replacement inputed by user.
+     *
+     * The new names and the conflicts are shown in a report first, the files are renamed only when there are no conflicts.
+     */
+    void handleBatchRename();
+
+    /**
+     * @brief Handles the remove command, the selected files are moved to the trash, those that cannot be are deleted permanently once confirmed.
      */
     void handleRemove();
 
+    /**
+     * @brief Shows the entries of the trash in a report, the chosen ones can then be restored or the trash emptied.
+     */
+    void handleTrash();
+
+    /**
+     * @brief Shows or hides the statistics of the tracer under the listing.
+     */
+    void toggleStats();
+
+    /**
+     * @brief Writes the statistics of the tracer as JSON and its spans as a Chrome trace, to paths inputed by user.
+     */
+    void handleTraceDump();
+
+    /**
+     * @brief Gets the number of rows the listing may take.
+     * @return The rows between the title and the last row, without the statistics when they are shown.
+     */
+    int listingHeight() const;
+
     /**
      * @brief Handles the create command.
      */
@@ -129,6 +199,28 @@ private:
     */
     void printErrorMessage(const std::string& message) const;
 
+    /**
+     * @brief Prints a message to the screen and waits for a key press.
+     * @param message The message to be printed.
+    */
+    void printMessage(const std::string& message) const;
+
+    /**
+     * @brief Asks the user how duplicates should be replaced.
+     * @param prompt The title of the input window.
+     * @param mode Set to the chosen mode.
+     * @return False if the user chose not to replace the duplicates.
+     */
+    bool askDeduplicationMode(const char *prompt, Deduplicator::Mode &mode);
+
+    /**
+     * @brief Parses a list of numbers and ranges such as "1 3-5".
+     * @param input The list.
+     * @param maximum The largest valid number.
+     * @return The numbers in the order given, the invalid ones are left out.
+     */
+    static std::vector<size_t> parseNumbers(const std::string &input, size_t maximum);
+
 
     /**
      * @brief Reprints the screen with the current directory and the cursour pointing at the selected file.
@@ -147,15 +239,113 @@ private:
 
 
     /**
-     * @brief Selects all the files in m_currentDir that contain the text inputed by user.
+     * @brief Selects all the files in m_currentDir that contain any of the patterns inputed by user.
+     *
+     * The patterns are separated by '|', or loaded one per line from a file when the input starts with '@'.
+     * Every file is read once and a report of the patterns found in each file is shown.
      */
     void handleTextSearch();
 
     /**
-     * @brief Finds all the files that are duplicates to the selected file and changes them to symbolic links to the selected file.
+     * @brief Selects all the files in m_currentDir with a line that matches the regex inputed by user.
+     */
+    void handleRegexTextSearch();
+
+    /**
+     * @brief Finds all the files that are duplicates to the selected file and changes them to symbolic, hard or reflinks to the selected file.
      */
     void handleDeduplicate();
 
+    /**
+     * @brief Finds all the groups of duplicate files in a tree inputed by user and shows them in a report.
+     *
+     * The duplicates can then be replaced by links to the first file of their group.
+     */
+    void handleDuplicateReport();
+
+    /**
+     * @brief Shows how many bytes the selected files share at the level of content-defined chunks.
+     *
+     * Tells where block-level dedup or delta storage would pay off for files that are similar but not identical.
+     */
+    void handleNearDuplicateReport();
+
+    /**
+     * @brief Finds all the groups of identical directories in a tree inputed by user and shows them in a report.
+     *
+     * The copies can then be collapsed into the first directory of their group and links.
+     */
+    void handleSubtreeReport();
+
+    /**
+     * @brief Compares the current directory with a directory inputed by user and shows the differences in a report.
+     *
+     * The other directory can then be made a mirror of the current one, only the added and changed entries are copied.
+     */
+    void handleMirror();
+
+    /**
+     * @brief Starts searching for the largest or the oldest files below the current directory and lists them as they are found.
+     *
+     * The listed files can be selected, removed, moved and copied like the files of a directory, u returns to the directory.
+     */
+    void handleTopFiles();
+
+    /**
+     * @brief Asks for a find query and lists the files below the current directory matching it as they are found.
+     *
+     * See FindQuery for the syntax, u returns to the directory.
+     */
+    void handleFind();
+
+    /**
+     * @brief Lists the largest or the oldest files or the files matching the find query found so far, keeps the cursor where it was.
+     */
+    void refreshResults();
+
+    /**
+     * @brief Stops showing the largest or the oldest files or the search results and lists the current directory again.
+     */
+    void leaveResults();
+
+    /**
+     * @brief Adds the current directory to the metadata index and updates the index.
+     */
+    void handleIndexDirectory();
+
+    /**
+     * @brief Searches the metadata index for file names containing the text inputed by user and lists the matching paths.
+     *
+     * Enter on a listed path opens its directory with the cursor on it, u returns to the current directory.
+     */
+    void handleIndexSearch();
+
+    /**
+     * @brief Lists the paths of the metadata index matching m_indexQuery.
+     */
+    void loadIndexSearch();
+
+    /**
+     * @brief Opens the directory of the path at the cursor and moves the cursor to it.
+     */
+    void openSearchResult();
+
+    /**
+     * @brief Lists the top of the tar archive, indexing it first when its index is not saved.
+     * @param archive The path to the archive in m_currentDir.
+     */
+    void openArchive(const fs::path &archive);
+
+    /**
+     * @brief Lists the directory member at the cursor or previews the regular member at the cursor.
+     */
+    void openArchiveMember();
+
+    /**
+     * @brief Lists the directory of the archive above the listed one, leaves the archive at its top.
+     */
+    void moveUpInArchive();
+
 
  
 
@@ -1,8 +1,25 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include "CommandLine.h"
 #include "UserInterface.h"
 
-int main()
+int main(int argc, char *argv[])
 {
+    if(argc > 1)
+    {
+        try
+        {
+            CommandLine commandLine(std::cout, std::cerr);
+            return commandLine.run(std::vector<std::string>(argv + 1, argv + argc));
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+            return CommandLine::FAILURE;
+        }
+    }
+
     try
     {
         UserInterface interface;